@@ -4,11 +4,34 @@
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <gio/gnetworking.h>
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <sys/file.h>
+#else
+#include <io.h>
+#include <sys/locking.h>
+#endif
+
+// Saves are written with g_file_set_contents_full
+#if !GLIB_CHECK_VERSION(2, 66, 0)
+#error "GLib 2.66 or newer is required"
+#endif
 
 #define SIZE 36
 #define BOARD_WIDTH 6
 #define BOARD_HEIGHT 6
-#define SAVE_FILE "game_save.dat"
+#define DEFAULT_SLOT "quicksave"
+#define SLOT_SUFFIX ".dat"
+#define SLOT_NAME_MAX 32
+#define INDEX_FILE "index.dat"
+#define INDEX_MAGIC "MGSI"
+#define INDEX_VERSION 1
+#define STATS_FILE "perf_stats.json"
+#define WEIGHTS_FILE "eval_weights.txt"
 
 // Game state
 int game_board[SIZE] = {
@@ -24,6 +47,54 @@ int player_move_matrix[SIZE] = {0}; // 0=none, 1=player, 2=computer
 int player_score = 0, computer_score = 0;
 int com_choice = -1;
 int game_over = 0;
+guint64 computer_turn_start = 0; // when play_computer_turn scheduled the pending move
+guint computer_move_source = 0;  // pending com_move timeout, 0 if none
+GCancellable *level_search = NULL; // running difficulty-level search, NULL if none
+
+// One applied move, enough to undo or redo it in constant time
+typedef struct {
+    uint8_t cell;
+    uint8_t owner;           // 1=player, 2=computer
+    uint8_t prev_multiplier; // number the mover multiplied by
+    uint8_t factor;          // number the mover chose; the next side's multiplier
+    gint think_remaining;    // history only: computer's think budget left after the move, for undo/redo
+} MoveRecord;
+
+// Make/unmake history of a board. Entries between count and top are undone
+// moves that can still be redone; making a new move discards them.
+typedef struct {
+    MoveRecord moves[SIZE];
+    int count;
+    int top;
+} MoveStack;
+
+MoveStack history; // moves of the current game
+extern gint think_budget, think_remaining; // think-time manager, defined with think_time()
+
+// Save slot index. Each slot is a save file in the per-user save directory;
+// index.dat holds one fixed-size record per slot so the slot browser can list
+// them without opening every save. It is updated in place on save and rebuilt
+// from the slot files when missing or corrupt.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t record_size;
+} SlotIndexHeader;
+
+typedef struct {
+    char name[SLOT_NAME_MAX];
+    int64_t saved_at;       // seconds since the epoch
+    int32_t player_score;
+    int32_t computer_score;
+    int32_t com_choice;
+    int32_t move_count;
+    uint8_t thumbnail[9];   // 2 bits per cell: 0=none, 1=player, 2=computer
+    uint8_t game_over;
+    uint8_t reserved[6];
+} SlotInfo;
+
+gchar *current_slot = NULL; // slot last saved or loaded
 
 // Simulated CPU Registers
 typedef struct {
@@ -34,6 +105,378 @@ typedef struct {
 
 CPU cpu; // global simulated CPU
 
+// Small seedable PCG32 generator. The game carries its own state instead of the
+// global rand(), so a game replays exactly from its seed and worker threads can
+// each own a generator without contention.
+typedef struct {
+    uint64_t state;
+    uint64_t inc;
+} Rng;
+
+uint32_t rng_next(Rng *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void rng_seed(Rng *rng, uint64_t seed) {
+    rng->state = 0;
+    rng->inc = (seed << 1u) | 1u;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+// Uniform integer in [0, n)
+int rng_range(Rng *rng, int n) {
+    return (int)(((uint64_t)rng_next(rng) * (uint32_t)n) >> 32);
+}
+
+uint64_t game_seed = 0; // seed of the current session, from --seed or the clock
+gint64 seed_option = -1; // --seed value; -1 picks a seed from the clock
+Rng game_rng;
+
+// Precomputed products of the factors 0-9. The engine uses this table on its
+// hot paths; the register-updating multiply() is kept for user-visible moves.
+// Build with -DVERIFY_PRODUCT_TABLE to check both paths against each other.
+static const int product_table[10][10] = {
+    { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9},
+    { 0,  2,  4,  6,  8, 10, 12, 14, 16, 18},
+    { 0,  3,  6,  9, 12, 15, 18, 21, 24, 27},
+    { 0,  4,  8, 12, 16, 20, 24, 28, 32, 36},
+    { 0,  5, 10, 15, 20, 25, 30, 35, 40, 45},
+    { 0,  6, 12, 18, 24, 30, 36, 42, 48, 54},
+    { 0,  7, 14, 21, 28, 35, 42, 49, 56, 63},
+    { 0,  8, 16, 24, 32, 40, 48, 56, 64, 72},
+    { 0,  9, 18, 27, 36, 45, 54, 63, 72, 81}
+};
+
+// Evaluation weights of the computer player. The defaults are the original
+// hand-picked constants; a weights file (as written by the console build's
+// --tune) overrides them.
+enum {
+    W_CENTER,            // centre bonus, minus the distance to the centre
+    W_OWN_LINE,          // per own piece in the same row or column
+    W_OPPONENT_LINE,     // per opponent piece in the same row or column
+    W_OWN_DIAGONAL,      // cell lies on a main diagonal (own lines)
+    W_OPPONENT_DIAGONAL, // cell lies on a main diagonal (opponent lines)
+    W_NOISE,             // random tie-break in [0, noise)
+    W_THREE_THRESHOLD,   // pieces in a row/column that trigger the setup stage
+    WEIGHT_COUNT
+};
+
+static const char *weight_names[WEIGHT_COUNT] = {
+    "center", "own_line", "opponent_line", "own_diagonal", "opponent_diagonal", "noise", "three_threshold"
+};
+
+static const int weight_min[WEIGHT_COUNT] = { -10, -10, -10, -10, -10, 1, 2 };
+static const int weight_max[WEIGHT_COUNT] = { 20, 10, 10, 10, 10, 10, 6 };
+
+int eval_weights[WEIGHT_COUNT] = { 4, 1, 1, 2, 2, 3, 3 };
+gchar *weights_path = NULL; // --weights; defaults to WEIGHTS_FILE
+
+// Load evaluation weights from a "name value" text file
+int load_weights(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        char name[64];
+        int value;
+        if (line[0] == '#' || sscanf(line, "%63s %d", name, &value) != 2)
+            continue;
+
+        int found = 0;
+        for (int i = 0; i < WEIGHT_COUNT; i++) {
+            if (strcmp(name, weight_names[i]) == 0) {
+                eval_weights[i] = CLAMP(value, weight_min[i], weight_max[i]);
+                found = 1;
+            }
+        }
+        if (!found)
+            g_printerr("%s: unknown weight '%s' ignored\n", path, name);
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+// Hot-path performance counters. Each thread accumulates into its own block and
+// the blocks are chained so the Stats window can sum them. With --trace FILE the
+// same probes also record spans that are written as a Chrome trace at exit.
+// Build with -DNO_PERF_STATS to compile the probes out entirely.
+#if !defined(__GNUC__) && !defined(NO_PERF_STATS)
+#define NO_PERF_STATS // scoped probes rely on __attribute__((cleanup))
+#endif
+
+typedef enum {
+    PERF_COM_MOVE,
+    PERF_STAGE_WIN,
+    PERF_STAGE_BLOCK,
+    PERF_STAGE_THREE,
+    PERF_STAGE_EVALUATE,
+    PERF_WIN_CHECK,
+    PERF_GET_INDEX,
+    PERF_EVALUATE_POSITION,
+    PERF_UPDATE_BOARD_UI,
+    PERF_UI_FLUSH,
+    PERF_SAVE_GAME,
+    PERF_LOAD_GAME,
+    PERF_COUNT
+} PerfId;
+
+static const char *perf_names[PERF_COUNT] = {
+    "com_move",
+    "com_move: win",
+    "com_move: block",
+    "com_move: three-in-row",
+    "com_move: evaluate",
+    "win_check",
+    "getIndex",
+    "evaluate_position",
+    "update_board_ui",
+    "ui_flush",
+    "save_game",
+    "load_game"
+};
+
+#ifndef NO_PERF_STATS
+// Probes that also become trace spans; the sub-microsecond ones would only add
+// noise. The last id must stay listed so the assert catches a new id's omission.
+static const gboolean perf_traced[] = {
+    [PERF_COM_MOVE] = TRUE,
+    [PERF_STAGE_WIN] = TRUE,
+    [PERF_STAGE_BLOCK] = TRUE,
+    [PERF_STAGE_THREE] = TRUE,
+    [PERF_STAGE_EVALUATE] = TRUE,
+    [PERF_UPDATE_BOARD_UI] = TRUE,
+    [PERF_UI_FLUSH] = TRUE,
+    [PERF_SAVE_GAME] = TRUE,
+    [PERF_LOAD_GAME] = TRUE
+};
+_Static_assert(G_N_ELEMENTS(perf_traced) == PERF_COUNT, "perf_traced needs an entry for every PerfId");
+#endif
+
+// One complete ("X") trace event: a named span on the recording thread
+typedef struct {
+    const char *name;
+    guint64 start;
+    guint64 duration;
+} TraceEvent;
+
+#define TRACE_CHUNK_EVENTS 4096
+
+typedef struct TraceChunk {
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+    int count;
+    struct TraceChunk *next;
+} TraceChunk;
+
+typedef struct PerfBlock {
+    guint64 calls[PERF_COUNT];
+    guint64 nanos[PERF_COUNT];
+    int tid;                   // small id used as the trace thread id
+    TraceChunk *trace_head;    // trace events, written only by the owning thread
+    TraceChunk *trace_tail;
+    struct PerfBlock *next;
+} PerfBlock;
+
+static PerfBlock *perf_blocks = NULL; // every live thread's block, newest first
+static PerfBlock perf_retired;        // counters of threads that have exited
+static int perf_block_count = 0;
+G_LOCK_DEFINE_STATIC(perf_blocks);
+static void perf_block_retire(gpointer data);
+static GPrivate perf_key = G_PRIVATE_INIT(perf_block_retire);
+
+gchar *trace_path = NULL; // set by --trace; NULL disables tracing
+guint64 trace_epoch = 0;
+
+// Monotonic clock in nanoseconds
+static guint64 perf_now() {
+#ifdef G_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * 1000000000u + (guint64)ts.tv_nsec;
+#else
+    return (guint64)g_get_monotonic_time() * 1000u;
+#endif
+}
+
+// Runs when a thread exits: folds its counters into perf_retired and frees its
+// block. A block holding trace events stays listed until trace_flush writes it.
+static void perf_block_retire(gpointer data) {
+    PerfBlock *block = data;
+
+    G_LOCK(perf_blocks);
+    for (int i = 0; i < PERF_COUNT; i++) {
+        perf_retired.calls[i] += block->calls[i];
+        perf_retired.nanos[i] += block->nanos[i];
+    }
+    memset(block->calls, 0, sizeof(block->calls));
+    memset(block->nanos, 0, sizeof(block->nanos));
+
+    if (block->trace_head == NULL) {
+        PerfBlock **link = &perf_blocks;
+        while (*link != block)
+            link = &(*link)->next;
+        *link = block->next;
+        g_free(block);
+    }
+    G_UNLOCK(perf_blocks);
+}
+
+// Returns the calling thread's block, registering it on first use
+static PerfBlock *perf_block() {
+    PerfBlock *block = g_private_get(&perf_key);
+    if (block == NULL) {
+        block = g_new0(PerfBlock, 1);
+        G_LOCK(perf_blocks);
+        block->tid = ++perf_block_count;
+        block->next = perf_blocks;
+        perf_blocks = block;
+        G_UNLOCK(perf_blocks);
+        g_private_set(&perf_key, block);
+    }
+    return block;
+}
+
+// Appends a span to the calling thread's trace buffer. Only the owning thread
+// writes its chunks, so no locking is needed until the flush at exit.
+void trace_complete(const char *name, guint64 start) {
+    if (trace_path == NULL || start == 0)
+        return;
+
+    guint64 end = perf_now();
+    PerfBlock *block = perf_block();
+    TraceChunk *chunk = block->trace_tail;
+    if (chunk == NULL || chunk->count == TRACE_CHUNK_EVENTS) {
+        TraceChunk *fresh = g_new0(TraceChunk, 1);
+        if (chunk == NULL)
+            block->trace_head = fresh;
+        else
+            chunk->next = fresh;
+        block->trace_tail = chunk = fresh;
+    }
+
+    TraceEvent *event = &chunk->events[chunk->count++];
+    event->name = name;
+    event->start = start;
+    event->duration = end - start;
+}
+
+// Writes every thread's events as a Chrome/Perfetto trace file
+int trace_flush() {
+    if (trace_path == NULL)
+        return 0;
+
+    FILE *fp = fopen(trace_path, "w");
+    if (!fp) {
+        g_printerr("Error opening trace file %s\n", trace_path);
+        return 0;
+    }
+
+    fprintf(fp, "{\"traceEvents\": [\n");
+    int first = 1;
+    G_LOCK(perf_blocks);
+    for (PerfBlock *block = perf_blocks; block != NULL; block = block->next) {
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", block->tid,
+                block->tid == 1 ? "main" : "worker");
+        first = 0;
+        for (TraceChunk *chunk = block->trace_head; chunk != NULL; chunk = chunk->next) {
+            for (int i = 0; i < chunk->count; i++) {
+                TraceEvent *event = &chunk->events[i];
+                fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                        "\"ts\": %.3f, \"dur\": %.3f}", event->name, block->tid,
+                        (event->start - trace_epoch) / 1000.0, event->duration / 1000.0);
+            }
+        }
+    }
+    G_UNLOCK(perf_blocks);
+    fprintf(fp, "\n]}\n");
+
+    fclose(fp);
+    return 1;
+}
+
+#ifndef NO_PERF_STATS
+static void perf_record(PerfId id, guint64 start) {
+    PerfBlock *block = perf_block();
+    block->calls[id]++;
+    block->nanos[id] += perf_now() - start;
+    if (perf_traced[id])
+        trace_complete(perf_names[id], start);
+}
+
+typedef struct {
+    PerfId id;
+    guint64 start;
+} PerfScope;
+
+static void perf_scope_end(PerfScope *scope) {
+    perf_record(scope->id, scope->start);
+}
+
+#define PERF_BEGIN(id) guint64 perf_start_##id = perf_now()
+#define PERF_END(id) perf_record(id, perf_start_##id)
+#define PERF_SCOPE(id) PerfScope perf_scope_##id __attribute__((cleanup(perf_scope_end))) = { id, perf_now() }
+#else
+#define PERF_BEGIN(id)
+#define PERF_END(id)
+#define PERF_SCOPE(id)
+#endif
+
+// Sums the counters of every thread into totals
+void perf_snapshot(PerfBlock *totals) {
+    memset(totals, 0, sizeof(*totals));
+    G_LOCK(perf_blocks);
+    memcpy(totals->calls, perf_retired.calls, sizeof(totals->calls));
+    memcpy(totals->nanos, perf_retired.nanos, sizeof(totals->nanos));
+    for (PerfBlock *block = perf_blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < PERF_COUNT; i++) {
+            totals->calls[i] += block->calls[i];
+            totals->nanos[i] += block->nanos[i];
+        }
+    }
+    G_UNLOCK(perf_blocks);
+}
+
+// Clears the counters of every thread
+void perf_reset() {
+    G_LOCK(perf_blocks);
+    memset(&perf_retired, 0, sizeof(perf_retired));
+    for (PerfBlock *block = perf_blocks; block != NULL; block = block->next) {
+        memset(block->calls, 0, sizeof(block->calls));
+        memset(block->nanos, 0, sizeof(block->nanos));
+    }
+    G_UNLOCK(perf_blocks);
+}
+
+// Writes the summed counters to a JSON file
+int perf_export_json(const char *path) {
+    PerfBlock totals;
+    perf_snapshot(&totals);
+
+    GString *json = g_string_new("{\n  \"counters\": [\n");
+    for (int i = 0; i < PERF_COUNT; i++) {
+        guint64 avg = totals.calls[i] ? totals.nanos[i] / totals.calls[i] : 0;
+        g_string_append_printf(json,
+            "    {\"name\": \"%s\", \"calls\": %" G_GUINT64_FORMAT ", \"total_ns\": %" G_GUINT64_FORMAT
+            ", \"avg_ns\": %" G_GUINT64_FORMAT "}%s\n",
+            perf_names[i], totals.calls[i], totals.nanos[i], avg, i + 1 < PERF_COUNT ? "," : "");
+    }
+    g_string_append(json, "  ]\n}\n");
+
+    gboolean ok = g_file_set_contents(path, json->str, json->len, NULL);
+    g_string_free(json, TRUE);
+    return ok;
+}
+
 // GTK UI Elements
 GtkWidget *window;
 GtkWidget *game_grid;
@@ -47,23 +490,49 @@ GtkWidget *cpu_state_window = NULL;
 GtkWidget *regA_label = NULL;
 GtkWidget *regB_label = NULL;
 GtkWidget *acc_label = NULL;
+GtkWidget *stats_window = NULL;
+GtkWidget *new_game_button = NULL;
+GtkWidget *save_game_button = NULL;
+GtkWidget *load_game_button = NULL;
+GtkWidget *undo_button = NULL;
+GtkWidget *redo_button = NULL;
+gboolean show_hints = FALSE; // --hints, or the Show hints check box
+gboolean save_io_busy = FALSE; // a background save or load is running
+gint bench_games = 0; // --bench-ui: scripted games to play, 0 for a normal session
+#define UI_BENCH_SLOT "ui-bench" // the slot the benchmark saves to
+GtkWidget *stats_labels[PERF_COUNT][3];
 
 // Function declarations
 void update_board_ui();
+void update_hints();
 void update_score_label();
 void update_status_label(const char *message);
+void update_choice_label();
+void update_cpu_state();
 void setup_new_game();
 void cpu_state_window_create();
+void stats_window_create();
+void update_stats_window();
 void play_computer_turn(int player_choice);
+void cancel_computer_turn();
+gboolean computer_turn_pending();
 int check_move(int player_id, int num1, int num2);
 int multiply(int *a, int *b);
+int product(int a, int b);
 int getIndex(int idx);
 int win_check(int player_id);
 void com_move(int player_num);
+void apply_computer_move(int player_num, int comp_num);
 int evaluate_position(int idx);
 int isBoardFull();
-int save_game();
-int load_game();
+int save_game(const char *slot);
+int load_game(const char *slot);
+void record_match(int result);
+void finish_game(int result);
+void publish_move(int cell, int owner, int factor);
+void publish_snapshot();
+void show_save_dialog();
+void show_load_dialog();
 
 // Multiplies two numbers using bitwise operations for simulation
 int multiply(int *a, int *b) {
@@ -81,11 +550,41 @@ int multiply(int *a, int *b) {
         y >>= 1;
     }
 
+#ifdef VERIFY_PRODUCT_TABLE
+    if (*a >= 0 && *a <= 9 && *b >= 0 && *b <= 9 && product_table[*a][*b] != cpu.acc) {
+        g_printerr("Product table mismatch: %d x %d = %d (table %d)\n",
+                   *a, *b, cpu.acc, product_table[*a][*b]);
+        abort();
+    }
+#endif
+
     return cpu.acc;
 }
 
+// Multiplies two factors (1-9) by table lookup, without touching the CPU registers.
+// Factors outside the table (e.g. from a corrupt save) give 0, which is on no board cell.
+int product(int a, int b) {
+    if ((unsigned)a > 9 || (unsigned)b > 9)
+        return 0;
+#ifdef VERIFY_PRODUCT_TABLE
+    int x = a, y = b, acc = 0;
+    while (y > 0) {
+        if (y & 1)
+            acc += x;
+        x <<= 1;
+        y >>= 1;
+    }
+    if (acc != product_table[a][b]) {
+        g_printerr("Product table mismatch: %d x %d = %d (table %d)\n", a, b, acc, product_table[a][b]);
+        abort();
+    }
+#endif
+    return product_table[a][b];
+}
+
 // Gets the index of a number in the game board
 int getIndex(int idx) {
+    PERF_SCOPE(PERF_GET_INDEX);
     for (int i = 0; i < SIZE; i++) {
         if (game_board[i] == idx)
             return i;
@@ -93,12 +592,75 @@ int getIndex(int idx) {
     return -1;
 }
 
+// Apply a move and push it on the stack. A new move discards the redo history.
+void make_move(int *moves, int *multiplier, MoveStack *stack, int cell, int owner, int factor) {
+    MoveRecord *record = &stack->moves[stack->count++];
+    record->cell = (uint8_t)cell;
+    record->owner = (uint8_t)owner;
+    record->prev_multiplier = (uint8_t)*multiplier;
+    record->factor = (uint8_t)factor;
+    stack->top = stack->count;
+
+    moves[cell] = owner;
+    *multiplier = factor;
+}
+
+// Take back the last move; returns 0 if there is none
+int unmake_move(int *moves, int *multiplier, MoveStack *stack) {
+    if (stack->count == 0)
+        return 0;
+
+    MoveRecord *record = &stack->moves[--stack->count];
+    moves[record->cell] = 0;
+    *multiplier = record->prev_multiplier;
+    return 1;
+}
+
+// Replay the last undone move; returns 0 if there is none
+int redo_move(int *moves, int *multiplier, MoveStack *stack) {
+    if (stack->count == stack->top)
+        return 0;
+
+    MoveRecord *record = &stack->moves[stack->count++];
+    moves[record->cell] = record->owner;
+    *multiplier = record->factor;
+    return 1;
+}
+
+// The computer's think budget at the current point of the history
+gint history_think_remaining() {
+    return history.count > 0 ? history.moves[history.count - 1].think_remaining : think_budget;
+}
+
+// Undo back to the player's previous turn: the computer's reply (if any) and the player's move
+int undo_turn() {
+    if (history.count == 0)
+        return 0;
+
+    int owner = history.moves[history.count - 1].owner;
+    unmake_move(player_move_matrix, &com_choice, &history);
+    if (owner == 2)
+        unmake_move(player_move_matrix, &com_choice, &history);
+    return 1;
+}
+
+// Redo the player's move and the computer's reply that followed it
+int redo_turn() {
+    if (!redo_move(player_move_matrix, &com_choice, &history))
+        return 0;
+
+    if (history.count < history.top && history.moves[history.count].owner == 2)
+        redo_move(player_move_matrix, &com_choice, &history);
+    return 1;
+}
+
 // Check if a move is valid and apply it
 int check_move(int player_id, int num1, int num2) {
     int result = multiply(&num1, &num2);
     int idx = getIndex(result);
     if (idx != -1 && player_move_matrix[idx] == 0) {
-        player_move_matrix[idx] = player_id;
+        make_move(player_move_matrix, &com_choice, &history, idx, player_id, num1);
+        history.moves[history.count - 1].think_remaining = think_remaining;
         return idx;
     }
     return -1;
@@ -115,6 +677,7 @@ int isBoardFull() {
 
 // Check for 4-in-a-row win condition
 int win_check(int player_id) {
+    PERF_SCOPE(PERF_WIN_CHECK);
     // Rows
     for (int row = 0; row < BOARD_HEIGHT; row++) {
         for (int col = 0; col <= BOARD_WIDTH - 4; col++) {
@@ -168,6 +731,7 @@ int win_check(int player_id) {
 
 // Calculate a position's strategic value (0-10)
 int evaluate_position(int idx) {
+    PERF_SCOPE(PERF_EVALUATE_POSITION);
     int value = 0;
     int row = idx / BOARD_WIDTH;
     int col = idx % BOARD_WIDTH;
@@ -177,11 +741,12 @@ int evaluate_position(int idx) {
     int center_col = BOARD_WIDTH / 2;
     int row_distance = abs(row - center_row);
     int col_distance = abs(col - center_col);
-    value += 4 - (row_distance + col_distance);
+    value += eval_weights[W_CENTER] - (row_distance + col_distance);
 
     // Prefer positions that could form a line
     for (int player_id = 1; player_id <= 2; player_id++) {
-        int multiplier = (player_id == 2) ? 1 : -1; // Prefer own lines, avoid opponent's
+        int own = (player_id == 2); // Prefer own lines, avoid opponent's
+        int line_weight = own ? eval_weights[W_OWN_LINE] : -eval_weights[W_OPPONENT_LINE];
 
         // Check rows
         int row_count = 0;
@@ -190,7 +755,7 @@ int evaluate_position(int idx) {
             if (player_move_matrix[check_idx] == player_id)
                 row_count++;
         }
-        value += multiplier * row_count;
+        value += line_weight * row_count;
 
         // Check columns
         int col_count = 0;
@@ -199,429 +764,3767 @@ int evaluate_position(int idx) {
             if (player_move_matrix[check_idx] == player_id)
                 col_count++;
         }
-        value += multiplier * col_count;
+        value += line_weight * col_count;
 
         // Diagonal checks (simplified)
         if ((row == col) || (row + col == BOARD_WIDTH - 1)) {
-            value += multiplier * 2; // Diagonals are valuable
+            value += own ? eval_weights[W_OWN_DIAGONAL] : -eval_weights[W_OPPONENT_DIAGONAL];
         }
     }
 
     // Add some randomness to prevent predictable play
-    value += rand() % 3;
+    value += rng_range(&game_rng, eval_weights[W_NOISE]);
 
     return value;
 }
 
-// Advanced computer move logic
-void com_move(int player_num) {
-    int comp_num = -1;
-    int best_idx = -1;
-    int best_value = -1000;
+// Alpha-beta search. A position is the board, the multiplier and the side to
+// move; a move picks a factor whose product with the multiplier is a free
+// cell, and that factor becomes the opponent's multiplier. Completing four in
+// a line wins; a full board or a side with no legal factor is a draw.
+#define SEARCH_WIN 10000 // score of a win at the root, minus the plies to reach it
+#define SEARCH_POLL_NODES 1024
+
+static int product_cell[10][10];  // board index of a x b, or -1
+static int search_windows[54][4]; // every four-cell line on the board
+static int search_window_count = 0;
+static guint64 zobrist_cells[SIZE][3]; // position hash keys per cell and owner
+static guint64 zobrist_multiplier[10];
+
+typedef struct Search Search;
+struct Search {
+    int moves[SIZE];
+    int multiplier;
+    MoveStack stack;
+    guint64 nodes;
+    gboolean aborted;
+    gboolean (*poll)(Search *search); // called every SEARCH_POLL_NODES nodes; TRUE aborts
+    gpointer poll_data;
+    guint64 node_limit;  // nodes to give up at, 0 for none
+    int noise;           // +- points of random noise on each evaluation
+    Rng *rng;            // source of the noise
+};
 
-    // 1. First try to find a winning move
-    for (int i = 1; i <= 9; i++) {
-        int result = multiply(&i, &player_num);
-        int idx = getIndex(result);
-        if (idx != -1 && player_move_matrix[idx] == 0) {
-            // Temporarily make the move
-            player_move_matrix[idx] = 2;
-            if (win_check(2)) {
-                comp_num = i;
-                best_idx = idx;
-                player_move_matrix[idx] = 0; // Undo temporary move
-                break;
-            }
-            player_move_matrix[idx] = 0; // Undo temporary move
-        }
+// splitmix64 step, used to fill the hash keys from a fixed seed
+static guint64 zobrist_next(guint64 *state) {
+    guint64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Fill the lookup tables; call once before any search runs
+void search_init() {
+    for (int a = 0; a <= 9; a++) {
+        for (int b = 0; b <= 9; b++)
+            product_cell[a][b] = getIndex(product(a, b));
     }
 
-    // 2. If no winning move, try to block player's potential win
-    if (comp_num == -1) {
-        for (int i = 1; i <= 9; i++) {
-            int result = multiply(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_move_matrix[idx] == 0) {
-                // Check if player would win with this position
-                player_move_matrix[idx] = 1;
-                if (win_check(1)) {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_move_matrix[idx] = 0; // Undo temporary move
-                    break;
-                }
-                player_move_matrix[idx] = 0; // Undo temporary move
+    guint64 state = 0x4D554C54; // fixed, so hashes are stable between runs
+    for (int i = 0; i < SIZE; i++) {
+        for (int owner = 0; owner < 3; owner++)
+            zobrist_cells[i][owner] = zobrist_next(&state);
+    }
+    for (int m = 0; m <= 9; m++)
+        zobrist_multiplier[m] = zobrist_next(&state);
+
+    static const int steps[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+    search_window_count = 0;
+    for (int row = 0; row < BOARD_HEIGHT; row++) {
+        for (int col = 0; col < BOARD_WIDTH; col++) {
+            for (int d = 0; d < 4; d++) {
+                int end_row = row + 3 * steps[d][0];
+                int end_col = col + 3 * steps[d][1];
+                if (end_row >= BOARD_HEIGHT || end_col < 0 || end_col >= BOARD_WIDTH)
+                    continue;
+                for (int k = 0; k < 4; k++)
+                    search_windows[search_window_count][k] =
+                        (row + k * steps[d][0]) * BOARD_WIDTH + col + k * steps[d][1];
+                search_window_count++;
             }
         }
     }
+}
 
-    // 3. Look for 3-in-a-row setups (both offensive and defensive)
-    if (comp_num == -1) {
-        // Look for possible computer 3-in-a-row
-        for (int i = 1; i <= 9; i++) {
-            int result = multiply(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_move_matrix[idx] == 0) {
-                player_move_matrix[idx] = 2;
-
-                // Check rows
-                int row = idx / BOARD_WIDTH;
-                int count = 0;
-                for (int col = 0; col < BOARD_WIDTH; col++) {
-                    if (player_move_matrix[row * BOARD_WIDTH + col] == 2)
-                        count++;
-                }
-                if (count >= 3) {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_move_matrix[idx] = 0;
-                    break;
-                }
+// Hash of a board and the multiplier of the side to move
+guint64 position_hash(const int *moves, int multiplier) {
+    guint64 hash = zobrist_multiplier[CLAMP(multiplier, 0, 9)];
+    for (int i = 0; i < SIZE; i++)
+        hash ^= zobrist_cells[i][moves[i]];
+    return hash;
+}
 
-                // Check columns
-                int col = idx % BOARD_WIDTH;
-                count = 0;
-                for (int row = 0; row < BOARD_HEIGHT; row++) {
-                    if (player_move_matrix[row * BOARD_WIDTH + col] == 2)
-                        count++;
-                }
-                if (count >= 3) {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_move_matrix[idx] = 0;
-                    break;
-                }
+// Does the piece on idx complete four in a line through it?
+static int search_wins_at(const int *moves, int idx) {
+    static const int steps[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+    int owner = moves[idx];
+    int row = idx / BOARD_WIDTH;
+    int col = idx % BOARD_WIDTH;
 
-                player_move_matrix[idx] = 0;
+    for (int d = 0; d < 4; d++) {
+        int run = 1;
+        for (int sign = -1; sign <= 1; sign += 2) {
+            int r = row + sign * steps[d][0];
+            int c = col + sign * steps[d][1];
+            while (r >= 0 && r < BOARD_HEIGHT && c >= 0 && c < BOARD_WIDTH &&
+                   moves[r * BOARD_WIDTH + c] == owner) {
+                run++;
+                r += sign * steps[d][0];
+                c += sign * steps[d][1];
             }
         }
+        if (run >= 4)
+            return 1;
     }
+    return 0;
+}
 
-    // 4. If still no strategic move found, evaluate all positions
-    if (comp_num == -1) {
-        for (int i = 1; i <= 9; i++) {
-            int result = multiply(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_move_matrix[idx] == 0) {
-                int value = evaluate_position(idx);
-                if (value > best_value) {
-                    best_value = value;
-                    comp_num = i;
-                    best_idx = idx;
-                }
-            }
+// Static score for player me: open lines weighted by the square of their pieces
+static int search_evaluate(const int *moves, int me) {
+    int score = 0;
+    for (int w = 0; w < search_window_count; w++) {
+        int mine = 0, theirs = 0;
+        for (int k = 0; k < 4; k++) {
+            int owner = moves[search_windows[w][k]];
+            if (owner == me)
+                mine++;
+            else if (owner != 0)
+                theirs++;
         }
+        if (theirs == 0)
+            score += mine * mine * eval_weights[W_OWN_LINE];
+        else if (mine == 0)
+            score -= theirs * theirs * eval_weights[W_OPPONENT_LINE];
     }
+    return score;
+}
 
-    // Apply the computer's move
-    if (comp_num != -1) {
-        int result = multiply(&comp_num, &player_num);
-        int idx = getIndex(result);
-        player_move_matrix[idx] = 2;
-        com_choice = comp_num;
-
-        // Update UI
-        char message[100];
-        sprintf(message, "Computer chose: %d → %d × %d = %d", comp_num, comp_num, player_num, result);
-        update_status_label(message);
+// Negamax with alpha-beta for the side me; *best_factor gets the best move at this node
+static int search_node(Search *s, int depth, int alpha, int beta, int me, int ply, int first, int *best_factor) {
+    if (++s->nodes % SEARCH_POLL_NODES == 0 && s->poll != NULL && s->poll(s))
+        s->aborted = TRUE;
+    if (s->node_limit && s->nodes >= s->node_limit)
+        s->aborted = TRUE;
+    if (s->aborted)
+        return 0;
 
-        if (computer_choice_label != NULL) {
-            char comp_choice_text[50];
-            sprintf(comp_choice_text, "Computer's choice: %d", comp_num);
-            gtk_label_set_text(GTK_LABEL(computer_choice_label), comp_choice_text);
+    int best = -SEARCH_WIN - 1;
+    int best_move = -1;
+    for (int n = 0; n <= 9; n++) {
+        // Try the suggested factor first, then the rest in order
+        int factor = n == 0 ? first : n;
+        if (factor < 1 || (n > 0 && factor == first))
+            continue;
+        int idx = product_cell[factor][s->multiplier];
+        if (idx == -1 || s->moves[idx] != 0)
+            continue;
+
+        make_move(s->moves, &s->multiplier, &s->stack, idx, me, factor);
+        int score;
+        if (search_wins_at(s->moves, idx))
+            score = SEARCH_WIN - ply;
+        else if (depth <= 1) {
+            score = search_evaluate(s->moves, me);
+            if (s->noise)
+                score += rng_range(s->rng, 2 * s->noise + 1) - s->noise;
+        } else
+            score = -search_node(s, depth - 1, -beta, -alpha, 3 - me, ply + 1, 0, NULL);
+        unmake_move(s->moves, &s->multiplier, &s->stack);
+
+        if (s->aborted)
+            return 0;
+        if (score > best) {
+            best = score;
+            best_move = factor;
         }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta)
+            break;
+    }
 
-        update_board_ui();
+    if (best_factor != NULL)
+        *best_factor = best_move;
+    return best_move == -1 ? 0 : best; // no legal factor: draw
+}
 
-        if (win_check(2)) {
-            computer_score++;
-            update_score_label();
-            update_status_label("Computer wins!");
-            game_over = 1;
-        } else if (isBoardFull()) {
-            update_status_label("Game ends in a tie!");
-            game_over = 1;
-        }
+// Search the position for player me to the given depth. Returns the score and
+// stores the best factor (-1 if none); the result is meaningless if aborted.
+int search_root(Search *s, int me, int depth, int previous_best, int *best_factor) {
+    s->stack.count = s->stack.top = 0;
+    s->aborted = FALSE;
+    return search_node(s, depth, -SEARCH_WIN - 1, SEARCH_WIN + 1, me, 1, previous_best, best_factor);
+}
+
+// Difficulty levels. Level 0 thinks for as long as the think-time manager
+// allows; the others search a fixed number of nodes per move with noisy
+// evaluations, so a move costs the same on any machine and, with --seed,
+// replays exactly. The level search runs on a worker thread.
+typedef struct {
+    const char *name;
+    guint64 nodes; // search budget per move
+    int noise;     // +- points added to each evaluation
+} Difficulty;
+
+static const Difficulty difficulty_levels[] = {
+    { "adaptive", 0, 0 },
+    { "beginner", 200, 60 },
+    { "easy", 2000, 25 },
+    { "medium", 20000, 10 },
+    { "hard", 200000, 3 },
+    { "expert", 1000000, 0 }
+};
+
+int difficulty = 0;           // selected level
+gchar *level_option = NULL;   // --level, a number or a name
+
+// Level number from a number or a name, or -1
+int parse_level(const char *text) {
+    for (int i = 0; i < (int)G_N_ELEMENTS(difficulty_levels); i++) {
+        if (strcmp(text, difficulty_levels[i].name) == 0)
+            return i;
     }
+    char *end;
+    long level = strtol(text, &end, 10);
+    return *end == '\0' && end != text && level >= 0 && level < (long)G_N_ELEMENTS(difficulty_levels) ? (int)level : -1;
 }
 
-// Save game state to file
-int save_game() {
-    FILE *fp = fopen(SAVE_FILE, "wb");
-    if (!fp) {
-        update_status_label("Error opening save file!");
-        return 0;
+typedef struct {
+    int moves[SIZE];
+    int multiplier;  // the player's factor
+    int level;
+    Rng rng;         // noise, drawn from the game's generator when the turn starts
+} LevelJob;
+
+static gboolean level_search_poll(Search *search) {
+    return g_cancellable_is_cancelled(search->poll_data);
+}
+
+// Iterative deepening until the level's node budget runs out; returns the factor
+static void level_search_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    LevelJob *job = task_data;
+    const Difficulty *level = &difficulty_levels[job->level];
+    Search search = { .poll = level_search_poll, .poll_data = cancellable,
+                      .node_limit = level->nodes, .noise = level->noise, .rng = &job->rng };
+    memcpy(search.moves, job->moves, sizeof(search.moves));
+    search.multiplier = job->multiplier;
+
+    int empty = 0;
+    for (int i = 0; i < SIZE; i++)
+        empty += job->moves[i] == 0;
+
+    int best = -1;
+    for (int depth = 1; depth <= empty; depth++) {
+        int factor;
+        guint64 iteration_start = trace_path ? perf_now() : 0;
+        int score = search_root(&search, 2, depth, best, &factor);
+        trace_complete("search_iteration", iteration_start);
+        if (search.aborted)
+            break;
+        best = factor;
+        if (best == -1 || abs(score) >= SEARCH_WIN - SIZE)
+            break;
+    }
+    g_task_return_int(task, best);
+}
+
+// Think-time manager. Each game has a budget of thinking time for the
+// computer (--think-budget). A move gets an even share of what is left over
+// the computer's remaining moves, scaled by how many factors are playable and
+// doubled when the opponent threatens to win. Forced moves and immediate
+// wins are played at once. The computer's search keeps deepening for as long
+// as its move is delayed, so the delay is real thinking time; with pondering
+// off (--ponder 0) nothing would search, so there is no delay.
+#define THINK_BUDGET_MS 6000
+#define THINK_MAX_MS 2000
+
+gint think_budget = THINK_BUDGET_MS; // per game, in milliseconds
+gint think_remaining = THINK_BUDGET_MS;
+
+// Milliseconds to think for player me to move against multiplier
+int think_time(const int *moves, int multiplier, int me, int remaining) {
+    int legal = 0, empty = 0, threatened = 0;
+    int cells[SIZE];
+    memcpy(cells, moves, sizeof(cells));
+
+    for (int factor = 1; factor <= 9; factor++) {
+        int idx = product_cell[factor][multiplier];
+        if (idx == -1 || cells[idx] != 0)
+            continue;
+        legal++;
+        cells[idx] = me;
+        int wins = search_wins_at(cells, idx);
+        cells[idx] = 0;
+        if (wins)
+            return 0;
     }
+    if (legal <= 1)
+        return 0;
 
-    // Save player move matrix
-    fwrite(player_move_matrix, sizeof(int), SIZE, fp);
+    for (int idx = 0; idx < SIZE; idx++) {
+        if (cells[idx] != 0)
+            continue;
+        empty++;
+        cells[idx] = 3 - me;
+        threatened |= search_wins_at(cells, idx);
+        cells[idx] = 0;
+    }
 
-    // Save scores
-    fwrite(&player_score, sizeof(int), 1, fp);
-    fwrite(&computer_score, sizeof(int), 1, fp);
+    int moves_left = (empty + 1) / 2;
+    int share = remaining / MAX(moves_left, 1) * legal / 9;
+    if (threatened)
+        share *= 2;
+    return MIN(share, MIN(THINK_MAX_MS, remaining));
+}
 
-    // Save computer choice
-    fwrite(&com_choice, sizeof(int), 1, fp);
+// Pondering: while the player thinks, a background thread searches the
+// computer's reply to each of the nine factors the player may choose. Once the
+// player clicks, the thread keeps deepening that one reply until the computer
+// moves. ponder_share limits its CPU use while the player is still thinking.
+// Results are kept per position hash, so returning to a position (undo, redo,
+// a new game with the same opening) resumes from the depth already reached.
+// The hint overlay on the number pad shows the same results.
+typedef struct {
+    int depth;        // deepest completed search, 0 if none yet
+    int factor;       // computer's best reply, -1 if the player's choice is illegal, 0 if it wins
+    int score;
+    gboolean complete; // proven, or searched to the end of the game
+} PonderResult;
 
-    // Save game state
-    fwrite(&game_over, sizeof(int), 1, fp);
+typedef struct {
+    int moves[SIZE];
+    int multiplier;
+} PonderJob;
 
-    fclose(fp);
-    update_status_label("Game saved successfully!");
-    return 1;
+typedef struct {
+    guint64 hash;
+    PonderResult results[9];
+} PonderCacheEntry;
+
+#define PONDER_CACHE_MAX 4096 // positions kept before the cache starts over
+
+gint ponder_share = 50;           // --ponder: CPU percent while the player thinks, 0 disables
+static GThread *ponder_thread = NULL;
+static gint ponder_stop = 0;       // set to make the thread return
+static gint ponder_focus = 0;      // factor the player chose, 0 while still thinking
+static gint64 ponder_slice_start = 0;
+static PonderResult ponder_results[9];
+static guint64 ponder_hash = 0;   // position the results belong to, 0 if none
+static GHashTable *ponder_cache = NULL; // position hash -> PonderCacheEntry
+static gint hint_refresh_pending = 0;
+G_LOCK_DEFINE_STATIC(ponder_results);
+
+static gboolean hint_refresh_idle(gpointer data);
+
+// Ask the main loop to redraw the hints; repeated requests collapse into one
+static void queue_hint_refresh() {
+    if (g_atomic_int_compare_and_exchange(&hint_refresh_pending, 0, 1))
+        g_idle_add(hint_refresh_idle, NULL);
 }
 
-// Load game state from file
-int load_game() {
-    FILE *fp = fopen(SAVE_FILE, "rb");
-    if (!fp) {
-        update_status_label("No saved game found.");
-        return 0;
-    }
+// Abort on stop; while unfocused, sleep off the CPU share not granted to pondering
+static gboolean ponder_poll(Search *search) {
+    if (g_atomic_int_get(&ponder_stop))
+        return TRUE;
 
-    // Load player move matrix
-    if (fread(player_move_matrix, sizeof(int), SIZE, fp) != SIZE) {
-        update_status_label("Error reading save file!");
-        fclose(fp);
-        return 0;
+    if (ponder_share < 100 && g_atomic_int_get(&ponder_focus) == 0) {
+        gint64 busy = g_get_monotonic_time() - ponder_slice_start;
+        g_usleep(busy * (100 - ponder_share) / ponder_share);
+        ponder_slice_start = g_get_monotonic_time();
     }
+    return FALSE;
+}
 
-    // Load scores
-    if (fread(&player_score, sizeof(int), 1, fp) != 1 ||
-        fread(&computer_score, sizeof(int), 1, fp) != 1) {
-        update_status_label("Error reading save file!");
-        fclose(fp);
-        return 0;
-    }
+static gpointer ponder_thread_main(gpointer data) {
+    PonderJob *job = data;
+    Search search = { .poll = ponder_poll };
+    ponder_slice_start = g_get_monotonic_time();
+
+    while (!g_atomic_int_get(&ponder_stop)) {
+        // Deepen the focused choice, or else the shallowest unfinished one
+        int focus = g_atomic_int_get(&ponder_focus);
+        int choice = -1;
+        G_LOCK(ponder_results);
+        for (int i = 0; i < 9; i++) {
+            if (ponder_results[i].complete || (focus != 0 && i != focus - 1))
+                continue;
+            if (choice == -1 || ponder_results[i].depth < ponder_results[choice].depth)
+                choice = i;
+        }
+        PonderResult current = choice != -1 ? ponder_results[choice] : (PonderResult){ 0 };
+        G_UNLOCK(ponder_results);
+        if (choice == -1)
+            break;
+
+        // Apply the player's choice, then search the computer's reply one ply deeper
+        memcpy(search.moves, job->moves, sizeof(search.moves));
+        search.multiplier = job->multiplier;
+        int idx = product_cell[choice + 1][job->multiplier];
+        PonderResult next = { current.depth + 1, -1, 0, TRUE };
+        if (idx != -1 && search.moves[idx] == 0) {
+            search.moves[idx] = 1;
+            search.multiplier = choice + 1;
+
+            // A choice that completes four in a line ends the game; there is no reply to search
+            if (search_wins_at(search.moves, idx)) {
+                next.factor = 0;
+                next.score = -SEARCH_WIN;
+            } else {
+                int empty = 0;
+                for (int i = 0; i < SIZE; i++)
+                    empty += search.moves[i] == 0;
+
+                guint64 iteration_start = trace_path ? perf_now() : 0;
+                next.score = search_root(&search, 2, next.depth, current.factor, &next.factor);
+                trace_complete("ponder_iteration", iteration_start);
+                if (search.aborted)
+                    break;
+                next.complete = next.depth >= empty || abs(next.score) >= SEARCH_WIN - SIZE;
+            }
+        }
 
-    // Load computer choice
-    if (fread(&com_choice, sizeof(int), 1, fp) != 1) {
-        update_status_label("Error reading save file!");
-        fclose(fp);
-        return 0;
+        G_LOCK(ponder_results);
+        ponder_results[choice] = next;
+        G_UNLOCK(ponder_results);
+        queue_hint_refresh();
     }
 
-    // Load game state
-    if (fread(&game_over, sizeof(int), 1, fp) != 1) {
-        update_status_label("Error reading save file!");
-        fclose(fp);
-        return 0;
+    g_free(job);
+    return NULL;
+}
+
+// Stop pondering, keeping its results in the cache
+void reset_ponder() {
+    if (ponder_thread != NULL) {
+        g_atomic_int_set(&ponder_stop, 1);
+        g_thread_join(ponder_thread);
+        ponder_thread = NULL;
     }
 
+    if (ponder_hash != 0) {
+        if (ponder_cache == NULL)
+            ponder_cache = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+        else if (g_hash_table_size(ponder_cache) >= PONDER_CACHE_MAX)
+            g_hash_table_remove_all(ponder_cache);
+
+        PonderCacheEntry *entry = g_hash_table_lookup(ponder_cache, &ponder_hash);
+        if (entry == NULL) {
+            entry = g_new(PonderCacheEntry, 1);
+            entry->hash = ponder_hash;
+            g_hash_table_insert(ponder_cache, &entry->hash, entry);
+        }
+        memcpy(entry->results, ponder_results, sizeof(entry->results));
+    }
+
+    memset(ponder_results, 0, sizeof(ponder_results));
+    ponder_hash = 0;
+    g_atomic_int_set(&ponder_focus, 0);
+}
+
+// Start pondering the current position, where the player is to move
+void start_ponder() {
+    reset_ponder();
+    if (ponder_share <= 0 || game_over || com_choice < 1)
+        return;
+
+    ponder_hash = position_hash(player_move_matrix, com_choice);
+    PonderCacheEntry *entry = ponder_cache ? g_hash_table_lookup(ponder_cache, &ponder_hash) : NULL;
+    if (entry != NULL)
+        memcpy(ponder_results, entry->results, sizeof(ponder_results));
+    queue_hint_refresh();
+
+    PonderJob *job = g_new(PonderJob, 1);
+    memcpy(job->moves, player_move_matrix, sizeof(job->moves));
+    job->multiplier = com_choice;
+    g_atomic_int_set(&ponder_stop, 0);
+    ponder_thread = g_thread_new("ponder", ponder_thread_main, job);
+}
+
+// The player chose factor: spend the thread's full effort on that reply
+void focus_ponder(int factor) {
+    g_atomic_int_set(&ponder_focus, factor);
+}
+
+// Has the reply to factor already been searched to the end?
+gboolean ponder_complete(int factor) {
+    G_LOCK(ponder_results);
+    gboolean complete = ponder_results[factor - 1].complete && ponder_results[factor - 1].depth > 0;
+    G_UNLOCK(ponder_results);
+    return complete;
+}
+
+// Stop pondering and return the pondered reply to factor; 0 if none was found
+int take_ponder_result(int factor, PonderResult *result) {
+    if (ponder_thread == NULL)
+        return 0;
+
+    g_atomic_int_set(&ponder_stop, 1);
+    g_thread_join(ponder_thread);
+    ponder_thread = NULL;
+    *result = ponder_results[factor - 1];
+    reset_ponder();
+    return result->depth > 0 && result->factor > 0;
+}
+
+// Perfect-play book written by the console version's solver (--solve). Each
+// record is a position on a proof tree, its value for the side to move and
+// the move to play: the winning move, a move that holds the draw, or in a
+// lost position the defence that took the solver longest to refute. Records
+// are 12 bytes, sorted, so a lookup is a binary search of the loaded file.
+#define BOOK_MAGIC "MGBK"
+#define BOOK_VERSION 1
+
+// Game values: of an opening for side 1, or of a book position for the side to move
+enum { VALUE_UNKNOWN, VALUE_WIN, VALUE_DRAW, VALUE_LOSS };
+
+// cells: bit i of words[0..1] and the low 8 bits of words[2] (cells 0-35 of
+// side 1, then side 2); then multiplier (4 bits), side - 1 (1), move (4) and
+// value (2)
+typedef struct {
+    guint32 words[3];
+} BookRecord;
+
+#define BOOK_KEY_MASK 0x1FFFu // the bits of words[2] that belong to the position
+
+typedef struct {
+    char magic[4];
+    guint32 version;
+    guint32 count;
+    guint8 values[10];        // value of each opening multiplier 1-9 for side 1
+    guint8 reserved[2];
+} BookHeader;
+
+typedef struct {
+    BookHeader header;
+    BookRecord *records;
+} Book;
+
+gchar *book_path = NULL; // --book
+Book *book = NULL;       // the computer plays its moves when it has one
+
+static void book_key(BookRecord *record, const int *moves, int multiplier, int side) {
+    guint64 mask[2] = { 0, 0 };
+    for (int i = 0; i < SIZE; i++) {
+        if (moves[i] != 0)
+            mask[moves[i] - 1] |= G_GUINT64_CONSTANT(1) << i;
+    }
+    record->words[0] = (guint32)mask[0];
+    record->words[1] = (guint32)(mask[0] >> 32) | (guint32)(mask[1] << 4);
+    record->words[2] = (guint32)(mask[1] >> 28) | (guint32)multiplier << 8 | (guint32)(side - 1) << 12;
+}
+
+static int compare_book_records(const void *a, const void *b) {
+    const BookRecord *x = a, *y = b;
+    for (int i = 0; i < 2; i++) {
+        if (x->words[i] != y->words[i])
+            return x->words[i] < y->words[i] ? -1 : 1;
+    }
+    guint32 kx = x->words[2] & BOOK_KEY_MASK, ky = y->words[2] & BOOK_KEY_MASK;
+    return kx < ky ? -1 : kx > ky;
+}
+
+// Returns NULL if the file is missing, truncated or holds a move outside 1-9
+Book *load_book(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    Book *loaded = g_new0(Book, 1);
+    gboolean ok = fread(&loaded->header, sizeof(loaded->header), 1, fp) == 1 &&
+                  memcmp(loaded->header.magic, BOOK_MAGIC, 4) == 0 && loaded->header.version == BOOK_VERSION;
+
+    // The count must match the file's length before it sizes an allocation
+    long end = ok && fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    ok = ok && end >= 0 &&
+         (guint64)end == sizeof(BookHeader) + (guint64)loaded->header.count * sizeof(BookRecord) &&
+         fseek(fp, (long)sizeof(BookHeader), SEEK_SET) == 0;
+    if (ok) {
+        loaded->records = g_new(BookRecord, (gsize)loaded->header.count + 1);
+        ok = fread(loaded->records, sizeof(BookRecord), loaded->header.count, fp) == loaded->header.count;
+    }
+    for (guint32 i = 0; ok && i < loaded->header.count; i++) {
+        int move = (loaded->records[i].words[2] >> 13) & 0xF;
+        ok = move >= 1 && move <= 9;
+    }
+    fclose(fp);
+    if (!ok) {
+        g_free(loaded->records);
+        g_free(loaded);
+        return NULL;
+    }
+    return loaded;
+}
+
+// The book move for side against multiplier, or -1 if the position is not in
+// the book or its move does not fit the board
+int book_move(const Book *b, const int *moves, int multiplier, int side) {
+    BookRecord key;
+    book_key(&key, moves, multiplier, side);
+    BookRecord *found = bsearch(&key, b->records, b->header.count, sizeof(BookRecord), compare_book_records);
+    if (found == NULL)
+        return -1;
+    int move = (found->words[2] >> 13) & 0xF;
+    int idx = getIndex(product(move, multiplier));
+    return idx != -1 && moves[idx] == 0 ? move : -1; // else the caller searches
+}
+
+// Opening multiplier that is best for the computer (side 2), or -1 if the book has no values
+int book_opening(const Book *b, Rng *rng) {
+    int best = -1, best_rank = 3, ties = 0;
+    for (int m = 1; m <= 9; m++) {
+        // A loss for the player first, then a draw, then a win
+        int value = b->header.values[m];
+        int rank = value == VALUE_LOSS ? 0 : value == VALUE_DRAW ? 1 : value == VALUE_WIN ? 2 : 3;
+        if (rank < best_rank) {
+            best_rank = rank;
+            best = m;
+            ties = 1;
+        } else if (rank == best_rank && rank < 3 && rng_range(rng, ++ties) == 0) {
+            best = m;
+        }
+    }
+    return best_rank < 3 ? best : -1;
+}
+
+// Advanced computer move logic. Book positions are played from the perfect-play
+// book; trial moves go through a scratch move stack.
+void com_move(int player_num) {
+    trace_complete("play_computer_turn", computer_turn_start);
+    PERF_SCOPE(PERF_COM_MOVE);
+    int comp_num = -1;
+    int best_idx = -1;
+    int best_value = -1000;
+    int multiplier = player_num;
+    MoveStack trial = { .count = 0, .top = 0 };
+
+    if (book != NULL && (comp_num = book_move(book, player_move_matrix, player_num, 2)) != -1)
+        best_idx = getIndex(product(comp_num, player_num));
+
+    // 0. Play the reply searched while the player was thinking. A one-ply
+    // search sees less than the rule cascade, so it must have gone deeper.
+    PonderResult pondered;
+    if (comp_num == -1 && take_ponder_result(player_num, &pondered) && (pondered.depth >= 2 || pondered.complete)) {
+        comp_num = pondered.factor;
+        best_idx = getIndex(product(comp_num, player_num));
+    }
+
+    // 1. First try to find a winning move
+    if (comp_num == -1) {
+        PERF_BEGIN(PERF_STAGE_WIN);
+        for (int i = 1; i <= 9; i++) {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && player_move_matrix[idx] == 0) {
+                // Temporarily make the move
+                make_move(player_move_matrix, &multiplier, &trial, idx, 2, i);
+                int wins = win_check(2);
+                unmake_move(player_move_matrix, &multiplier, &trial);
+                if (wins) {
+                    comp_num = i;
+                    best_idx = idx;
+                    break;
+                }
+            }
+        }
+        PERF_END(PERF_STAGE_WIN);
+    }
+
+    // 2. If no winning move, try to block player's potential win
+    if (comp_num == -1) {
+        PERF_SCOPE(PERF_STAGE_BLOCK);
+        for (int i = 1; i <= 9; i++) {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && player_move_matrix[idx] == 0) {
+                // Check if player would win with this position
+                make_move(player_move_matrix, &multiplier, &trial, idx, 1, i);
+                int loses = win_check(1);
+                unmake_move(player_move_matrix, &multiplier, &trial);
+                if (loses) {
+                    comp_num = i;
+                    best_idx = idx;
+                    break;
+                }
+            }
+        }
+    }
+
+    // 3. Look for 3-in-a-row setups (both offensive and defensive)
+    if (comp_num == -1) {
+        PERF_SCOPE(PERF_STAGE_THREE);
+        // Look for possible computer 3-in-a-row
+        for (int i = 1; i <= 9; i++) {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && player_move_matrix[idx] == 0) {
+                make_move(player_move_matrix, &multiplier, &trial, idx, 2, i);
+
+                // Check rows
+                int row = idx / BOARD_WIDTH;
+                int row_count = 0;
+                for (int col = 0; col < BOARD_WIDTH; col++) {
+                    if (player_move_matrix[row * BOARD_WIDTH + col] == 2)
+                        row_count++;
+                }
+
+                // Check columns
+                int col = idx % BOARD_WIDTH;
+                int col_count = 0;
+                for (int row = 0; row < BOARD_HEIGHT; row++) {
+                    if (player_move_matrix[row * BOARD_WIDTH + col] == 2)
+                        col_count++;
+                }
+
+                unmake_move(player_move_matrix, &multiplier, &trial);
+                if (row_count >= eval_weights[W_THREE_THRESHOLD] ||
+                    col_count >= eval_weights[W_THREE_THRESHOLD]) {
+                    comp_num = i;
+                    best_idx = idx;
+                    break;
+                }
+            }
+        }
+    }
+
+    // 4. If still no strategic move found, evaluate all positions
+    if (comp_num == -1) {
+        PERF_SCOPE(PERF_STAGE_EVALUATE);
+        for (int i = 1; i <= 9; i++) {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && player_move_matrix[idx] == 0) {
+                int value = evaluate_position(idx);
+                if (value > best_value) {
+                    best_value = value;
+                    comp_num = i;
+                    best_idx = idx;
+                }
+            }
+        }
+    }
+
+    apply_computer_move(player_num, comp_num);
+}
+
+// Play the computer's chosen factor against player_num and update the UI
+void apply_computer_move(int player_num, int comp_num) {
+    if (comp_num != -1) {
+        int result = multiply(&comp_num, &player_num);
+        make_move(player_move_matrix, &com_choice, &history, getIndex(result), 2, comp_num);
+        history.moves[history.count - 1].think_remaining = think_remaining;
+        publish_move(getIndex(result), 2, comp_num);
+
+        // Update UI
+        char message[100];
+        sprintf(message, "Computer chose: %d → %d × %d = %d", comp_num, comp_num, player_num, result);
+        update_status_label(message);
+
+        update_choice_label();
+
+        update_board_ui();
+        update_stats_window();
+
+        if (win_check(2)) {
+            computer_score++;
+            update_score_label();
+            update_status_label("Computer wins!");
+            game_over = 1;
+            finish_game(-1);
+        } else if (isBoardFull()) {
+            update_status_label("Game ends in a tie!");
+            game_over = 1;
+            finish_game(0);
+        } else {
+            start_ponder();
+        }
+    }
+}
+
+gchar *save_dir_override = NULL; // --bench-ui saves to a temporary directory instead
+
+// Directory holding the save slots and their index, created on first use
+const gchar *save_dir() {
+    static gchar *dir = NULL;
+    if (save_dir_override != NULL)
+        return save_dir_override;
+    if (dir == NULL) {
+        dir = g_build_filename(g_get_user_data_dir(), "multiplication-game", "saves", NULL);
+        g_mkdir_with_parents(dir, 0755);
+    }
+    return dir;
+}
+
+// Match history, in the same files and format as the console version: an
+// append-only log of finished games (matches.log) and an index of a prefix
+// of it (matches.idx) holding per-player totals sorted by name, the players
+// in leaderboard order and each player's record numbers grouped together.
+// The unindexed tail of the log is scanned on open and merged in, and is
+// compacted into a new index every MATCH_COMPACT_TAIL matches, so queries
+// stay fast however long the log grows. Appends and compactions hold an
+// advisory lock on matches.lock, which the console version takes as well.
+#define MATCH_LOG_FILE "matches.log"
+#define MATCH_INDEX_FILE "matches.idx"
+#define MATCH_LOCK_FILE "matches.lock"
+#define MATCH_LOG_MAGIC "MGML"
+#define MATCH_INDEX_MAGIC "MGMX"
+#define MATCH_VERSION 1
+#define MATCH_NAME_MAX 32
+#define MATCH_COMPACT_TAIL 1024
+#define MATCH_SCAN_TAIL 65536 // tail held while indexing a long unindexed log
+#define MATCH_FULL_MOVES 1 // factors holds every move of the game
+#define MATCH_OWNERS 2     // owners says who made each move
+#define LEADERBOARD_SIZE 10
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+} MatchLogHeader;
+
+typedef struct {
+    char player[MATCH_NAME_MAX];
+    int64_t finished_at;  // seconds since the epoch
+    uint64_t seed;        // the session's game seed
+    uint32_t duration_ms;
+    int8_t result;        // 1 the player won, 0 draw, -1 the computer won
+    uint8_t move_count;   // stones on the final board
+    uint8_t level;
+    uint8_t flags;        // MATCH_FULL_MOVES, MATCH_OWNERS
+    uint8_t opening;      // the computer's first multiplier
+    uint8_t factors[18];  // factor of each move, two per byte, low nibble first
+    uint8_t owners[5];    // bit i set if move i was the computer's
+    uint8_t reserved[4];
+    uint32_t checksum;    // FNV-1a of the bytes above
+} MatchRecord;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t log_records;  // records of the log covered by the index
+    uint32_t player_count;
+    uint32_t reserved;
+} MatchIndexHeader;
+
+typedef struct {
+    char name[MATCH_NAME_MAX];
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+    uint32_t first;        // position of the player's first record number
+    uint32_t match_count;  // record numbers belonging to the player
+    uint32_t reserved;
+    int64_t last_played;
+} MatchPlayer;
+
+_Static_assert(sizeof(MatchRecord) == 88, "MatchRecord is part of the log format");
+_Static_assert(sizeof(MatchPlayer) == 64, "MatchPlayer is part of the index format");
+
+// The index in memory plus the log's unindexed tail
+typedef struct {
+    MatchIndexHeader header;
+    MatchPlayer *players;   // sorted by name
+    uint32_t *ranking;      // players in leaderboard order
+    MatchRecord *tail;
+    uint32_t *tail_numbers; // log record number of each tail record
+    size_t tail_count;
+    size_t tail_capacity;
+    uint64_t scanned;       // log records read so far, indexed or in the tail
+    uint64_t index_records; // log_records of the index file as read, to notice another compaction
+} MatchStore;
+
+gchar *player_name = NULL;            // --name, or the login name
+int match_live = 0;                    // the game in play is recorded when it ends
+guint64 match_started = 0;            // perf_now() when it started
+GMutex match_lock;                    // held while the files are written or queried
+
+void match_path(char *path, size_t size, const char *file) {
+    g_snprintf(path, size, "%s" G_DIR_SEPARATOR_S "%s", save_dir(), file);
+}
+
+// Take the lock serializing writers of the log and index across processes.
+// Returns a descriptor for match_file_unlock, or -1 if the lock file cannot
+// be opened, in which case the caller goes ahead unlocked.
+int match_file_lock() {
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOCK_FILE);
+    int fd = g_open(path, O_RDWR | O_CREAT, 0666);
+    if (fd == -1)
+        return -1;
+#ifdef G_OS_UNIX
+    while (flock(fd, LOCK_EX) != 0 && errno == EINTR)
+        ;
+#else
+    while (_locking(fd, _LK_LOCK, 1) != 0)
+        ;
+#endif
+    return fd;
+}
+
+void match_file_unlock(int fd) {
+    if (fd == -1)
+        return;
+#ifndef G_OS_UNIX
+    _lseek(fd, 0, SEEK_SET);
+    _locking(fd, _LK_UNLCK, 1);
+#endif
+    close(fd); // also releases the flock
+}
+
+// log_records of the index file on disk, 0 if it is missing or unusable
+uint64_t match_index_records() {
+    char path[600];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    FILE *fp = fopen(path, "rb");
+    MatchIndexHeader header;
+    int ok = fp && fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, MATCH_INDEX_MAGIC, 4) == 0 && header.version == MATCH_VERSION;
+    if (fp)
+        fclose(fp);
+    return ok ? header.log_records : 0;
+}
+
+// Finish a file written to temp and move it over path. The contents reach the
+// disk before the rename, so a crash leaves either the old file or the new
+// one. If written is 0 or any step fails, temp is removed and path is untouched.
+int replace_file(FILE *fp, const char *temp, const char *path, int written) {
+    int ok = written && fflush(fp) == 0 && g_fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+#ifndef G_OS_UNIX
+    // rename does not replace an existing file on Windows
+    if (ok)
+        remove(path);
+#endif
+    if (ok && rename(temp, path) != 0)
+        ok = 0;
+    if (!ok)
+        remove(temp);
+    return ok;
+}
+
+uint32_t match_checksum(const MatchRecord *record) {
+    // Low half of a 64-bit FNV-1a, as the console version writes it
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < offsetof(MatchRecord, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return (uint32_t)hash;
+}
+
+// Leaderboard order: most wins, then fewest losses, then name
+int compare_standing(const MatchPlayer *a, const MatchPlayer *b) {
+    if (a->wins != b->wins)
+        return a->wins > b->wins ? -1 : 1;
+    if (a->losses != b->losses)
+        return a->losses < b->losses ? -1 : 1;
+    return strncmp(a->name, b->name, MATCH_NAME_MAX);
+}
+
+// Players of the store being ranked, for the qsort comparator below
+static const MatchPlayer *ranking_players;
+
+int compare_ranking(const void *a, const void *b) {
+    return compare_standing(&ranking_players[*(const uint32_t *)a], &ranking_players[*(const uint32_t *)b]);
+}
+
+int compare_players(const void *a, const void *b) {
+    return compare_standing((const MatchPlayer *)a, (const MatchPlayer *)b);
+}
+
+// Index of name among the sorted players, or -1
+int find_match_player(const MatchPlayer *players, uint32_t count, const char *name) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = strncmp(players[mid].name, name, MATCH_NAME_MAX);
+        if (c == 0)
+            return (int)mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+// Add a record's result to a player's totals
+void match_count_result(MatchPlayer *player, const MatchRecord *record) {
+    if (record->result > 0)
+        player->wins++;
+    else if (record->result < 0)
+        player->losses++;
+    else
+        player->draws++;
+    player->match_count++;
+    if (record->finished_at > player->last_played)
+        player->last_played = record->finished_at;
+}
+
+// Read the index; a missing or unusable one leaves the store empty
+void load_match_index(MatchStore *store) {
+    char path[600];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    memset(&store->header, 0, sizeof(store->header));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return;
+    MatchIndexHeader header;
+    uint32_t count = 0;
+    if (fread(&header, sizeof(header), 1, fp) == 1 &&
+            memcmp(header.magic, MATCH_INDEX_MAGIC, 4) == 0 && header.version == MATCH_VERSION) {
+        store->index_records = header.log_records;
+        count = header.player_count;
+        store->players = g_new(MatchPlayer, count ? count : 1);
+        store->ranking = g_new(uint32_t, count ? count : 1);
+        if (fread(store->players, sizeof(MatchPlayer), count, fp) == count &&
+                fread(store->ranking, sizeof(uint32_t), count, fp) == count)
+            store->header = header;
+        else
+            store->header.player_count = 0;
+    }
+    fclose(fp);
+}
+
+int match_compact(MatchStore *store);
+
+// Append a record to the tail. A log far ahead of its index (a lost index, or
+// records written by an older version) is indexed in MATCH_SCAN_TAIL chunks.
+void match_add_tail(MatchStore *store, const MatchRecord *record, uint32_t number) {
+    // If another process got there first the tail just keeps growing
+    if (store->tail_count == MATCH_SCAN_TAIL)
+        match_compact(store);
+    if (store->tail_count == store->tail_capacity) {
+        store->tail_capacity = store->tail_capacity ? store->tail_capacity * 2 : MATCH_COMPACT_TAIL;
+        store->tail = g_renew(MatchRecord, store->tail, store->tail_capacity);
+        store->tail_numbers = g_renew(uint32_t, store->tail_numbers, store->tail_capacity);
+    }
+    store->tail[store->tail_count] = *record;
+    store->tail_numbers[store->tail_count++] = number;
+}
+
+// Open the store: the index, then every log record past it
+MatchStore *match_store_open() {
+    MatchStore *store = g_new0(MatchStore, 1);
+    load_match_index(store);
+
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    FILE *fp = fopen(path, "rb");
+    MatchLogHeader header;
+    if (!fp || fread(&header, sizeof(header), 1, fp) != 1 ||
+            memcmp(header.magic, MATCH_LOG_MAGIC, 4) != 0 || header.version != MATCH_VERSION ||
+            header.record_size != sizeof(MatchRecord)) {
+        // No usable log: nothing the index says can be trusted either
+        if (fp)
+            fclose(fp);
+        g_free(store->players);
+        g_free(store->ranking);
+        store->players = NULL;
+        store->ranking = NULL;
+        memset(&store->header, 0, sizeof(store->header));
+        return store;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    uint64_t log_records = (uint64_t)(ftell(fp) - (long)sizeof(header)) / sizeof(MatchRecord);
+    if (store->header.log_records > log_records) {
+        // The log was replaced behind the index's back; index it again
+        g_free(store->players);
+        g_free(store->ranking);
+        store->players = NULL;
+        store->ranking = NULL;
+        memset(&store->header, 0, sizeof(store->header));
+    }
+
+    store->scanned = store->header.log_records;
+    fseek(fp, (long)(sizeof(header) + store->scanned * sizeof(MatchRecord)), SEEK_SET);
+    MatchRecord record;
+    while (store->scanned < log_records && fread(&record, sizeof(record), 1, fp) == 1) {
+        if (record.checksum == match_checksum(&record))
+            match_add_tail(store, &record, (uint32_t)store->scanned);
+        store->scanned++;
+    }
     fclose(fp);
+    return store;
+}
+
+void match_store_close(MatchStore *store) {
+    if (!store)
+        return;
+    g_free(store->players);
+    g_free(store->ranking);
+    g_free(store->tail);
+    g_free(store->tail_numbers);
+    g_free(store);
+}
+
+// Tail records in player order, then log order
+static const MatchRecord *sorting_tail;
+
+int compare_tail(const void *a, const void *b) {
+    uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+    int c = strncmp(sorting_tail[i].player, sorting_tail[j].player, MATCH_NAME_MAX);
+    return c != 0 ? c : (i > j) - (i < j);
+}
+
+// Merge the tail into a new index and replace the old one with it. The old
+// index's record numbers are streamed across player by player with the new
+// ones added after them, so the cost is one pass over the index.
+int match_compact(MatchStore *store) {
+    char path[600], temp[610];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    g_snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    int lock = match_file_lock();
+    if (match_index_records() != store->index_records) {
+        match_file_unlock(lock);
+        return 0;
+    }
+
+    uint32_t *order = g_new(uint32_t, store->tail_count ? store->tail_count : 1);
+    for (size_t i = 0; i < store->tail_count; i++)
+        order[i] = (uint32_t)i;
+    sorting_tail = store->tail;
+    qsort(order, store->tail_count, sizeof(uint32_t), compare_tail);
+
+    // Merge the sorted player lists
+    uint32_t old_count = store->header.player_count;
+    uint32_t capacity = old_count + (uint32_t)store->tail_count;
+    MatchPlayer *players = g_new0(MatchPlayer, capacity ? capacity : 1);
+    uint32_t *old_of = g_new(uint32_t, capacity ? capacity : 1);   // old player or UINT32_MAX
+    uint32_t *tail_of = g_new(uint32_t, capacity ? capacity : 1);  // first position in order
+    uint32_t count = 0, p = 0;
+    size_t t = 0;
+    while (p < old_count || t < store->tail_count) {
+        const char *tail_name = t < store->tail_count ? store->tail[order[t]].player : NULL;
+        int c = p == old_count ? 1 : !tail_name ? -1 :
+                strncmp(store->players[p].name, tail_name, MATCH_NAME_MAX);
+        MatchPlayer *player = &players[count];
+        old_of[count] = UINT32_MAX;
+        tail_of[count] = UINT32_MAX;
+        if (c <= 0) {
+            *player = store->players[p];
+            old_of[count] = p++;
+        } else {
+            memcpy(player->name, tail_name, MATCH_NAME_MAX);
+        }
+        if (c >= 0) {
+            tail_of[count] = (uint32_t)t;
+            for (; t < store->tail_count &&
+                   strncmp(store->tail[order[t]].player, player->name, MATCH_NAME_MAX) == 0; t++)
+                match_count_result(player, &store->tail[order[t]]);
+        }
+        count++;
+    }
+
+    MatchIndexHeader header = { MATCH_INDEX_MAGIC, MATCH_VERSION, store->scanned, count, 0 };
+    uint32_t *ranking = g_new(uint32_t, count ? count : 1);
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        ranking[i] = i;
+        players[i].first = first;
+        first += players[i].match_count;
+    }
+    ranking_players = players;
+    qsort(ranking, count, sizeof(uint32_t), compare_ranking);
+
+    FILE *in = NULL;
+    if (old_count) {
+        in = fopen(path, "rb");
+        if (in)
+            fseek(in, (long)(sizeof(MatchIndexHeader) + old_count * (sizeof(MatchPlayer) + sizeof(uint32_t))), SEEK_SET);
+    }
+    FILE *out = fopen(temp, "wb");
+    int ok = out != NULL && (old_count == 0 || in != NULL);
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(players, sizeof(MatchPlayer), count, out) == count &&
+             fwrite(ranking, sizeof(uint32_t), count, out) == count;
+        uint32_t buffer[1024];
+        for (uint32_t i = 0; ok && i < count; i++) {
+            // The old record numbers are stored in player order, so they are read in sequence
+            if (old_of[i] != UINT32_MAX) {
+                for (uint32_t left = store->players[old_of[i]].match_count; ok && left > 0;) {
+                    uint32_t chunk = left < 1024 ? left : 1024;
+                    ok = fread(buffer, sizeof(uint32_t), chunk, in) == chunk &&
+                         fwrite(buffer, sizeof(uint32_t), chunk, out) == chunk;
+                    left -= chunk;
+                }
+            }
+            if (tail_of[i] != UINT32_MAX) {
+                for (size_t j = tail_of[i]; ok && j < store->tail_count &&
+                     strncmp(store->tail[order[j]].player, players[i].name, MATCH_NAME_MAX) == 0; j++)
+                    ok = fwrite(&store->tail_numbers[order[j]], sizeof(uint32_t), 1, out) == 1;
+            }
+        }
+    }
+    if (in)
+        fclose(in);
+    g_free(order);
+    g_free(old_of);
+    g_free(tail_of);
+
+    if (out)
+        ok = replace_file(out, temp, path, ok);
+    match_file_unlock(lock);
+    if (!ok) {
+        g_free(players);
+        g_free(ranking);
+        return 0;
+    }
+
+    g_free(store->players);
+    g_free(store->ranking);
+    store->players = players;
+    store->ranking = ranking;
+    store->header = header;
+    store->index_records = header.log_records;
+    store->tail_count = 0;
+    return 1;
+}
+
+// Append a finished match to the log, compacting the index when the tail is full
+int match_append(MatchRecord *record) {
+    record->checksum = match_checksum(record);
+
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    int lock = match_file_lock();
+    FILE *fp = fopen(path, "r+b");
+    MatchLogHeader header = { MATCH_LOG_MAGIC, MATCH_VERSION, sizeof(MatchRecord), 0 }, existing;
+    if (fp && (fread(&existing, sizeof(existing), 1, fp) != 1 || memcmp(&existing, &header, sizeof(header)) != 0)) {
+        // Not a log this version can read: keep it aside and start a new one
+        gchar *aside = g_strdup_printf("%s.%" G_GINT64_FORMAT ".bad", path, (gint64)time(NULL));
+        fclose(fp);
+        fp = NULL;
+        int moved = g_rename(path, aside) == 0;
+        if (moved)
+            g_printerr("The match history was unreadable; moved it to %s\n", aside);
+        else
+            g_printerr("Cannot read or move aside the match history %s\n", path);
+        g_free(aside);
+        if (!moved) {
+            match_file_unlock(lock);
+            return 0;
+        }
+    }
+    if (!fp) {
+        fp = fopen(path, "wb");
+        if (!fp || fwrite(&header, sizeof(header), 1, fp) != 1) {
+            if (fp)
+                fclose(fp);
+            match_file_unlock(lock);
+            return 0;
+        }
+    }
+
+    // Start at the end of the last whole record, over any torn write
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    uint64_t records = (uint64_t)(size - (long)sizeof(header)) / sizeof(MatchRecord);
+    fseek(fp, (long)(sizeof(header) + records * sizeof(MatchRecord)), SEEK_SET);
+    int ok = fwrite(record, sizeof(*record), 1, fp) == 1;
+    if (fclose(fp) != 0)
+        ok = 0;
+    match_file_unlock(lock);
+
+    // Compact once the unindexed tail is full (match_compact takes the lock again)
+    if (ok && records + 1 - match_index_records() >= MATCH_COMPACT_TAIL) {
+        MatchStore *store = match_store_open();
+        match_compact(store);
+        match_store_close(store);
+    }
+    return ok;
+}
+
+// Fill a record of the interactive game that just ended
+void match_fill(MatchRecord *record, int result) {
+    memset(record, 0, sizeof(*record));
+    g_strlcpy(record->player, player_name, MATCH_NAME_MAX);
+    record->finished_at = (int64_t)time(NULL);
+    record->seed = game_seed;
+    record->duration_ms = match_started ? (uint32_t)((perf_now() - match_started) / 1000000) : 0;
+    record->result = (int8_t)result;
+    record->level = (uint8_t)difficulty;
+
+    int stones = 0;
+    for (int i = 0; i < SIZE; i++)
+        stones += player_move_matrix[i] != 0;
+    record->move_count = (uint8_t)stones;
+
+    // Loaded games have no history from the start, so only their end is known
+    if (history.count == stones && stones > 0) {
+        record->flags |= MATCH_FULL_MOVES | MATCH_OWNERS;
+        record->opening = history.moves[0].prev_multiplier;
+        for (int i = 0; i < history.count; i++) {
+            record->factors[i / 2] |= (uint8_t)(history.moves[i].factor << (i % 2 * 4));
+            if (history.moves[i].owner == 2)
+                record->owners[i / 8] |= (uint8_t)(1 << (i % 8));
+        }
+    }
+}
+
+// Worker thread: append a finished match (and compact if the tail is full)
+static void record_match_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    g_mutex_lock(&match_lock);
+    gboolean ok = match_append(task_data);
+    g_mutex_unlock(&match_lock);
+    if (!ok)
+        g_printerr("Error writing the match history\n");
+    g_task_return_boolean(task, ok);
+}
+
+// Record the game's result (1 player won, 0 draw, -1 computer won) in the background
+void record_match(int result) {
+    if (!match_live || bench_games > 0) // scripted games stay out of the history
+        return;
+    match_live = 0;
+    MatchRecord *record = g_new(MatchRecord, 1);
+    match_fill(record, result);
+
+    GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, record, g_free);
+    g_task_run_in_thread(task, record_match_thread);
+    g_object_unref(task);
+}
+
+// Spectator broadcast (--publish): every change to the game goes to the
+// console version's spectator hub (--hub) as an 8-byte event, or after undo,
+// redo and load as a snapshot of the whole position, in the console
+// version's format; the hub fans them out to read-only spectators.
+#define SPECTATE_PUBLISHER 'P'
+#define PACKED_SCORE_MAX ((1 << 20) - 1)
+
+enum { SPECTATE_MOVE = 1, SPECTATE_NEW_GAME, SPECTATE_END, SPECTATE_SNAPSHOT };
+
+typedef struct {
+    uint8_t type;   // SPECTATE_*
+    uint8_t cell;   // move: the cell taken
+    uint8_t owner;  // move: the side taking it; end: the winner, 0 for a tie
+    uint8_t factor; // move, new game: the multiplier the next side plays against
+    uint32_t seq;
+} SpectateEvent;
+
+// The console version's 16-byte PackedGame position
+typedef struct {
+    uint64_t cells;
+    uint64_t info;
+} PackedGame;
+
+typedef struct {
+    SpectateEvent event;
+    PackedGame game;
+} SpectateSnapshot;
+
+gint publish_port = 0; // --publish, 0 when not publishing
+static GSocketConnection *publish_connection = NULL;
+static guint32 publish_seq = 0;
+
+// Pack the game as the console version's pack_game does
+static void pack_position(PackedGame *game) {
+    uint64_t mask[2] = { 0, 0 };
+    int count = 0;
+    for (int i = 0; i < SIZE; i++) {
+        if (player_move_matrix[i] == 1 || player_move_matrix[i] == 2) {
+            mask[player_move_matrix[i] - 1] |= 1ULL << i;
+            count++;
+        }
+    }
+    game->cells = mask[0] | mask[1] << SIZE;
+    game->info = mask[1] >> (64 - SIZE) |
+                 (uint64_t)(com_choice >= 1 && com_choice <= 9 ? com_choice : 0) << 8 |
+                 (uint64_t)count << 12 |
+                 (uint64_t)(game_over != 0) << 18 |
+                 (uint64_t)CLAMP(player_score, 0, PACKED_SCORE_MAX) << 24 |
+                 (uint64_t)CLAMP(computer_score, 0, PACKED_SCORE_MAX) << 44;
+}
+
+// Stamp an event and send it. The socket is non-blocking so a stalled hub
+// never freezes the window: a write that would block, or only gets part of
+// the event out, stops publishing, since the hub could no longer follow.
+static void publish_send(SpectateSnapshot *event) {
+    gsize size = event->event.type == SPECTATE_SNAPSHOT ? sizeof(SpectateSnapshot) : sizeof(SpectateEvent);
+    GError *error = NULL;
+
+    event->event.seq = publish_seq++;
+    gssize sent = g_socket_send(g_socket_connection_get_socket(publish_connection), (const gchar *)event, size, NULL, &error);
+    if (sent == (gssize)size)
+        return;
+    if (error != NULL && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        g_printerr("The spectator hub is not keeping up; stopped publishing\n");
+    else if (error != NULL)
+        g_printerr("Lost the spectator hub: %s\n", error->message);
+    else
+        g_printerr("The spectator hub took part of an event; stopped publishing\n");
+    g_clear_error(&error);
+    g_clear_object(&publish_connection);
+}
+
+void publish_event(int type, int cell, int owner, int factor) {
+    if (publish_connection == NULL)
+        return;
+    SpectateSnapshot event = { .event = { (uint8_t)type, (uint8_t)cell, (uint8_t)owner, (uint8_t)factor, 0 } };
+    publish_send(&event);
+}
+
+void publish_move(int cell, int owner, int factor) {
+    publish_event(SPECTATE_MOVE, cell, owner, factor);
+}
+
+// Send the whole position: on connecting, and after undo, redo and load
+void publish_snapshot() {
+    if (publish_connection == NULL)
+        return;
+    SpectateSnapshot snapshot = { .event = { SPECTATE_SNAPSHOT, 0, 0, 0, 0 } };
+    pack_position(&snapshot.game);
+    publish_send(&snapshot);
+}
+
+// Connect to the hub on this machine
+void start_publishing() {
+    GSocketClient *client = g_socket_client_new();
+    GError *error = NULL;
+    publish_connection = g_socket_client_connect_to_host(client, "127.0.0.1", (guint16)publish_port, NULL, &error);
+    g_object_unref(client);
+    if (publish_connection == NULL) {
+        g_printerr("No spectator hub on port %d: %s\n", publish_port, error->message);
+        g_error_free(error);
+        return;
+    }
+
+    // Events are tiny and should leave at once
+    g_socket_set_option(g_socket_connection_get_socket(publish_connection), IPPROTO_TCP, TCP_NODELAY, 1, NULL);
+    char role = SPECTATE_PUBLISHER;
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(publish_connection));
+    if (!g_output_stream_write_all(out, &role, 1, NULL, NULL, NULL)) {
+        g_clear_object(&publish_connection);
+        return;
+    }
+    g_socket_set_blocking(g_socket_connection_get_socket(publish_connection), FALSE);
+    g_print("Publishing moves to the spectator hub on port %d\n", publish_port);
+    publish_snapshot();
+}
+
+// A game has ended: tell spectators and record it in the match history
+void finish_game(int result) {
+    publish_event(SPECTATE_END, 0, result == 1 ? 1 : result == -1 ? 2 : 0, 0);
+    record_match(result);
+}
+
+// Up to n players in leaderboard order, counting the tail; returns how many
+int match_leaderboard(const MatchStore *store, MatchPlayer *out, int n) {
+    // Totals of the players with matches in the tail
+    MatchPlayer *changed = g_new0(MatchPlayer, store->tail_count ? store->tail_count : 1);
+    size_t changed_count = 0;
+    for (size_t i = 0; i < store->tail_count; i++) {
+        const MatchRecord *record = &store->tail[i];
+        size_t j = 0;
+        while (j < changed_count && strncmp(changed[j].name, record->player, MATCH_NAME_MAX) != 0)
+            j++;
+        if (j == changed_count) {
+            int old = find_match_player(store->players, store->header.player_count, record->player);
+            if (old >= 0)
+                changed[j] = store->players[old];
+            else
+                memcpy(changed[j].name, record->player, MATCH_NAME_MAX);
+            changed_count++;
+        }
+        match_count_result(&changed[j], record);
+    }
+
+    // Players untouched by the tail keep their order, so only the first n of
+    // them can still make the board
+    MatchPlayer *candidates = g_new(MatchPlayer, n + changed_count + 1);
+    size_t count = 0;
+    for (uint32_t i = 0; i < store->header.player_count && (int)(count) < n; i++) {
+        const MatchPlayer *player = &store->players[store->ranking[i]];
+        size_t j = 0;
+        while (j < changed_count && strncmp(changed[j].name, player->name, MATCH_NAME_MAX) != 0)
+            j++;
+        if (j == changed_count)
+            candidates[count++] = *player;
+    }
+    memcpy(candidates + count, changed, changed_count * sizeof(MatchPlayer));
+    count += changed_count;
+    qsort(candidates, count, sizeof(MatchPlayer), compare_players);
+
+    if ((int)count > n)
+        count = (size_t)n;
+    memcpy(out, candidates, count * sizeof(MatchPlayer));
+    g_free(candidates);
+    g_free(changed);
+    return (int)count;
+}
+
+// Up to n of name's matches, newest first; totals, if given, gets the
+// player's standing. Returns how many were found.
+int match_history(const MatchStore *store, const char *name, MatchRecord *out, int n, MatchPlayer *totals) {
+    int count = 0;
+    if (totals) {
+        memset(totals, 0, sizeof(*totals));
+        strncpy(totals->name, name, MATCH_NAME_MAX - 1);
+    }
+    int p = find_match_player(store->players, store->header.player_count, name);
+    if (p >= 0 && totals)
+        *totals = store->players[p];
+
+    for (size_t i = store->tail_count; i-- > 0;) {
+        if (strncmp(store->tail[i].player, name, MATCH_NAME_MAX) != 0)
+            continue;
+        if (totals)
+            match_count_result(totals, &store->tail[i]);
+        if (count < n)
+            out[count++] = store->tail[i];
+    }
+    if (p < 0 || count >= n)
+        return count;
+
+    // The newest indexed matches are the last of the player's record numbers
+    char path[600];
+    const MatchPlayer *player = &store->players[p];
+    uint32_t wanted = (uint32_t)(n - count) < player->match_count ? (uint32_t)(n - count) : player->match_count;
+    uint32_t *numbers = g_new(uint32_t, wanted ? wanted : 1);
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    FILE *fp = fopen(path, "rb");
+    long offset = (long)(sizeof(MatchIndexHeader) + store->header.player_count * (sizeof(MatchPlayer) + sizeof(uint32_t)) +
+                         (player->first + player->match_count - wanted) * sizeof(uint32_t));
+    if (!fp || fseek(fp, offset, SEEK_SET) != 0 || fread(numbers, sizeof(uint32_t), wanted, fp) != wanted)
+        wanted = 0;
+    if (fp)
+        fclose(fp);
+
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    fp = wanted ? fopen(path, "rb") : NULL;
+    for (uint32_t i = wanted; fp && i-- > 0;) {
+        MatchRecord *record = &out[count];
+        if (fseek(fp, (long)(sizeof(MatchLogHeader) + numbers[i] * sizeof(MatchRecord)), SEEK_SET) == 0 &&
+                fread(record, sizeof(*record), 1, fp) == 1 && record->checksum == match_checksum(record))
+            count++;
+    }
+    if (fp)
+        fclose(fp);
+    g_free(numbers);
+    return count;
+}
+
+// Moves of a match record: cells, owners and factors of up to SIZE moves.
+// Each side multiplies by the other side's last factor (the player starts
+// from the opening); records without owners alternate from the player.
+// Returns the number of moves, 0 if the record holds only the result. The
+// console version decodes records with the same function.
+int match_decode(const MatchRecord *record, uint8_t *cells, uint8_t *owners, uint8_t *factors) {
+    if (!(record->flags & MATCH_FULL_MOVES))
+        return 0;
+
+    int taken[SIZE] = {0};
+    int last_factor[3] = { 0, 0, record->opening };
+    int length = 0;
+    for (int i = 0; i < record->move_count && i < SIZE; i++) {
+        int owner = record->flags & MATCH_OWNERS ? 1 + (record->owners[i / 8] >> (i % 8) & 1) : 1 + i % 2;
+        int factor = record->factors[i / 2] >> (i % 2 * 4) & 0xF;
+        int multiplier = last_factor[3 - owner];
+        int cell = factor >= 1 && factor <= 9 && multiplier >= 1 && multiplier <= 9 ? getIndex(product(factor, multiplier)) : -1;
+        if (cell < 0 || taken[cell])
+            break;
+        taken[cell] = 1;
+        cells[i] = (uint8_t)cell;
+        owners[i] = (uint8_t)owner;
+        factors[i] = (uint8_t)factor;
+        last_factor[owner] = factor;
+        length = i + 1;
+    }
+    return length;
+}
+
+// Slot names become file names, so only letters, digits, '-' and '_' are allowed
+int valid_slot_name(const char *slot) {
+    size_t length = strlen(slot);
+    if (length == 0 || length >= SLOT_NAME_MAX)
+        return 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!g_ascii_isalnum(slot[i]) && slot[i] != '-' && slot[i] != '_')
+            return 0;
+    }
+    return 1;
+}
+
+// Path of a slot's save file (free with g_free)
+gchar *slot_path(const char *slot) {
+    gchar *file_name = g_strconcat(slot, SLOT_SUFFIX, NULL);
+    gchar *path = g_build_filename(save_dir(), file_name, NULL);
+    g_free(file_name);
+    return path;
+}
+
+// Fill an index record from a game state
+void slot_info_fill(SlotInfo *info, const char *slot, const int *moves, int p_score, int c_score,
+                    int choice, int over, gint64 saved_at) {
+    memset(info, 0, sizeof(*info));
+    g_strlcpy(info->name, slot, SLOT_NAME_MAX);
+    info->saved_at = saved_at;
+    info->player_score = p_score;
+    info->computer_score = c_score;
+    info->com_choice = choice;
+    info->game_over = (uint8_t)over;
+    for (int i = 0; i < SIZE; i++) {
+        if (moves[i] != 0)
+            info->move_count++;
+        info->thumbnail[i / 4] |= (uint8_t)((moves[i] & 3) << ((i % 4) * 2));
+    }
+}
+
+// Owner of a cell in an index record's thumbnail (0=none, 1=player, 2=computer)
+int slot_thumbnail_cell(const SlotInfo *info, int idx) {
+    return (info->thumbnail[idx / 4] >> ((idx % 4) * 2)) & 3;
+}
+
+// Read the index record of a slot directly from its save file
+int slot_info_from_file(SlotInfo *info, const char *slot) {
+    gchar *path = slot_path(slot);
+    gchar *contents;
+    gsize length;
+    int ok = g_file_get_contents(path, &contents, &length, NULL);
+
+    if (ok) {
+        int values[SIZE + 4];
+        ok = length >= sizeof(values);
+        if (ok) {
+            memcpy(values, contents, sizeof(values));
+            GStatBuf st;
+            gint64 saved_at = g_stat(path, &st) == 0 ? (gint64)st.st_mtime : 0;
+            slot_info_fill(info, slot, values, values[SIZE], values[SIZE + 1], values[SIZE + 2],
+                           values[SIZE + 3], saved_at);
+        }
+        g_free(contents);
+    }
+    g_free(path);
+    return ok;
+}
+
+// Rewrite the index from the slot files on disk (used when it is missing or corrupt)
+int rebuild_index() {
+    GDir *dir = g_dir_open(save_dir(), 0, NULL);
+    if (dir == NULL)
+        return 0;
+
+    GArray *slots = g_array_new(FALSE, FALSE, sizeof(SlotInfo));
+    const gchar *entry;
+    while ((entry = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(entry, SLOT_SUFFIX))
+            continue;
+        gchar *slot = g_strndup(entry, strlen(entry) - strlen(SLOT_SUFFIX));
+        SlotInfo info;
+        if (valid_slot_name(slot) && slot_info_from_file(&info, slot))
+            g_array_append_val(slots, info);
+        g_free(slot);
+    }
+    g_dir_close(dir);
+
+    SlotIndexHeader header = { INDEX_MAGIC, INDEX_VERSION, slots->len, sizeof(SlotInfo) };
+    GByteArray *data = g_byte_array_new();
+    g_byte_array_append(data, (const guint8 *)&header, sizeof(header));
+    g_byte_array_append(data, (const guint8 *)slots->data, slots->len * sizeof(SlotInfo));
+
+    gchar *path = g_build_filename(save_dir(), INDEX_FILE, NULL);
+    int ok = g_file_set_contents(path, (const gchar *)data->data, data->len, NULL);
+    g_free(path);
+    g_byte_array_free(data, TRUE);
+    g_array_free(slots, TRUE);
+    return ok;
+}
+
+// Open the index, checking its header; returns NULL if it is missing or corrupt
+FILE *open_index(const char *mode, SlotIndexHeader *header) {
+    gchar *path = g_build_filename(save_dir(), INDEX_FILE, NULL);
+    FILE *fp = g_fopen(path, mode);
+    g_free(path);
+    if (!fp)
+        return NULL;
+
+    if (fread(header, sizeof(*header), 1, fp) != 1 ||
+        memcmp(header->magic, INDEX_MAGIC, 4) != 0 ||
+        header->version != INDEX_VERSION ||
+        header->record_size != sizeof(SlotInfo) ||
+        fseek(fp, 0, SEEK_END) != 0 ||
+        ftell(fp) != (long)(sizeof(*header) + (long)header->count * sizeof(SlotInfo))) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// Update one slot's index record in place, or append it
+int update_index(const SlotInfo *info) {
+    SlotIndexHeader header;
+    FILE *fp = open_index("r+b", &header);
+    if (!fp)
+        return rebuild_index();
+
+    guint32 position = header.count;
+    SlotInfo record;
+    fseek(fp, sizeof(header), SEEK_SET);
+    for (guint32 i = 0; i < header.count && fread(&record, sizeof(record), 1, fp) == 1; i++) {
+        if (strncmp(record.name, info->name, SLOT_NAME_MAX) == 0) {
+            position = i;
+            break;
+        }
+    }
+
+    fseek(fp, (long)(sizeof(header) + position * sizeof(SlotInfo)), SEEK_SET);
+    int ok = fwrite(info, sizeof(*info), 1, fp) == 1;
+    if (ok && position == header.count) {
+        header.count++;
+        fseek(fp, 0, SEEK_SET);
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    }
+    fclose(fp);
+    return ok;
+}
+
+// Read every index record, rebuilding the index first if it is unusable
+GArray *read_index() {
+    GArray *slots = g_array_new(FALSE, FALSE, sizeof(SlotInfo));
+    SlotIndexHeader header;
+    FILE *fp = open_index("rb", &header);
+    if (!fp) {
+        rebuild_index();
+        fp = open_index("rb", &header);
+        if (!fp)
+            return slots;
+    }
+
+    g_array_set_size(slots, header.count);
+    fseek(fp, sizeof(header), SEEK_SET);
+    g_array_set_size(slots, fread(slots->data, sizeof(SlotInfo), header.count, fp));
+    fclose(fp);
+
+    // Names become file paths; drop records whose name is unterminated or invalid
+    for (guint i = slots->len; i-- > 0;) {
+        const SlotInfo *info = &g_array_index(slots, SlotInfo, i);
+        if (memchr(info->name, '\0', SLOT_NAME_MAX) == NULL || !valid_slot_name(info->name))
+            g_array_remove_index(slots, i);
+    }
+    return slots;
+}
+
+// Enable or disable the Save/Load buttons while a save file operation runs
+void set_save_io_busy(gboolean busy) {
+    save_io_busy = busy;
+    if (save_game_button != NULL)
+        gtk_widget_set_sensitive(save_game_button, !busy);
+    if (load_game_button != NULL)
+        gtk_widget_set_sensitive(load_game_button, !busy);
+}
+
+// Serialize the game state in the save file layout
+GBytes *save_snapshot() {
+    GByteArray *data = g_byte_array_new();
+
+    // Player move matrix, scores, computer choice and game state
+    g_byte_array_append(data, (const guint8 *)player_move_matrix, sizeof(player_move_matrix));
+    g_byte_array_append(data, (const guint8 *)&player_score, sizeof(int));
+    g_byte_array_append(data, (const guint8 *)&computer_score, sizeof(int));
+    g_byte_array_append(data, (const guint8 *)&com_choice, sizeof(int));
+    g_byte_array_append(data, (const guint8 *)&game_over, sizeof(int));
+
+    // Random generator so the game replays exactly
+    g_byte_array_append(data, (const guint8 *)&game_seed, sizeof(uint64_t));
+    g_byte_array_append(data, (const guint8 *)&game_rng, sizeof(Rng));
+
+    return g_byte_array_free_to_bytes(data);
+}
+
+// Restore the game state from the save file layout
+int restore_snapshot(GBytes *bytes) {
+    gsize length;
+    const guint8 *data = g_bytes_get_data(bytes, &length);
+    gsize required = sizeof(player_move_matrix) + 4 * sizeof(int);
+    if (length < required)
+        return 0;
+
+    // Check the whole position before touching the game, so a corrupt file
+    // changes nothing
+    int cells[SIZE], state[4];
+    memcpy(cells, data, sizeof(cells));
+    memcpy(state, data + sizeof(cells), sizeof(state));
+    for (int i = 0; i < SIZE; i++) {
+        if (cells[i] < 0 || cells[i] > 2)
+            return 0;
+    }
+    if (state[2] != -1 && (state[2] < 1 || state[2] > 9))
+        return 0;
+    if (state[3] != 0 && state[3] != 1)
+        return 0;
+
+    memcpy(player_move_matrix, cells, sizeof(player_move_matrix));
+    player_score = state[0];
+    computer_score = state[1];
+    com_choice = state[2];
+    game_over = state[3];
+    data += sizeof(cells) + sizeof(state);
+
+    // Random generator (absent in saves from older versions)
+    if (length >= required + sizeof(uint64_t) + sizeof(Rng)) {
+        memcpy(&game_seed, data, sizeof(uint64_t));
+        memcpy(&game_rng, data + sizeof(uint64_t), sizeof(Rng));
+    }
+    return 1;
+}
+
+// A background save: the snapshot, its slot and the slot's index record
+typedef struct {
+    gchar *slot;
+    GBytes *bytes;
+    SlotInfo info;
+} SaveJob;
+
+static void save_job_free(SaveJob *job) {
+    g_free(job->slot);
+    g_bytes_unref(job->bytes);
+    g_free(job);
+}
+
+// Worker thread: write the snapshot to a temporary file, fsync it and
+// atomically rename it over the slot file, so a crash never leaves a torn
+// save; then update the slot's index record
+static void save_game_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    PERF_SCOPE(PERF_SAVE_GAME);
+    SaveJob *job = task_data;
+    gsize length;
+    const gchar *data = g_bytes_get_data(job->bytes, &length);
+    gchar *path = slot_path(job->slot);
+    GError *error = NULL;
+
+    if (g_file_set_contents_full(path, data, length,
+                                 G_FILE_SET_CONTENTS_CONSISTENT | G_FILE_SET_CONTENTS_DURABLE,
+                                 0666, &error)) {
+        update_index(&job->info);
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_error(task, error);
+    }
+    g_free(path);
+}
+
+// Main loop: report the result of a background save
+static void save_game_finished(GObject *source, GAsyncResult *result, gpointer data) {
+    GError *error = NULL;
+    set_save_io_busy(FALSE);
+
+    if (g_task_propagate_boolean(G_TASK(result), &error)) {
+        gchar *message = g_strdup_printf("Game saved to slot '%s'!", current_slot);
+        update_status_label(message);
+        g_free(message);
+    } else {
+        g_printerr("Save failed: %s\n", error->message);
+        update_status_label("Error writing save file!");
+        g_error_free(error);
+    }
+}
+
+// Save game state to a slot in the background
+int save_game(const char *slot) {
+    if (save_io_busy)
+        return 0;
+    if (!valid_slot_name(slot)) {
+        update_status_label("Invalid slot name. Use letters, digits, '-' and '_'.");
+        return 0;
+    }
+
+    g_free(current_slot);
+    current_slot = g_strdup(slot);
+    set_save_io_busy(TRUE);
+    update_status_label("Saving game...");
+
+    SaveJob *job = g_new0(SaveJob, 1);
+    job->slot = g_strdup(slot);
+    job->bytes = save_snapshot();
+    slot_info_fill(&job->info, slot, player_move_matrix, player_score, computer_score,
+                   com_choice, game_over, g_get_real_time() / G_USEC_PER_SEC);
+
+    GTask *task = g_task_new(NULL, NULL, save_game_finished, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)save_job_free);
+    g_task_run_in_thread(task, save_game_thread);
+    g_object_unref(task);
+    return 1;
+}
+
+// Worker thread: read the whole save file of a slot
+static void load_game_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    PERF_SCOPE(PERF_LOAD_GAME);
+    gchar *path = slot_path(task_data);
+    gchar *contents;
+    gsize length;
+    GError *error = NULL;
+
+    if (g_file_get_contents(path, &contents, &length, &error)) {
+        g_task_return_pointer(task, g_bytes_new_take(contents, length), (GDestroyNotify)g_bytes_unref);
+    } else {
+        g_task_return_error(task, error);
+    }
+    g_free(path);
+}
+
+// Main loop: apply a loaded save and refresh the UI
+static void load_game_finished(GObject *source, GAsyncResult *result, gpointer data) {
+    GError *error = NULL;
+    GBytes *bytes = g_task_propagate_pointer(G_TASK(result), &error);
+    set_save_io_busy(FALSE);
+
+    if (bytes == NULL) {
+        if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            update_status_label("No saved game found.");
+        } else {
+            g_printerr("Load failed: %s\n", error->message);
+            update_status_label("Error reading save file!");
+        }
+        g_error_free(error);
+        return;
+    }
+
+    cancel_computer_turn();
+    int ok = restore_snapshot(bytes);
+    g_bytes_unref(bytes);
+    if (!ok) {
+        update_status_label("Error reading save file!");
+        return;
+    }
+    g_free(current_slot);
+    current_slot = g_strdup(g_task_get_task_data(G_TASK(result)));
+
+    // The save holds no move history; undo starts over from the loaded position
+    history.count = history.top = 0;
+    think_remaining = think_budget;
+    match_live = 0; // only games played from the start go into the match history
+    publish_snapshot();
+    start_ponder();
+
+    // Update UI
+    update_board_ui();
+    update_score_label();
+
+    update_choice_label();
+
+    update_status_label("Game loaded successfully!");
+}
+
+// Load game state from a slot in the background
+int load_game(const char *slot) {
+    if (save_io_busy)
+        return 0;
+    if (!valid_slot_name(slot)) {
+        update_status_label("Invalid slot name. Use letters, digits, '-' and '_'.");
+        return 0;
+    }
+
+    set_save_io_busy(TRUE);
+    update_status_label("Loading game...");
+
+    GTask *task = g_task_new(NULL, NULL, load_game_finished, NULL);
+    g_task_set_task_data(task, g_strdup(slot), g_free);
+    g_task_run_in_thread(task, load_game_thread);
+    g_object_unref(task);
+    return 1;
+}
+
+// Worker thread: read the slot index
+static void list_slots_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    g_task_return_pointer(task, read_index(), (GDestroyNotify)g_array_unref);
+}
+
+// Draw a slot's board thumbnail, 6 pixels per cell
+GdkPixbuf *slot_thumbnail(const SlotInfo *info) {
+    static const guint8 colors[3][3] = {
+        { 0xE0, 0xE0, 0xE0 }, // empty
+        { 0x4C, 0xAF, 0x50 }, // player
+        { 0xE5, 0x39, 0x35 }  // computer
+    };
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, BOARD_WIDTH * 6, BOARD_HEIGHT * 6);
+    int stride = gdk_pixbuf_get_rowstride(pixbuf);
+    guint8 *pixels = gdk_pixbuf_get_pixels(pixbuf);
+
+    for (int y = 0; y < BOARD_HEIGHT * 6; y++) {
+        for (int x = 0; x < BOARD_WIDTH * 6; x++) {
+            int owner = slot_thumbnail_cell(info, (y / 6) * BOARD_WIDTH + x / 6);
+            int border = (x % 6 == 5) || (y % 6 == 5);
+            for (int c = 0; c < 3; c++)
+                pixels[y * stride + x * 3 + c] = border ? 0xFF : colors[owner % 3][c];
+        }
+    }
+    return pixbuf;
+}
+
+// Main loop: show the slot browser and load the chosen slot
+static void list_slots_finished(GObject *source, GAsyncResult *result, gpointer data) {
+    GArray *slots = g_task_propagate_pointer(G_TASK(result), NULL);
+    set_save_io_busy(FALSE);
+    if (slots == NULL || slots->len == 0) {
+        update_status_label("No saved game found.");
+        if (slots)
+            g_array_unref(slots);
+        return;
+    }
+
+    enum { COL_THUMBNAIL, COL_NAME, COL_SAVED, COL_SCORE, COL_MOVES, N_COLUMNS };
+    GtkListStore *store = gtk_list_store_new(N_COLUMNS, GDK_TYPE_PIXBUF, G_TYPE_STRING,
+                                             G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT);
+    for (guint i = 0; i < slots->len; i++) {
+        SlotInfo *info = &g_array_index(slots, SlotInfo, i);
+        GDateTime *saved = g_date_time_new_from_unix_local(info->saved_at);
+        gchar *saved_text = saved ? g_date_time_format(saved, "%Y-%m-%d %H:%M") : g_strdup("?");
+        gchar *score_text = g_strdup_printf("%d - %d%s", info->player_score, info->computer_score,
+                                            info->game_over ? " (over)" : "");
+        GdkPixbuf *thumbnail = slot_thumbnail(info);
+        GtkTreeIter iter;
+
+        gtk_list_store_append(store, &iter);
+        gtk_list_store_set(store, &iter, COL_THUMBNAIL, thumbnail, COL_NAME, info->name,
+                           COL_SAVED, saved_text, COL_SCORE, score_text, COL_MOVES, info->move_count, -1);
+
+        g_object_unref(thumbnail);
+        g_free(score_text);
+        g_free(saved_text);
+        if (saved)
+            g_date_time_unref(saved);
+    }
+    g_array_unref(slots);
+
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Load Game",
+                                                   GTK_WINDOW(window),
+                                                   GTK_DIALOG_MODAL,
+                                                   "Cancel",
+                                                   GTK_RESPONSE_CANCEL,
+                                                   "Load",
+                                                   GTK_RESPONSE_ACCEPT,
+                                                   NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 480, 400);
+
+    GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    const char *titles[N_COLUMNS] = { "", "Slot", "Saved", "Score", "Moves" };
+    for (int col = 0; col < N_COLUMNS; col++) {
+        GtkCellRenderer *renderer = col == COL_THUMBNAIL ? gtk_cell_renderer_pixbuf_new() : gtk_cell_renderer_text_new();
+        GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes(
+            titles[col], renderer, col == COL_THUMBNAIL ? "pixbuf" : "text", col, NULL);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+    }
+    g_signal_connect_swapped(tree, "row-activated", G_CALLBACK(gtk_window_activate_default), dialog);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scrolled), tree);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    gtk_container_set_border_width(GTK_CONTAINER(content_area), 10);
+    gtk_box_pack_start(GTK_BOX(content_area), scrolled, TRUE, TRUE, 0);
+
+    gtk_widget_show_all(dialog);
+
+    gchar *slot = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        GtkTreeModel *model;
+        GtkTreeIter iter;
+        if (gtk_tree_selection_get_selected(gtk_tree_view_get_selection(GTK_TREE_VIEW(tree)), &model, &iter))
+            gtk_tree_model_get(model, &iter, COL_NAME, &slot, -1);
+    }
+    gtk_widget_destroy(dialog);
+
+    if (slot != NULL) {
+        load_game(slot);
+        g_free(slot);
+    }
+}
+
+// Read the slot index in the background, then show the slot browser
+void show_load_dialog() {
+    if (save_io_busy)
+        return;
+
+    set_save_io_busy(TRUE);
+    GTask *task = g_task_new(NULL, NULL, list_slots_finished, NULL);
+    g_task_run_in_thread(task, list_slots_thread);
+    g_object_unref(task);
+}
+
+// Ask for a slot name, then save to it
+void show_save_dialog() {
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Save Game",
+                                                   GTK_WINDOW(window),
+                                                   GTK_DIALOG_MODAL,
+                                                   "Cancel",
+                                                   GTK_RESPONSE_CANCEL,
+                                                   "Save",
+                                                   GTK_RESPONSE_ACCEPT,
+                                                   NULL);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    gtk_container_set_border_width(GTK_CONTAINER(content_area), 20);
+
+    GtkWidget *prompt_label = gtk_label_new("Slot name (letters, digits, '-' and '_'):");
+    gtk_widget_set_halign(prompt_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(content_area), prompt_label, FALSE, FALSE, 5);
+
+    GtkWidget *slot_entry = gtk_entry_new();
+    gtk_entry_set_max_length(GTK_ENTRY(slot_entry), SLOT_NAME_MAX - 1);
+    gtk_entry_set_text(GTK_ENTRY(slot_entry), current_slot ? current_slot : DEFAULT_SLOT);
+    gtk_entry_set_activates_default(GTK_ENTRY(slot_entry), TRUE);
+    gtk_box_pack_start(GTK_BOX(content_area), slot_entry, FALSE, FALSE, 5);
+
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *slot = g_strdup(gtk_entry_get_text(GTK_ENTRY(slot_entry)));
+        gtk_widget_destroy(dialog);
+        save_game(g_strstrip(slot));
+        g_free(slot);
+        return;
+    }
+    gtk_widget_destroy(dialog);
+}
+
+// Widget updates are coalesced per frame. The update_* functions only record
+// which parts of the window are stale; a tick callback on the main window's
+// frame clock redraws each stale part once, just before the frame is laid out
+// and painted. A burst of model changes (engine replies, undo/redo runs,
+// replay steps, hint refreshes) therefore relabels each widget at most once
+// per frame.
+enum {
+    DIRTY_BOARD  = 1 << 0, // cells and undo/redo sensitivity
+    DIRTY_HINTS  = 1 << 1, // number buttons
+    DIRTY_SCORE  = 1 << 2,
+    DIRTY_STATUS = 1 << 3, // shows pending_status
+    DIRTY_CHOICE = 1 << 4, // computer's choice label
+    DIRTY_CPU    = 1 << 5,
+    DIRTY_STATS  = 1 << 6
+};
+static guint ui_dirty = 0;
+static guint ui_tick_id = 0;
+static gchar *pending_status = NULL; // latest status message, earlier ones are never shown
+
+static void render_board();
+static void render_hints();
+static void render_score_label();
+static void render_status_label();
+static void render_choice_label();
+static void render_cpu_state();
+static void render_stats_window();
+
+// Redraw everything marked stale since the last frame
+static gboolean ui_flush_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer data) {
+    PERF_SCOPE(PERF_UI_FLUSH);
+    guint parts = ui_dirty;
+    ui_dirty = 0;
+    ui_tick_id = 0;
+
+    if (parts & DIRTY_BOARD)
+        render_board();
+    if (parts & DIRTY_HINTS)
+        render_hints();
+    if (parts & DIRTY_CHOICE)
+        render_choice_label();
+    if (parts & DIRTY_SCORE)
+        render_score_label();
+    if (parts & DIRTY_STATUS)
+        render_status_label();
+    if (parts & DIRTY_CPU)
+        render_cpu_state();
+    if (parts & DIRTY_STATS)
+        render_stats_window();
+    return G_SOURCE_REMOVE;
+}
+
+// Mark parts of the window stale and make sure the next frame redraws them
+static void mark_ui_dirty(guint parts) {
+    ui_dirty |= parts;
+    if (ui_tick_id == 0 && window != NULL)
+        ui_tick_id = gtk_widget_add_tick_callback(window, ui_flush_tick, NULL, NULL);
+}
+
+// Update the UI representation of the game board
+void update_board_ui() {
+    mark_ui_dirty(DIRTY_BOARD | DIRTY_HINTS);
+}
+
+static void render_board() {
+    PERF_SCOPE(PERF_UPDATE_BOARD_UI);
+    for (int i = 0; i < SIZE; i++) {
+        GtkWidget *button = board_buttons[i];
+
+        // Set button label
+        char label[10];
+        sprintf(label, "%d", game_board[i]);
+        gtk_button_set_label(GTK_BUTTON(button), label);
+
+        // Set button color based on player
+        GtkStyleContext *context = gtk_widget_get_style_context(button);
+
+        // Remove all previous classes
+        gtk_style_context_remove_class(context, "player-cell");
+        gtk_style_context_remove_class(context, "computer-cell");
+        gtk_style_context_remove_class(context, "empty-cell");
+
+        // Apply appropriate style
+        if (player_move_matrix[i] == 1) {
+            gtk_style_context_add_class(context, "player-cell");
+        } else if (player_move_matrix[i] == 2) {
+            gtk_style_context_add_class(context, "computer-cell");
+        } else {
+            gtk_style_context_add_class(context, "empty-cell");
+        }
+
+        // Enable/disable based on game state
+        gtk_widget_set_sensitive(button, !game_over);
+    }
+
+    if (undo_button != NULL)
+        gtk_widget_set_sensitive(undo_button, history.count > 0);
+    if (redo_button != NULL)
+        gtk_widget_set_sensitive(redo_button, history.count < history.top && !computer_turn_pending());
+}
+
+// Show on each number button whether it is playable and, once pondering has
+// searched it, how good it is for the player. Only reads finished results, so
+// it never waits for the search.
+void update_hints() {
+    mark_ui_dirty(DIRTY_HINTS);
+}
+
+static void render_hints() {
+    gboolean players_turn = !game_over && !computer_turn_pending() && com_choice >= 1;
+    gboolean analysed = ponder_hash != 0 && players_turn &&
+                        ponder_hash == position_hash(player_move_matrix, com_choice);
+    PonderResult results[9];
+    G_LOCK(ponder_results);
+    memcpy(results, ponder_results, sizeof(results));
+    G_UNLOCK(ponder_results);
+
+    for (int i = 0; i < 9; i++) {
+        GtkWidget *button = number_buttons[i];
+        if (button == NULL)
+            continue;
+
+        GtkStyleContext *context = gtk_widget_get_style_context(button);
+        gtk_style_context_remove_class(context, "hint-good");
+        gtk_style_context_remove_class(context, "hint-bad");
+        gtk_style_context_remove_class(context, "hint-illegal");
+
+        char label[32];
+        char tooltip[100];
+        sprintf(label, "%d", i + 1);
+        tooltip[0] = '\0';
+
+        if (show_hints && players_turn) {
+            int idx = product_cell[i + 1][com_choice];
+            int score = -results[i].score; // results are from the computer's side
+            if (idx == -1 || player_move_matrix[idx] != 0) {
+                gtk_style_context_add_class(context, "hint-illegal");
+                sprintf(label, "%d\n-", i + 1);
+                sprintf(tooltip, "%d × %d = %d is not available", i + 1, com_choice, (i + 1) * com_choice);
+            } else if (analysed && results[i].depth > 0) {
+                if (score >= SEARCH_WIN - SIZE)
+                    sprintf(label, "%d\nwin", i + 1);
+                else if (score <= -(SEARCH_WIN - SIZE))
+                    sprintf(label, "%d\nloss", i + 1);
+                else
+                    sprintf(label, "%d\n%+d", i + 1, score);
+                if (score != 0)
+                    gtk_style_context_add_class(context, score > 0 ? "hint-good" : "hint-bad");
+                if (results[i].factor == 0)
+                    sprintf(tooltip, "%d × %d = %d completes four in a line", i + 1, com_choice, (i + 1) * com_choice);
+                else
+                    sprintf(tooltip, "Computer's best reply: %d (looked %d moves ahead%s)",
+                            results[i].factor, results[i].depth, results[i].complete ? ", final" : "");
+            } else {
+                sprintf(label, "%d\n...", i + 1);
+                strcpy(tooltip, ponder_share > 0 ? "Analysing..." : "Analysis is off (--ponder 0)");
+            }
+        }
+
+        gtk_button_set_label(GTK_BUTTON(button), label);
+        gtk_widget_set_tooltip_text(button, tooltip[0] ? tooltip : NULL);
+    }
+}
+
+static gboolean hint_refresh_idle(gpointer data) {
+    g_atomic_int_set(&hint_refresh_pending, 0);
+    update_hints();
+    return G_SOURCE_REMOVE;
+}
+
+// Update the score display
+void update_score_label() {
+    mark_ui_dirty(DIRTY_SCORE);
+}
+
+static void render_score_label() {
+    if (score_label != NULL) {
+        char score_text[100];
+        sprintf(score_text, "Player: %d | Computer: %d", player_score, computer_score);
+        gtk_label_set_text(GTK_LABEL(score_label), score_text);
+    }
+}
+
+// Update the status message
+void update_status_label(const char *message) {
+    g_free(pending_status);
+    pending_status = g_strdup(message);
+    mark_ui_dirty(DIRTY_STATUS);
+}
+
+static void render_status_label() {
+    if (status_label != NULL && pending_status != NULL) {
+        gtk_label_set_text(GTK_LABEL(status_label), pending_status);
+    }
+}
+
+// Update the label showing the factor the player must multiply by
+void update_choice_label() {
+    mark_ui_dirty(DIRTY_CHOICE);
+}
+
+static void render_choice_label() {
+    if (computer_choice_label != NULL) {
+        char comp_choice_text[50];
+        sprintf(comp_choice_text, "Computer's choice: %d", com_choice);
+        gtk_label_set_text(GTK_LABEL(computer_choice_label), comp_choice_text);
+    }
+}
+
+// Update the CPU register display
+void update_cpu_state() {
+    mark_ui_dirty(DIRTY_CPU);
+}
+
+static void render_cpu_state() {
+    if (cpu_state_window && regA_label != NULL && regB_label != NULL && acc_label != NULL) {
+        char reg_text[20];
+
+        sprintf(reg_text, "Register A: %d", cpu.regA);
+        gtk_label_set_text(GTK_LABEL(regA_label), reg_text);
+
+        sprintf(reg_text, "Register B: %d", cpu.regB);
+        gtk_label_set_text(GTK_LABEL(regB_label), reg_text);
+
+        sprintf(reg_text, "Accumulator: %d", cpu.acc);
+        gtk_label_set_text(GTK_LABEL(acc_label), reg_text);
+    }
+}
+
+// Handler for player's number selection
+void on_number_clicked(GtkWidget *widget, gpointer data) {
+    if (game_over) {
+        update_status_label("Game is over. Start a new game.");
+        return;
+    }
+    if (computer_turn_pending()) {
+        update_status_label("Computer is thinking...");
+        return;
+    }
+
+    int player_choice = GPOINTER_TO_INT(data);
+    int multiplier = com_choice;
+    int idx = check_move(1, player_choice, multiplier);
+
+    if (idx != -1) {
+        publish_move(idx, 1, player_choice);
+        int result = multiply(&player_choice, &multiplier);
+        char message[100];
+        sprintf(message, "You chose: %d → %d × %d = %d", player_choice, player_choice, multiplier, result);
+        update_status_label(message);
+
+        update_board_ui();
+        update_cpu_state();
+        update_stats_window();
+
+        if (win_check(1)) {
+            reset_ponder();
+            player_score++;
+            update_score_label();
+            update_status_label("Congratulations, You win!");
+            game_over = 1;
+            finish_game(1);
+        } else if (isBoardFull()) {
+            reset_ponder();
+            update_status_label("Game ends in a tie!");
+            game_over = 1;
+            finish_game(0);
+        } else {
+            // Computer's turn
+            play_computer_turn(player_choice);
+        }
+    } else {
+        int result = multiply(&player_choice, &com_choice);
+        char message[100];
+        sprintf(message, "Invalid move. %d × %d = %d is not available.",
+                player_choice, com_choice, result);
+        update_status_label(message);
+    }
+}
+
+// Is the computer's move still being waited for?
+gboolean computer_turn_pending() {
+    return computer_move_source != 0 || level_search != NULL;
+}
+
+static void level_search_finished(GObject *source, GAsyncResult *result, gpointer data) {
+    GTask *task = G_TASK(result);
+    if (g_cancellable_is_cancelled(g_task_get_cancellable(task)))
+        return;
+
+    g_clear_object(&level_search);
+    trace_complete("play_computer_turn", computer_turn_start);
+    apply_computer_move(GPOINTER_TO_INT(data), (int)g_task_propagate_int(task, NULL));
+}
+
+// Timeout callback running the scheduled computer move once
+static gboolean com_move_timeout(gpointer data) {
+    computer_move_source = 0;
+    think_remaining = MAX(think_remaining - (int)((perf_now() - computer_turn_start) / 1000000), 0);
+    com_move(GPOINTER_TO_INT(data));
+    return G_SOURCE_REMOVE;
+}
+
+// Computer's turn to play
+void play_computer_turn(int player_choice) {
+    // Create a "thinking" effect
+    update_status_label("Computer is thinking...");
+    computer_turn_start = perf_now();
+
+    if (book != NULL && book_move(book, player_move_matrix, player_choice, 2) != -1) {
+        // Perfect play: a lookup, no thinking
+        reset_ponder();
+        computer_move_source = g_timeout_add(0, com_move_timeout, GINT_TO_POINTER(player_choice));
+        update_hints();
+        return;
+    }
+
+    if (difficulty > 0) {
+        // Fixed node budget, off the UI thread; pondering has no say in the move
+        reset_ponder();
+        LevelJob *job = g_new(LevelJob, 1);
+        memcpy(job->moves, player_move_matrix, sizeof(job->moves));
+        job->multiplier = player_choice;
+        job->level = difficulty;
+        guint64 seed = rng_next(&game_rng);
+        seed = (seed << 32) | rng_next(&game_rng);
+        rng_seed(&job->rng, seed);
+
+        level_search = g_cancellable_new();
+        GTask *task = g_task_new(NULL, level_search, level_search_finished, GINT_TO_POINTER(player_choice));
+        g_task_set_task_data(task, job, g_free);
+        g_task_run_in_thread(task, level_search_thread);
+        g_object_unref(task);
+        update_hints();
+        return;
+    }
+
+    focus_ponder(player_choice);
+
+    // Delay the computer's move by the time it is given to think, unless
+    // pondering already solved it. With pondering off (--ponder 0) nothing
+    // searches during a delay, so the move is played at once.
+    guint delay = ponder_thread == NULL || ponder_complete(player_choice) ? 0 :
+                  think_time(player_move_matrix, player_choice, 2, think_remaining);
+    computer_move_source = g_timeout_add(delay, com_move_timeout, GINT_TO_POINTER(player_choice));
+    update_hints();
+}
+
+// Drop a computer move that is still waiting on its timeout or search
+void cancel_computer_turn() {
+    if (computer_move_source != 0) {
+        g_source_remove(computer_move_source);
+        computer_move_source = 0;
+    }
+    if (level_search != NULL) {
+        g_cancellable_cancel(level_search);
+        g_clear_object(&level_search);
+    }
+}
+
+// Refresh everything that depends on the move history
+void update_history_ui(const char *message) {
+    update_choice_label();
 
-    // Update UI
     update_board_ui();
     update_score_label();
+    update_status_label(message);
+}
 
-    if (computer_choice_label != NULL) {
-        char comp_choice_text[50];
-        sprintf(comp_choice_text, "Computer's choice: %d", com_choice);
-        gtk_label_set_text(GTK_LABEL(computer_choice_label), comp_choice_text);
+// Handler for Undo button
+void on_undo_clicked(GtkWidget *widget, gpointer data) {
+    cancel_computer_turn();
+
+    // Taking back the move that ended the game also takes back its point. A
+    // loaded finished game has no history, so there is nothing to take back.
+    int winner = !game_over ? 0 : win_check(1) ? 1 : win_check(2) ? 2 : 0;
+    if (!undo_turn())
+        return;
+    if (winner == 1)
+        player_score--;
+    else if (winner == 2)
+        computer_score--;
+    // Give back the thinking time the computer spent on the undone reply
+    think_remaining = history_think_remaining();
+    game_over = 0;
+    publish_snapshot();
+    update_history_ui("Move undone. Choose a number (1-9).");
+    start_ponder();
+}
+
+// Handler for Redo button
+void on_redo_clicked(GtkWidget *widget, gpointer data) {
+    if (computer_turn_pending() || !redo_turn())
+        return;
+    think_remaining = history_think_remaining();
+    reset_ponder();
+
+    const char *message = "Move redone. Choose a number (1-9).";
+    if (win_check(1)) {
+        player_score++;
+        message = "Congratulations, You win!";
+        game_over = 1;
+    } else if (win_check(2)) {
+        computer_score++;
+        message = "Computer wins!";
+        game_over = 1;
+    } else if (isBoardFull()) {
+        message = "Game ends in a tie!";
+        game_over = 1;
+    }
+    publish_snapshot();
+    update_history_ui(message);
+
+    // The redone move was the player's and the computer never answered it
+    if (!game_over && history.moves[history.count - 1].owner == 1)
+        play_computer_turn(com_choice);
+    else
+        start_ponder();
+}
+
+// Handler for the Show hints check box
+void on_hints_toggled(GtkWidget *widget, gpointer data) {
+    show_hints = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+    update_hints();
+}
+
+// Handler for the difficulty selector; applies from the computer's next move
+void on_level_changed(GtkWidget *widget, gpointer data) {
+    difficulty = MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(widget)), 0);
+}
+
+// Handler for New Game button
+void on_new_game_clicked(GtkWidget *widget, gpointer data) {
+    setup_new_game();
+}
+
+// Handler for Save Game button
+void on_save_game_clicked(GtkWidget *widget, gpointer data) {
+    if (bench_games > 0)
+        save_game(UI_BENCH_SLOT); // no one to answer the dialog
+    else
+        show_save_dialog();
+}
+
+// Handler for Load Game button
+void on_load_game_clicked(GtkWidget *widget, gpointer data) {
+    if (bench_games > 0)
+        load_game(UI_BENCH_SLOT);
+    else
+        show_load_dialog();
+}
+
+// Handler for CPU State button
+void on_cpu_state_clicked(GtkWidget *widget, gpointer data) {
+    if (!cpu_state_window) {
+        cpu_state_window_create();
+    } else {
+        gtk_widget_show_all(cpu_state_window);
+    }
+    update_cpu_state();
+}
+
+// Create the CPU state window
+void cpu_state_window_create() {
+    // Create window
+    cpu_state_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(cpu_state_window), "CPU State");
+    gtk_window_set_default_size(GTK_WINDOW(cpu_state_window), 300, 200);
+    gtk_window_set_transient_for(GTK_WINDOW(cpu_state_window), GTK_WINDOW(window));
+    gtk_window_set_position(GTK_WINDOW(cpu_state_window), GTK_WIN_POS_CENTER_ON_PARENT);
+
+    // Connect destroy signal
+    g_signal_connect(cpu_state_window, "destroy", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+
+    // Create container
+    GtkWidget *cpu_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(cpu_box), 20);
+    gtk_container_add(GTK_CONTAINER(cpu_state_window), cpu_box);
+
+    // Create labels for CPU state
+    GtkWidget *title_label = gtk_label_new("CPU Registers");
+    gtk_widget_set_halign(title_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(cpu_box), title_label, FALSE, FALSE, 5);
+
+    regA_label = gtk_label_new("Register A: 0");
+    gtk_widget_set_halign(regA_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(cpu_box), regA_label, FALSE, FALSE, 5);
+
+    regB_label = gtk_label_new("Register B: 0");
+    gtk_widget_set_halign(regB_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(cpu_box), regB_label, FALSE, FALSE, 5);
+
+    acc_label = gtk_label_new("Accumulator: 0");
+    gtk_widget_set_halign(acc_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(cpu_box), acc_label, FALSE, FALSE, 5);
+
+    // Close button
+    GtkWidget *close_button = gtk_button_new_with_label("Close");
+    g_signal_connect_swapped(close_button, "clicked", G_CALLBACK(gtk_widget_hide), cpu_state_window);
+    gtk_box_pack_start(GTK_BOX(cpu_box), close_button, FALSE, FALSE, 10);
+
+    gtk_widget_show_all(cpu_state_window);
+}
+
+// Update the performance counter display
+void update_stats_window() {
+    mark_ui_dirty(DIRTY_STATS);
+}
+
+static void render_stats_window() {
+    if (!stats_window)
+        return;
+
+    PerfBlock totals;
+    perf_snapshot(&totals);
+
+    for (int i = 0; i < PERF_COUNT; i++) {
+        char text[32];
+        guint64 avg = totals.calls[i] ? totals.nanos[i] / totals.calls[i] : 0;
+
+        sprintf(text, "%" G_GUINT64_FORMAT, totals.calls[i]);
+        gtk_label_set_text(GTK_LABEL(stats_labels[i][0]), text);
+
+        sprintf(text, "%.3f", totals.nanos[i] / 1e6);
+        gtk_label_set_text(GTK_LABEL(stats_labels[i][1]), text);
+
+        sprintf(text, "%" G_GUINT64_FORMAT, avg);
+        gtk_label_set_text(GTK_LABEL(stats_labels[i][2]), text);
+    }
+}
+
+// Handler for Stats button
+void on_stats_clicked(GtkWidget *widget, gpointer data) {
+    if (!stats_window) {
+        stats_window_create();
+    } else {
+        gtk_widget_show_all(stats_window);
+    }
+    update_stats_window();
+}
+
+// Handler for the Stats window's Refresh button
+void on_stats_refresh_clicked(GtkWidget *widget, gpointer data) {
+    update_stats_window();
+}
+
+// Handler for the Stats window's Reset button
+void on_stats_reset_clicked(GtkWidget *widget, gpointer data) {
+    perf_reset();
+    update_stats_window();
+}
+
+// Handler for the Stats window's Export button
+void on_stats_export_clicked(GtkWidget *widget, gpointer data) {
+    if (perf_export_json(STATS_FILE)) {
+        update_status_label("Performance stats exported to " STATS_FILE);
+    } else {
+        update_status_label("Error writing " STATS_FILE "!");
+    }
+}
+
+// Attach a row of labels to a grid, the first column left-aligned
+static void attach_grid_row(GtkWidget *grid, int row, const char **texts, int columns) {
+    for (int col = 0; col < columns; col++) {
+        GtkWidget *label = gtk_label_new(texts[col]);
+        gtk_widget_set_halign(label, col == 0 ? GTK_ALIGN_START : GTK_ALIGN_END);
+        gtk_grid_attach(GTK_GRID(grid), label, col, row, 1, 1);
+    }
+}
+
+// Handler for Leaderboard button: the top players and the player's latest matches
+void on_leaderboard_clicked(GtkWidget *widget, gpointer data) {
+    MatchPlayer top[LEADERBOARD_SIZE], totals;
+    MatchRecord recent[LEADERBOARD_SIZE];
+    g_mutex_lock(&match_lock);
+    MatchStore *store = match_store_open();
+    int top_count = match_leaderboard(store, top, LEADERBOARD_SIZE);
+    int recent_count = match_history(store, player_name, recent, LEADERBOARD_SIZE, &totals);
+    match_store_close(store);
+    g_mutex_unlock(&match_lock);
+
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Leaderboard",
+                                                   GTK_WINDOW(window),
+                                                   GTK_DIALOG_MODAL,
+                                                   "Close",
+                                                   GTK_RESPONSE_CLOSE,
+                                                   NULL);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    gtk_container_set_border_width(GTK_CONTAINER(content_area), 20);
+    gtk_box_set_spacing(GTK_BOX(content_area), 10);
+
+    GtkWidget *top_label = gtk_label_new(top_count ? "Top Players" : "No matches played yet.");
+    gtk_widget_set_halign(top_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(content_area), top_label, FALSE, FALSE, 0);
+
+    GtkWidget *top_grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(top_grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(top_grid), 15);
+    gtk_box_pack_start(GTK_BOX(content_area), top_grid, FALSE, FALSE, 0);
+    if (top_count) {
+        const char *headers[5] = { "Player", "Won", "Drawn", "Lost", "Win %" };
+        attach_grid_row(top_grid, 0, headers, 5);
+    }
+    for (int i = 0; i < top_count; i++) {
+        guint played = top[i].wins + top[i].draws + top[i].losses;
+        gchar *name = g_strdup_printf("%d. %s", i + 1, top[i].name);
+        gchar *wins = g_strdup_printf("%u", top[i].wins);
+        gchar *draws = g_strdup_printf("%u", top[i].draws);
+        gchar *losses = g_strdup_printf("%u", top[i].losses);
+        gchar *share = g_strdup_printf("%.0f", played ? 100.0 * top[i].wins / played : 0.0);
+        const char *row[5] = { name, wins, draws, losses, share };
+        attach_grid_row(top_grid, i + 1, row, 5);
+        g_free(name);
+        g_free(wins);
+        g_free(draws);
+        g_free(losses);
+        g_free(share);
+    }
+
+    gchar *recent_text = g_strdup_printf("Your Matches (%s): %u won, %u drawn, %u lost",
+                                         totals.name, totals.wins, totals.draws, totals.losses);
+    GtkWidget *recent_label = gtk_label_new(recent_text);
+    g_free(recent_text);
+    gtk_widget_set_halign(recent_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(content_area), recent_label, FALSE, FALSE, 0);
+
+    GtkWidget *recent_grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(recent_grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(recent_grid), 15);
+    gtk_box_pack_start(GTK_BOX(content_area), recent_grid, FALSE, FALSE, 0);
+    for (int i = 0; i < recent_count; i++) {
+        GDateTime *finished = g_date_time_new_from_unix_local(recent[i].finished_at);
+        gchar *when = g_date_time_format(finished, "%Y-%m-%d %H:%M");
+        gchar *moves = g_strdup_printf("%u moves", recent[i].move_count);
+        gchar *duration = g_strdup_printf("%.1f s", recent[i].duration_ms / 1000.0);
+        const char *row[4] = { when, recent[i].result > 0 ? "Won" : recent[i].result < 0 ? "Lost" : "Draw",
+                               moves, duration };
+        attach_grid_row(recent_grid, i, row, 4);
+        g_free(when);
+        g_free(moves);
+        g_free(duration);
+        g_date_time_unref(finished);
+    }
+
+    gtk_widget_show_all(dialog);
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+}
+
+// Replay browser. The game list is a GtkTreeModel over a match log that
+// reads records only when the view asks for them, a page at a time, and the
+// view runs in fixed-height mode so it never measures rows it does not show.
+// Opening an archive costs one seek and memory stays at the page cache
+// however many games it holds. The selected game is decoded and scrubbed
+// through on the main board, which the live game gets back when the window
+// closes.
+#define REPLAY_PAGE 64      // records read at once
+#define REPLAY_PAGES 8      // pages cached
+#define REPLAY_SPEED 2.0    // default playback speed in moves per second
+
+enum {
+    REPLAY_COL_NUMBER,
+    REPLAY_COL_WHEN,
+    REPLAY_COL_PLAYER,
+    REPLAY_COL_RESULT,
+    REPLAY_COL_MOVES,
+    REPLAY_COL_DURATION,
+    REPLAY_COL_COUNT
+};
+
+typedef struct {
+    GObject parent;
+    FILE *fp;
+    gint count;                        // whole records in the log
+    gint stamp;
+    gint64 page_number[REPLAY_PAGES];  // page held in each cache slot, -1 for none
+    MatchRecord pages[REPLAY_PAGES][REPLAY_PAGE];
+} MatchListModel;
+
+typedef struct {
+    GObjectClass parent_class;
+} MatchListModelClass;
+
+static void match_list_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(MatchListModel, match_list_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, match_list_model_tree_model_init))
+
+#define MATCH_LIST_MODEL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), match_list_model_get_type(), MatchListModel))
+
+static void match_list_model_init(MatchListModel *list) {
+    list->stamp = g_random_int();
+    for (int i = 0; i < REPLAY_PAGES; i++)
+        list->page_number[i] = -1;
+}
+
+static void match_list_model_finalize(GObject *object) {
+    MatchListModel *list = MATCH_LIST_MODEL(object);
+    if (list->fp)
+        fclose(list->fp);
+    G_OBJECT_CLASS(match_list_model_parent_class)->finalize(object);
+}
+
+static void match_list_model_class_init(MatchListModelClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = match_list_model_finalize;
+}
+
+// Open a match log; returns NULL if it is missing or not a match log
+MatchListModel *match_list_model_new(const char *path) {
+    FILE *fp = g_fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    MatchLogHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, MATCH_LOG_MAGIC, 4) != 0 ||
+        header.version != MATCH_VERSION || header.record_size != sizeof(MatchRecord) ||
+        fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    MatchListModel *list = g_object_new(match_list_model_get_type(), NULL);
+    list->fp = fp;
+    list->count = (gint)MIN((ftell(fp) - (long)sizeof(header)) / (long)sizeof(MatchRecord), G_MAXINT);
+    return list;
+}
+
+// Record shown on a row (newest first), reading its page if it is not
+// cached; NULL if it cannot be read or fails its checksum
+const MatchRecord *match_list_record(MatchListModel *list, gint row) {
+    if (row < 0 || row >= list->count)
+        return NULL;
+    gint64 number = list->count - 1 - row;
+    gint64 page = number / REPLAY_PAGE;
+    int slot = (int)(page % REPLAY_PAGES);
+    if (list->page_number[slot] != page) {
+        size_t wanted = (size_t)MIN(REPLAY_PAGE, list->count - page * REPLAY_PAGE);
+        list->page_number[slot] = -1;
+        if (fseek(list->fp, (long)(sizeof(MatchLogHeader) + page * REPLAY_PAGE * sizeof(MatchRecord)), SEEK_SET) != 0 ||
+            fread(list->pages[slot], sizeof(MatchRecord), wanted, list->fp) != wanted)
+            return NULL;
+        list->page_number[slot] = page;
+    }
+    const MatchRecord *record = &list->pages[slot][number % REPLAY_PAGE];
+    return record->checksum == match_checksum(record) ? record : NULL;
+}
+
+static GtkTreeModelFlags match_list_get_flags(GtkTreeModel *model) {
+    return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint match_list_get_n_columns(GtkTreeModel *model) {
+    return REPLAY_COL_COUNT;
+}
+
+static GType match_list_get_column_type(GtkTreeModel *model, gint column) {
+    return G_TYPE_STRING;
+}
+
+// Point iter at row if the row exists
+static gboolean match_list_set_iter(MatchListModel *list, GtkTreeIter *iter, gint row) {
+    if (row < 0 || row >= list->count)
+        return FALSE;
+    iter->stamp = list->stamp;
+    iter->user_data = GINT_TO_POINTER(row);
+    return TRUE;
+}
+
+static gboolean match_list_get_iter(GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path) {
+    if (gtk_tree_path_get_depth(path) != 1)
+        return FALSE;
+    return match_list_set_iter(MATCH_LIST_MODEL(model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath *match_list_get_path(GtkTreeModel *model, GtkTreeIter *iter) {
+    return gtk_tree_path_new_from_indices(GPOINTER_TO_INT(iter->user_data), -1);
+}
+
+static void match_list_get_value(GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value) {
+    MatchListModel *list = MATCH_LIST_MODEL(model);
+    gint row = GPOINTER_TO_INT(iter->user_data);
+    const MatchRecord *record = match_list_record(list, row);
+    gchar *text = NULL;
+
+    g_value_init(value, G_TYPE_STRING);
+    if (column == REPLAY_COL_NUMBER) {
+        text = g_strdup_printf("%d", list->count - row);
+    } else if (record == NULL) {
+        text = g_strdup(column == REPLAY_COL_WHEN ? "(damaged)" : "");
+    } else if (column == REPLAY_COL_WHEN) {
+        GDateTime *finished = g_date_time_new_from_unix_local(record->finished_at);
+        text = finished ? g_date_time_format(finished, "%Y-%m-%d %H:%M") : g_strdup("?");
+        if (finished)
+            g_date_time_unref(finished);
+    } else if (column == REPLAY_COL_PLAYER) {
+        text = g_strndup(record->player, MATCH_NAME_MAX);
+    } else if (column == REPLAY_COL_RESULT) {
+        text = g_strdup(record->result > 0 ? "Won" : record->result < 0 ? "Lost" : "Draw");
+    } else if (column == REPLAY_COL_MOVES) {
+        text = g_strdup_printf("%u%s", record->move_count, record->flags & MATCH_FULL_MOVES ? "" : " (end only)");
+    } else {
+        text = g_strdup_printf("%.1f s", record->duration_ms / 1000.0);
+    }
+    g_value_take_string(value, text);
+}
+
+static gboolean match_list_iter_next(GtkTreeModel *model, GtkTreeIter *iter) {
+    return match_list_set_iter(MATCH_LIST_MODEL(model), iter, GPOINTER_TO_INT(iter->user_data) + 1);
+}
+
+static gboolean match_list_iter_previous(GtkTreeModel *model, GtkTreeIter *iter) {
+    return match_list_set_iter(MATCH_LIST_MODEL(model), iter, GPOINTER_TO_INT(iter->user_data) - 1);
+}
+
+static gboolean match_list_iter_children(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent) {
+    return parent == NULL && match_list_set_iter(MATCH_LIST_MODEL(model), iter, 0);
+}
+
+static gboolean match_list_iter_has_child(GtkTreeModel *model, GtkTreeIter *iter) {
+    return FALSE;
+}
+
+static gint match_list_iter_n_children(GtkTreeModel *model, GtkTreeIter *iter) {
+    return iter == NULL ? MATCH_LIST_MODEL(model)->count : 0;
+}
+
+static gboolean match_list_iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n) {
+    return parent == NULL && match_list_set_iter(MATCH_LIST_MODEL(model), iter, n);
+}
+
+static gboolean match_list_iter_parent(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *child) {
+    return FALSE;
+}
+
+static void match_list_model_tree_model_init(GtkTreeModelIface *iface) {
+    iface->get_flags = match_list_get_flags;
+    iface->get_n_columns = match_list_get_n_columns;
+    iface->get_column_type = match_list_get_column_type;
+    iface->get_iter = match_list_get_iter;
+    iface->get_path = match_list_get_path;
+    iface->get_value = match_list_get_value;
+    iface->iter_next = match_list_iter_next;
+    iface->iter_previous = match_list_iter_previous;
+    iface->iter_children = match_list_iter_children;
+    iface->iter_has_child = match_list_iter_has_child;
+    iface->iter_n_children = match_list_iter_n_children;
+    iface->iter_nth_child = match_list_iter_nth_child;
+    iface->iter_parent = match_list_iter_parent;
+}
+
+// The game being replayed, decoded from its record
+typedef struct {
+    int length;                // moves that can be replayed
+    uint8_t cells[SIZE];
+    uint8_t owners[SIZE];
+    uint8_t factors[SIZE];
+    uint8_t multipliers[SIZE]; // number each move's factor was multiplied by
+} Replay;
+
+// The live game, put aside while the board shows a replay
+typedef struct {
+    int moves[SIZE];
+    int com_choice;
+    int game_over;
+    MoveStack history;
+} LiveGame;
+
+GtkWidget *replay_window = NULL;
+GtkWidget *replay_view = NULL;
+GtkWidget *replay_title = NULL;
+GtkWidget *replay_scale = NULL;
+GtkWidget *replay_speed = NULL;
+GtkWidget *replay_play_button = NULL;
+GtkWidget *replay_move_label = NULL;
+Replay replay;
+LiveGame live_game;
+guint replay_source = 0; // playback timer, 0 when paused
+
+// Decode a record for replay; NULL gives an empty replay
+void replay_decode(Replay *r, const MatchRecord *record) {
+    r->length = record ? match_decode(record, r->cells, r->owners, r->factors) : 0;
+
+    // The number each move multiplied by is the other side's last factor
+    int last_factor[3] = { 0, 0, record ? record->opening : 0 };
+    for (int i = 0; i < r->length; i++) {
+        r->multipliers[i] = (uint8_t)last_factor[3 - r->owners[i]];
+        last_factor[r->owners[i]] = r->factors[i];
+    }
+}
+
+// Show the replayed game after its first step moves
+void replay_show(int step) {
+    memset(player_move_matrix, 0, sizeof(player_move_matrix));
+    for (int i = 0; i < step && i < replay.length; i++)
+        player_move_matrix[replay.cells[i]] = replay.owners[i];
+    update_board_ui();
+
+    gchar *text;
+    if (step == 0) {
+        text = g_strdup_printf("Start of the game (%d moves)", replay.length);
+    } else {
+        int i = step - 1;
+        text = g_strdup_printf("Move %d of %d: %s chose %d → %d × %d = %d", step, replay.length,
+                               replay.owners[i] == 1 ? "Player" : "Computer", replay.factors[i],
+                               replay.factors[i], replay.multipliers[i], game_board[replay.cells[i]]);
+    }
+    gtk_label_set_text(GTK_LABEL(replay_move_label), text);
+    g_free(text);
+}
+
+void replay_stop() {
+    if (replay_source != 0) {
+        g_source_remove(replay_source);
+        replay_source = 0;
+    }
+    if (replay_play_button != NULL)
+        gtk_button_set_label(GTK_BUTTON(replay_play_button), "Play");
+}
+
+// Playback timer: step forward, pausing at the end
+static gboolean replay_tick(gpointer data) {
+    int step = (int)gtk_range_get_value(GTK_RANGE(replay_scale));
+    if (step >= replay.length) {
+        replay_source = 0;
+        replay_stop();
+        return G_SOURCE_REMOVE;
+    }
+    gtk_range_set_value(GTK_RANGE(replay_scale), step + 1);
+    return G_SOURCE_CONTINUE;
+}
+
+void replay_play() {
+    replay_stop();
+    if (replay.length == 0)
+        return;
+    if ((int)gtk_range_get_value(GTK_RANGE(replay_scale)) >= replay.length)
+        gtk_range_set_value(GTK_RANGE(replay_scale), 0);
+    double speed = gtk_range_get_value(GTK_RANGE(replay_speed));
+    replay_source = g_timeout_add((guint)(1000 / speed), replay_tick, NULL);
+    gtk_button_set_label(GTK_BUTTON(replay_play_button), "Pause");
+}
+
+// Handler for a new selection in the game list: decode that game only
+void on_replay_selection_changed(GtkTreeSelection *selection, gpointer data) {
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    replay_stop();
+    replay.length = 0;
+    if (gtk_tree_selection_get_selected(selection, &model, &iter))
+        replay_decode(&replay, match_list_record(MATCH_LIST_MODEL(model), GPOINTER_TO_INT(iter.user_data)));
+
+    gtk_range_set_range(GTK_RANGE(replay_scale), 0, MAX(replay.length, 1));
+    gtk_range_set_value(GTK_RANGE(replay_scale), replay.length);
+    replay_show(replay.length);
+    if (replay.length == 0 && gtk_tree_selection_get_selected(selection, NULL, NULL))
+        gtk_label_set_text(GTK_LABEL(replay_move_label), "Only the result of this game was recorded.");
+}
+
+void on_replay_scale_changed(GtkRange *range, gpointer data) {
+    replay_show((int)gtk_range_get_value(range));
+}
+
+void on_replay_play_clicked(GtkWidget *widget, gpointer data) {
+    if (replay_source != 0)
+        replay_stop();
+    else
+        replay_play();
+}
+
+// Handler for the step buttons; data is the step to add (a large value for the ends)
+void on_replay_step_clicked(GtkWidget *widget, gpointer data) {
+    replay_stop();
+    int step = (int)gtk_range_get_value(GTK_RANGE(replay_scale)) + GPOINTER_TO_INT(data);
+    gtk_range_set_value(GTK_RANGE(replay_scale), CLAMP(step, 0, replay.length));
+}
+
+void on_replay_speed_changed(GtkRange *range, gpointer data) {
+    if (replay_source != 0)
+        replay_play();
+}
+
+// Show an archive in the game list; returns FALSE if it cannot be read
+gboolean replay_open_archive(const char *path) {
+    MatchListModel *list = match_list_model_new(path);
+    if (list == NULL)
+        return FALSE;
+    gchar *base = g_path_get_basename(path);
+    gchar *title = g_strdup_printf("%s: %d games, newest first", base, list->count);
+    gtk_label_set_text(GTK_LABEL(replay_title), title);
+    g_free(title);
+    g_free(base);
+
+    gtk_tree_view_set_model(GTK_TREE_VIEW(replay_view), GTK_TREE_MODEL(list));
+    g_object_unref(list);
+    return TRUE;
+}
+
+// Handler for the Open Archive button
+void on_replay_open_clicked(GtkWidget *widget, gpointer data) {
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Open Game Archive",
+                                                    GTK_WINDOW(replay_window),
+                                                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                    "Cancel", GTK_RESPONSE_CANCEL,
+                                                    "Open", GTK_RESPONSE_ACCEPT,
+                                                    NULL);
+    gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(dialog), save_dir());
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        if (!replay_open_archive(path))
+            gtk_label_set_text(GTK_LABEL(replay_title), "Not a match history file.");
+        g_free(path);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+// The replay window is closing: give the board back to the live game
+void on_replay_destroy(GtkWidget *widget, gpointer data) {
+    replay_stop();
+    replay_window = NULL;
+    replay_play_button = NULL;
+
+    memcpy(player_move_matrix, live_game.moves, sizeof(player_move_matrix));
+    com_choice = live_game.com_choice;
+    game_over = live_game.game_over;
+    history = live_game.history;
+    update_board_ui();
+    update_status_label(game_over ? "Game is over. Start a new game." : "Choose a number (1-9).");
+    if (!game_over)
+        start_ponder();
+}
+
+// Add a fixed-width text column to the game list
+static void replay_add_column(const char *title, int column, int width) {
+    GtkTreeViewColumn *view_column = gtk_tree_view_column_new_with_attributes(title, gtk_cell_renderer_text_new(),
+                                                                              "text", column, NULL);
+    gtk_tree_view_column_set_sizing(view_column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(view_column, width);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(replay_view), view_column);
+}
+
+// Handler for Replays button
+void on_replays_clicked(GtkWidget *widget, gpointer data) {
+    if (replay_window != NULL) {
+        gtk_window_present(GTK_WINDOW(replay_window));
+        return;
+    }
+    if (computer_turn_pending()) {
+        update_status_label("Computer is thinking...");
+        return;
     }
 
-    update_status_label("Game loaded successfully!");
-    return 1;
+    // Put the live game aside; the board belongs to the replay until the window closes
+    reset_ponder();
+    memcpy(live_game.moves, player_move_matrix, sizeof(player_move_matrix));
+    live_game.com_choice = com_choice;
+    live_game.game_over = game_over;
+    live_game.history = history;
+    game_over = 1;
+    replay.length = 0;
+
+    replay_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(replay_window), "Replays");
+    gtk_window_set_default_size(GTK_WINDOW(replay_window), 560, 520);
+    gtk_window_set_transient_for(GTK_WINDOW(replay_window), GTK_WINDOW(window));
+    gtk_window_set_modal(GTK_WINDOW(replay_window), TRUE);
+    g_signal_connect(replay_window, "destroy", G_CALLBACK(on_replay_destroy), NULL);
+
+    GtkWidget *replay_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(replay_box), 20);
+    gtk_container_add(GTK_CONTAINER(replay_window), replay_box);
+
+    // Archive name and Open button
+    GtkWidget *title_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(replay_box), title_row, FALSE, FALSE, 0);
+    replay_title = gtk_label_new("No match history yet.");
+    gtk_widget_set_halign(replay_title, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(title_row), replay_title, TRUE, TRUE, 0);
+    GtkWidget *open_button = gtk_button_new_with_label("Open Archive...");
+    g_signal_connect(open_button, "clicked", G_CALLBACK(on_replay_open_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(title_row), open_button, FALSE, FALSE, 0);
+
+    // Game list; fixed-height mode keeps the view from measuring every row
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(replay_box), scrolled, TRUE, TRUE, 0);
+    replay_view = gtk_tree_view_new();
+    replay_add_column("#", REPLAY_COL_NUMBER, 70);
+    replay_add_column("Finished", REPLAY_COL_WHEN, 130);
+    replay_add_column("Player", REPLAY_COL_PLAYER, 110);
+    replay_add_column("Result", REPLAY_COL_RESULT, 60);
+    replay_add_column("Moves", REPLAY_COL_MOVES, 100);
+    replay_add_column("Time", REPLAY_COL_DURATION, 60);
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(replay_view), TRUE);
+    gtk_container_add(GTK_CONTAINER(scrolled), replay_view);
+    GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(replay_view));
+    gtk_tree_selection_set_mode(selection, GTK_SELECTION_BROWSE);
+    g_signal_connect(selection, "changed", G_CALLBACK(on_replay_selection_changed), NULL);
+
+    // Position slider and move description
+    replay_scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0, 1, 1);
+    gtk_scale_set_digits(GTK_SCALE(replay_scale), 0);
+    g_signal_connect(replay_scale, "value-changed", G_CALLBACK(on_replay_scale_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(replay_box), replay_scale, FALSE, FALSE, 0);
+    replay_move_label = gtk_label_new("");
+    gtk_widget_set_halign(replay_move_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(replay_box), replay_move_label, FALSE, FALSE, 0);
+
+    // Step and Play buttons, then the speed slider
+    GtkWidget *button_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(replay_box), button_row, FALSE, FALSE, 0);
+    const char *step_labels[4] = { "|<", "<", ">", ">|" };
+    const int steps[4] = { -SIZE, -1, 1, SIZE };
+    for (int i = 0; i < 4; i++) {
+        GtkWidget *step_button = gtk_button_new_with_label(step_labels[i]);
+        g_signal_connect(step_button, "clicked", G_CALLBACK(on_replay_step_clicked), GINT_TO_POINTER(steps[i]));
+        gtk_box_pack_start(GTK_BOX(button_row), step_button, FALSE, FALSE, 0);
+        if (i == 1) {
+            replay_play_button = gtk_button_new_with_label("Play");
+            g_signal_connect(replay_play_button, "clicked", G_CALLBACK(on_replay_play_clicked), NULL);
+            gtk_box_pack_start(GTK_BOX(button_row), replay_play_button, FALSE, FALSE, 0);
+        }
+    }
+    gtk_box_pack_start(GTK_BOX(button_row), gtk_label_new("Moves/s"), FALSE, FALSE, 0);
+    replay_speed = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0.5, 20, 0.5);
+    gtk_range_set_value(GTK_RANGE(replay_speed), REPLAY_SPEED);
+    g_signal_connect(replay_speed, "value-changed", G_CALLBACK(on_replay_speed_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), replay_speed, TRUE, TRUE, 0);
+
+    gchar *path = g_build_filename(save_dir(), MATCH_LOG_FILE, NULL);
+    replay_open_archive(path);
+    g_free(path);
+    replay_show(0);
+    gtk_label_set_text(GTK_LABEL(replay_move_label), "Select a game to replay it.");
+
+    gtk_widget_show_all(replay_window);
 }
 
-// Update the UI representation of the game board
-void update_board_ui() {
-    for (int i = 0; i < SIZE; i++) {
-        GtkWidget *button = board_buttons[i];
+// Heatmap dashboard: which products get claimed, when and by whom, and how
+// the opening multiplier affects the result, aggregated over a match log.
+// The log is split between worker threads that each stream their range into
+// their own GameStats, summed at the end, so memory does not grow with the
+// number of games. Same statistics and CSV as the console's --aggregate.
+#define AGGREGATE_FILE "aggregate.csv"
+#define AGGREGATE_CHUNK 1024 // log records read at once
 
-        // Set button label
-        char label[10];
-        sprintf(label, "%d", game_board[i]);
-        gtk_button_set_label(GTK_BUTTON(button), label);
+// Every field is a counter, so blocks are merged by adding them as uint64_t arrays
+typedef struct {
+    uint64_t games;              // games with their moves
+    uint64_t moves;
+    uint64_t decided;            // games with a winner
+    uint64_t skipped;            // log records without their moves, or damaged
+    uint64_t claims[2][SIZE];    // times each cell was claimed by the player / the computer
+    uint64_t ply_sum[SIZE];      // sum of the move numbers (from 1) of those claims
+    uint64_t winner_cells[SIZE]; // times the cell was the winner's when the game ended
+    uint64_t openings[10][3];    // results by opening multiplier: player won, draw, computer won
+    uint64_t opening_moves[10];  // moves of the games of each opening
+} GameStats;
+
+// What the heatmap colours the cells by
+enum {
+    HEATMAP_CLAIMED,  // share of games the cell was claimed in
+    HEATMAP_SHARE,    // player's share of the claims
+    HEATMAP_ORDER,    // mean move number of a claim
+    HEATMAP_WINNER,   // share of decided games the winner owned the cell in
+    HEATMAP_MODES
+};
 
-        // Set button color based on player
-        GtkStyleContext *context = gtk_widget_get_style_context(button);
+// One thread's share of a log
+typedef struct {
+    const gchar *path;
+    gint64 first;
+    gint64 last;
+    GameStats stats;
+} AggregateJob;
+
+GtkWidget *heatmap_window = NULL;
+GtkWidget *heatmap_area = NULL;
+GtkWidget *heatmap_status = NULL;
+GtkWidget *heatmap_mode_combo = NULL;
+GtkWidget *heatmap_labels[9][5];    // per opening: games, player, draw, computer, moves
+GameStats heatmap_stats;
+gchar *heatmap_path = NULL;         // log being shown
+gboolean heatmap_busy = FALSE;
+guint64 heatmap_started = 0;        // perf_now() when the running aggregation started
+
+// Count one game; result is 1 if the player won, 0 for a draw, -1 if the computer won
+void stats_add_game(GameStats *stats, int opening, const uint8_t *cells, const uint8_t *owners, int length, int result) {
+    int final[SIZE] = {0};
+    stats->games++;
+    stats->moves += length;
+    for (int i = 0; i < length; i++) {
+        stats->claims[owners[i] - 1][cells[i]]++;
+        stats->ply_sum[cells[i]] += i + 1;
+        final[cells[i]] = owners[i];
+    }
+    if (result != 0) {
+        int winner = result > 0 ? 1 : 2;
+        stats->decided++;
+        for (int i = 0; i < SIZE; i++)
+            stats->winner_cells[i] += final[i] == winner;
+    }
+    if (opening >= 1 && opening <= 9) {
+        stats->openings[opening][1 - result]++;
+        stats->opening_moves[opening] += length;
+    }
+}
 
-        // Remove all previous classes
-        gtk_style_context_remove_class(context, "player-cell");
-        gtk_style_context_remove_class(context, "computer-cell");
-        gtk_style_context_remove_class(context, "empty-cell");
+void stats_merge(GameStats *into, const GameStats *from) {
+    uint64_t *a = (uint64_t *)into;
+    const uint64_t *b = (const uint64_t *)from;
+    for (size_t i = 0; i < sizeof(GameStats) / sizeof(uint64_t); i++)
+        a[i] += b[i];
+}
 
-        // Apply appropriate style
-        if (player_move_matrix[i] == 1) {
-            gtk_style_context_add_class(context, "player-cell");
-        } else if (player_move_matrix[i] == 2) {
-            gtk_style_context_add_class(context, "computer-cell");
-        } else {
-            gtk_style_context_add_class(context, "empty-cell");
+// Worker thread: stream a range of log records into the job's block
+static gpointer aggregate_worker(gpointer data) {
+    AggregateJob *job = data;
+    FILE *fp = g_fopen(job->path, "rb");
+    if (!fp || fseek(fp, (long)(sizeof(MatchLogHeader) + job->first * sizeof(MatchRecord)), SEEK_SET) != 0) {
+        if (fp)
+            fclose(fp);
+        return NULL;
+    }
+    MatchRecord *chunk = g_new(MatchRecord, AGGREGATE_CHUNK);
+    uint8_t cells[SIZE], owners[SIZE], factors[SIZE];
+    for (gint64 number = job->first; number < job->last;) {
+        size_t wanted = (size_t)MIN(job->last - number, AGGREGATE_CHUNK);
+        size_t got = fread(chunk, sizeof(MatchRecord), wanted, fp);
+        for (size_t i = 0; i < got; i++) {
+            int length = chunk[i].checksum == match_checksum(&chunk[i]) ?
+                         match_decode(&chunk[i], cells, owners, factors) : 0;
+            if (length > 0)
+                stats_add_game(&job->stats, chunk[i].opening, cells, owners, length, chunk[i].result);
+            else
+                job->stats.skipped++;
         }
-
-        // Enable/disable based on game state
-        gtk_widget_set_sensitive(button, !game_over);
+        if (got < wanted)
+            break;
+        number += got;
     }
+    g_free(chunk);
+    fclose(fp);
+    return NULL;
 }
 
-// Update the score display
-void update_score_label() {
-    if (score_label != NULL) {
-        char score_text[100];
-        sprintf(score_text, "Player: %d | Computer: %d", player_score, computer_score);
-        gtk_label_set_text(GTK_LABEL(score_label), score_text);
+// Task thread: split the log between the processors and sum their blocks
+static void aggregate_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    const gchar *path = task_data;
+    MatchListModel *list = match_list_model_new(path);
+    if (list == NULL) {
+        g_task_return_new_error(task, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a match log", path);
+        return;
+    }
+    gint64 records = list->count;
+    g_object_unref(list);
+
+    int threads = MAX(g_get_num_processors(), 1);
+    AggregateJob *jobs = g_new0(AggregateJob, threads);
+    GThread **workers = g_new(GThread *, threads);
+    for (int t = 0; t < threads; t++) {
+        jobs[t].path = path;
+        jobs[t].first = records * t / threads;
+        jobs[t].last = records * (t + 1) / threads;
+        workers[t] = g_thread_new("aggregate", aggregate_worker, &jobs[t]);
     }
+    GameStats *stats = g_new0(GameStats, 1);
+    for (int t = 0; t < threads; t++) {
+        g_thread_join(workers[t]);
+        stats_merge(stats, &jobs[t].stats);
+    }
+    g_free(jobs);
+    g_free(workers);
+    g_task_return_pointer(task, stats, g_free);
 }
 
-// Update the status message
-void update_status_label(const char *message) {
-    if (status_label != NULL) {
-        gtk_label_set_text(GTK_LABEL(status_label), message);
+// Colour of a heatmap value in 0..1: grey to orange, or for the player's
+// share the computer's red to the player's green
+static void heatmap_color(cairo_t *cr, double value, gboolean share) {
+    value = CLAMP(value, 0.0, 1.0);
+    if (share)
+        cairo_set_source_rgb(cr, 0.90 + (0.30 - 0.90) * value, 0.22 + (0.69 - 0.22) * value, 0.21 + (0.31 - 0.21) * value);
+    else
+        cairo_set_source_rgb(cr, 0.88 + (1.00 - 0.88) * value, 0.88 + (0.60 - 0.88) * value, 0.88 + (0.00 - 0.88) * value);
+}
+
+// Value of a cell in a heatmap mode, and the text shown under its product
+static double heatmap_value(const GameStats *stats, int mode, int i, gchar *text, size_t size) {
+    uint64_t claims = stats->claims[0][i] + stats->claims[1][i];
+    double value = 0;
+    if (mode == HEATMAP_CLAIMED) {
+        value = stats->games ? (double)claims / stats->games : 0;
+        g_snprintf(text, size, "%.0f%%", 100 * value);
+    } else if (mode == HEATMAP_SHARE) {
+        value = claims ? (double)stats->claims[0][i] / claims : 0.5;
+        g_snprintf(text, size, claims ? "P %.0f%%" : "-", 100 * value);
+    } else if (mode == HEATMAP_ORDER) {
+        value = claims ? (double)stats->ply_sum[i] / claims : 0;
+        g_snprintf(text, size, claims ? "move %.1f" : "-", value);
+    } else {
+        value = stats->decided ? (double)stats->winner_cells[i] / stats->decided : 0;
+        g_snprintf(text, size, "%.0f%%", 100 * value);
     }
+    return value;
 }
 
-// Update the CPU register display
-void update_cpu_state() {
-    if (cpu_state_window && regA_label != NULL && regB_label != NULL && acc_label != NULL) {
-        char reg_text[20];
+// Draw the 6x6 heatmap over the game board's products
+static gboolean on_heatmap_draw(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    int mode = MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(heatmap_mode_combo)), 0);
+    double width = gtk_widget_get_allocated_width(widget) / (double)BOARD_WIDTH;
+    double height = gtk_widget_get_allocated_height(widget) / (double)BOARD_HEIGHT;
+    gchar text[32];
 
-        sprintf(reg_text, "Register A: %d", cpu.regA);
-        gtk_label_set_text(GTK_LABEL(regA_label), reg_text);
+    // Scale to the largest value, except for shares which are already 0..1
+    double largest = 0;
+    for (int i = 0; i < SIZE; i++)
+        largest = MAX(largest, heatmap_value(&heatmap_stats, mode, i, text, sizeof(text)));
 
-        sprintf(reg_text, "Register B: %d", cpu.regB);
-        gtk_label_set_text(GTK_LABEL(regB_label), reg_text);
+    for (int i = 0; i < SIZE; i++) {
+        double x = i % BOARD_WIDTH * width, y = i / BOARD_WIDTH * height;
+        double value = heatmap_value(&heatmap_stats, mode, i, text, sizeof(text));
+        heatmap_color(cr, mode == HEATMAP_SHARE ? value : largest > 0 ? value / largest : 0, mode == HEATMAP_SHARE);
+        cairo_rectangle(cr, x + 1, y + 1, width - 2, height - 2);
+        cairo_fill(cr);
+
+        gchar number[8];
+        g_snprintf(number, sizeof(number), "%d", game_board[i]);
+        cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+        cairo_set_font_size(cr, height * 0.28);
+        cairo_move_to(cr, x + width * 0.1, y + height * 0.45);
+        cairo_show_text(cr, number);
+        cairo_set_font_size(cr, height * 0.18);
+        cairo_move_to(cr, x + width * 0.1, y + height * 0.8);
+        cairo_show_text(cr, text);
+    }
+    return TRUE;
+}
 
-        sprintf(reg_text, "Accumulator: %d", cpu.acc);
-        gtk_label_set_text(GTK_LABEL(acc_label), reg_text);
+void on_heatmap_mode_changed(GtkWidget *widget, gpointer data) {
+    gtk_widget_queue_draw(heatmap_area);
+}
+
+// Show freshly aggregated statistics
+void update_heatmap_window() {
+    for (int m = 1; m <= 9; m++) {
+        const uint64_t *r = heatmap_stats.openings[m];
+        uint64_t games = r[0] + r[1] + r[2];
+        gchar text[5][32];
+        g_snprintf(text[0], sizeof(text[0]), "%" G_GUINT64_FORMAT, (guint64)games);
+        g_snprintf(text[1], sizeof(text[1]), "%.1f%%", games ? 100.0 * r[0] / games : 0.0);
+        g_snprintf(text[2], sizeof(text[2]), "%.1f%%", games ? 100.0 * r[1] / games : 0.0);
+        g_snprintf(text[3], sizeof(text[3]), "%.1f%%", games ? 100.0 * r[2] / games : 0.0);
+        g_snprintf(text[4], sizeof(text[4]), "%.1f", games ? (double)heatmap_stats.opening_moves[m] / games : 0.0);
+        for (int col = 0; col < 5; col++)
+            gtk_label_set_text(GTK_LABEL(heatmap_labels[m - 1][col]), text[col]);
     }
+    gtk_widget_queue_draw(heatmap_area);
 }
 
-// Handler for player's number selection
-void on_number_clicked(GtkWidget *widget, gpointer data) {
-    if (game_over) {
-        update_status_label("Game is over. Start a new game.");
+// Main loop: the aggregation finished
+static void aggregate_finished(GObject *source, GAsyncResult *result, gpointer data) {
+    GError *error = NULL;
+    GameStats *stats = g_task_propagate_pointer(G_TASK(result), &error);
+    heatmap_busy = FALSE;
+    if (heatmap_window == NULL) {
+        g_free(stats);
+        g_clear_error(&error);
+        return;
+    }
+    if (stats == NULL) {
+        gtk_label_set_text(GTK_LABEL(heatmap_status), error->message);
+        g_error_free(error);
         return;
     }
 
-    int player_choice = GPOINTER_TO_INT(data);
-    int idx = check_move(1, player_choice, com_choice);
-
-    if (idx != -1) {
-        int result = multiply(&player_choice, &com_choice);
-        char message[100];
-        sprintf(message, "You chose: %d → %d × %d = %d", player_choice, player_choice, com_choice, result);
-        update_status_label(message);
-
-        update_board_ui();
-        update_cpu_state();
+    heatmap_stats = *stats;
+    g_free(stats);
+    gchar *base = g_path_get_basename(heatmap_path);
+    gchar *text = g_strdup_printf("%" G_GUINT64_FORMAT " games from %s (%" G_GUINT64_FORMAT " without moves), %.0f ms",
+                                  (guint64)heatmap_stats.games, base, (guint64)heatmap_stats.skipped,
+                                  (perf_now() - heatmap_started) / 1e6);
+    gtk_label_set_text(GTK_LABEL(heatmap_status), text);
+    g_free(text);
+    g_free(base);
+    update_heatmap_window();
+}
 
-        if (win_check(1)) {
-            player_score++;
-            update_score_label();
-            update_status_label("Congratulations, You win!");
-            game_over = 1;
-        } else if (isBoardFull()) {
-            update_status_label("Game ends in a tie!");
-            game_over = 1;
-        } else {
-            // Computer's turn
-            play_computer_turn(player_choice);
-        }
-    } else {
-        int result = multiply(&player_choice, &com_choice);
-        char message[100];
-        sprintf(message, "Invalid move. %d × %d = %d is not available.",
-                player_choice, com_choice, result);
-        update_status_label(message);
-    }
+// Aggregate heatmap_path in the background
+void heatmap_refresh() {
+    if (heatmap_busy)
+        return;
+    heatmap_busy = TRUE;
+    gtk_label_set_text(GTK_LABEL(heatmap_status), "Aggregating...");
+
+    heatmap_started = perf_now();
+    GTask *task = g_task_new(NULL, NULL, aggregate_finished, NULL);
+    g_task_set_task_data(task, g_strdup(heatmap_path), g_free);
+    g_task_run_in_thread(task, aggregate_thread);
+    g_object_unref(task);
 }
 
-// Computer's turn to play
-void play_computer_turn(int player_choice) {
-    // Create a "thinking" effect
-    update_status_label("Computer is thinking...");
+// Handler for the dashboard's Refresh button
+void on_heatmap_refresh_clicked(GtkWidget *widget, gpointer data) {
+    heatmap_refresh();
+}
 
-    // Use a timeout to delay the computer's move
-    g_timeout_add(1000, (GSourceFunc)com_move, GINT_TO_POINTER(player_choice));
+// Handler for the dashboard's Open Archive button
+void on_heatmap_open_clicked(GtkWidget *widget, gpointer data) {
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Open Game Archive",
+                                                    GTK_WINDOW(heatmap_window),
+                                                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                    "Cancel", GTK_RESPONSE_CANCEL,
+                                                    "Open", GTK_RESPONSE_ACCEPT,
+                                                    NULL);
+    gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(dialog), save_dir());
+    if (!heatmap_busy && gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        g_free(heatmap_path);
+        heatmap_path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        heatmap_refresh();
+    }
+    gtk_widget_destroy(dialog);
 }
 
-// Handler for New Game button
-void on_new_game_clicked(GtkWidget *widget, gpointer data) {
-    setup_new_game();
+// One row per cell, then one per opening multiplier:
+//   kind,key,product,games,player,computer,draws,mean_ply,winner_share
+gboolean write_stats_csv(const char *path, const GameStats *stats) {
+    FILE *fp = g_fopen(path, "w");
+    if (!fp)
+        return FALSE;
+    fprintf(fp, "kind,key,product,games,player,computer,draws,mean_ply,winner_share\n");
+    for (int i = 0; i < SIZE; i++) {
+        uint64_t claims = stats->claims[0][i] + stats->claims[1][i];
+        fprintf(fp, "cell,%d,%d,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",,%.3f,%.4f\n",
+                i, game_board[i], (guint64)stats->games, (guint64)stats->claims[0][i], (guint64)stats->claims[1][i],
+                claims ? (double)stats->ply_sum[i] / claims : 0.0,
+                stats->decided ? (double)stats->winner_cells[i] / stats->decided : 0.0);
+    }
+    for (int m = 1; m <= 9; m++) {
+        const uint64_t *r = stats->openings[m];
+        uint64_t games = r[0] + r[1] + r[2];
+        fprintf(fp, "opening,%d,,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%.3f,\n",
+                m, (guint64)games, (guint64)r[0], (guint64)r[2], (guint64)r[1],
+                games ? (double)stats->opening_moves[m] / games : 0.0);
+    }
+    return fclose(fp) == 0;
 }
 
-// Handler for Save Game button
-void on_save_game_clicked(GtkWidget *widget, gpointer data) {
-    save_game();
+// Handler for the dashboard's Export CSV button
+void on_heatmap_export_clicked(GtkWidget *widget, gpointer data) {
+    if (write_stats_csv(AGGREGATE_FILE, &heatmap_stats))
+        gtk_label_set_text(GTK_LABEL(heatmap_status), "Statistics exported to " AGGREGATE_FILE);
+    else
+        gtk_label_set_text(GTK_LABEL(heatmap_status), "Error writing " AGGREGATE_FILE "!");
 }
 
-// Handler for Load Game button
-void on_load_game_clicked(GtkWidget *widget, gpointer data) {
-    load_game();
+void on_heatmap_destroy(GtkWidget *widget, gpointer data) {
+    heatmap_window = NULL;
 }
 
-// Handler for CPU State button
-void on_cpu_state_clicked(GtkWidget *widget, gpointer data) {
-    if (!cpu_state_window) {
-        cpu_state_window_create();
-    } else {
-        gtk_widget_show_all(cpu_state_window);
+// Handler for Heatmap button
+void on_heatmap_clicked(GtkWidget *widget, gpointer data) {
+    if (heatmap_window != NULL) {
+        gtk_window_present(GTK_WINDOW(heatmap_window));
+        heatmap_refresh();
+        return;
     }
-    update_cpu_state();
+    if (heatmap_path == NULL)
+        heatmap_path = g_build_filename(save_dir(), MATCH_LOG_FILE, NULL);
+
+    heatmap_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(heatmap_window), "Heatmap");
+    gtk_window_set_default_size(GTK_WINDOW(heatmap_window), 480, 760);
+    gtk_window_set_transient_for(GTK_WINDOW(heatmap_window), GTK_WINDOW(window));
+    g_signal_connect(heatmap_window, "destroy", G_CALLBACK(on_heatmap_destroy), NULL);
+
+    GtkWidget *heatmap_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(heatmap_box), 20);
+    gtk_container_add(GTK_CONTAINER(heatmap_window), heatmap_box);
+
+    heatmap_status = gtk_label_new("");
+    gtk_widget_set_halign(heatmap_status, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(heatmap_box), heatmap_status, FALSE, FALSE, 0);
+
+    heatmap_mode_combo = gtk_combo_box_text_new();
+    const char *modes[HEATMAP_MODES] = {
+        "Claimed (% of games)", "Player's share of the claims", "Mean move number of a claim",
+        "Winner's cells (% of decided games)"
+    };
+    for (int i = 0; i < HEATMAP_MODES; i++)
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(heatmap_mode_combo), modes[i]);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(heatmap_mode_combo), HEATMAP_CLAIMED);
+    g_signal_connect(heatmap_mode_combo, "changed", G_CALLBACK(on_heatmap_mode_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(heatmap_box), heatmap_mode_combo, FALSE, FALSE, 0);
+
+    heatmap_area = gtk_drawing_area_new();
+    gtk_widget_set_size_request(heatmap_area, 360, 360);
+    g_signal_connect(heatmap_area, "draw", G_CALLBACK(on_heatmap_draw), NULL);
+    gtk_box_pack_start(GTK_BOX(heatmap_box), heatmap_area, TRUE, TRUE, 0);
+
+    // Results by the computer's opening multiplier
+    GtkWidget *opening_grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(opening_grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(opening_grid), 15);
+    gtk_box_pack_start(GTK_BOX(heatmap_box), opening_grid, FALSE, FALSE, 0);
+    const char *headers[6] = { "Opening", "Games", "Player", "Draw", "Computer", "Moves" };
+    attach_grid_row(opening_grid, 0, headers, 6);
+    for (int m = 1; m <= 9; m++) {
+        gchar opening[4];
+        g_snprintf(opening, sizeof(opening), "%d", m);
+        GtkWidget *opening_label = gtk_label_new(opening);
+        gtk_widget_set_halign(opening_label, GTK_ALIGN_START);
+        gtk_grid_attach(GTK_GRID(opening_grid), opening_label, 0, m, 1, 1);
+        for (int col = 0; col < 5; col++) {
+            heatmap_labels[m - 1][col] = gtk_label_new("");
+            gtk_widget_set_halign(heatmap_labels[m - 1][col], GTK_ALIGN_END);
+            gtk_grid_attach(GTK_GRID(opening_grid), heatmap_labels[m - 1][col], col + 1, m, 1, 1);
+        }
+    }
+
+    // Open Archive, Refresh, Export and Close buttons
+    GtkWidget *button_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(heatmap_box), button_row, FALSE, FALSE, 10);
+
+    GtkWidget *open_button = gtk_button_new_with_label("Open Archive...");
+    g_signal_connect(open_button, "clicked", G_CALLBACK(on_heatmap_open_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), open_button, TRUE, TRUE, 0);
+
+    GtkWidget *refresh_button = gtk_button_new_with_label("Refresh");
+    g_signal_connect(refresh_button, "clicked", G_CALLBACK(on_heatmap_refresh_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), refresh_button, TRUE, TRUE, 0);
+
+    GtkWidget *export_button = gtk_button_new_with_label("Export CSV");
+    g_signal_connect(export_button, "clicked", G_CALLBACK(on_heatmap_export_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), export_button, TRUE, TRUE, 0);
+
+    GtkWidget *close_button = gtk_button_new_with_label("Close");
+    g_signal_connect_swapped(close_button, "clicked", G_CALLBACK(gtk_widget_destroy), heatmap_window);
+    gtk_box_pack_start(GTK_BOX(button_row), close_button, TRUE, TRUE, 0);
+
+    memset(&heatmap_stats, 0, sizeof(heatmap_stats));
+    update_heatmap_window();
+    gtk_widget_show_all(heatmap_window);
+    heatmap_refresh();
 }
 
-// Create the CPU state window
-void cpu_state_window_create() {
+// Create the performance stats window
+void stats_window_create() {
     // Create window
-    cpu_state_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_title(GTK_WINDOW(cpu_state_window), "CPU State");
-    gtk_window_set_default_size(GTK_WINDOW(cpu_state_window), 300, 200);
-    gtk_window_set_transient_for(GTK_WINDOW(cpu_state_window), GTK_WINDOW(window));
-    gtk_window_set_position(GTK_WINDOW(cpu_state_window), GTK_WIN_POS_CENTER_ON_PARENT);
+    stats_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(stats_window), "Stats");
+    gtk_window_set_default_size(GTK_WINDOW(stats_window), 420, 360);
+    gtk_window_set_transient_for(GTK_WINDOW(stats_window), GTK_WINDOW(window));
+    gtk_window_set_position(GTK_WINDOW(stats_window), GTK_WIN_POS_CENTER_ON_PARENT);
 
-    // Connect destroy signal
-    g_signal_connect(cpu_state_window, "destroy", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+    // Closing from the title bar only hides the window; clear the pointer if it is destroyed anyway
+    g_signal_connect(stats_window, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+    g_signal_connect(stats_window, "destroy", G_CALLBACK(gtk_widget_destroyed), &stats_window);
 
     // Create container
-    GtkWidget *cpu_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
-    gtk_container_set_border_width(GTK_CONTAINER(cpu_box), 20);
-    gtk_container_add(GTK_CONTAINER(cpu_state_window), cpu_box);
+    GtkWidget *stats_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(stats_box), 20);
+    gtk_container_add(GTK_CONTAINER(stats_window), stats_box);
 
-    // Create labels for CPU state
-    GtkWidget *title_label = gtk_label_new("CPU Registers");
+    GtkWidget *title_label = gtk_label_new("Hot-Path Counters");
     gtk_widget_set_halign(title_label, GTK_ALIGN_START);
-    gtk_box_pack_start(GTK_BOX(cpu_box), title_label, FALSE, FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(stats_box), title_label, FALSE, FALSE, 5);
+
+#ifdef NO_PERF_STATS
+    GtkWidget *disabled_label = gtk_label_new("Performance counters are disabled in this build.");
+    gtk_widget_set_halign(disabled_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(stats_box), disabled_label, FALSE, FALSE, 5);
+#endif
+
+    // One row per probe: name, calls, total time, average time
+    GtkWidget *stats_grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(stats_grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(stats_grid), 15);
+    gtk_box_pack_start(GTK_BOX(stats_box), stats_grid, FALSE, FALSE, 5);
+
+    const char *headers[4] = { "Probe", "Calls", "Total ms", "Avg ns" };
+    for (int col = 0; col < 4; col++) {
+        GtkWidget *header = gtk_label_new(headers[col]);
+        gtk_widget_set_halign(header, col == 0 ? GTK_ALIGN_START : GTK_ALIGN_END);
+        gtk_grid_attach(GTK_GRID(stats_grid), header, col, 0, 1, 1);
+    }
 
-    regA_label = gtk_label_new("Register A: 0");
-    gtk_widget_set_halign(regA_label, GTK_ALIGN_START);
-    gtk_box_pack_start(GTK_BOX(cpu_box), regA_label, FALSE, FALSE, 5);
+    for (int i = 0; i < PERF_COUNT; i++) {
+        GtkWidget *name_label = gtk_label_new(perf_names[i]);
+        gtk_widget_set_halign(name_label, GTK_ALIGN_START);
+        gtk_grid_attach(GTK_GRID(stats_grid), name_label, 0, i + 1, 1, 1);
 
-    regB_label = gtk_label_new("Register B: 0");
-    gtk_widget_set_halign(regB_label, GTK_ALIGN_START);
-    gtk_box_pack_start(GTK_BOX(cpu_box), regB_label, FALSE, FALSE, 5);
+        for (int col = 0; col < 3; col++) {
+            stats_labels[i][col] = gtk_label_new("0");
+            gtk_widget_set_halign(stats_labels[i][col], GTK_ALIGN_END);
+            gtk_grid_attach(GTK_GRID(stats_grid), stats_labels[i][col], col + 1, i + 1, 1, 1);
+        }
+    }
 
-    acc_label = gtk_label_new("Accumulator: 0");
-    gtk_widget_set_halign(acc_label, GTK_ALIGN_START);
-    gtk_box_pack_start(GTK_BOX(cpu_box), acc_label, FALSE, FALSE, 5);
+    // Refresh, Reset, Export and Close buttons
+    GtkWidget *button_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(stats_box), button_row, FALSE, FALSE, 10);
+
+    GtkWidget *refresh_button = gtk_button_new_with_label("Refresh");
+    g_signal_connect(refresh_button, "clicked", G_CALLBACK(on_stats_refresh_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), refresh_button, TRUE, TRUE, 0);
+
+    GtkWidget *reset_button = gtk_button_new_with_label("Reset");
+    g_signal_connect(reset_button, "clicked", G_CALLBACK(on_stats_reset_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), reset_button, TRUE, TRUE, 0);
+
+    GtkWidget *export_button = gtk_button_new_with_label("Export JSON");
+    g_signal_connect(export_button, "clicked", G_CALLBACK(on_stats_export_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_row), export_button, TRUE, TRUE, 0);
 
-    // Close button
     GtkWidget *close_button = gtk_button_new_with_label("Close");
-    g_signal_connect_swapped(close_button, "clicked", G_CALLBACK(gtk_widget_hide), cpu_state_window);
-    gtk_box_pack_start(GTK_BOX(cpu_box), close_button, FALSE, FALSE, 10);
+    g_signal_connect_swapped(close_button, "clicked", G_CALLBACK(gtk_widget_hide), stats_window);
+    gtk_box_pack_start(GTK_BOX(button_row), close_button, TRUE, TRUE, 0);
 
-    gtk_widget_show_all(cpu_state_window);
+    gtk_widget_show_all(stats_window);
 }
 
 // Setup a new game
 void setup_new_game() {
     // Reset game state
+    cancel_computer_turn();
     memset(player_move_matrix, 0, sizeof(player_move_matrix));
+    history.count = history.top = 0;
     game_over = 0;
+    think_remaining = think_budget;
 
-    // Random computer choice
-    com_choice = (rand() % 9) + 1;
+    // Random computer choice, or with a book the opening best for the computer
+    com_choice = book != NULL ? book_opening(book, &game_rng) : -1;
+    if (com_choice == -1)
+        com_choice = rng_range(&game_rng, 9) + 1;
+    match_live = 1;
+    match_started = perf_now();
+    publish_event(SPECTATE_NEW_GAME, 0, 0, com_choice);
 
-    if (computer_choice_label != NULL) {
-        char comp_choice_text[50];
-        sprintf(comp_choice_text, "Computer's choice: %d", com_choice);
-        gtk_label_set_text(GTK_LABEL(computer_choice_label), comp_choice_text);
-    }
+    update_choice_label();
 
     // Update UI
     update_board_ui();
     update_status_label("New game started. Choose a number (1-9).");
+    start_ponder();
 }
 
 // Handler for rules button
@@ -644,6 +4547,10 @@ void on_rules_clicked(GtkWidget *widget, gpointer data) {
         "5. After your move, the computer plays using your number as its multiplier.\n"
         "6. The game continues until someone gets 4 in a row or the board is full.\n\n"
         "Use the CPU State button to see the simulated CPU registers.\n"
+        "Use the Stats button to see where the game spends its time.\n"
+        "Use the Leaderboard button to see the best players and your latest games,\n"
+        "and the Replays button to step through any recorded game on the board.\n"
+        "Undo takes back your last move and the computer's reply; Redo replays them.\n"
         "Save and load your game progress with the Save/Load buttons."
     );
 
@@ -666,6 +4573,9 @@ void setup_css() {
         ".computer-cell { background-color: #E53935; font-weight: bold; color: red; }"
         ".empty-cell { background-color: #E0E0E0; }"
         ".number-button { font-size: 18px; font-weight: bold; background-color: #FFF9C4; }"
+        ".hint-good { background-color: #C8E6C9; }"
+        ".hint-bad { background-color: #FFCDD2; }"
+        ".hint-illegal { color: #9E9E9E; background-color: #EEEEEE; }"
         ".action-button { background-color: #81D4FA; }"
         ".header-label { font-size: 16px; font-weight: bold; color: #3E2723; }"
         ".status-label { font-style: italic; color: #616161; }";
@@ -692,14 +4602,305 @@ void setup_css() {
     g_object_unref(provider);
 }
 
+// UI benchmark (--bench-ui): plays scripted games by clicking the real
+// buttons from the main loop and times each click to the first frame painted
+// after its effect. Moves, the computer's reply, New, Save and Load are timed
+// separately; resident memory is sampled after a warm-up and at the end. Run
+// it under Xvfb (xvfb-run -a) for a headless measurement.
+#define UI_BENCH_WARMUP 10          // games before the memory baseline
+#define UI_BENCH_SAVE_EVERY 10      // save and reload during every tenth game
+#define UI_BENCH_STALL_MS 30000     // longest wait for a click's result
+
+typedef enum {
+    BENCH_MOVE,   // the player's move is on screen
+    BENCH_REPLY,  // the computer's answer is on screen
+    BENCH_NEW,
+    BENCH_SAVE,
+    BENCH_LOAD,
+    BENCH_KINDS
+} BenchKind;
+
+static const char *bench_names[BENCH_KINDS] = { "move", "computer reply", "new game", "save", "load" };
+
+typedef struct {
+    GArray *samples[BENCH_KINDS]; // click-to-frame latencies in nanoseconds
+    Rng rng;
+    guint64 started;
+    guint64 clicked;              // perf_now() at the last injected click
+    guint waiting;                // BenchKind bits still waiting for their frame
+    guint64 clicks;
+    guint64 watched_clicks;       // clicks when the watchdog last looked
+    guint64 missed;               // results that came without a new frame
+    int games;
+    int moves_in_game;
+    int save_step;                // 0 before the save, 1 saved, 2 reloaded
+    long rss_start_kb;
+    long rss_peak_kb;
+    guint next_source;
+    guint watchdog_source;
+} UiBench;
+
+static UiBench *ui_bench = NULL;
+gint bench_status = 0; // exit status of a benchmark run
+
+// Resident set size of the process in KiB, or -1 where it is not known
+static long resident_kb() {
+    long kb = -1;
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/statm", "r");
+    long pages, resident;
+    if (file != NULL) {
+        if (fscanf(file, "%ld %ld", &pages, &resident) == 2)
+            kb = resident * (sysconf(_SC_PAGESIZE) / 1024);
+        fclose(file);
+    }
+#endif
+    return kb;
+}
+
+// Has the result the click of this kind waits for arrived?
+static gboolean bench_result_ready(BenchKind kind) {
+    switch (kind) {
+    case BENCH_REPLY:
+        return !computer_turn_pending();
+    case BENCH_SAVE:
+    case BENCH_LOAD:
+        return !save_io_busy;
+    default:
+        return TRUE; // applied inside the click handler
+    }
+}
+
+static gboolean ui_bench_next(gpointer data);
+
+static void ui_bench_schedule() {
+    if (ui_bench->next_source == 0)
+        ui_bench->next_source = g_idle_add(ui_bench_next, NULL);
+}
+
+// Every painted frame: time the clicks whose result it shows
+static void ui_bench_after_paint(GdkFrameClock *clock, gpointer data) {
+    if (ui_bench == NULL || ui_bench->waiting == 0)
+        return;
+
+    guint64 now = perf_now();
+    for (int kind = 0; kind < BENCH_KINDS; kind++) {
+        if ((ui_bench->waiting & (1u << kind)) && bench_result_ready(kind)) {
+            guint64 latency = now - ui_bench->clicked;
+            g_array_append_val(ui_bench->samples[kind], latency);
+            ui_bench->waiting &= ~(1u << kind);
+        }
+    }
+    if (ui_bench->waiting == 0)
+        ui_bench_schedule();
+}
+
+// Click a button the way a user would and note what to wait for
+static void ui_bench_click(GtkWidget *button, guint waiting) {
+    ui_bench->clicks++;
+    ui_bench->clicked = perf_now();
+    ui_bench->waiting = waiting;
+    gtk_button_clicked(GTK_BUTTON(button));
+}
+
+// Value of the sorted samples at percentile p, in milliseconds
+static double bench_percentile(GArray *samples, double p) {
+    if (samples->len == 0)
+        return 0;
+    guint index = (guint)(p / 100 * (samples->len - 1) + 0.5);
+    return g_array_index(samples, guint64, index) / 1e6;
+}
+
+static gint compare_guint64(gconstpointer a, gconstpointer b) {
+    guint64 x = *(const guint64 *)a, y = *(const guint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Print the report and close the window, which ends the application
+static void ui_bench_finish() {
+    long rss_end_kb = resident_kb();
+    double seconds = (perf_now() - ui_bench->started) / 1e9;
+
+    g_print("UI benchmark: %d games, %" G_GUINT64_FORMAT " clicks in %.1f s\n",
+            ui_bench->games, ui_bench->clicks, seconds);
+    g_print("%-16s %8s %9s %9s %9s %9s\n", "click-to-frame", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (int kind = 0; kind < BENCH_KINDS; kind++) {
+        GArray *samples = ui_bench->samples[kind];
+        g_array_sort(samples, compare_guint64);
+        g_print("%-16s %8u %9.2f %9.2f %9.2f %9.2f\n", bench_names[kind], samples->len,
+                bench_percentile(samples, 50), bench_percentile(samples, 90),
+                bench_percentile(samples, 99), bench_percentile(samples, 100));
+        g_array_free(samples, TRUE);
+    }
+    if (ui_bench->missed > 0)
+        g_print("%" G_GUINT64_FORMAT " results were never followed by a frame\n", ui_bench->missed);
+    if (ui_bench->rss_start_kb >= 0 && rss_end_kb >= 0) {
+        int measured = MAX(ui_bench->games - UI_BENCH_WARMUP, 1);
+        g_print("Resident memory: %.1f MB after %d games, %.1f MB at the end, peak %.1f MB (%+.2f KB per game)\n",
+                ui_bench->rss_start_kb / 1024.0, UI_BENCH_WARMUP, rss_end_kb / 1024.0,
+                ui_bench->rss_peak_kb / 1024.0, (double)(rss_end_kb - ui_bench->rss_start_kb) / measured);
+    }
+
+    if (ui_bench->next_source != 0)
+        g_source_remove(ui_bench->next_source);
+    if (ui_bench->watchdog_source != 0)
+        g_source_remove(ui_bench->watchdog_source);
+    g_free(ui_bench);
+    ui_bench = NULL;
+    gtk_widget_destroy(window);
+}
+
+// Delete the benchmark's scratch save directory and everything in it
+void ui_bench_remove_saves() {
+    GDir *dir = g_dir_open(save_dir_override, 0, NULL);
+    if (dir != NULL) {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            gchar *path = g_build_filename(save_dir_override, name, NULL);
+            g_remove(path);
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+    g_rmdir(save_dir_override);
+    g_free(save_dir_override);
+    save_dir_override = NULL;
+}
+
+// Main loop, once the last click's results are on screen: the next click
+static gboolean ui_bench_next(gpointer data) {
+    ui_bench->next_source = 0;
+
+    int legal[9], legal_count = 0;
+    for (int factor = 1; factor <= 9 && com_choice >= 1; factor++) {
+        int idx = product_cell[factor][com_choice];
+        if (idx != -1 && player_move_matrix[idx] == 0)
+            legal[legal_count++] = factor;
+    }
+
+    // A side with no legal factor ends the game in a draw, which the board does not announce
+    if (game_over || legal_count == 0) {
+        ui_bench->games++;
+        long rss = resident_kb();
+        ui_bench->rss_peak_kb = MAX(ui_bench->rss_peak_kb, rss);
+        if (ui_bench->games == UI_BENCH_WARMUP)
+            ui_bench->rss_start_kb = rss;
+        if (ui_bench->games >= bench_games) {
+            ui_bench_finish();
+            return G_SOURCE_REMOVE;
+        }
+        ui_bench->moves_in_game = 0;
+        ui_bench->save_step = 0;
+        ui_bench_click(new_game_button, 1u << BENCH_NEW);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (ui_bench->games % UI_BENCH_SAVE_EVERY == UI_BENCH_SAVE_EVERY - 1 && save_dir_override != NULL &&
+        ui_bench->moves_in_game == 2 && ui_bench->save_step < 2) {
+        if (ui_bench->save_step++ == 0)
+            ui_bench_click(save_game_button, 1u << BENCH_SAVE);
+        else
+            ui_bench_click(load_game_button, 1u << BENCH_LOAD);
+        return G_SOURCE_REMOVE;
+    }
+
+    int factor = legal[rng_range(&ui_bench->rng, legal_count)];
+    ui_bench->moves_in_game++;
+    ui_bench_click(number_buttons[factor - 1], 1u << BENCH_MOVE);
+    if (computer_turn_pending())
+        ui_bench->waiting |= 1u << BENCH_REPLY;
+    return G_SOURCE_REMOVE;
+}
+
+// Catch results that never reach the screen and waits that never end
+static gboolean ui_bench_watchdog(gpointer data) {
+    static int idle_ticks = 0;
+    if (ui_bench->waiting == 0 || ui_bench->clicks != ui_bench->watched_clicks) {
+        ui_bench->watched_clicks = ui_bench->clicks;
+        idle_ticks = 0;
+        return G_SOURCE_CONTINUE;
+    }
+
+    idle_ticks++;
+    gboolean ready = TRUE;
+    for (int kind = 0; kind < BENCH_KINDS; kind++)
+        if ((ui_bench->waiting & (1u << kind)) && !bench_result_ready(kind))
+            ready = FALSE;
+
+    if (ready && idle_ticks >= 2) {
+        // The result is applied but nothing asked for a frame to show it
+        ui_bench->missed++;
+        ui_bench->waiting = 0;
+        ui_bench_schedule();
+    } else if (idle_ticks * 500 >= UI_BENCH_STALL_MS) {
+        g_printerr("UI benchmark stalled after %d games waiting for %s\n", ui_bench->games,
+                   bench_names[g_bit_nth_lsf(ui_bench->waiting, -1)]);
+        bench_status = 1;
+        ui_bench->watchdog_source = 0;
+        ui_bench_finish();
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// Start the benchmark once the window is shown
+void ui_bench_start() {
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(window);
+    if (clock == NULL) {
+        g_printerr("UI benchmark needs a display (try xvfb-run)\n");
+        bench_status = 1;
+        gtk_widget_destroy(window);
+        return;
+    }
+
+    // Save and load through a scratch directory, never the player's own saves
+    save_dir_override = g_dir_make_tmp("multiplication-game-bench-XXXXXX", NULL);
+    if (save_dir_override == NULL)
+        g_printerr("UI benchmark: no temporary directory, so saves and loads are skipped\n");
+
+    ui_bench = g_new0(UiBench, 1);
+    for (int kind = 0; kind < BENCH_KINDS; kind++)
+        ui_bench->samples[kind] = g_array_new(FALSE, FALSE, sizeof(guint64));
+    rng_seed(&ui_bench->rng, game_seed ^ 0x9E3779B97F4A7C15ULL);
+    ui_bench->rss_start_kb = -1;
+    ui_bench->rss_peak_kb = resident_kb();
+    ui_bench->started = perf_now();
+
+    g_signal_connect(clock, "after-paint", G_CALLBACK(ui_bench_after_paint), NULL);
+    ui_bench->watchdog_source = g_timeout_add(500, ui_bench_watchdog, NULL);
+    ui_bench_schedule();
+}
+
 // Create and setup window
 static void activate(GtkApplication *app, gpointer user_data) {
+    // Seed random number generator
+    game_seed = seed_option >= 0 ? (uint64_t)seed_option : (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    rng_seed(&game_rng, game_seed);
+    g_print("Game seed: %" G_GUINT64_FORMAT "\n", (guint64)game_seed);
+
+    load_weights(weights_path ? weights_path : WEIGHTS_FILE);
+    search_init();
+    think_budget = MAX(think_budget, 0);
+    if (level_option != NULL) {
+        difficulty = parse_level(level_option);
+        if (difficulty == -1) {
+            g_printerr("Unknown level '%s'; using %s\n", level_option, difficulty_levels[0].name);
+            difficulty = 0;
+        }
+    }
+    if (book_path != NULL && (book = load_book(book_path)) == NULL)
+        g_printerr("Could not load the book %s\n", book_path);
+    if (player_name == NULL)
+        player_name = g_strdup(g_get_user_name());
+
     setup_css();
     // Create window
     window = gtk_application_window_new(app);
     gtk_window_set_title(GTK_WINDOW(window), "Multiplication Strategy Game");
     gtk_window_set_default_size(GTK_WINDOW(window), 800, 600);
     gtk_container_set_border_width(GTK_CONTAINER(window), 20);
+    // Late updates (background saves finishing at exit) must not queue frames on a dead window
+    g_signal_connect(window, "destroy", G_CALLBACK(gtk_widget_destroyed), &window);
 
     // Main container
     GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
@@ -800,31 +5001,64 @@ static void activate(GtkApplication *app, gpointer user_data) {
         gtk_grid_attach(GTK_GRID(numbers_grid), number_buttons[i], col, row, 1, 1);
     }
 
+    // Hint overlay toggle
+    GtkWidget *hints_check = gtk_check_button_new_with_label("Show hints");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(hints_check), show_hints);
+    g_signal_connect(hints_check, "toggled", G_CALLBACK(on_hints_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(controls_box), hints_check, FALSE, FALSE, 0);
+
+    // Difficulty selector
+    GtkWidget *level_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    gtk_box_pack_start(GTK_BOX(level_box), gtk_label_new("Difficulty:"), FALSE, FALSE, 0);
+    GtkWidget *level_combo = gtk_combo_box_text_new();
+    for (int i = 0; i < (int)G_N_ELEMENTS(difficulty_levels); i++)
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(level_combo), difficulty_levels[i].name);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(level_combo), difficulty);
+    g_signal_connect(level_combo, "changed", G_CALLBACK(on_level_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(level_box), level_combo, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(controls_box), level_box, FALSE, FALSE, 0);
+
     // Action buttons
     GtkWidget *button_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
     gtk_box_pack_start(GTK_BOX(controls_box), button_box, FALSE, FALSE, 10);
 
     // New Game button
-    GtkWidget *new_game_button = gtk_button_new_with_label("New Game");
+    new_game_button = gtk_button_new_with_label("New Game");
     context = gtk_widget_get_style_context(new_game_button);
     gtk_style_context_add_class(context, "action-button");
     g_signal_connect(new_game_button, "clicked", G_CALLBACK(on_new_game_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(button_box), new_game_button, FALSE, FALSE, 0);
 
     // Save Game button
-    GtkWidget *save_game_button = gtk_button_new_with_label("Save Game");
+    save_game_button = gtk_button_new_with_label("Save Game");
     context = gtk_widget_get_style_context(save_game_button);
     gtk_style_context_add_class(context, "action-button");
     g_signal_connect(save_game_button, "clicked", G_CALLBACK(on_save_game_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(button_box), save_game_button, FALSE, FALSE, 0);
 
     // Load Game button
-    GtkWidget *load_game_button = gtk_button_new_with_label("Load Game");
+    load_game_button = gtk_button_new_with_label("Load Game");
     context = gtk_widget_get_style_context(load_game_button);
     gtk_style_context_add_class(context, "action-button");
     g_signal_connect(load_game_button, "clicked", G_CALLBACK(on_load_game_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(button_box), load_game_button, FALSE, FALSE, 0);
 
+    // Undo/Redo buttons
+    GtkWidget *history_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(button_box), history_box, FALSE, FALSE, 0);
+
+    undo_button = gtk_button_new_with_label("Undo");
+    context = gtk_widget_get_style_context(undo_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(undo_button, "clicked", G_CALLBACK(on_undo_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(history_box), undo_button, TRUE, TRUE, 0);
+
+    redo_button = gtk_button_new_with_label("Redo");
+    context = gtk_widget_get_style_context(redo_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(redo_button, "clicked", G_CALLBACK(on_redo_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(history_box), redo_button, TRUE, TRUE, 0);
+
     // CPU State button
     GtkWidget *cpu_state_button = gtk_button_new_with_label("CPU State");
     context = gtk_widget_get_style_context(cpu_state_button);
@@ -832,6 +5066,34 @@ static void activate(GtkApplication *app, gpointer user_data) {
     g_signal_connect(cpu_state_button, "clicked", G_CALLBACK(on_cpu_state_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(button_box), cpu_state_button, FALSE, FALSE, 0);
 
+    // Stats button
+    GtkWidget *stats_button = gtk_button_new_with_label("Stats");
+    context = gtk_widget_get_style_context(stats_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(stats_button, "clicked", G_CALLBACK(on_stats_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_box), stats_button, FALSE, FALSE, 0);
+
+    // Leaderboard button
+    GtkWidget *leaderboard_button = gtk_button_new_with_label("Leaderboard");
+    context = gtk_widget_get_style_context(leaderboard_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(leaderboard_button, "clicked", G_CALLBACK(on_leaderboard_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_box), leaderboard_button, FALSE, FALSE, 0);
+
+    // Replays button
+    GtkWidget *replays_button = gtk_button_new_with_label("Replays");
+    context = gtk_widget_get_style_context(replays_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(replays_button, "clicked", G_CALLBACK(on_replays_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_box), replays_button, FALSE, FALSE, 0);
+
+    // Heatmap button
+    GtkWidget *heatmap_button = gtk_button_new_with_label("Heatmap");
+    context = gtk_widget_get_style_context(heatmap_button);
+    gtk_style_context_add_class(context, "action-button");
+    g_signal_connect(heatmap_button, "clicked", G_CALLBACK(on_heatmap_clicked), NULL);
+    gtk_box_pack_start(GTK_BOX(button_box), heatmap_button, FALSE, FALSE, 0);
+
     // Rules button
     GtkWidget *rules_button = gtk_button_new_with_label("Rules");
     context = gtk_widget_get_style_context(rules_button);
@@ -850,22 +5112,47 @@ static void activate(GtkApplication *app, gpointer user_data) {
     gtk_widget_show_all(window);
 
     // Initialize game
+    if (publish_port > 0)
+        start_publishing();
     setup_new_game();
+    if (bench_games > 0)
+        ui_bench_start();
 }
 
+// Command line options
+static GOptionEntry option_entries[] = {
+    { "trace", 0, 0, G_OPTION_ARG_FILENAME, &trace_path, "Record a Chrome trace of the session to FILE", "FILE" },
+    { "seed", 0, 0, G_OPTION_ARG_INT64, &seed_option, "Seed the game's random generator (replays a session)", "N" },
+    { "weights", 0, 0, G_OPTION_ARG_FILENAME, &weights_path, "Load the computer's evaluation weights from FILE", "FILE" },
+    { "ponder", 0, 0, G_OPTION_ARG_INT, &ponder_share, "CPU percent used to think on the player's time (0 disables, default 50)", "N" },
+    { "think-budget", 0, 0, G_OPTION_ARG_INT, &think_budget, "Computer thinking time per game in milliseconds (default 6000)", "MS" },
+    { "level", 0, 0, G_OPTION_ARG_STRING, &level_option, "Difficulty 0-5 or adaptive, beginner, easy, medium, hard, expert", "LEVEL" },
+    { "hints", 0, 0, G_OPTION_ARG_NONE, &show_hints, "Show the legality and evaluation of each number", NULL },
+    { "book", 0, 0, G_OPTION_ARG_FILENAME, &book_path, "Play perfectly from a book written by the console version's --solve", "FILE" },
+    { "name", 0, 0, G_OPTION_ARG_STRING, &player_name, "Name to record finished games under (default: the login name)", "NAME" },
+    { "publish", 0, 0, G_OPTION_ARG_INT, &publish_port, "Send each move to the spectator hub on PORT (the console version's --hub)", "PORT" },
+    { "bench-ui", 0, 0, G_OPTION_ARG_INT, &bench_games, "Click through N scripted games and report click-to-frame latency", "N" },
+    { NULL }
+};
+
 int main(int argc, char **argv) {
-    // Seed random number generator
-    srand(time(NULL));
+    trace_epoch = perf_now();
 
     // Initialize GTK
     GtkApplication *app;
     int status;
 
     app = gtk_application_new("org.gtk.multiplication.game", G_APPLICATION_FLAGS_NONE);
+    g_application_add_main_option_entries(G_APPLICATION(app), option_entries);
     g_signal_connect(app, "activate", G_CALLBACK(activate), NULL);
 
     status = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
+    reset_ponder();
+    if (save_dir_override != NULL)
+        ui_bench_remove_saves();
+
+    trace_flush();
 
-    return status;
+    return status != 0 ? status : bench_status;
 }
@@ -2,12 +2,52 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <stdarg.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <sys/locking.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#include <stdatomic.h>
+#include <signal.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #define SIZE 36
 #define WIDTH 6
 #define HEIGHT 6
-#define SAVE_FILE "game_save.dat"
+#define DEFAULT_SLOT "quicksave"
+#define SLOT_SUFFIX ".dat"
+#define SLOT_NAME_MAX 32
+#define INDEX_FILE "index.dat"
+#define INDEX_MAGIC "MGSI"
+#define INDEX_VERSION 1
+#define STATS_FILE "perf_stats.json"
+#define WEIGHTS_FILE "eval_weights.txt"
+#define ANALYSIS_CACHE_FILE "analysis_cache.txt"
+#define ANALYSIS_DEPTH 8
+#define NNUE_FILE "nnue.bin"
 
 // Board arranged in a 6x6 grid
 int board[SIZE] ={
@@ -23,552 +63,6824 @@ int player_moves[SIZE] = {0}; // 0=none, 1=player, 2=computer
 int player_score = 0, computer_score = 0;
 int com_choice = -1;
 int game_over = 0;
+char move_note[200] = ""; // the last moves, shown under the board on the next redraw
 
-// Simulated CPU Registers
+// One applied move, enough to undo or redo it in constant time
 typedef struct
 {
-    int regA;
-    int regB;
-    int acc;
-} CPU;
+    uint8_t cell;
+    uint8_t owner;           // 1=player, 2=computer
+    uint8_t prev_multiplier; // number the mover multiplied by
+    uint8_t factor;          // number the mover chose; the next side's multiplier
+} MoveRecord;
 
-CPU cpu;
+// Make/unmake history of a board. Entries between count and top are undone
+// moves that can still be redone; making a new move discards them.
+typedef struct
+{
+    MoveRecord moves[SIZE];
+    int count;
+    int top;
+} MoveStack;
 
-// Multiplies two numbers using bitwise operations for simulation
-int multiplication(int *a, int *b)
+MoveStack history; // moves of the interactive game
+
+// Packed game state: the board, multiplier, scores, flags and move count of a
+// game in 16 trivially copyable bytes, against about 176 in the globals above,
+// so a host can keep millions of idle games resident and copy them with two
+// loads. Side 1 is the player, side 2 the computer.
+//   cells: bits 0-35 side 1's cells, bits 36-63 side 2's cells 0-27
+//   info:  bits 0-7 side 2's cells 28-35, 8-11 multiplier (0 before the first
+//          choice), 12-17 move count, 18 game over, 19-23 reserved,
+//          24-43 player score, 44-63 computer score (both saturate)
+typedef struct
 {
-    cpu.regA = *a;
-    cpu.regB = *b;
-    cpu.acc = 0;
+    uint64_t cells;
+    uint64_t info;
+} PackedGame;
 
-    int x = *a;
-    int y = *b;
+_Static_assert(sizeof(PackedGame) == 16, "PackedGame must stay 16 bytes");
 
-    while (y > 0)
-    {
-        if (y & 1)
-            cpu.acc += x;
-        x <<= 1;
-        y >>= 1;
-    }
+#define PACKED_CELLS ((1ULL << SIZE) - 1)
+#define PACKED_SCORE_MAX ((1 << 20) - 1)
+#define SAVE_STATE_INTS (SIZE + 4) // board, both scores, multiplier, game over
 
-    return cpu.acc;
+static inline uint64_t packed_mask(const PackedGame *game, int side)
+{
+    if (side == 1)
+        return game->cells & PACKED_CELLS;
+    return (game->cells >> SIZE) | (game->info & 0xFF) << (64 - SIZE);
 }
 
-// Gets the index of a number in the game board
-int getIndex(int idx)
+static inline void packed_set_mask(PackedGame *game, int side, uint64_t mask)
 {
-    for (int i = 0; i < SIZE; i++)
+    if (side == 1)
+        game->cells = (game->cells & ~PACKED_CELLS) | (mask & PACKED_CELLS);
+    else
     {
-        if (board[i] == idx)
-            return i;
+        game->cells = (game->cells & PACKED_CELLS) | mask << SIZE;
+        game->info = (game->info & ~0xFFULL) | (mask >> (64 - SIZE) & 0xFF);
     }
-    return -1;
 }
 
-// Update score for the specified player
-void updateScore(int player_id)
+// 0 for a free cell, else the side owning it
+static inline int packed_owner(const PackedGame *game, int idx)
 {
-    if (player_id == 1)
-        player_score++;
-    if (player_id == 2)
-        computer_score++;
+    return (int)(packed_mask(game, 1) >> idx & 1) | (int)(packed_mask(game, 2) >> idx & 1) << 1;
 }
 
-// Display the game board with colors
-void display()
+static inline int packed_field(const PackedGame *game, int shift, int bits)
 {
+    return (int)(game->info >> shift & ((1ULL << bits) - 1));
+}
 
-    printf("\033[0m"); // Reset color attributes
+static inline void packed_set_field(PackedGame *game, int shift, int bits, int value)
+{
+    uint64_t mask = ((1ULL << bits) - 1) << shift;
+    game->info = (game->info & ~mask) | ((uint64_t)value << shift & mask);
+}
 
-    printf("\n\n+-----------------------+\n");
-    for (int i = 0; i < SIZE; i++)
-    {
-        printf("|");
-        if (player_moves[i] == 1)
-            printf(" \033[1;32mP\033[0m ");
-        else if (player_moves[i] == 2)
-            printf(" \033[1;31mC\033[0m ");
-        else if (board[i] > 0 && board[i] < 10)
-            printf(" %d ", board[i]);
-        else
-            printf("%d ", board[i]);
+static inline int packed_multiplier(const PackedGame *game) { return packed_field(game, 8, 4); }
+static inline int packed_move_count(const PackedGame *game) { return packed_field(game, 12, 6); }
+static inline int packed_game_over(const PackedGame *game) { return packed_field(game, 18, 1); }
+static inline int packed_player_score(const PackedGame *game) { return packed_field(game, 24, 20); }
+static inline int packed_computer_score(const PackedGame *game) { return packed_field(game, 44, 20); }
 
-        if ((i + 1) % WIDTH == 0)
-        {
-            printf("|\n+-----------------------+\n");
-        }
-    }
+static inline void packed_set_multiplier(PackedGame *game, int multiplier) { packed_set_field(game, 8, 4, multiplier); }
+static inline void packed_set_game_over(PackedGame *game, int over) { packed_set_field(game, 18, 1, over != 0); }
 
-    printf("Player Score: \033[1;32m%d\033[0m \t Computer Score: \033[1;31m%d\033[0m\n", player_score, computer_score);
+static inline void packed_set_scores(PackedGame *game, int player, int computer)
+{
+    packed_set_field(game, 24, 20, player < 0 ? 0 : player > PACKED_SCORE_MAX ? PACKED_SCORE_MAX : player);
+    packed_set_field(game, 44, 20, computer < 0 ? 0 : computer > PACKED_SCORE_MAX ? PACKED_SCORE_MAX : computer);
 }
 
-// Animation for computer's thinking
-void animate_thinking()
+// Put side's piece on a free cell; the mover's factor becomes the multiplier
+static inline void packed_play(PackedGame *game, int idx, int side, int factor)
 {
-    printf("\nComputer thinking");
-    fflush(stdout);
-    for (int i = 0; i < 3; i++)
+    packed_set_mask(game, side, packed_mask(game, side) | 1ULL << idx);
+    packed_set_field(game, 12, 6, packed_move_count(game) + 1);
+    packed_set_multiplier(game, factor);
+}
+
+// Pack the interactive game's layout; com_choice -1 (not chosen yet) packs as 0
+void pack_game(PackedGame *game, const int *moves, int player, int computer, int multiplier, int over)
+{
+    uint64_t mask[2] = { 0, 0 };
+    int count = 0;
+    for (int i = 0; i < SIZE; i++)
     {
-        printf(".");
-        fflush(stdout);
-        usleep(500000);
+        if (moves[i] == 1 || moves[i] == 2)
+        {
+            mask[moves[i] - 1] |= 1ULL << i;
+            count++;
+        }
     }
-    printf("\n");
+    game->cells = game->info = 0;
+    packed_set_mask(game, 1, mask[0]);
+    packed_set_mask(game, 2, mask[1]);
+    packed_set_multiplier(game, multiplier >= 1 && multiplier <= 9 ? multiplier : 0);
+    packed_set_field(game, 12, 6, count);
+    packed_set_game_over(game, over);
+    packed_set_scores(game, player, computer);
 }
 
-// Clear screen with delay
-void clear_screen(int t)
+void unpack_game(const PackedGame *game, int *moves, int *player, int *computer, int *multiplier, int *over)
 {
-    sleep(t);
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif
+    for (int i = 0; i < SIZE; i++)
+        moves[i] = packed_owner(game, i);
+    *player = packed_player_score(game);
+    *computer = packed_computer_score(game);
+    *multiplier = packed_multiplier(game) ? packed_multiplier(game) : -1;
+    *over = packed_game_over(game);
 }
 
-// Check if board is full (draw condition)
-int isBoardFull()
+// Read the state part of a save (SAVE_STATE_INTS ints, as save_game writes
+// them); returns 0 if it is not a valid game
+int pack_save(PackedGame *game, const int *data)
 {
     for (int i = 0; i < SIZE; i++)
     {
-        if (player_moves[i] == 0)
+        if (data[i] < 0 || data[i] > 2)
             return 0;
     }
+    int multiplier = data[SIZE + 2];
+    if (multiplier != -1 && (multiplier < 1 || multiplier > 9))
+        return 0;
+    pack_game(game, data, data[SIZE], data[SIZE + 1], multiplier, data[SIZE + 3]);
     return 1;
 }
 
-// Check for 4-in-a-row win condition
-int checkWin(int player_id)
+void unpack_save(const PackedGame *game, int *data)
 {
-    // Rows
-    for (int row = 0; row < HEIGHT; row++)
-    {
-        for (int col = 0; col <= WIDTH - 4; col++)
-        {
-            int idx = row * WIDTH + col;
-            if (player_moves[idx] == player_id &&
-                    player_moves[idx + 1] == player_id &&
-                    player_moves[idx + 2] == player_id &&
-                    player_moves[idx + 3] == player_id)
-                return 1;
-        }
-    }
-    // Columns
-    for (int col = 0; col < WIDTH; col++)
-    {
-        for (int row = 0; row <= HEIGHT - 4; row++)
-        {
-            int idx = row * WIDTH + col;
-            if (player_moves[idx] == player_id &&
-                    player_moves[idx + WIDTH] == player_id &&
-                    player_moves[idx + 2 * WIDTH] == player_id &&
-                    player_moves[idx + 3 * WIDTH] == player_id)
-                return 1;
-        }
-    }
-    // Diagonals (Top-Left to Bottom-Right)
-    for (int row = 0; row <= HEIGHT - 4; row++)
+    unpack_game(game, data, &data[SIZE], &data[SIZE + 1], &data[SIZE + 2], &data[SIZE + 3]);
+}
+
+// Spectator broadcast protocol. A game publishing to the hub (--publish)
+// sends each change as an 8-byte event; a snapshot event is followed by the
+// whole position as a PackedGame. The hub forwards the same bytes to its
+// spectators, so both legs share one format. Integers are in the machine's
+// byte order: publisher, hub and spectators all run on one machine.
+#define SPECTATE_PORT 7413
+#define SPECTATE_PUBLISHER 'P' // the first byte a connection sends the hub
+#define SPECTATE_SPECTATOR 'S'
+
+enum { SPECTATE_MOVE = 1, SPECTATE_NEW_GAME, SPECTATE_END, SPECTATE_SNAPSHOT };
+
+typedef struct
+{
+    uint8_t type;   // SPECTATE_*
+    uint8_t cell;   // move: the cell taken
+    uint8_t owner;  // move: the side taking it; end: the winner, 0 for a tie
+    uint8_t factor; // move, new game: the multiplier the next side plays against
+    uint32_t seq;   // consecutive per stream; a snapshot carries the last one it includes
+} SpectateEvent;
+
+typedef struct
+{
+    SpectateEvent event;
+    PackedGame game;
+} SpectateSnapshot;
+
+_Static_assert(sizeof(SpectateEvent) == 8, "SpectateEvent must stay 8 bytes");
+_Static_assert(sizeof(SpectateSnapshot) == 24, "SpectateSnapshot must stay 24 bytes");
+
+size_t spectate_event_size(int type)
+{
+    return type == SPECTATE_SNAPSHOT ? sizeof(SpectateSnapshot) : sizeof(SpectateEvent);
+}
+
+// Apply an event to a position; returns 0 if it does not fit the position
+int spectate_apply(PackedGame *game, const SpectateSnapshot *event)
+{
+    const SpectateEvent *e = &event->event;
+    switch (e->type)
     {
-        for (int col = 0; col <= WIDTH - 4; col++)
-        {
-            int idx = row * WIDTH + col;
-            if (player_moves[idx] == player_id &&
-                    player_moves[idx + WIDTH + 1] == player_id &&
-                    player_moves[idx + 2 * (WIDTH + 1)] == player_id &&
-                    player_moves[idx + 3 * (WIDTH + 1)] == player_id)
-                return 1;
-        }
+    case SPECTATE_MOVE:
+        if (e->cell >= SIZE || e->owner < 1 || e->owner > 2 || e->factor < 1 || e->factor > 9 ||
+            packed_owner(game, e->cell) != 0 || packed_game_over(game))
+            return 0;
+        packed_play(game, e->cell, e->owner, e->factor);
+        return 1;
+    case SPECTATE_NEW_GAME:
+        if (e->factor < 1 || e->factor > 9)
+            return 0;
+        packed_set_mask(game, 1, 0);
+        packed_set_mask(game, 2, 0);
+        packed_set_field(game, 12, 6, 0);
+        packed_set_multiplier(game, e->factor);
+        packed_set_game_over(game, 0);
+        return 1;
+    case SPECTATE_END:
+        if (e->owner > 2 || packed_game_over(game))
+            return 0;
+        packed_set_game_over(game, 1);
+        packed_set_scores(game, packed_player_score(game) + (e->owner == 1),
+                          packed_computer_score(game) + (e->owner == 2));
+        return 1;
+    case SPECTATE_SNAPSHOT:
+        *game = event->game;
+        return 1;
     }
-    // Diagonals (Top-Right to Bottom-Left)
-    for (int row = 0; row <= HEIGHT - 4; row++)
+    return 0;
+}
+
+int publish_fd = -1;       // --publish: connection to the hub, -1 when not publishing
+uint32_t publish_seq = 0;
+
+// Connect to the hub on this machine in the given role; returns the socket or -1
+int spectate_connect(int port, char role)
+{
+#ifdef _WIN32
+    (void)port;
+    (void)role;
+    printf("Spectator broadcast needs POSIX sockets\n");
+    return -1;
+#else
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int one = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0 ||
+        send(fd, &role, 1, MSG_NOSIGNAL) != 1)
     {
-        for (int col = 3; col < WIDTH; col++)
-        {
-            int idx = row * WIDTH + col;
-            if (player_moves[idx] == player_id &&
-                    player_moves[idx + WIDTH - 1] == player_id &&
-                    player_moves[idx + 2 * (WIDTH - 1)] == player_id &&
-                    player_moves[idx + 3 * (WIDTH - 1)] == player_id)
-                return 1;
-        }
+        close(fd);
+        return -1;
     }
-    return 0;
+    return fd;
+#endif
 }
 
-// Check if a move is valid and apply it
-int moveCheck(int player_id, int num1, int num2)
+// Stamp an event and send it to the hub; a failed send stops publishing
+void publish_send(SpectateSnapshot *event)
 {
-    int result = multiplication(&num1, &num2);
-    int idx = getIndex(result);
-    if (idx != -1 && player_moves[idx] == 0)
+#ifndef _WIN32
+    size_t size = spectate_event_size(event->event.type);
+    event->event.seq = publish_seq++;
+    if (send(publish_fd, event, size, MSG_NOSIGNAL) != (ssize_t)size)
     {
-        player_moves[idx] = player_id;
-        return idx;
+        printf("\nLost the spectator hub; no longer publishing.\n");
+        close(publish_fd);
+        publish_fd = -1;
     }
-    return -1;
+#endif
 }
 
-// Calculate a position's strategic value (0-10)
-int positionEvaluate(int idx)
+void publish_event(int type, int cell, int owner, int factor)
 {
-    int value = 0;
-    int row = idx / WIDTH;
-    int col = idx % WIDTH;
+    if (publish_fd < 0)
+        return;
+    SpectateSnapshot event = { .event = { (uint8_t)type, (uint8_t)cell, (uint8_t)owner, (uint8_t)factor, 0 } };
+    publish_send(&event);
+}
 
-    // Prefer center positions
-    int center_row = HEIGHT / 2;
-    int center_col = WIDTH / 2;
-    int row_distance = abs(row - center_row);
-    int col_distance = abs(col - center_col);
-    value += 4 - (row_distance + col_distance);
+// Send the whole position: on connecting, and after anything that is not a
+// single move (undo, redo, load)
+void publish_snapshot()
+{
+    if (publish_fd < 0)
+        return;
+    SpectateSnapshot snapshot = { .event = { SPECTATE_SNAPSHOT, 0, 0, 0, 0 } };
+    pack_game(&snapshot.game, player_moves, player_score, computer_score, com_choice, game_over);
+    publish_send(&snapshot);
+}
 
-    // Prefer positions that could form a line
-    for (int player_id = 1; player_id <= 2; player_id++)
-    {
-        int multiplier = (player_id == 2) ? 1 : -1; // Prefer own lines, avoid opponent's
+// Save slot index. Each slot is a save file in the per-user save directory;
+// index.dat holds one fixed-size record per slot so the slot list can be shown
+// without opening every save. It is updated in place on save and rebuilt from
+// the slot files when missing or corrupt.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t record_size;
+} SlotIndexHeader;
 
-        // Check rows
-        int row_count = 0;
-        for (int c = 0; c < WIDTH; c++)
-        {
-            int check_idx = row * WIDTH + c;
-            if (player_moves[check_idx] == player_id)
-                row_count++;
-        }
-        value += multiplier * row_count;
+typedef struct
+{
+    char name[SLOT_NAME_MAX];
+    int64_t saved_at;       // seconds since the epoch
+    int32_t player_score;
+    int32_t computer_score;
+    int32_t com_choice;
+    int32_t move_count;
+    uint8_t thumbnail[9];   // 2 bits per cell: 0=none, 1=player, 2=computer
+    uint8_t game_over;
+    uint8_t reserved[6];
+} SlotInfo;
 
-        // Check columns
-        int col_count = 0;
-        for (int r = 0; r < HEIGHT; r++)
-        {
-            int check_idx = r * WIDTH + col;
-            if (player_moves[check_idx] == player_id)
-                col_count++;
-        }
-        value += multiplier * col_count;
+// Simulated CPU Registers
+typedef struct
+{
+    int regA;
+    int regB;
+    int acc;
+} CPU;
 
-        // Diagonal checks (simplified)
-        if ((row == col) || (row + col == WIDTH - 1))
-        {
-            value += multiplier * 2; // Diagonals are valuable
-        }
-    }
+CPU cpu;
 
-    // Add some randomness to prevent predictable play
-    value += rand() % 3;
+// Small seedable PCG32 generator. The game carries its own state instead of the
+// global rand(), so a game replays exactly from its seed and worker threads can
+// each own a generator without contention.
+typedef struct
+{
+    uint64_t state;
+    uint64_t inc;
+} Rng;
 
-    return value;
+uint32_t rng_next(Rng *rng)
+{
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
 }
 
-// Advanced computer move logic
-void compMove(int player_num)
+void rng_seed(Rng *rng, uint64_t seed)
 {
-    int comp_num = -1;
-    int best_idx = -1;
-    int best_value = -1000;
+    rng->state = 0;
+    rng->inc = (seed << 1u) | 1u;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
 
-    //find a winning move
-    for (int i = 1; i <= 9; i++)
-    {
-        int result = multiplication(&i, &player_num);
-        int idx = getIndex(result);
-        if (idx != -1 && player_moves[idx] == 0)
-        {
+// Uniform integer in [0, n)
+int rng_range(Rng *rng, int n)
+{
+    return (int)(((uint64_t)rng_next(rng) * (uint32_t)n) >> 32);
+}
 
-            player_moves[idx] = 2;
-            if (checkWin(2))
-            {
-                comp_num = i;
-                best_idx = idx;
-                player_moves[idx] = 0;
-                break;
-            }
-            player_moves[idx] = 0;
-        }
-    }
+uint64_t game_seed = 0; // seed of the current session, from --seed or the clock
+Rng game_rng;
 
-    // block player's potential win
-    if (comp_num == -1)
-    {
-        for (int i = 1; i <= 9; i++)
-        {
-            int result = multiplication(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_moves[idx] == 0)
-            {
+// Precomputed products of the factors 0-9. The engine uses this table on its
+// hot paths; the register-updating multiplication() is kept for user-visible moves.
+// Build with -DVERIFY_PRODUCT_TABLE to check both paths against each other.
+static const int product_table[10][10] =
+{
+    { 0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9},
+    { 0,  2,  4,  6,  8, 10, 12, 14, 16, 18},
+    { 0,  3,  6,  9, 12, 15, 18, 21, 24, 27},
+    { 0,  4,  8, 12, 16, 20, 24, 28, 32, 36},
+    { 0,  5, 10, 15, 20, 25, 30, 35, 40, 45},
+    { 0,  6, 12, 18, 24, 30, 36, 42, 48, 54},
+    { 0,  7, 14, 21, 28, 35, 42, 49, 56, 63},
+    { 0,  8, 16, 24, 32, 40, 48, 56, 64, 72},
+    { 0,  9, 18, 27, 36, 45, 54, 63, 72, 81}
+};
 
-                player_moves[idx] = 1;
-                if (checkWin(1))
-                {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_moves[idx] = 0;
-                    break;
-                }
-                player_moves[idx] = 0;
-            }
-        }
-    }
+// Evaluation weights of the computer player. The defaults are the original
+// hand-picked constants; a weights file overrides them and --tune writes one.
+enum
+{
+    W_CENTER,            // centre bonus, minus the distance to the centre
+    W_OWN_LINE,          // per own piece in the same row or column
+    W_OPPONENT_LINE,     // per opponent piece in the same row or column
+    W_OWN_DIAGONAL,      // cell lies on a main diagonal (own lines)
+    W_OPPONENT_DIAGONAL, // cell lies on a main diagonal (opponent lines)
+    W_NOISE,             // random tie-break in [0, noise)
+    W_THREE_THRESHOLD,   // pieces in a row/column that trigger the setup stage
+    WEIGHT_COUNT
+};
 
-    //Look for 3-in-a-row
-    if (comp_num == -1)
-    {
+static const char *weight_names[WEIGHT_COUNT] =
+{
+    "center", "own_line", "opponent_line", "own_diagonal", "opponent_diagonal", "noise", "three_threshold"
+};
 
-        for (int i = 1; i <= 9; i++)
-        {
-            int result = multiplication(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_moves[idx] == 0)
-            {
-                player_moves[idx] = 2;
+static const int weight_min[WEIGHT_COUNT] = { -10, -10, -10, -10, -10, 1, 2 };
+static const int weight_max[WEIGHT_COUNT] = { 20, 10, 10, 10, 10, 10, 6 };
 
+int eval_weights[WEIGHT_COUNT] = { 4, 1, 1, 2, 2, 3, 3 };
 
-                int row = idx / WIDTH;
-                int count = 0;
-                for (int col = 0; col < WIDTH; col++)
-                {
-                    if (player_moves[row * WIDTH + col] == 2)
-                        count++;
-                }
-                if (count >= 3)
+// Hot-path performance counters. Each thread accumulates into its own block and
+// the blocks are chained so the stats report can sum them. With --trace FILE the
+// same probes also record spans that are written as a Chrome trace at exit.
+// Build with -DNO_PERF_STATS to compile the probes out entirely.
+#if !defined(__GNUC__) && !defined(NO_PERF_STATS)
+#define NO_PERF_STATS // scoped probes rely on __attribute__((cleanup))
+#endif
+
+typedef enum
+{
+    PERF_COMP_MOVE,
+    PERF_STAGE_WIN,
+    PERF_STAGE_BLOCK,
+    PERF_STAGE_THREE,
+    PERF_STAGE_EVALUATE,
+    PERF_CHECK_WIN,
+    PERF_GET_INDEX,
+    PERF_POSITION_EVALUATE,
+    PERF_DISPLAY,
+    PERF_SAVE_GAME,
+    PERF_LOAD_GAME,
+    PERF_COUNT
+} PerfId;
+
+static const char *perf_names[PERF_COUNT] =
+{
+    "compMove",
+    "compMove: win",
+    "compMove: block",
+    "compMove: three-in-row",
+    "compMove: evaluate",
+    "checkWin",
+    "getIndex",
+    "positionEvaluate",
+    "display",
+    "save_game",
+    "load_game"
+};
+
+#ifndef NO_PERF_STATS
+// Probes that also become trace spans; the sub-microsecond ones would only add noise
+static const int perf_traced[PERF_COUNT] =
+{
+    1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1
+};
+#endif
+
+// One complete ("X") trace event: a named span on the recording thread
+typedef struct
+{
+    const char *name;
+    unsigned long long start;
+    unsigned long long duration;
+} TraceEvent;
+
+#define TRACE_CHUNK_EVENTS 4096
+
+typedef struct TraceChunk
+{
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+    int count;
+    struct TraceChunk *next;
+} TraceChunk;
+
+typedef struct PerfBlock
+{
+    unsigned long long calls[PERF_COUNT];
+    unsigned long long nanos[PERF_COUNT];
+    int tid;                   // small id used as the trace thread id
+    TraceChunk *trace_head;    // trace events, written only by the owning thread
+    TraceChunk *trace_tail;
+    struct PerfBlock *next;
+} PerfBlock;
+
+static PerfBlock *perf_blocks = NULL;   // every live thread's block, newest first
+static PerfBlock perf_retired;          // counters of threads that have exited
+static int perf_block_count = 0;
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local PerfBlock *perf_local = NULL;
+
+const char *trace_path = NULL; // set by --trace; NULL disables tracing
+unsigned long long trace_epoch = 0;
+
+// Monotonic clock in nanoseconds
+static unsigned long long perf_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+// Runs when a thread exits: folds its counters into perf_retired and frees its
+// block. A block holding trace events stays listed until trace_flush writes it.
+static void perf_block_retire(void *data)
+{
+    PerfBlock *block = data;
+
+    pthread_mutex_lock(&perf_lock);
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        perf_retired.calls[i] += block->calls[i];
+        perf_retired.nanos[i] += block->nanos[i];
+    }
+    memset(block->calls, 0, sizeof(block->calls));
+    memset(block->nanos, 0, sizeof(block->nanos));
+
+    if (block->trace_head == NULL)
+    {
+        PerfBlock **link = &perf_blocks;
+        while (*link != block)
+            link = &(*link)->next;
+        *link = block->next;
+        free(block);
+    }
+    pthread_mutex_unlock(&perf_lock);
+}
+
+static void perf_key_create()
+{
+    pthread_key_create(&perf_key, perf_block_retire);
+}
+
+// Returns the calling thread's block, registering it on first use
+static PerfBlock *perf_block()
+{
+    if (perf_local == NULL)
+    {
+        PerfBlock *block = calloc(1, sizeof(PerfBlock));
+        if (block == NULL)
+        {
+            fprintf(stderr, "Out of memory for performance counters\n");
+            exit(1);
+        }
+        pthread_once(&perf_key_once, perf_key_create);
+
+        pthread_mutex_lock(&perf_lock);
+        block->tid = ++perf_block_count;
+        block->next = perf_blocks;
+        perf_blocks = block;
+        pthread_mutex_unlock(&perf_lock);
+
+        pthread_setspecific(perf_key, block);
+        perf_local = block;
+    }
+    return perf_local;
+}
+
+// Appends a span to the calling thread's trace buffer. Only the owning thread
+// writes its chunks, so no locking is needed until the flush at exit.
+void trace_complete(const char *name, unsigned long long start)
+{
+    if (trace_path == NULL || start == 0)
+        return;
+
+    unsigned long long end = perf_now();
+    PerfBlock *block = perf_block();
+    TraceChunk *chunk = block->trace_tail;
+    if (chunk == NULL || chunk->count == TRACE_CHUNK_EVENTS)
+    {
+        TraceChunk *fresh = calloc(1, sizeof(TraceChunk));
+        if (chunk == NULL)
+            block->trace_head = fresh;
+        else
+            chunk->next = fresh;
+        block->trace_tail = chunk = fresh;
+    }
+
+    TraceEvent *event = &chunk->events[chunk->count++];
+    event->name = name;
+    event->start = start;
+    event->duration = end - start;
+}
+
+// Writes every thread's events as a Chrome/Perfetto trace file
+void trace_flush()
+{
+    if (trace_path == NULL)
+        return;
+
+    FILE *fp = fopen(trace_path, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "Error opening trace file %s\n", trace_path);
+        return;
+    }
+
+    fprintf(fp, "{\"traceEvents\": [\n");
+    int first = 1;
+    pthread_mutex_lock(&perf_lock);
+    for (PerfBlock *block = perf_blocks; block != NULL; block = block->next)
+    {
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", block->tid,
+                block->tid == 1 ? "main" : "worker");
+        first = 0;
+        for (TraceChunk *chunk = block->trace_head; chunk != NULL; chunk = chunk->next)
+        {
+            for (int i = 0; i < chunk->count; i++)
+            {
+                TraceEvent *event = &chunk->events[i];
+                fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                        "\"ts\": %.3f, \"dur\": %.3f}", event->name, block->tid,
+                        (event->start - trace_epoch) / 1000.0, event->duration / 1000.0);
+            }
+        }
+    }
+    pthread_mutex_unlock(&perf_lock);
+    fprintf(fp, "\n]}\n");
+
+    fclose(fp);
+}
+
+#ifndef NO_PERF_STATS
+static void perf_record(PerfId id, unsigned long long start)
+{
+    PerfBlock *block = perf_block();
+    block->calls[id]++;
+    block->nanos[id] += perf_now() - start;
+    if (perf_traced[id])
+        trace_complete(perf_names[id], start);
+}
+
+typedef struct
+{
+    PerfId id;
+    unsigned long long start;
+} PerfScope;
+
+static void perf_scope_end(PerfScope *scope)
+{
+    perf_record(scope->id, scope->start);
+}
+
+#define PERF_BEGIN(id) unsigned long long perf_start_##id = perf_now()
+#define PERF_END(id) perf_record(id, perf_start_##id)
+#define PERF_SCOPE(id) PerfScope perf_scope_##id __attribute__((cleanup(perf_scope_end))) = { id, perf_now() }
+#else
+#define PERF_BEGIN(id)
+#define PERF_END(id)
+#define PERF_SCOPE(id)
+#endif
+
+// Sums the counters of every thread into totals
+void perf_snapshot(PerfBlock *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+    pthread_mutex_lock(&perf_lock);
+    memcpy(totals->calls, perf_retired.calls, sizeof(totals->calls));
+    memcpy(totals->nanos, perf_retired.nanos, sizeof(totals->nanos));
+    for (PerfBlock *block = perf_blocks; block != NULL; block = block->next)
+    {
+        for (int i = 0; i < PERF_COUNT; i++)
+        {
+            totals->calls[i] += block->calls[i];
+            totals->nanos[i] += block->nanos[i];
+        }
+    }
+    pthread_mutex_unlock(&perf_lock);
+}
+
+// Print the summed counters as a table
+void display_stats()
+{
+    PerfBlock totals;
+    perf_snapshot(&totals);
+
+#ifdef NO_PERF_STATS
+    printf("Performance counters are disabled in this build.\n");
+#endif
+    printf("%-24s %12s %12s %10s\n", "Probe", "Calls", "Total ms", "Avg ns");
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        unsigned long long avg = totals.calls[i] ? totals.nanos[i] / totals.calls[i] : 0;
+        printf("%-24s %12llu %12.3f %10llu\n", perf_names[i], totals.calls[i], totals.nanos[i] / 1e6, avg);
+    }
+}
+
+// Write the summed counters to a JSON file
+int export_stats(const char *path)
+{
+    PerfBlock totals;
+    perf_snapshot(&totals);
+
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+    {
+        printf("Error opening %s!\n", path);
+        return 0;
+    }
+
+    fprintf(fp, "{\n  \"counters\": [\n");
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        unsigned long long avg = totals.calls[i] ? totals.nanos[i] / totals.calls[i] : 0;
+        fprintf(fp, "    {\"name\": \"%s\", \"calls\": %llu, \"total_ns\": %llu, \"avg_ns\": %llu}%s\n",
+                perf_names[i], totals.calls[i], totals.nanos[i], avg, i + 1 < PERF_COUNT ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    fclose(fp);
+    printf("Performance stats exported to %s\n", path);
+    return 1;
+}
+
+// Multiplies two numbers using bitwise operations for simulation
+int multiplication(int *a, int *b)
+{
+    cpu.regA = *a;
+    cpu.regB = *b;
+    cpu.acc = 0;
+
+    int x = *a;
+    int y = *b;
+
+    while (y > 0)
+    {
+        if (y & 1)
+            cpu.acc += x;
+        x <<= 1;
+        y >>= 1;
+    }
+
+#ifdef VERIFY_PRODUCT_TABLE
+    if (*a >= 0 && *a <= 9 && *b >= 0 && *b <= 9 && product_table[*a][*b] != cpu.acc)
+    {
+        fprintf(stderr, "Product table mismatch: %d x %d = %d (table %d)\n",
+                *a, *b, cpu.acc, product_table[*a][*b]);
+        abort();
+    }
+#endif
+
+    return cpu.acc;
+}
+
+// Multiplies two factors (1-9) by table lookup, without touching the CPU registers.
+// Factors outside the table (e.g. from a corrupt save) give 0, which is on no board cell.
+int product(int a, int b)
+{
+    if ((unsigned)a > 9 || (unsigned)b > 9)
+        return 0;
+#ifdef VERIFY_PRODUCT_TABLE
+    int x = a, y = b, acc = 0;
+    while (y > 0)
+    {
+        if (y & 1)
+            acc += x;
+        x <<= 1;
+        y >>= 1;
+    }
+    if (acc != product_table[a][b])
+    {
+        fprintf(stderr, "Product table mismatch: %d x %d = %d (table %d)\n", a, b, acc, product_table[a][b]);
+        abort();
+    }
+#endif
+    return product_table[a][b];
+}
+
+// Gets the index of a number in the game board
+int getIndex(int idx)
+{
+    PERF_SCOPE(PERF_GET_INDEX);
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (board[i] == idx)
+            return i;
+    }
+    return -1;
+}
+
+// Update score for the specified player
+void updateScore(int player_id)
+{
+    if (player_id == 1)
+        player_score++;
+    if (player_id == 2)
+        computer_score++;
+}
+
+// Display the game board with colors
+void display()
+{
+    PERF_SCOPE(PERF_DISPLAY);
+
+    printf("\033[0m"); // Reset color attributes
+
+    printf("\n\n+-----------------------+\n");
+    for (int i = 0; i < SIZE; i++)
+    {
+        printf("|");
+        if (player_moves[i] == 1)
+            printf(" \033[1;32mP\033[0m ");
+        else if (player_moves[i] == 2)
+            printf(" \033[1;31mC\033[0m ");
+        else if (board[i] > 0 && board[i] < 10)
+            printf(" %d ", board[i]);
+        else
+            printf("%d ", board[i]);
+
+        if ((i + 1) % WIDTH == 0)
+        {
+            printf("|\n+-----------------------+\n");
+        }
+    }
+
+    printf("Player Score: \033[1;32m%d\033[0m \t Computer Score: \033[1;31m%d\033[0m\n", player_score, computer_score);
+}
+
+// Clear screen with delay
+void clear_screen(int t)
+{
+    sleep(t);
+#ifdef _WIN32
+    system("cls");
+#else
+    system("clear");
+#endif
+}
+
+// Check if a board is full (draw condition)
+int boardFull(const int *moves)
+{
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (moves[i] == 0)
+            return 0;
+    }
+    return 1;
+}
+
+// Check if the game board is full
+int isBoardFull()
+{
+    return boardFull(player_moves);
+}
+
+// Check for 4-in-a-row win condition on a board
+int boardWin(const int *moves, int player_id)
+{
+    PERF_SCOPE(PERF_CHECK_WIN);
+    // Rows
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        for (int col = 0; col <= WIDTH - 4; col++)
+        {
+            int idx = row * WIDTH + col;
+            if (moves[idx] == player_id &&
+                    moves[idx + 1] == player_id &&
+                    moves[idx + 2] == player_id &&
+                    moves[idx + 3] == player_id)
+                return 1;
+        }
+    }
+    // Columns
+    for (int col = 0; col < WIDTH; col++)
+    {
+        for (int row = 0; row <= HEIGHT - 4; row++)
+        {
+            int idx = row * WIDTH + col;
+            if (moves[idx] == player_id &&
+                    moves[idx + WIDTH] == player_id &&
+                    moves[idx + 2 * WIDTH] == player_id &&
+                    moves[idx + 3 * WIDTH] == player_id)
+                return 1;
+        }
+    }
+    // Diagonals (Top-Left to Bottom-Right)
+    for (int row = 0; row <= HEIGHT - 4; row++)
+    {
+        for (int col = 0; col <= WIDTH - 4; col++)
+        {
+            int idx = row * WIDTH + col;
+            if (moves[idx] == player_id &&
+                    moves[idx + WIDTH + 1] == player_id &&
+                    moves[idx + 2 * (WIDTH + 1)] == player_id &&
+                    moves[idx + 3 * (WIDTH + 1)] == player_id)
+                return 1;
+        }
+    }
+    // Diagonals (Top-Right to Bottom-Left)
+    for (int row = 0; row <= HEIGHT - 4; row++)
+    {
+        for (int col = 3; col < WIDTH; col++)
+        {
+            int idx = row * WIDTH + col;
+            if (moves[idx] == player_id &&
+                    moves[idx + WIDTH - 1] == player_id &&
+                    moves[idx + 2 * (WIDTH - 1)] == player_id &&
+                    moves[idx + 3 * (WIDTH - 1)] == player_id)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Check for 4-in-a-row win condition on the game board
+int checkWin(int player_id)
+{
+    return boardWin(player_moves, player_id);
+}
+
+// Apply a move and push it on the stack. A new move discards the redo history.
+void make_move(int *moves, int *multiplier, MoveStack *stack, int cell, int owner, int factor)
+{
+    MoveRecord *record = &stack->moves[stack->count++];
+    record->cell = (uint8_t)cell;
+    record->owner = (uint8_t)owner;
+    record->prev_multiplier = (uint8_t)*multiplier;
+    record->factor = (uint8_t)factor;
+    stack->top = stack->count;
+
+    moves[cell] = owner;
+    *multiplier = factor;
+}
+
+// Take back the last move; returns 0 if there is none
+int unmake_move(int *moves, int *multiplier, MoveStack *stack)
+{
+    if (stack->count == 0)
+        return 0;
+
+    MoveRecord *record = &stack->moves[--stack->count];
+    moves[record->cell] = 0;
+    *multiplier = record->prev_multiplier;
+    return 1;
+}
+
+// Replay the last undone move; returns 0 if there is none
+int redo_move(int *moves, int *multiplier, MoveStack *stack)
+{
+    if (stack->count == stack->top)
+        return 0;
+
+    MoveRecord *record = &stack->moves[stack->count++];
+    moves[record->cell] = record->owner;
+    *multiplier = record->factor;
+    return 1;
+}
+
+// Check if a move is valid and apply it
+int moveCheck(int player_id, int num1, int num2)
+{
+    int result = multiplication(&num1, &num2);
+    int idx = getIndex(result);
+    if (idx != -1 && player_moves[idx] == 0)
+    {
+        make_move(player_moves, &com_choice, &history, idx, player_id, num1);
+        return idx;
+    }
+    return -1;
+}
+
+// Undo back to the player's previous turn: the computer's reply (if any) and the player's move
+int undo_turn()
+{
+    if (history.count == 0)
+        return 0;
+
+    int owner = history.moves[history.count - 1].owner;
+    unmake_move(player_moves, &com_choice, &history);
+    if (owner == 2)
+        unmake_move(player_moves, &com_choice, &history);
+    return 1;
+}
+
+// Redo the player's move and the computer's reply that followed it
+int redo_turn()
+{
+    if (!redo_move(player_moves, &com_choice, &history))
+        return 0;
+
+    if (history.count < history.top && history.moves[history.count].owner == 2)
+        redo_move(player_moves, &com_choice, &history);
+    return 1;
+}
+
+// Clamp weights to the ranges the engine can use
+void clampWeights(int *weights)
+{
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+    {
+        if (weights[i] < weight_min[i])
+            weights[i] = weight_min[i];
+        if (weights[i] > weight_max[i])
+            weights[i] = weight_max[i];
+    }
+}
+
+// Load evaluation weights from a "name value" text file
+int load_weights(const char *path, int *weights)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), fp))
+    {
+        char name[64];
+        int value;
+        if (line[0] == '#' || sscanf(line, "%63s %d", name, &value) != 2)
+            continue;
+
+        int found = 0;
+        for (int i = 0; i < WEIGHT_COUNT; i++)
+        {
+            if (strcmp(name, weight_names[i]) == 0)
+            {
+                weights[i] = value;
+                found = 1;
+            }
+        }
+        if (!found)
+            fprintf(stderr, "%s: unknown weight '%s' ignored\n", path, name);
+    }
+
+    fclose(fp);
+    clampWeights(weights);
+    return 1;
+}
+
+// Finish a file written to temp and move it over path. The contents reach the
+// disk before the rename, so a crash leaves either the old file or the new
+// one. If written is 0 or any step fails, temp is removed and path is untouched.
+int replace_file(FILE *fp, const char *temp, const char *path, int written)
+{
+    int ok = written && fflush(fp) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(fp)) == 0;
+#else
+    ok = ok && fsync(fileno(fp)) == 0;
+#endif
+    ok = fclose(fp) == 0 && ok;
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    if (ok)
+        remove(path);
+#endif
+    if (ok && rename(temp, path) != 0)
+        ok = 0;
+    if (!ok)
+        remove(temp);
+    return ok;
+}
+
+// Save evaluation weights as a "name value" text file
+int save_weights(const char *path, const int *weights)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+    {
+        printf("Error opening %s!\n", path);
+        return 0;
+    }
+
+    fprintf(fp, "# Evaluation weights for the computer player\n");
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        fprintf(fp, "%s %d\n", weight_names[i], weights[i]);
+
+    fclose(fp);
+    return 1;
+}
+
+// 64-bit FNV-1a of a buffer
+uint64_t content_hash(const unsigned char *data, size_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Optional neural evaluator (--nnue FILE), in the style of chess NNUE. The 81
+// inputs are the 36 cells owned by the side to move, the 36 owned by the
+// opponent and the 9 possible multipliers. The first layer's sums (the
+// accumulator) are kept for both sides' points of view and updated from the
+// previous ply's on every move, so a leaf costs three column updates instead
+// of a full 81x32 product. The rest is a small quantized network:
+//   accumulators (2x32, int16) -> clipped ReLU to 0..127 (uint8)
+//   -> 64x16 dense (int8 weights) -> clipped ReLU -> 16x1 dense -> score
+// The int16 column updates and the uint8 x int8 dot products use SSE2/SSSE3
+// when the compiler targets them (e.g. -march=native) and plain C otherwise.
+#define NNUE_INPUTS (2 * SIZE + 9)
+#define NNUE_HIDDEN 32         // accumulator width per point of view
+#define NNUE_HIDDEN2 16
+#define NNUE_MAGIC "MGNN"
+#define NNUE_VERSION 1
+#define NNUE_QA 127            // activation scale: 1.0 is stored as 127
+#define NNUE_QB 64             // weight scale of the two dense layers
+#define NNUE_SCORE 100         // search score of one logit of predicted result
+
+// Weights file: the header, then each array below in order, little-endian
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t hidden;
+    uint32_t hidden2;
+} NnueHeader;
+
+typedef struct
+{
+    int16_t input_weights[NNUE_INPUTS][NNUE_HIDDEN]; // scaled by NNUE_QA
+    int16_t input_bias[NNUE_HIDDEN];
+    int8_t hidden_weights[NNUE_HIDDEN2][2 * NNUE_HIDDEN]; // scaled by NNUE_QB
+    int32_t hidden_bias[NNUE_HIDDEN2];                   // scaled by NNUE_QA * NNUE_QB
+    int8_t output_weights[NNUE_HIDDEN2];
+    int32_t output_bias;
+    uint64_t hash;        // of the file, so cached analyses notice a new network
+} Nnue;
+
+// First-layer sums from player 1's and player 2's point of view
+typedef struct
+{
+    int16_t values[2][NNUE_HIDDEN];
+} NnueAccumulator;
+
+Nnue *nnue = NULL; // loaded network, NULL for the hand-written evaluation
+
+// Input index of a piece of owner on cell, seen by player view
+static inline int nnue_cell_feature(int cell, int owner, int view)
+{
+    return (owner == view ? 0 : SIZE) + cell;
+}
+
+static inline int nnue_multiplier_feature(int multiplier)
+{
+    return 2 * SIZE + multiplier - 1;
+}
+
+// values += sign * column
+static inline void nnue_add_column(int16_t *values, const int16_t *column, int sign)
+{
+#ifdef __SSE2__
+    for (int i = 0; i < NNUE_HIDDEN; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i c = _mm_loadu_si128((const __m128i *)(column + i));
+        v = sign > 0 ? _mm_add_epi16(v, c) : _mm_sub_epi16(v, c);
+        _mm_storeu_si128((__m128i *)(values + i), v);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        values[i] += sign * column[i];
+#endif
+}
+
+// Build both accumulators of a position from scratch
+void nnue_refresh(const Nnue *net, NnueAccumulator *acc, const int *moves, int multiplier)
+{
+    for (int view = 1; view <= 2; view++)
+    {
+        int16_t *values = acc->values[view - 1];
+        memcpy(values, net->input_bias, sizeof(net->input_bias));
+        for (int i = 0; i < SIZE; i++)
+        {
+            if (moves[i] != 0)
+                nnue_add_column(values, net->input_weights[nnue_cell_feature(i, moves[i], view)], 1);
+        }
+        if (multiplier >= 1 && multiplier <= 9)
+            nnue_add_column(values, net->input_weights[nnue_multiplier_feature(multiplier)], 1);
+    }
+}
+
+// Derive the accumulators after owner takes cell and the multiplier changes
+void nnue_update(const Nnue *net, const NnueAccumulator *from, NnueAccumulator *to,
+                 int cell, int owner, int old_multiplier, int new_multiplier)
+{
+    *to = *from;
+    for (int view = 1; view <= 2; view++)
+    {
+        int16_t *values = to->values[view - 1];
+        nnue_add_column(values, net->input_weights[nnue_cell_feature(cell, owner, view)], 1);
+        // Multiplier 0 (no choice yet) has no input, as in nnue_refresh
+        if (old_multiplier >= 1 && old_multiplier <= 9)
+            nnue_add_column(values, net->input_weights[nnue_multiplier_feature(old_multiplier)], -1);
+        if (new_multiplier >= 1 && new_multiplier <= 9)
+            nnue_add_column(values, net->input_weights[nnue_multiplier_feature(new_multiplier)], 1);
+    }
+}
+
+// Clipped ReLU of both accumulators into 0..NNUE_QA, side to move first
+static void nnue_activate(const NnueAccumulator *acc, int side, uint8_t *out)
+{
+    for (int half = 0; half < 2; half++)
+    {
+        const int16_t *values = acc->values[half == 0 ? side - 1 : 2 - side];
+        uint8_t *dest = out + half * NNUE_HIDDEN;
+#ifdef __SSE2__
+        const __m128i limit = _mm_set1_epi8(NNUE_QA);
+        for (int i = 0; i < NNUE_HIDDEN; i += 16)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i *)(values + i));
+            __m128i hi = _mm_loadu_si128((const __m128i *)(values + i + 8));
+            __m128i packed = _mm_min_epu8(_mm_packus_epi16(lo, hi), limit);
+            _mm_storeu_si128((__m128i *)(dest + i), packed);
+        }
+#else
+        for (int i = 0; i < NNUE_HIDDEN; i++)
+            dest[i] = (uint8_t)(values[i] < 0 ? 0 : values[i] > NNUE_QA ? NNUE_QA : values[i]);
+#endif
+    }
+}
+
+// Sum of input[i] * weights[i] over 2 * NNUE_HIDDEN entries
+static inline int32_t nnue_dot(const uint8_t *input, const int8_t *weights)
+{
+#ifdef __SSSE3__
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < 2 * NNUE_HIDDEN; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+        // 127 * 127 * 2 fits the int16 pairs maddubs produces
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(a, w), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < 2 * NNUE_HIDDEN; i++)
+        sum += input[i] * weights[i];
+    return sum;
+#endif
+}
+
+// Score of the position for side (the side to move), in search units
+int nnue_evaluate(const Nnue *net, const NnueAccumulator *acc, int side)
+{
+    uint8_t input[2 * NNUE_HIDDEN];
+    nnue_activate(acc, side, input);
+
+    int32_t output = net->output_bias;
+    for (int o = 0; o < NNUE_HIDDEN2; o++)
+    {
+        int32_t sum = (nnue_dot(input, net->hidden_weights[o]) + net->hidden_bias[o]) / NNUE_QB;
+        sum = sum < 0 ? 0 : sum > NNUE_QA ? NNUE_QA : sum;
+        output += sum * net->output_weights[o];
+    }
+    return (int)((int64_t)output * NNUE_SCORE / (NNUE_QA * NNUE_QB));
+}
+
+// Load a weights file; returns NULL if it is missing or not a compatible network
+Nnue *load_nnue(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    NnueHeader header;
+    Nnue *net = calloc(1, sizeof(Nnue));
+    int ok = net != NULL && fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, NNUE_MAGIC, 4) == 0 && header.version == NNUE_VERSION &&
+             header.inputs == NNUE_INPUTS && header.hidden == NNUE_HIDDEN && header.hidden2 == NNUE_HIDDEN2 &&
+             fread(net->input_weights, sizeof(net->input_weights), 1, fp) == 1 &&
+             fread(net->input_bias, sizeof(net->input_bias), 1, fp) == 1 &&
+             fread(net->hidden_weights, sizeof(net->hidden_weights), 1, fp) == 1 &&
+             fread(net->hidden_bias, sizeof(net->hidden_bias), 1, fp) == 1 &&
+             fread(net->output_weights, sizeof(net->output_weights), 1, fp) == 1 &&
+             fread(&net->output_bias, sizeof(net->output_bias), 1, fp) == 1;
+    fclose(fp);
+    if (!ok)
+    {
+        free(net);
+        return NULL;
+    }
+
+    net->hash = content_hash((const unsigned char *)net, offsetof(Nnue, hash));
+    return net;
+}
+
+int save_nnue(const char *path, const Nnue *net)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return 0;
+
+    NnueHeader header = { NNUE_MAGIC, NNUE_VERSION, NNUE_INPUTS, NNUE_HIDDEN, NNUE_HIDDEN2 };
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(net->input_weights, sizeof(net->input_weights), 1, fp);
+    fwrite(net->input_bias, sizeof(net->input_bias), 1, fp);
+    fwrite(net->hidden_weights, sizeof(net->hidden_weights), 1, fp);
+    fwrite(net->hidden_bias, sizeof(net->hidden_bias), 1, fp);
+    fwrite(net->output_weights, sizeof(net->output_weights), 1, fp);
+    fwrite(&net->output_bias, sizeof(net->output_bias), 1, fp);
+    return fclose(fp) == 0;
+}
+
+// Alpha-beta search. A position is the board, the multiplier and the side to
+// move; a move picks a factor whose product with the multiplier is a free
+// cell, and that factor becomes the opponent's multiplier. Completing four in
+// a line wins; a full board or a side with no legal factor is a draw.
+#define SEARCH_WIN 10000 // score of a win at the root, minus the plies to reach it
+#define SEARCH_POLL_NODES 1024
+
+int product_cell[10][10];  // board index of a x b, or -1
+int search_windows[54][4]; // every four-cell line on the board
+int search_window_count = 0;
+
+typedef struct
+{
+    int moves[SIZE];
+    int multiplier;
+    MoveStack stack;
+    const int *weights;
+    unsigned long long nodes;
+    unsigned long long deadline; // perf_now() time to give up at, 0 for none
+    unsigned long long node_limit; // nodes to give up at, 0 for none
+    int noise;                   // +- points of random noise on each evaluation
+    Rng *rng;                    // source of the noise
+    const Nnue *nnue;            // evaluates leaves when set, else search_evaluate
+    atomic_int *stop;            // set by another thread to give up, or NULL
+    NnueAccumulator acc[SIZE + 2]; // network accumulators of the position at each ply
+    int aborted;
+    int pv[SIZE + 2][SIZE + 2]; // principal variation found at each ply
+    int pv_length[SIZE + 2];
+} Search;
+
+// Fill the lookup tables; call once before any search runs
+void search_init()
+{
+    for (int a = 0; a <= 9; a++)
+    {
+        for (int b = 0; b <= 9; b++)
+            product_cell[a][b] = getIndex(product(a, b));
+    }
+
+    static const int steps[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+    search_window_count = 0;
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        for (int col = 0; col < WIDTH; col++)
+        {
+            for (int d = 0; d < 4; d++)
+            {
+                int end_row = row + 3 * steps[d][0];
+                int end_col = col + 3 * steps[d][1];
+                if (end_row >= HEIGHT || end_col < 0 || end_col >= WIDTH)
+                    continue;
+                for (int k = 0; k < 4; k++)
+                    search_windows[search_window_count][k] = (row + k * steps[d][0]) * WIDTH + col + k * steps[d][1];
+                search_window_count++;
+            }
+        }
+    }
+}
+
+// Does the piece on idx complete four in a line through it?
+int search_wins_at(const int *moves, int idx)
+{
+    static const int steps[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+    int owner = moves[idx];
+    int row = idx / WIDTH;
+    int col = idx % WIDTH;
+
+    for (int d = 0; d < 4; d++)
+    {
+        int run = 1;
+        for (int sign = -1; sign <= 1; sign += 2)
+        {
+            int r = row + sign * steps[d][0];
+            int c = col + sign * steps[d][1];
+            while (r >= 0 && r < HEIGHT && c >= 0 && c < WIDTH && moves[r * WIDTH + c] == owner)
+            {
+                run++;
+                r += sign * steps[d][0];
+                c += sign * steps[d][1];
+            }
+        }
+        if (run >= 4)
+            return 1;
+    }
+    return 0;
+}
+
+// Static score for player me: open lines weighted by the square of their pieces
+int search_evaluate(const int *moves, int me, const int *weights)
+{
+    int score = 0;
+    for (int w = 0; w < search_window_count; w++)
+    {
+        int mine = 0, theirs = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            int owner = moves[search_windows[w][k]];
+            if (owner == me)
+                mine++;
+            else if (owner != 0)
+                theirs++;
+        }
+        if (theirs == 0)
+            score += mine * mine * weights[W_OWN_LINE];
+        else if (mine == 0)
+            score -= theirs * theirs * weights[W_OPPONENT_LINE];
+    }
+    return score;
+}
+
+// Negamax with alpha-beta for the side me, trying factor first when it is legal
+int search_node(Search *s, int depth, int alpha, int beta, int me, int ply, int first)
+{
+    if (++s->nodes % SEARCH_POLL_NODES == 0 &&
+        ((s->deadline && perf_now() >= s->deadline) || (s->stop && atomic_load(s->stop))))
+        s->aborted = 1;
+    if (s->node_limit && s->nodes >= s->node_limit)
+        s->aborted = 1;
+    s->pv_length[ply] = ply;
+    if (s->aborted)
+        return 0;
+
+    int best = -SEARCH_WIN - 1;
+    int any = 0;
+    for (int n = 0; n <= 9; n++)
+    {
+        int factor = n == 0 ? first : n;
+        if (factor < 1 || (n > 0 && factor == first))
+            continue;
+        int idx = product_cell[factor][s->multiplier];
+        if (idx == -1 || s->moves[idx] != 0)
+            continue;
+        any = 1;
+
+        int multiplier = s->multiplier;
+        make_move(s->moves, &s->multiplier, &s->stack, idx, me, factor);
+        if (s->nnue)
+            nnue_update(s->nnue, &s->acc[ply], &s->acc[ply + 1], idx, me, multiplier, factor);
+        int score;
+        s->pv_length[ply + 1] = ply + 1;
+        if (search_wins_at(s->moves, idx))
+            score = SEARCH_WIN - ply;
+        else if (depth <= 1)
+        {
+            // The network scores the side to move, which is now the opponent
+            score = s->nnue ? -nnue_evaluate(s->nnue, &s->acc[ply + 1], 3 - me)
+                            : search_evaluate(s->moves, me, s->weights);
+            if (s->noise)
+                score += rng_range(s->rng, 2 * s->noise + 1) - s->noise;
+        }
+        else
+            score = -search_node(s, depth - 1, -beta, -alpha, 3 - me, ply + 1, 0);
+        unmake_move(s->moves, &s->multiplier, &s->stack);
+
+        if (s->aborted)
+            return 0;
+        if (score > best)
+            best = score;
+        if (score > alpha)
+        {
+            alpha = score;
+            s->pv[ply][ply] = factor;
+            for (int i = ply + 1; i < s->pv_length[ply + 1]; i++)
+                s->pv[ply][i] = s->pv[ply + 1][i];
+            s->pv_length[ply] = s->pv_length[ply + 1];
+        }
+        if (alpha >= beta)
+            break;
+    }
+
+    return any ? best : 0; // no legal factor: draw
+}
+
+// Search the position for player me to the given depth. The best line is left
+// in pv[1] (pv_length[1] - 1 moves); the result is meaningless if aborted.
+int search_root(Search *s, int me, int depth, int previous_best)
+{
+    s->stack.count = s->stack.top = 0;
+    s->aborted = 0;
+    if (s->nnue)
+        nnue_refresh(s->nnue, &s->acc[1], s->moves, s->multiplier);
+    return search_node(s, depth, -SEARCH_WIN - 1, SEARCH_WIN + 1, me, 1, previous_best);
+}
+
+// Outcome of an iterative deepening search
+typedef struct
+{
+    int depth;            // deepest completed iteration
+    int best;             // best factor, -1 if none
+    int score;            // for the side searched; beyond +-(SEARCH_WIN - SIZE) is a forced result
+    int pv_length;
+    int pv[SIZE];         // factors, alternating the two sides
+    unsigned long long nodes;
+} SearchResult;
+
+// Called after each completed iteration of search_deepen
+typedef void (*SearchReport)(const SearchResult *result, void *data);
+
+// Deepen one ply at a time until max_depth, a proven result, the end of the
+// game or one of the search's limits. A cut-off iteration is discarded, so the
+// result is always from a completed depth.
+void search_deepen(Search *search, SearchResult *result, int me, int max_depth,
+                   SearchReport report, void *report_data)
+{
+    int empty = 0;
+    for (int i = 0; i < SIZE; i++)
+        empty += search->moves[i] == 0;
+
+    memset(result, 0, sizeof(*result));
+    result->best = -1;
+    for (int depth = 1; depth <= max_depth && depth <= empty; depth++)
+    {
+        unsigned long long iteration_start = trace_path ? perf_now() : 0;
+        int score = search_root(search, me, depth, result->best);
+        trace_complete("search iteration", iteration_start);
+        if (search->aborted)
+            break;
+
+        result->depth = depth;
+        result->score = score;
+        result->pv_length = search->pv_length[1] - 1;
+        memcpy(result->pv, &search->pv[1][1], result->pv_length * sizeof(int));
+        result->best = result->pv_length > 0 ? result->pv[0] : -1;
+        result->nodes = search->nodes;
+        if (report)
+            report(result, report_data);
+        if (result->best == -1 || abs(score) >= SEARCH_WIN - SIZE)
+            break;
+    }
+    result->nodes = search->nodes;
+}
+
+// Prepare a search of a position with the current weights and network.
+// movetime is in milliseconds and node_limit in nodes, 0 for no limit.
+void search_setup(Search *search, const int *moves, int multiplier, int movetime,
+                  unsigned long long node_limit, int noise, Rng *rng)
+{
+    memcpy(search->moves, moves, sizeof(search->moves));
+    search->multiplier = multiplier;
+    search->weights = eval_weights;
+    search->nodes = 0;
+    search->deadline = movetime ? perf_now() + movetime * 1000000ULL : 0;
+    search->node_limit = node_limit;
+    search->noise = noise;
+    search->rng = rng;
+    search->nnue = nnue;
+    search->stop = NULL;
+}
+
+// Iterative deepening search of a position up to max_depth, movetime
+// milliseconds or node_limit nodes (0 for no limit). Without a time limit the
+// result depends only on the position, the limits and the noise generator,
+// never on the machine.
+void search_position(SearchResult *result, const int *moves, int multiplier, int me, int max_depth,
+                     int movetime, unsigned long long node_limit, int noise, Rng *rng)
+{
+    Search search;
+    search_setup(&search, moves, multiplier, movetime, node_limit, noise, rng);
+    search_deepen(&search, result, me, max_depth, NULL, NULL);
+}
+
+// Difficulty levels. Level 0 thinks for as long as the think-time manager
+// allows; the others search a fixed number of nodes per move with noisy
+// evaluations, so a move costs the same on any machine and, with --seed,
+// replays exactly.
+typedef struct
+{
+    const char *name;
+    unsigned long long nodes; // search budget per move
+    int noise;                // +- points added to each evaluation
+} Difficulty;
+
+static const Difficulty difficulty_levels[] = {
+    { "adaptive", 0, 0 },
+    { "beginner", 200, 60 },
+    { "easy", 2000, 25 },
+    { "medium", 20000, 10 },
+    { "hard", 200000, 3 },
+    { "expert", 1000000, 0 }
+};
+
+#define DIFFICULTY_COUNT ((int)(sizeof(difficulty_levels) / sizeof(difficulty_levels[0])))
+
+int difficulty = 0; // --level
+
+// Level number from a number or a name, or -1
+int parse_level(const char *text)
+{
+    for (int i = 0; i < DIFFICULTY_COUNT; i++)
+    {
+        if (strcmp(text, difficulty_levels[i].name) == 0)
+            return i;
+    }
+    char *end;
+    long level = strtol(text, &end, 10);
+    return *end == '\0' && end != text && level >= 0 && level < DIFFICULTY_COUNT ? (int)level : -1;
+}
+
+// Think-time manager. Each game has a budget of thinking time for the
+// computer (--think-budget). A move gets an even share of what is left over
+// the computer's remaining moves, scaled by how many factors are playable and
+// doubled when the opponent threatens to win. Forced moves and immediate
+// wins are played at once.
+#define THINK_BUDGET_MS 6000
+#define THINK_MAX_MS 2000
+
+int think_budget = THINK_BUDGET_MS; // per game, in milliseconds
+int think_remaining = THINK_BUDGET_MS;
+
+// Milliseconds to think for player me to move against multiplier
+int think_time(const int *moves, int multiplier, int me, int remaining)
+{
+    int legal = 0, empty = 0, threatened = 0;
+    int cells[SIZE];
+    memcpy(cells, moves, sizeof(cells));
+
+    for (int factor = 1; factor <= 9; factor++)
+    {
+        int idx = product_cell[factor][multiplier];
+        if (idx == -1 || cells[idx] != 0)
+            continue;
+        legal++;
+        cells[idx] = me;
+        int wins = search_wins_at(cells, idx);
+        cells[idx] = 0;
+        if (wins)
+            return 0;
+    }
+    if (legal <= 1)
+        return 0;
+
+    for (int idx = 0; idx < SIZE; idx++)
+    {
+        if (cells[idx] != 0)
+            continue;
+        empty++;
+        cells[idx] = 3 - me;
+        threatened |= search_wins_at(cells, idx);
+        cells[idx] = 0;
+    }
+
+    int moves_left = (empty + 1) / 2;
+    int share = remaining / (moves_left > 0 ? moves_left : 1) * legal / 9;
+    if (threatened)
+        share *= 2;
+    if (share > THINK_MAX_MS)
+        share = THINK_MAX_MS;
+    return share < remaining ? share : remaining;
+}
+
+// Calculate a position's strategic value for player me
+int positionEvaluate(const int *moves, int idx, int me, const int *weights, Rng *rng)
+{
+    PERF_SCOPE(PERF_POSITION_EVALUATE);
+    int value = 0;
+    int row = idx / WIDTH;
+    int col = idx % WIDTH;
+
+    // Prefer center positions
+    int center_row = HEIGHT / 2;
+    int center_col = WIDTH / 2;
+    int row_distance = abs(row - center_row);
+    int col_distance = abs(col - center_col);
+    value += weights[W_CENTER] - (row_distance + col_distance);
+
+    // Prefer positions that could form a line
+    for (int player_id = 1; player_id <= 2; player_id++)
+    {
+        int own = (player_id == me); // Prefer own lines, avoid opponent's
+        int line_weight = own ? weights[W_OWN_LINE] : -weights[W_OPPONENT_LINE];
+
+        // Check rows
+        int row_count = 0;
+        for (int c = 0; c < WIDTH; c++)
+        {
+            int check_idx = row * WIDTH + c;
+            if (moves[check_idx] == player_id)
+                row_count++;
+        }
+        value += line_weight * row_count;
+
+        // Check columns
+        int col_count = 0;
+        for (int r = 0; r < HEIGHT; r++)
+        {
+            int check_idx = r * WIDTH + col;
+            if (moves[check_idx] == player_id)
+                col_count++;
+        }
+        value += line_weight * col_count;
+
+        // Diagonal checks (simplified)
+        if ((row == col) || (row + col == WIDTH - 1))
+        {
+            value += own ? weights[W_OWN_DIAGONAL] : -weights[W_OPPONENT_DIAGONAL];
+        }
+    }
+
+    // Add some randomness to prevent predictable play
+    value += rng_range(rng, weights[W_NOISE]);
+
+    return value;
+}
+
+// Choose the factor player me plays against the given multiplier, or -1 if no
+// product is free. Trial moves go through a scratch move stack and are unmade
+// before returning.
+int chooseFactor(int *moves, int player_num, int me, const int *weights, Rng *rng)
+{
+    PERF_SCOPE(PERF_COMP_MOVE);
+    int opponent = 3 - me;
+    int comp_num = -1;
+    int best_value = -1000;
+    int multiplier = player_num;
+    MoveStack trial = { .count = 0, .top = 0 };
+
+    //find a winning move
+    PERF_BEGIN(PERF_STAGE_WIN);
+    for (int i = 1; i <= 9; i++)
+    {
+        int result = product(i, player_num);
+        int idx = getIndex(result);
+        if (idx != -1 && moves[idx] == 0)
+        {
+            make_move(moves, &multiplier, &trial, idx, me, i);
+            int wins = boardWin(moves, me);
+            unmake_move(moves, &multiplier, &trial);
+            if (wins)
+            {
+                comp_num = i;
+                break;
+            }
+        }
+    }
+    PERF_END(PERF_STAGE_WIN);
+
+    // block player's potential win
+    if (comp_num == -1)
+    {
+        PERF_SCOPE(PERF_STAGE_BLOCK);
+        for (int i = 1; i <= 9; i++)
+        {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && moves[idx] == 0)
+            {
+                make_move(moves, &multiplier, &trial, idx, opponent, i);
+                int loses = boardWin(moves, opponent);
+                unmake_move(moves, &multiplier, &trial);
+                if (loses)
+                {
+                    comp_num = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    //Look for 3-in-a-row
+    if (comp_num == -1)
+    {
+        PERF_SCOPE(PERF_STAGE_THREE);
+
+        for (int i = 1; i <= 9; i++)
+        {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && moves[idx] == 0)
+            {
+                make_move(moves, &multiplier, &trial, idx, me, i);
+
+                int row = idx / WIDTH;
+                int row_count = 0;
+                for (int col = 0; col < WIDTH; col++)
+                {
+                    if (moves[row * WIDTH + col] == me)
+                        row_count++;
+                }
+
+                int col = idx % WIDTH;
+                int col_count = 0;
+                for (int row = 0; row < HEIGHT; row++)
+                {
+                    if (moves[row * WIDTH + col] == me)
+                        col_count++;
+                }
+
+                unmake_move(moves, &multiplier, &trial);
+                if (row_count >= weights[W_THREE_THRESHOLD] || col_count >= weights[W_THREE_THRESHOLD])
+                {
+                    comp_num = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    //evaluate
+    if (comp_num == -1)
+    {
+        PERF_SCOPE(PERF_STAGE_EVALUATE);
+        for (int i = 1; i <= 9; i++)
+        {
+            int result = product(i, player_num);
+            int idx = getIndex(result);
+            if (idx != -1 && moves[idx] == 0)
+            {
+                int value = positionEvaluate(moves, idx, me, weights, rng);
+                if (value > best_value)
+                {
+                    best_value = value;
+                    comp_num = i;
+                }
+            }
+        }
+    }
+
+    return comp_num;
+}
+
+// Print and clear the notes about the last moves
+void show_move_note()
+{
+    printf("%s", move_note);
+    move_note[0] = '\0';
+}
+
+// Perfect-play book written by the solver (--solve). Each record is a
+// position on a proof tree, its value for the side to move and the move to
+// play: the winning move, a move that holds the draw, or in a lost position
+// the defence that took the solver longest to refute. Records are packed into
+// 12 bytes and sorted, so a lookup is a binary search of the loaded file.
+#define BOOK_MAGIC "MGBK"
+#define BOOK_VERSION 1
+#define BOOK_FILE "perfect_play.book"
+
+// Game values: of an opening for side 1, or of a book position for the side to move
+enum { VALUE_UNKNOWN, VALUE_WIN, VALUE_DRAW, VALUE_LOSS };
+
+// cells: bit i of words[0..1] and the low 8 bits of words[2] (cells 0-35 of
+// side 1, then side 2); then multiplier (4 bits), side - 1 (1), move (4) and
+// value (2)
+typedef struct
+{
+    uint32_t words[3];
+} BookRecord;
+
+#define BOOK_KEY_MASK 0x1FFFu // the bits of words[2] that belong to the position
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint8_t values[10];       // value of each opening multiplier 1-9 for side 1
+    uint8_t reserved[2];
+} BookHeader;
+
+typedef struct
+{
+    BookHeader header;
+    BookRecord *records;
+} Book;
+
+Book *book = NULL; // loaded with --book; the computer plays its moves when it has one
+
+// Ownership bitmasks of a board
+void board_masks(const int *moves, uint64_t *mask)
+{
+    mask[0] = mask[1] = 0;
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (moves[i] != 0)
+            mask[moves[i] - 1] |= 1ULL << i;
+    }
+}
+
+void book_pack(BookRecord *record, const uint64_t *mask, int multiplier, int side, int move, int value)
+{
+    record->words[0] = (uint32_t)mask[0];
+    record->words[1] = (uint32_t)(mask[0] >> 32) | (uint32_t)(mask[1] << 4);
+    record->words[2] = (uint32_t)(mask[1] >> 28) | (uint32_t)multiplier << 8 | (uint32_t)(side - 1) << 12 |
+                       (uint32_t)move << 13 | (uint32_t)value << 17;
+}
+
+int compare_book_records(const void *a, const void *b)
+{
+    const BookRecord *x = a, *y = b;
+    for (int i = 0; i < 2; i++)
+    {
+        if (x->words[i] != y->words[i])
+            return x->words[i] < y->words[i] ? -1 : 1;
+    }
+    uint32_t kx = x->words[2] & BOOK_KEY_MASK, ky = y->words[2] & BOOK_KEY_MASK;
+    return kx < ky ? -1 : kx > ky;
+}
+
+// Returns NULL if the file is missing, truncated or holds a move outside 1-9
+Book *load_book(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    Book *loaded = calloc(1, sizeof(Book));
+    if (!loaded)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    int ok = fread(&loaded->header, sizeof(loaded->header), 1, fp) == 1 &&
+             memcmp(loaded->header.magic, BOOK_MAGIC, 4) == 0 && loaded->header.version == BOOK_VERSION;
+
+    // The count must match the file's length before it sizes an allocation
+    long end = ok && fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    ok = ok && end >= 0 &&
+         (uint64_t)end == sizeof(BookHeader) + (uint64_t)loaded->header.count * sizeof(BookRecord) &&
+         fseek(fp, (long)sizeof(BookHeader), SEEK_SET) == 0;
+    if (ok)
+    {
+        loaded->records = malloc(((size_t)loaded->header.count + 1) * sizeof(BookRecord));
+        ok = loaded->records != NULL &&
+             fread(loaded->records, sizeof(BookRecord), loaded->header.count, fp) == loaded->header.count;
+    }
+    for (uint32_t i = 0; ok && i < loaded->header.count; i++)
+    {
+        int move = (loaded->records[i].words[2] >> 13) & 0xF;
+        ok = move >= 1 && move <= 9;
+    }
+    fclose(fp);
+    if (!ok)
+    {
+        free(loaded->records);
+        free(loaded);
+        return NULL;
+    }
+    return loaded;
+}
+
+// The book move for side against multiplier, or -1 if the position is not in
+// the book or its move does not fit the board. value, if given, is set to the
+// position's VALUE_* for side.
+int book_move(const Book *b, const int *moves, int multiplier, int side, int *value)
+{
+    uint64_t mask[2];
+    BookRecord key;
+    board_masks(moves, mask);
+    book_pack(&key, mask, multiplier, side, 0, 0);
+
+    BookRecord *found = bsearch(&key, b->records, b->header.count, sizeof(BookRecord), compare_book_records);
+    if (!found)
+        return -1;
+    int move = (found->words[2] >> 13) & 0xF;
+    int idx = getIndex(product(move, multiplier));
+    if (idx == -1 || moves[idx] != 0)
+        return -1; // the caller searches instead
+    if (value)
+        *value = (found->words[2] >> 17) & 3;
+    return move;
+}
+
+// Opening multiplier that is best for side 2, or -1 if the book has no values
+int book_opening(const Book *b, Rng *rng)
+{
+    int best = -1, best_rank = 3, ties = 0;
+    for (int m = 1; m <= 9; m++)
+    {
+        // A loss for side 1 first, then a draw, then a win
+        int value = b->header.values[m];
+        int rank = value == VALUE_LOSS ? 0 : value == VALUE_DRAW ? 1 : value == VALUE_WIN ? 2 : 3;
+        if (rank < best_rank)
+        {
+            best_rank = rank;
+            best = m;
+            ties = 1;
+        }
+        else if (rank == best_rank && rank < 3 && rng_range(rng, ++ties) == 0)
+            best = m;
+    }
+    return best_rank < 3 ? best : -1;
+}
+
+int autoplay_visible();
+
+// Advanced computer move logic. At a difficulty level the computer searches
+// the level's node budget. Otherwise it searches for as long as the think-time
+// manager allows; when that is too short to look two moves ahead (forced
+// moves, immediate wins, an exhausted budget) the rule cascade decides. With
+// a perfect-play book, book positions are played from the book.
+void compMove(int player_num)
+{
+    unsigned long long start = perf_now();
+    int budget = think_time(player_moves, player_num, 2, think_remaining);
+    int comp_num = -1;
+
+    if (autoplay_visible())
+    {
+        printf("\nComputer thinking...");
+        fflush(stdout);
+    }
+    if (book)
+        comp_num = book_move(book, player_moves, player_num, 2, NULL);
+    if (comp_num == -1 && difficulty > 0)
+    {
+        // Fixed node budget; the noise comes from the game's generator
+        const Difficulty *level = &difficulty_levels[difficulty];
+        SearchResult search;
+        search_position(&search, player_moves, player_num, 2, SIZE, 0, level->nodes, level->noise, &game_rng);
+        comp_num = search.best;
+    }
+    else if (comp_num == -1 && budget > 0)
+    {
+        SearchResult search;
+        search_position(&search, player_moves, player_num, 2, SIZE, budget, 0, 0, NULL);
+        if (search.depth >= 2)
+            comp_num = search.best;
+    }
+    if (comp_num == -1)
+        comp_num = chooseFactor(player_moves, player_num, 2, eval_weights, &game_rng);
+    if (autoplay_visible())
+        printf("\n");
+
+    think_remaining -= (int)((perf_now() - start) / 1000000ULL);
+    if (think_remaining < 0)
+        think_remaining = 0;
+
+    // Apply move
+    if (comp_num != -1)
+    {
+        int result = multiplication(&comp_num, &player_num);
+        make_move(player_moves, &com_choice, &history, getIndex(result), 2, comp_num);
+        publish_event(SPECTATE_MOVE, getIndex(result), 2, comp_num);
+        size_t used = strlen(move_note);
+        snprintf(move_note + used, sizeof(move_note) - used,
+                 "\nComputer chooses: %d => multiplication result: %d x %d = %d\n",
+                 comp_num, comp_num, player_num, result);
+
+        if (checkWin(2))
+        {
+            if (autoplay_visible())
+            {
+                clear_screen(0);
+                display();
+                show_move_note();
+                printf("\nComputer Wins by 4 in a line!\n");
+            }
+            updateScore(2);
+            game_over = 1;
+        }
+    }
+}
+
+// Play one headless game between two weight sets, weights_a moving first as
+// player 1 against the opening multiplier. Returns the winner (1 or 2), or 0
+// for a draw (full board, or no free product for the side to move).
+int selfPlay(const int *weights_a, const int *weights_b, int opening, Rng *rng)
+{
+    int moves[SIZE] = {0};
+    int multiplier = opening;
+    int side = 1;
+
+    for (;;)
+    {
+        int factor = chooseFactor(moves, multiplier, side, side == 1 ? weights_a : weights_b, rng);
+        if (factor == -1)
+            return 0;
+
+        moves[getIndex(product(factor, multiplier))] = side;
+        if (boardWin(moves, side))
+            return side;
+        if (boardFull(moves))
+            return 0;
+
+        multiplier = factor;
+        side = 3 - side;
+    }
+}
+
+// Work shared by the tuner's threads for one SPSA iteration
+typedef struct
+{
+    const int *plus;      // theta + c*delta
+    const int *minus;     // theta - c*delta
+    uint64_t seed;        // iteration seed; each game pair derives its own
+    int first_pair;
+    int last_pair;        // exclusive
+    int score;            // wins of plus minus wins of minus
+} TuneJob;
+
+// Mix a seed and an index into a well-spread 64-bit value (splitmix64)
+uint64_t mix_seed(uint64_t seed, uint64_t index)
+{
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Play a range of game pairs; each pair repeats one opening with the sides swapped
+void *tune_worker(void *arg)
+{
+    TuneJob *job = arg;
+    job->score = 0;
+
+    for (int pair = job->first_pair; pair < job->last_pair; pair++)
+    {
+        Rng rng;
+        rng_seed(&rng, mix_seed(job->seed, pair));
+        int opening = rng_range(&rng, 9) + 1;
+
+        int winner = selfPlay(job->plus, job->minus, opening, &rng);
+        job->score += (winner == 1) - (winner == 2);
+
+        winner = selfPlay(job->minus, job->plus, opening, &rng);
+        job->score += (winner == 2) - (winner == 1);
+    }
+    return NULL;
+}
+
+// Tune the evaluation weights with SPSA: each iteration perturbs every weight
+// at once, plays game pairs between the two perturbed sets across all threads
+// and steps towards the stronger one. The result is written to path.
+int tune(int iterations, int pairs, int threads, const char *path)
+{
+    double theta[WEIGHT_COUNT];
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        theta[i] = eval_weights[i];
+
+    TuneJob *jobs = calloc(threads, sizeof(TuneJob));
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    Rng rng;
+    rng_seed(&rng, game_seed);
+
+    printf("Tuning %d iterations x %d game pairs on %d threads (seed %llu)\n",
+           iterations, pairs, threads, (unsigned long long)game_seed);
+
+    for (int k = 1; k <= iterations; k++)
+    {
+        // Standard SPSA gain sequences
+        double a_k = 2.0 / pow(k + iterations / 10.0, 0.602);
+        double c_k = 1.0 / pow(k, 0.101);
+
+        int delta[WEIGHT_COUNT], plus[WEIGHT_COUNT], minus[WEIGHT_COUNT];
+        for (int i = 0; i < WEIGHT_COUNT; i++)
+        {
+            delta[i] = (rng_next(&rng) & 1) ? 1 : -1;
+            plus[i] = (int)lround(theta[i] + c_k * delta[i]);
+            minus[i] = (int)lround(theta[i] - c_k * delta[i]);
+        }
+        clampWeights(plus);
+        clampWeights(minus);
+
+        uint64_t iteration_seed = rng_next(&rng) | ((uint64_t)rng_next(&rng) << 32);
+        for (int t = 0; t < threads; t++)
+        {
+            jobs[t].plus = plus;
+            jobs[t].minus = minus;
+            jobs[t].seed = iteration_seed;
+            jobs[t].first_pair = (int)((long long)pairs * t / threads);
+            jobs[t].last_pair = (int)((long long)pairs * (t + 1) / threads);
+            pthread_create(&workers[t], NULL, tune_worker, &jobs[t]);
+        }
+
+        int score = 0;
+        for (int t = 0; t < threads; t++)
+        {
+            pthread_join(workers[t], NULL);
+            score += jobs[t].score;
+        }
+
+        // Gradient estimate from the normalised score of plus against minus
+        double result = score / (2.0 * pairs);
+        for (int i = 0; i < WEIGHT_COUNT; i++)
+        {
+            theta[i] += a_k * result / (2.0 * c_k * delta[i]);
+            if (theta[i] < weight_min[i])
+                theta[i] = weight_min[i];
+            if (theta[i] > weight_max[i])
+                theta[i] = weight_max[i];
+        }
+
+        printf("Iteration %d: plus-minus score %+.3f\n", k, result);
+    }
+
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        eval_weights[i] = (int)lround(theta[i]);
+    clampWeights(eval_weights);
+
+    free(jobs);
+    free(workers);
+
+    printf("Tuned weights:\n");
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        printf("  %-18s %d\n", weight_names[i], eval_weights[i]);
+
+    if (!save_weights(path, eval_weights))
+        return 0;
+    printf("Weights written to %s\n", path);
+    return 1;
+}
+
+// Training data for the neural evaluator: positions from self-play games,
+// each labelled with how the game ended for the side to move
+#define POSITIONS_MAGIC "MGPS"
+#define POSITIONS_VERSION 1
+#define TRAIN_BATCH 256
+#define TRAIN_RATE 0.001
+
+typedef struct
+{
+    int8_t cells[SIZE]; // 0=empty, 1 or 2 for the owner
+    int8_t multiplier;
+    int8_t side;        // side to move
+    int8_t result;      // 1 won, 0 drawn, -1 lost, for the side to move
+    int8_t reserved;
+} PositionRecord;
+
+// Positions of a range of games, collected by one generator thread
+typedef struct
+{
+    int first_game;
+    int last_game;        // exclusive
+    PositionRecord *records;
+    size_t count;
+    size_t capacity;
+} PositionJob;
+
+// Play one game from a few random opening moves and record every position
+void *position_worker(void *arg)
+{
+    PositionJob *job = arg;
+
+    for (int game = job->first_game; game < job->last_game; game++)
+    {
+        Rng rng;
+        rng_seed(&rng, mix_seed(game_seed, game));
+        int moves[SIZE] = {0};
+        int multiplier = rng_range(&rng, 9) + 1;
+        int random_plies = rng_range(&rng, 5);
+        int side = 1;
+        int winner = 0;
+        size_t first = job->count;
+
+        for (int ply = 0;; ply++)
+        {
+            int factor;
+            if (ply < random_plies)
+            {
+                int legal[9], legal_count = 0;
+                for (int f = 1; f <= 9; f++)
+                {
+                    if (moves[getIndex(product(f, multiplier))] == 0)
+                        legal[legal_count++] = f;
+                }
+                factor = legal_count > 0 ? legal[rng_range(&rng, legal_count)] : -1;
+            }
+            else
+                factor = chooseFactor(moves, multiplier, side, eval_weights, &rng);
+            if (factor == -1)
+                break;
+
+            if (job->count == job->capacity)
+            {
+                job->capacity = job->capacity ? 2 * job->capacity : 4096;
+                job->records = realloc(job->records, job->capacity * sizeof(PositionRecord));
+            }
+            PositionRecord *record = &job->records[job->count++];
+            for (int i = 0; i < SIZE; i++)
+                record->cells[i] = (int8_t)moves[i];
+            record->multiplier = (int8_t)multiplier;
+            record->side = (int8_t)side;
+            record->reserved = 0;
+
+            moves[getIndex(product(factor, multiplier))] = side;
+            if (boardWin(moves, side))
+            {
+                winner = side;
+                break;
+            }
+            if (boardFull(moves))
+                break;
+            multiplier = factor;
+            side = 3 - side;
+        }
+
+        for (size_t i = first; i < job->count; i++)
+        {
+            PositionRecord *record = &job->records[i];
+            record->result = (int8_t)(winner == 0 ? 0 : winner == record->side ? 1 : -1);
+        }
+    }
+    return NULL;
+}
+
+// Generate positions from the given number of self-play games on all threads.
+// Game i is seeded from the game seed and i, so the file does not depend on
+// the thread count.
+int generate_positions(const char *path, int games, int threads)
+{
+    PositionJob *jobs = calloc(threads, sizeof(PositionJob));
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+
+    printf("Generating positions from %d games on %d threads (seed %llu)\n",
+           games, threads, (unsigned long long)game_seed);
+    for (int t = 0; t < threads; t++)
+    {
+        jobs[t].first_game = (int)((long long)games * t / threads);
+        jobs[t].last_game = (int)((long long)games * (t + 1) / threads);
+        pthread_create(&workers[t], NULL, position_worker, &jobs[t]);
+    }
+
+    int ok = 1;
+    uint32_t total = 0;
+    FILE *fp = fopen(path, "wb");
+    if (fp)
+    {
+        uint32_t header[3] = { 0, POSITIONS_VERSION, 0 };
+        memcpy(header, POSITIONS_MAGIC, 4);
+        fwrite(header, sizeof(header), 1, fp);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+        if (fp && jobs[t].count > 0)
+            ok &= fwrite(jobs[t].records, sizeof(PositionRecord), jobs[t].count, fp) == jobs[t].count;
+        total += (uint32_t)jobs[t].count;
+        free(jobs[t].records);
+    }
+    if (fp)
+    {
+        // Patch the record count into the header now that it is known
+        fseek(fp, 2 * sizeof(uint32_t), SEEK_SET);
+        fwrite(&total, sizeof(total), 1, fp);
+        ok &= fclose(fp) == 0;
+    }
+    free(jobs);
+    free(workers);
+
+    if (!fp || !ok)
+    {
+        printf("Could not write %s\n", path);
+        return 0;
+    }
+    printf("%u positions written to %s\n", total, path);
+    return 1;
+}
+
+PositionRecord *load_positions(const char *path, size_t *count)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    uint32_t header[3];
+    PositionRecord *records = NULL;
+    *count = 0;
+    if (fread(header, sizeof(header), 1, fp) == 1 && memcmp(header, POSITIONS_MAGIC, 4) == 0 &&
+        header[1] == POSITIONS_VERSION && header[2] > 0)
+    {
+        // The count comes from the file; a bad one fails here instead of crashing
+        records = malloc((size_t)header[2] * sizeof(PositionRecord));
+        if (records)
+            *count = fread(records, sizeof(PositionRecord), header[2], fp);
+        else
+            fprintf(stderr, "Not enough memory for %u positions in %s\n", header[2], path);
+    }
+    fclose(fp);
+    if (records && *count == 0)
+    {
+        free(records);
+        records = NULL;
+    }
+    return records;
+}
+
+// Floating-point twin of Nnue with activations in 0..1, trained with Adam and
+// quantized when saved. Each parameter array keeps its gradient and both Adam
+// moments in the matching arrays of grad, m and v.
+typedef struct
+{
+    float input_weights[NNUE_INPUTS][NNUE_HIDDEN];
+    float input_bias[NNUE_HIDDEN];
+    float hidden_weights[NNUE_HIDDEN2][2 * NNUE_HIDDEN];
+    float hidden_bias[NNUE_HIDDEN2];
+    float output_weights[NNUE_HIDDEN2];
+    float output_bias;
+} NnueTrainer;
+
+#define TRAINER_PARAMS (sizeof(NnueTrainer) / sizeof(float))
+#define TRAIN_WEIGHT_LIMIT ((float)NNUE_QA / NNUE_QB) // largest dense weight an int8 holds
+
+static inline float clip01(float x)
+{
+    return x < 0 ? 0 : x > 1 ? 1 : x;
+}
+
+// Active inputs of a record from player view's side; returns how many
+static int record_features(const PositionRecord *record, int view, int *features)
+{
+    int count = 0;
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (record->cells[i] != 0)
+            features[count++] = nnue_cell_feature(i, record->cells[i], view);
+    }
+    if (record->multiplier >= 1 && record->multiplier <= 9)
+        features[count++] = nnue_multiplier_feature(record->multiplier);
+    return count;
+}
+
+// Forward pass, and with grad set the backward pass accumulated into grad.
+// Returns the predicted score of the side to move as a probability.
+float train_position(const NnueTrainer *net, NnueTrainer *grad, const PositionRecord *record)
+{
+    int features[2][SIZE + 1], feature_count[2];
+    float pre[2 * NNUE_HIDDEN], hidden[2 * NNUE_HIDDEN];
+    float pre2[NNUE_HIDDEN2], hidden2[NNUE_HIDDEN2];
+
+    for (int half = 0; half < 2; half++)
+    {
+        int view = half == 0 ? record->side : 3 - record->side;
+        feature_count[half] = record_features(record, view, features[half]);
+        for (int j = 0; j < NNUE_HIDDEN; j++)
+        {
+            float sum = net->input_bias[j];
+            for (int k = 0; k < feature_count[half]; k++)
+                sum += net->input_weights[features[half][k]][j];
+            pre[half * NNUE_HIDDEN + j] = sum;
+            hidden[half * NNUE_HIDDEN + j] = clip01(sum);
+        }
+    }
+
+    float out = net->output_bias;
+    for (int o = 0; o < NNUE_HIDDEN2; o++)
+    {
+        float sum = net->hidden_bias[o];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++)
+            sum += net->hidden_weights[o][i] * hidden[i];
+        pre2[o] = sum;
+        hidden2[o] = clip01(sum);
+        out += net->output_weights[o] * hidden2[o];
+    }
+    float predicted = 1.0f / (1.0f + expf(-out));
+    if (!grad)
+        return predicted;
+
+    // Cross-entropy against the game result: d loss / d out = predicted - target
+    float d_out = predicted - (record->result + 1) / 2.0f;
+    float d_hidden[2 * NNUE_HIDDEN] = {0};
+    grad->output_bias += d_out;
+    for (int o = 0; o < NNUE_HIDDEN2; o++)
+    {
+        grad->output_weights[o] += d_out * hidden2[o];
+        if (pre2[o] <= 0 || pre2[o] >= 1)
+            continue;
+        float d_pre2 = d_out * net->output_weights[o];
+        grad->hidden_bias[o] += d_pre2;
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++)
+        {
+            grad->hidden_weights[o][i] += d_pre2 * hidden[i];
+            d_hidden[i] += d_pre2 * net->hidden_weights[o][i];
+        }
+    }
+    for (int half = 0; half < 2; half++)
+    {
+        for (int j = 0; j < NNUE_HIDDEN; j++)
+        {
+            float value = pre[half * NNUE_HIDDEN + j];
+            if (value <= 0 || value >= 1)
+                continue;
+            float d_pre = d_hidden[half * NNUE_HIDDEN + j];
+            grad->input_bias[j] += d_pre;
+            for (int k = 0; k < feature_count[half]; k++)
+                grad->input_weights[features[half][k]][j] += d_pre;
+        }
+    }
+    return predicted;
+}
+
+// Round the trained network to the integer layout nnue_evaluate runs
+void quantize_nnue(const NnueTrainer *net, Nnue *out)
+{
+    for (int f = 0; f < NNUE_INPUTS; f++)
+    {
+        for (int j = 0; j < NNUE_HIDDEN; j++)
+            out->input_weights[f][j] = (int16_t)lroundf(net->input_weights[f][j] * NNUE_QA);
+    }
+    for (int j = 0; j < NNUE_HIDDEN; j++)
+        out->input_bias[j] = (int16_t)lroundf(net->input_bias[j] * NNUE_QA);
+    for (int o = 0; o < NNUE_HIDDEN2; o++)
+    {
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++)
+            out->hidden_weights[o][i] = (int8_t)lroundf(net->hidden_weights[o][i] * NNUE_QB);
+        out->hidden_bias[o] = (int32_t)lroundf(net->hidden_bias[o] * NNUE_QA * NNUE_QB);
+        out->output_weights[o] = (int8_t)lroundf(net->output_weights[o] * NNUE_QB);
+    }
+    out->output_bias = (int32_t)lroundf(net->output_bias * NNUE_QA * NNUE_QB);
+}
+
+// Mean cross-entropy and share of decided games called the right way
+static void train_loss(const NnueTrainer *net, const PositionRecord *records, size_t count,
+                       double *loss, double *accuracy)
+{
+    double total = 0;
+    size_t decided = 0, correct = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double p = train_position(net, NULL, &records[i]);
+        double target = (records[i].result + 1) / 2.0;
+        p = p < 1e-6 ? 1e-6 : p > 1 - 1e-6 ? 1 - 1e-6 : p;
+        total -= target * log(p) + (1 - target) * log(1 - p);
+        if (records[i].result != 0)
+        {
+            decided++;
+            correct += (p > 0.5) == (records[i].result > 0);
+        }
+    }
+    *loss = count ? total / count : 0;
+    *accuracy = decided ? (double)correct / decided : 0;
+}
+
+// Train a network on a positions file for the given number of epochs and
+// write the quantized weights to path. A tenth of the positions is held back
+// to report the loss on positions the network has not seen.
+int train_nnue(const char *positions_path, int epochs, const char *path)
+{
+    size_t count = 0;
+    PositionRecord *records = load_positions(positions_path, &count);
+    if (!records)
+    {
+        printf("No positions in %s (create them with --gen-positions)\n", positions_path);
+        return 0;
+    }
+
+    NnueTrainer *net = calloc(1, sizeof(NnueTrainer));
+    NnueTrainer *grad = calloc(1, sizeof(NnueTrainer));
+    NnueTrainer *m = calloc(1, sizeof(NnueTrainer));
+    NnueTrainer *v = calloc(1, sizeof(NnueTrainer));
+    Rng rng;
+    rng_seed(&rng, game_seed);
+
+    // Shuffle once so the held-back tenth is a fair sample
+    for (size_t i = count - 1; i > 0; i--)
+    {
+        size_t j = rng_range(&rng, (int)(i + 1));
+        PositionRecord swap = records[i];
+        records[i] = records[j];
+        records[j] = swap;
+    }
+    size_t validation = count / 10;
+    size_t training = count - validation;
+    PositionRecord *held_back = records + training;
+
+    float *params = (float *)net;
+    for (size_t i = 0; i < TRAINER_PARAMS; i++)
+        params[i] = (rng_range(&rng, 2001) - 1000) / 1000.0f * 0.2f;
+    for (int j = 0; j < NNUE_HIDDEN; j++)
+        net->input_bias[j] = 0.25f;
+    for (int o = 0; o < NNUE_HIDDEN2; o++)
+        net->hidden_bias[o] = 0.25f;
+
+    printf("Training on %zu positions (%zu held back) for %d epochs\n", training, validation, epochs);
+    float *g = (float *)grad, *first = (float *)m, *second = (float *)v;
+    long step = 0;
+    for (int epoch = 1; epoch <= epochs; epoch++)
+    {
+        for (size_t i = training - 1; i > 0; i--)
+        {
+            size_t j = rng_range(&rng, (int)(i + 1));
+            PositionRecord swap = records[i];
+            records[i] = records[j];
+            records[j] = swap;
+        }
+
+        for (size_t start = 0; start < training; start += TRAIN_BATCH)
+        {
+            size_t end = start + TRAIN_BATCH < training ? start + TRAIN_BATCH : training;
+            memset(grad, 0, sizeof(NnueTrainer));
+            for (size_t i = start; i < end; i++)
+                train_position(net, grad, &records[i]);
+
+            // Adam with the usual decay rates and bias correction
+            step++;
+            double correction1 = 1 - pow(0.9, step);
+            double correction2 = 1 - pow(0.999, step);
+            float scale = 1.0f / (float)(end - start);
+            for (size_t p = 0; p < TRAINER_PARAMS; p++)
+            {
+                float gradient = g[p] * scale;
+                first[p] = 0.9f * first[p] + 0.1f * gradient;
+                second[p] = 0.999f * second[p] + 0.001f * gradient * gradient;
+                params[p] -= (float)(TRAIN_RATE * (first[p] / correction1) /
+                                     (sqrt(second[p] / correction2) + 1e-8));
+            }
+
+            // Keep the dense layers inside what their int8 weights can hold
+            float *dense = &net->hidden_weights[0][0];
+            for (size_t p = 0; p < sizeof(net->hidden_weights) / sizeof(float); p++)
+                dense[p] = fmaxf(-TRAIN_WEIGHT_LIMIT, fminf(TRAIN_WEIGHT_LIMIT, dense[p]));
+            for (int o = 0; o < NNUE_HIDDEN2; o++)
+                net->output_weights[o] = fmaxf(-TRAIN_WEIGHT_LIMIT, fminf(TRAIN_WEIGHT_LIMIT, net->output_weights[o]));
+        }
+
+        double train_loss_value, train_accuracy, loss, accuracy;
+        train_loss(net, records, training, &train_loss_value, &train_accuracy);
+        train_loss(net, held_back, validation, &loss, &accuracy);
+        printf("Epoch %d: loss %.4f (held back %.4f), decided games called right %.1f%% (held back %.1f%%)\n",
+               epoch, train_loss_value, loss, 100 * train_accuracy, 100 * accuracy);
+    }
+
+    Nnue *quantized = calloc(1, sizeof(Nnue));
+    quantize_nnue(net, quantized);
+    int ok = save_nnue(path, quantized);
+    if (ok)
+        printf("Network written to %s\n", path);
+    else
+        printf("Could not write %s\n", path);
+
+    free(quantized);
+    free(net);
+    free(grad);
+    free(m);
+    free(v);
+    free(records);
+    return ok;
+}
+
+// Tournaments between computer players (--player SPEC, twice or more). Every
+// pairing plays game pairs: both games of a pair start from the same random
+// opening with the colours swapped, so neither side profits from a lucky
+// opening or from moving first. Pairs are shared out to all threads; with
+// --sprt a pairing stops as soon as the sequential probability ratio test
+// decides between its two Elo hypotheses.
+#define TOURNAMENT_MAX_PLAYERS 16
+#define OPENING_PLIES 2        // random moves after the opening multiplier
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+
+// One computer player: the rule-based chooseFactor or the alpha-beta search
+typedef struct
+{
+    char name[64];
+    int search;                     // 0 for chooseFactor
+    int weights[WEIGHT_COUNT];
+    Nnue *nnue;                     // search only
+    int depth;                      // search limits; 0 for none
+    unsigned long long nodes;
+    int movetime;
+    int noise;
+} Player;
+
+// Results of one pairing, from the first player's side
+typedef struct
+{
+    const Player *a;
+    const Player *b;
+    int pair_limit;
+    atomic_int next_pair;
+    atomic_int decided;             // SPRT reached a bound; stop handing out pairs
+    pthread_mutex_t lock;
+    int wins, draws, losses;
+    int pairs;
+    int pair_counts[5];             // pairs scoring 0, 0.5, 1, 1.5 and 2 points
+    double llr;
+} Pairing;
+
+typedef struct
+{
+    Pairing *pairing;
+    double elo0, elo1;              // SPRT hypotheses; elo0 == elo1 for no test
+} PairingJob;
+
+// Free the network a player loaded for itself (nnue=); the global one stays
+void free_player(Player *player)
+{
+    if (player->nnue != nnue)
+        free(player->nnue);
+    player->nnue = nnue;
+}
+
+// Parse "rules|search[,key=value...]"; keys are name, weights, nnue, level,
+// depth, nodes, movetime and noise. Returns 0 on a bad specification.
+int parse_player(const char *spec, Player *player)
+{
+    char copy[256], *save;
+    snprintf(copy, sizeof(copy), "%s", spec);
+    memset(player, 0, sizeof(*player));
+    memcpy(player->weights, eval_weights, sizeof(player->weights));
+    player->nnue = nnue;
+    snprintf(player->name, sizeof(player->name), "%s", spec);
+
+    char *kind = strtok_r(copy, ",", &save);
+    if (!kind || (strcmp(kind, "rules") != 0 && strcmp(kind, "search") != 0))
+        return 0;
+    player->search = strcmp(kind, "search") == 0;
+
+    for (char *option = strtok_r(NULL, ",", &save); option; option = strtok_r(NULL, ",", &save))
+    {
+        char *value = strchr(option, '=');
+        if (!value)
+            return 0;
+        *value++ = '\0';
+
+        if (strcmp(option, "name") == 0)
+            snprintf(player->name, sizeof(player->name), "%s", value);
+        else if (strcmp(option, "weights") == 0)
+        {
+            if (!load_weights(value, player->weights))
+                return 0;
+        }
+        else if (strcmp(option, "nnue") == 0)
+        {
+            free_player(player);
+            if (!(player->nnue = load_nnue(value)))
+                return 0;
+        }
+        else if (strcmp(option, "level") == 0)
+        {
+            // Level 0 ("adaptive") sets no limits of its own
+            int level = parse_level(value);
+            if (level < 0)
+                return 0;
+            if (level > 0)
+            {
+                player->nodes = difficulty_levels[level].nodes;
+                player->noise = difficulty_levels[level].noise;
+            }
+        }
+        else if (strcmp(option, "depth") == 0)
+            player->depth = atoi(value);
+        else if (strcmp(option, "nodes") == 0)
+            player->nodes = strtoull(value, NULL, 10);
+        else if (strcmp(option, "movetime") == 0)
+            player->movetime = atoi(value);
+        else if (strcmp(option, "noise") == 0)
+            player->noise = atoi(value);
+        else
+            return 0;
+    }
+
+    // An unlimited search would solve the whole game every move
+    if (player->search && !player->depth && !player->nodes && !player->movetime)
+        player->nodes = difficulty_levels[DIFFICULTY_COUNT / 2].nodes;
+    return 1;
+}
+
+int player_move(const Player *player, int *moves, int multiplier, int side, Rng *rng)
+{
+    if (player->search)
+    {
+        Search search;
+        SearchResult result;
+        search_setup(&search, moves, multiplier, player->movetime, player->nodes, player->noise, rng);
+        search.weights = player->weights;
+        search.nnue = player->nnue;
+        search_deepen(&search, &result, side, player->depth ? player->depth : SIZE, NULL, NULL);
+        if (result.best != -1)
+            return result.best;
+    }
+    return chooseFactor(moves, multiplier, side, player->weights, rng);
+}
+
+// Play one game from an opening; returns the winning side (1 or 2) or 0 for a draw
+int tournament_game(const Player *first, const Player *second, const int *opening, int multiplier, Rng *rng)
+{
+    int moves[SIZE];
+    memcpy(moves, opening, sizeof(moves));
+    int side = 1;
+
+    for (;;)
+    {
+        int factor = player_move(side == 1 ? first : second, moves, multiplier, side, rng);
+        if (factor == -1)
+            return 0;
+
+        int idx = product_cell[factor][multiplier];
+        moves[idx] = side;
+        if (search_wins_at(moves, idx))
+            return side;
+        if (boardFull(moves))
+            return 0;
+        multiplier = factor;
+        side = 3 - side;
+    }
+}
+
+// Random opening of pair number pair, the same for every pairing
+void tournament_opening(int pair, int *moves, int *multiplier)
+{
+    Rng rng;
+    rng_seed(&rng, mix_seed(game_seed, pair));
+    memset(moves, 0, SIZE * sizeof(int));
+    *multiplier = rng_range(&rng, 9) + 1;
+
+    // Stones are placed for both sides without moving the multiplier on, so
+    // the opening leaves side 1 to move and neither side a line ahead
+    for (int ply = 0; ply < OPENING_PLIES; ply++)
+    {
+        int idx;
+        do
+            idx = rng_range(&rng, SIZE);
+        while (moves[idx] != 0);
+        moves[idx] = 1 + ply % 2;
+    }
+}
+
+// Expected score of a player rated elo above its opponent
+double elo_score(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+double score_elo(double score)
+{
+    if (score <= 0)
+        return -INFINITY;
+    if (score >= 1)
+        return INFINITY;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Mean and variance per game of the pair scores of a pairing
+void pair_statistics(const Pairing *pairing, double *mean, double *variance)
+{
+    *mean = *variance = 0;
+    if (pairing->pairs == 0)
+        return;
+    for (int k = 0; k < 5; k++)
+        *mean += pairing->pair_counts[k] * (k / 4.0);
+    *mean /= pairing->pairs;
+    for (int k = 0; k < 5; k++)
+        *variance += pairing->pair_counts[k] * (k / 4.0 - *mean) * (k / 4.0 - *mean);
+    *variance /= pairing->pairs;
+}
+
+// Log-likelihood ratio of elo1 against elo0, using the normal approximation
+// of the pair scores (the usual GSPRT for paired games)
+double sprt_llr(const Pairing *pairing, double elo0, double elo1)
+{
+    double mean, variance;
+    pair_statistics(pairing, &mean, &variance);
+    if (variance <= 0)
+        return 0;
+    double s0 = elo_score(elo0), s1 = elo_score(elo1);
+    return pairing->pairs * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+void *pairing_worker(void *arg)
+{
+    PairingJob *job = arg;
+    Pairing *pairing = job->pairing;
+    double lower = log(SPRT_BETA / (1 - SPRT_ALPHA));
+    double upper = log((1 - SPRT_BETA) / SPRT_ALPHA);
+
+    while (!atomic_load(&pairing->decided))
+    {
+        int pair = atomic_fetch_add(&pairing->next_pair, 1);
+        if (pair >= pairing->pair_limit)
+            break;
+
+        int opening[SIZE], multiplier;
+        tournament_opening(pair, opening, &multiplier);
+        Rng rng;
+        rng_seed(&rng, mix_seed(game_seed ^ 0x5eedULL, pair));
+
+        int first = tournament_game(pairing->a, pairing->b, opening, multiplier, &rng);
+        int second = tournament_game(pairing->b, pairing->a, opening, multiplier, &rng);
+        // Half points of a over the pair, 0 to 4
+        int points = (first == 1 ? 2 : first == 0) + (second == 2 ? 2 : second == 0);
+
+        pthread_mutex_lock(&pairing->lock);
+        pairing->wins += (first == 1) + (second == 2);
+        pairing->losses += (first == 2) + (second == 1);
+        pairing->draws += (first == 0) + (second == 0);
+        pairing->pair_counts[points]++;
+        pairing->pairs++;
+        if (job->elo0 != job->elo1)
+        {
+            pairing->llr = sprt_llr(pairing, job->elo0, job->elo1);
+            if (pairing->llr <= lower || pairing->llr >= upper)
+                atomic_store(&pairing->decided, 1);
+        }
+        pthread_mutex_unlock(&pairing->lock);
+    }
+    return NULL;
+}
+
+// Play every pairing of the players, pairs game pairs each (fewer when the
+// SPRT decides first), and print the scores and Elo differences with 95%
+// error bars. elo0 == elo1 turns the SPRT off.
+int tournament(Player *players, int player_count, int pairs, int threads, double elo0, double elo1)
+{
+    double points[TOURNAMENT_MAX_PLAYERS] = {0};
+    int games[TOURNAMENT_MAX_PLAYERS] = {0};
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    PairingJob *jobs = calloc(threads, sizeof(PairingJob));
+    double lower = log(SPRT_BETA / (1 - SPRT_ALPHA));
+    double upper = log((1 - SPRT_BETA) / SPRT_ALPHA);
+    int sprt = elo0 != elo1;
+
+    printf("Tournament of %d players, up to %d game pairs per pairing on %d threads (seed %llu)\n",
+           player_count, pairs, threads, (unsigned long long)game_seed);
+    if (sprt)
+        printf("SPRT elo0 %.1f elo1 %.1f, alpha %.2f beta %.2f: LLR bounds [%.2f, %.2f]\n",
+               elo0, elo1, SPRT_ALPHA, SPRT_BETA, lower, upper);
+
+    for (int i = 0; i < player_count; i++)
+    {
+        for (int j = i + 1; j < player_count; j++)
+        {
+            Pairing pairing;
+            memset(&pairing, 0, sizeof(pairing));
+            pairing.a = &players[i];
+            pairing.b = &players[j];
+            pairing.pair_limit = pairs;
+            atomic_init(&pairing.next_pair, 0);
+            atomic_init(&pairing.decided, 0);
+            pthread_mutex_init(&pairing.lock, NULL);
+
+            unsigned long long start = perf_now();
+            for (int t = 0; t < threads; t++)
+            {
+                jobs[t].pairing = &pairing;
+                jobs[t].elo0 = elo0;
+                jobs[t].elo1 = elo1;
+                pthread_create(&workers[t], NULL, pairing_worker, &jobs[t]);
+            }
+            for (int t = 0; t < threads; t++)
+                pthread_join(workers[t], NULL);
+            pthread_mutex_destroy(&pairing.lock);
+
+            double mean, variance;
+            pair_statistics(&pairing, &mean, &variance);
+            double margin = pairing.pairs > 0 ? 1.96 * sqrt(variance / pairing.pairs) : 0;
+            double elo = score_elo(mean);
+            double elo_low = score_elo(mean - margin), elo_high = score_elo(mean + margin);
+
+            printf("\n%s vs %s: +%d =%d -%d in %d pairs (%.1f s)\n", players[i].name, players[j].name,
+                   pairing.wins, pairing.draws, pairing.losses, pairing.pairs, (perf_now() - start) / 1e9);
+            printf("  score %.1f%%, Elo %+.1f [%+.1f, %+.1f]\n", 100 * mean, elo, elo_low, elo_high);
+            if (sprt)
+                printf("  LLR %.2f: %s\n", pairing.llr,
+                       pairing.llr >= upper ? "H1 accepted (elo1 is more likely)" :
+                       pairing.llr <= lower ? "H0 accepted (elo0 is more likely)" :
+                       "undecided, more pairs needed");
+
+            points[i] += pairing.wins + pairing.draws / 2.0;
+            points[j] += pairing.losses + pairing.draws / 2.0;
+            games[i] += 2 * pairing.pairs;
+            games[j] += 2 * pairing.pairs;
+        }
+    }
+
+    if (player_count > 2)
+    {
+        printf("\nStandings:\n");
+        for (int i = 0; i < player_count; i++)
+            printf("  %-24s %7.1f / %d\n", players[i].name, points[i], games[i]);
+    }
+
+    free(workers);
+    free(jobs);
+    return 1;
+}
+
+// Weak solver (--solve): proves the value of each of the nine openings (empty
+// board, opening multiplier, side 1 to move) with depth-first proof-number
+// search. A question is "can attacker force four in a line?"; an opening is a
+// win for side 1 if side 1 can, a loss if side 2 can and a draw if neither.
+// Proof and disproof numbers live in a transposition table shared by all
+// threads, which take openings from a queue. The table is checkpointed
+// periodically and on Ctrl+C, so a long solve resumes where it stopped, and
+// the proof trees are written out as a perfect-play book (see Book).
+#define PN_INF 0x7FFFFFFFu
+#define SOLVE_BUCKET 4              // entries per table bucket
+#define SOLVE_LOCKS 4096            // striped locks over the buckets
+#define SOLVE_HASH_MB 512
+#define SOLVE_CHECKPOINT_FILE "solve_checkpoint.dat"
+#define SOLVE_CHECKPOINT_MAGIC "MGSC"
+#define SOLVE_CHECKPOINT_VERSION 1
+#define SOLVE_CHECKPOINT_SECONDS 60
+#define SOLVE_FULL ((1ULL << SIZE) - 1)
+
+typedef struct
+{
+    uint64_t mask[2];   // cells of side 1 and side 2
+    int multiplier;
+    int side;           // side to move
+} SolvePosition;
+
+typedef struct
+{
+    uint64_t key;       // side 1's cells, multiplier, side and attacker; 0 when empty
+    uint64_t cells;     // side 2's cells
+    uint32_t pn, dn;    // pn 0: attacker wins; dn 0: attacker cannot win
+    uint32_t work;      // nodes searched below the entry, kept when replacing
+    uint32_t reserved;
+} SolveEntry;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    int32_t values[10];
+} SolveCheckpointHeader;
+
+typedef struct
+{
+    SolveEntry *table;
+    size_t buckets;            // a power of two
+    pthread_mutex_t locks[SOLVE_LOCKS];
+    atomic_int next_opening;
+    atomic_int stop;
+    atomic_ullong nodes;
+    int values[10];            // VALUE_* of each opening multiplier
+    pthread_mutex_t values_lock;
+} Solver;
+
+typedef struct
+{
+    int factor;
+    int terminal;              // decided by the move itself
+    SolvePosition position;
+    uint32_t pn, dn;
+} SolveChild;
+
+Solver *solver = NULL;
+uint64_t window_masks[54];
+int cell_windows[SIZE][16];    // windows through each cell, -1 terminated
+
+void solver_init_windows()
+{
+    for (int i = 0; i < SIZE; i++)
+        cell_windows[i][0] = -1;
+    for (int w = 0; w < search_window_count; w++)
+    {
+        window_masks[w] = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            int cell = search_windows[w][k];
+            int n = 0;
+            window_masks[w] |= 1ULL << cell;
+            while (cell_windows[cell][n] != -1)
+                n++;
+            cell_windows[cell][n] = w;
+            cell_windows[cell][n + 1] = -1;
+        }
+    }
+}
+
+static inline int mask_wins_at(uint64_t mask, int idx)
+{
+    for (const int *w = cell_windows[idx]; *w != -1; w++)
+    {
+        if ((mask & window_masks[*w]) == window_masks[*w])
+            return 1;
+    }
+    return 0;
+}
+
+static inline uint64_t solve_key(const SolvePosition *p, int attacker)
+{
+    return p->mask[0] | (uint64_t)p->multiplier << SIZE | (uint64_t)(p->side - 1) << (SIZE + 4) |
+           (uint64_t)(attacker - 1) << (SIZE + 5);
+}
+
+static inline uint32_t pn_add(uint32_t a, uint32_t b)
+{
+    return a >= PN_INF - b ? PN_INF : a + b;
+}
+
+int solve_lookup(Solver *s, const SolvePosition *p, int attacker, uint32_t *pn, uint32_t *dn, uint32_t *work)
+{
+    uint64_t key = solve_key(p, attacker);
+    size_t bucket = mix_seed(key, p->mask[1]) & (s->buckets - 1);
+    SolveEntry *entries = &s->table[bucket * SOLVE_BUCKET];
+    int found = 0;
+
+    pthread_mutex_lock(&s->locks[bucket % SOLVE_LOCKS]);
+    for (int i = 0; i < SOLVE_BUCKET && !found; i++)
+    {
+        if (entries[i].key == key && entries[i].cells == p->mask[1])
+        {
+            *pn = entries[i].pn;
+            *dn = entries[i].dn;
+            if (work)
+                *work = entries[i].work;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&s->locks[bucket % SOLVE_LOCKS]);
+    return found;
+}
+
+// Store an entry, replacing the bucket's entry with the least work behind it
+void solve_store_key(Solver *s, uint64_t key, uint64_t cells, uint32_t pn, uint32_t dn, uint32_t work)
+{
+    size_t bucket = mix_seed(key, cells) & (s->buckets - 1);
+    SolveEntry *entries = &s->table[bucket * SOLVE_BUCKET];
+    SolveEntry *victim = &entries[0];
+
+    pthread_mutex_lock(&s->locks[bucket % SOLVE_LOCKS]);
+    for (int i = 0; i < SOLVE_BUCKET; i++)
+    {
+        if (entries[i].key == key && entries[i].cells == cells)
+        {
+            victim = &entries[i];
+            break;
+        }
+        if (entries[i].key == 0 || entries[i].work < victim->work)
+            victim = &entries[i];
+        if (entries[i].key == 0)
+            break;
+    }
+    if (victim->key == key && victim->cells == cells && victim->work > work)
+        work = victim->work;
+    victim->key = key;
+    victim->cells = cells;
+    victim->pn = pn;
+    victim->dn = dn;
+    victim->work = work;
+    pthread_mutex_unlock(&s->locks[bucket % SOLVE_LOCKS]);
+}
+
+// The legal moves of a position and the positions they lead to; moves that
+// end the game get their final numbers for attacker. Returns how many.
+int solve_children(const SolvePosition *p, int attacker, SolveChild *children)
+{
+    int count = 0;
+    for (int factor = 1; factor <= 9; factor++)
+    {
+        int idx = product_cell[factor][p->multiplier];
+        if (idx == -1 || ((p->mask[0] | p->mask[1]) >> idx & 1))
+            continue;
+
+        SolveChild *child = &children[count++];
+        child->factor = factor;
+        child->position = *p;
+        child->position.mask[p->side - 1] |= 1ULL << idx;
+        child->position.multiplier = factor;
+        child->position.side = 3 - p->side;
+        child->terminal = 1;
+        if (mask_wins_at(child->position.mask[p->side - 1], idx))
+        {
+            child->pn = p->side == attacker ? 0 : PN_INF;
+            child->dn = p->side == attacker ? PN_INF : 0;
+        }
+        else if ((child->position.mask[0] | child->position.mask[1]) == SOLVE_FULL)
+        {
+            child->pn = PN_INF; // a full board is a draw
+            child->dn = 0;
+        }
+        else
+        {
+            child->terminal = 0;
+            child->pn = child->dn = 1;
+        }
+    }
+    return count;
+}
+
+// Multiple-iterative deepening of df-pn: search below p until its proof
+// number reaches thpn or its disproof number thdn. Returns the nodes searched.
+uint32_t solve_mid(Solver *s, const SolvePosition *p, int attacker, uint32_t thpn, uint32_t thdn,
+                   uint32_t *pn_out, uint32_t *dn_out)
+{
+    SolveChild children[9];
+    int count = solve_children(p, attacker, children);
+    int or_node = p->side == attacker;
+    uint32_t work = 1;
+    uint32_t pn = PN_INF, dn = 0; // no legal factor: a draw
+
+    atomic_fetch_add(&s->nodes, 1);
+    for (int i = 0; i < count; i++)
+    {
+        if (!children[i].terminal)
+            solve_lookup(s, &children[i].position, attacker, &children[i].pn, &children[i].dn, NULL);
+    }
+
+    while (count > 0)
+    {
+        // The node's numbers, its most proving child and the runner-up's number
+        int best = 0;
+        uint32_t second = PN_INF;
+        pn = or_node ? PN_INF : 0;
+        dn = or_node ? 0 : PN_INF;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t key_number = or_node ? children[i].pn : children[i].dn;
+            uint32_t best_number = or_node ? children[best].pn : children[best].dn;
+            if (or_node)
+            {
+                pn = children[i].pn < pn ? children[i].pn : pn;
+                dn = pn_add(dn, children[i].dn);
+            }
+            else
+            {
+                pn = pn_add(pn, children[i].pn);
+                dn = children[i].dn < dn ? children[i].dn : dn;
+            }
+            if (i > 0 && key_number < best_number)
+            {
+                second = best_number;
+                best = i;
+            }
+            else if (i > 0 && key_number < second)
+                second = key_number;
+        }
+        if (pn >= thpn || dn >= thdn || pn == 0 || dn == 0 || atomic_load(&s->stop))
+            break;
+
+        SolveChild *child = &children[best];
+        uint32_t child_pn, child_dn;
+        if (or_node)
+        {
+            child_pn = thpn < pn_add(second, 1) ? thpn : pn_add(second, 1);
+            child_dn = pn_add(thdn - dn, child->dn);
+        }
+        else
+        {
+            child_dn = thdn < pn_add(second, 1) ? thdn : pn_add(second, 1);
+            child_pn = pn_add(thpn - pn, child->pn);
+        }
+        work = pn_add(work, solve_mid(s, &child->position, attacker, child_pn, child_dn, &child->pn, &child->dn));
+    }
+
+    solve_store_key(s, solve_key(p, attacker), p->mask[1], pn, dn, work);
+    *pn_out = pn;
+    *dn_out = dn;
+    return work;
+}
+
+// Search p until the question is settled or the solver stops; returns 1 if settled
+int solve_position(Solver *s, const SolvePosition *p, int attacker, uint32_t *pn, uint32_t *dn)
+{
+    if (solve_lookup(s, p, attacker, pn, dn, NULL) && (*pn == 0 || *dn == 0))
+        return 1;
+    do
+        solve_mid(s, p, attacker, PN_INF, PN_INF, pn, dn);
+    while (*pn != 0 && *dn != 0 && !atomic_load(&s->stop));
+    return *pn == 0 || *dn == 0;
+}
+
+void *solve_worker(void *arg)
+{
+    Solver *s = arg;
+    for (;;)
+    {
+        int m = atomic_fetch_add(&s->next_opening, 1) + 1;
+        if (m > 9 || atomic_load(&s->stop))
+            break;
+        pthread_mutex_lock(&s->values_lock);
+        int known = s->values[m] != VALUE_UNKNOWN;
+        pthread_mutex_unlock(&s->values_lock);
+        if (known)
+            continue;
+
+        SolvePosition root = { {0, 0}, m, 1 };
+        uint32_t pn, dn;
+        int value = VALUE_UNKNOWN;
+        if (solve_position(s, &root, 1, &pn, &dn))
+        {
+            if (pn == 0)
+                value = VALUE_WIN;
+            else if (solve_position(s, &root, 2, &pn, &dn))
+                value = pn == 0 ? VALUE_LOSS : VALUE_DRAW;
+        }
+        if (value == VALUE_UNKNOWN)
+            break;
+
+        pthread_mutex_lock(&s->values_lock);
+        s->values[m] = value;
+        pthread_mutex_unlock(&s->values_lock);
+        printf("Opening %d: %s for the side moving first\n", m,
+               value == VALUE_WIN ? "win" : value == VALUE_LOSS ? "loss" : "draw");
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// Write the table and the solved openings; a bucket is locked while copied
+int save_solve_checkpoint(Solver *s, const char *path)
+{
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *fp = fopen(temp, "wb");
+    if (!fp)
+        return 0;
+
+    SolveCheckpointHeader header = { SOLVE_CHECKPOINT_MAGIC, SOLVE_CHECKPOINT_VERSION, 0, {0} };
+    pthread_mutex_lock(&s->values_lock);
+    for (int m = 0; m <= 9; m++)
+        header.values[m] = s->values[m];
+    pthread_mutex_unlock(&s->values_lock);
+    int written = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    for (size_t bucket = 0; bucket < s->buckets && written; bucket++)
+    {
+        SolveEntry entries[SOLVE_BUCKET];
+        pthread_mutex_lock(&s->locks[bucket % SOLVE_LOCKS]);
+        memcpy(entries, &s->table[bucket * SOLVE_BUCKET], sizeof(entries));
+        pthread_mutex_unlock(&s->locks[bucket % SOLVE_LOCKS]);
+        for (int i = 0; i < SOLVE_BUCKET; i++)
+        {
+            if (entries[i].key != 0 && written)
+            {
+                written = fwrite(&entries[i], sizeof(SolveEntry), 1, fp) == 1;
+                header.count++;
+            }
+        }
+    }
+    written = written && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+    return replace_file(fp, temp, path, written);
+}
+
+int load_solve_checkpoint(Solver *s, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    SolveCheckpointHeader header;
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, SOLVE_CHECKPOINT_MAGIC, 4) == 0 && header.version == SOLVE_CHECKPOINT_VERSION;
+    if (ok)
+    {
+        for (int m = 1; m <= 9; m++)
+            s->values[m] = header.values[m];
+        SolveEntry entry;
+        for (uint64_t i = 0; i < header.count && fread(&entry, sizeof(entry), 1, fp) == 1; i++)
+            solve_store_key(s, entry.key, entry.cells, entry.pn, entry.dn, entry.work);
+    }
+    fclose(fp);
+    return ok;
+}
+
+// Records of a book being built, and the positions already walked
+typedef struct
+{
+    BookRecord *records;
+    size_t count;
+    size_t capacity;
+    uint64_t *seen;            // pairs of solve_key and side 2's cells
+    size_t seen_count;
+    size_t seen_capacity;      // slots, a power of two
+} BookBuilder;
+
+// Mark a position visited; returns 0 if it already was
+int book_visit(BookBuilder *b, uint64_t key, uint64_t cells)
+{
+    if (2 * (b->seen_count + 1) > b->seen_capacity)
+    {
+        uint64_t *old = b->seen;
+        size_t old_capacity = b->seen_capacity;
+        b->seen_capacity = old_capacity ? 2 * old_capacity : 1 << 16;
+        b->seen = calloc(2 * b->seen_capacity, sizeof(uint64_t));
+        b->seen_count = 0;
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            if (old[2 * i] != 0)
+                book_visit(b, old[2 * i], old[2 * i + 1]);
+        }
+        free(old);
+    }
+
+    size_t slot = mix_seed(key, cells) & (b->seen_capacity - 1);
+    while (b->seen[2 * slot] != 0)
+    {
+        if (b->seen[2 * slot] == key && b->seen[2 * slot + 1] == cells)
+            return 0;
+        slot = (slot + 1) & (b->seen_capacity - 1);
+    }
+    b->seen[2 * slot] = key;
+    b->seen[2 * slot + 1] = cells;
+    b->seen_count++;
+    return 1;
+}
+
+void book_add(BookBuilder *b, const SolvePosition *p, int move, int value)
+{
+    if (b->count == b->capacity)
+    {
+        b->capacity = b->capacity ? 2 * b->capacity : 4096;
+        b->records = realloc(b->records, b->capacity * sizeof(BookRecord));
+    }
+    book_pack(&b->records[b->count++], p->mask, p->multiplier, p->side, move, value);
+}
+
+// Walk the proof (proof = 1) or disproof tree of attacker below p. Where the
+// winning side, or the side holding the draw, has to pick a move, that move
+// is recorded; every answer of the other side is walked. Numbers missing
+// from the table are searched again. Returns 0 if the solver was stopped.
+int book_collect(Solver *s, BookBuilder *b, const SolvePosition *p, int attacker, int proof)
+{
+    if (!book_visit(b, solve_key(p, attacker), p->mask[1]))
+        return 1;
+
+    SolveChild children[9];
+    int count = solve_children(p, attacker, children);
+    int chooser = (p->side == attacker) == proof; // the side to move picks one move
+
+    if (chooser)
+    {
+        // A move that settles the question at once, else one the table already
+        // settles, else search the moves until one does
+        int pick = -1;
+        for (int i = 0; i < count && pick == -1; i++)
+        {
+            if (children[i].terminal && (proof ? children[i].pn : children[i].dn) == 0)
+                pick = i;
+        }
+        for (int i = 0; i < count && pick == -1; i++)
+        {
+            if (!children[i].terminal && solve_lookup(s, &children[i].position, attacker, &children[i].pn, &children[i].dn, NULL) &&
+                (proof ? children[i].pn : children[i].dn) == 0)
+                pick = i;
+        }
+        for (int i = 0; i < count && pick == -1; i++)
+        {
+            if (children[i].terminal)
+                continue;
+            if (!solve_position(s, &children[i].position, attacker, &children[i].pn, &children[i].dn))
+                return 0;
+            if ((proof ? children[i].pn : children[i].dn) == 0)
+                pick = i;
+        }
+        if (pick == -1)
+            return 1; // cannot happen below a settled position
+
+        book_add(b, p, children[pick].factor, proof ? VALUE_WIN : VALUE_DRAW);
+        return children[pick].terminal || book_collect(s, b, &children[pick].position, attacker, proof);
+    }
+
+    // Every answer is walked; in a lost position the book defends with the one
+    // whose refutation took the most work
+    int defence = -1;
+    uint32_t most_work = 0;
+    for (int i = 0; i < count; i++)
+    {
+        SolveChild *child = &children[i];
+        uint32_t work = 0;
+        if (child->terminal)
+            continue;
+        if (!solve_position(s, &child->position, attacker, &child->pn, &child->dn) ||
+            !book_collect(s, b, &child->position, attacker, proof))
+            return 0;
+        solve_lookup(s, &child->position, attacker, &child->pn, &child->dn, &work);
+        if (defence == -1 || work > most_work)
+        {
+            defence = i;
+            most_work = work;
+        }
+    }
+    if (proof && defence != -1)
+        book_add(b, p, children[defence].factor, VALUE_LOSS);
+    return 1;
+}
+
+// Build the book of every solved opening and write it to path
+int write_book(Solver *s, const char *path)
+{
+    BookBuilder b;
+    memset(&b, 0, sizeof(b));
+
+    for (int m = 1; m <= 9; m++)
+    {
+        SolvePosition root = { {0, 0}, m, 1 };
+        int ok = 1;
+        if (s->values[m] == VALUE_WIN)
+            ok = book_collect(s, &b, &root, 1, 1);
+        else if (s->values[m] == VALUE_LOSS)
+            ok = book_collect(s, &b, &root, 2, 1);
+        else if (s->values[m] == VALUE_DRAW)
+            ok = book_collect(s, &b, &root, 1, 0) && book_collect(s, &b, &root, 2, 0);
+        if (!ok)
+        {
+            free(b.records);
+            free(b.seen);
+            return 0;
+        }
+    }
+    free(b.seen);
+
+    // One record per position, keeping the best value (VALUE_WIN is lowest)
+    qsort(b.records, b.count, sizeof(BookRecord), compare_book_records);
+    size_t unique = 0;
+    for (size_t i = 0; i < b.count; i++)
+    {
+        if (unique > 0 && compare_book_records(&b.records[unique - 1], &b.records[i]) == 0)
+        {
+            if ((b.records[i].words[2] >> 17 & 3) < (b.records[unique - 1].words[2] >> 17 & 3))
+                b.records[unique - 1] = b.records[i];
+            continue;
+        }
+        b.records[unique++] = b.records[i];
+    }
+
+    BookHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_MAGIC, 4);
+    header.version = BOOK_VERSION;
+    header.count = (uint32_t)unique;
+    for (int m = 1; m <= 9; m++)
+        header.values[m] = (uint8_t)s->values[m];
+
+    // Written aside and renamed, so an interrupted write leaves the old book
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *fp = fopen(temp, "wb");
+    int ok = fp != NULL;
+    if (fp)
+    {
+        int written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                      fwrite(b.records, sizeof(BookRecord), unique, fp) == unique;
+        ok = replace_file(fp, temp, path, written);
+    }
+    free(b.records);
+    if (ok)
+        printf("Book of %zu positions (%zu bytes) written to %s\n", unique,
+               sizeof(header) + unique * sizeof(BookRecord), path);
+    else
+        printf("Could not write the book %s\n", path);
+    return ok;
+}
+
+void solve_interrupt(int signal_number)
+{
+    (void)signal_number;
+    if (solver)
+        atomic_store(&solver->stop, 1);
+}
+
+// Solve the openings on all threads with a hash_mb table, resuming from and
+// checkpointing to checkpoint, for at most seconds (0 for no limit), then
+// write the book of whatever is solved
+int solve(int threads, int hash_mb, int seconds, const char *checkpoint, const char *book_path)
+{
+    solver = calloc(1, sizeof(Solver));
+    solver->buckets = 1;
+    while ((solver->buckets * 2) * SOLVE_BUCKET * sizeof(SolveEntry) <= (size_t)hash_mb << 20)
+        solver->buckets *= 2;
+    solver->table = calloc(solver->buckets * SOLVE_BUCKET, sizeof(SolveEntry));
+    if (!solver->table)
+    {
+        printf("Could not allocate a %d MB table\n", hash_mb);
+        return 0;
+    }
+    for (int i = 0; i < SOLVE_LOCKS; i++)
+        pthread_mutex_init(&solver->locks[i], NULL);
+    pthread_mutex_init(&solver->values_lock, NULL);
+    solver_init_windows();
+
+    if (load_solve_checkpoint(solver, checkpoint))
+        printf("Resuming from %s\n", checkpoint);
+    printf("Solving the openings on %d threads with a %zu MB table (Ctrl+C saves a checkpoint)\n", threads,
+           solver->buckets * SOLVE_BUCKET * sizeof(SolveEntry) >> 20);
+    signal(SIGINT, solve_interrupt);
+
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    for (int t = 0; t < threads; t++)
+        pthread_create(&workers[t], NULL, solve_worker, solver);
+
+    // Wait, checkpointing now and then, until every opening is settled or we stop
+    unsigned long long start = perf_now(), last_checkpoint = start;
+    for (;;)
+    {
+        int settled = 0;
+        pthread_mutex_lock(&solver->values_lock);
+        for (int m = 1; m <= 9; m++)
+            settled += solver->values[m] != VALUE_UNKNOWN;
+        pthread_mutex_unlock(&solver->values_lock);
+        if (settled == 9 || atomic_load(&solver->stop))
+            break;
+        if (atomic_load(&solver->next_opening) >= 9 + threads)
+            break; // every worker has left the queue
+
+        sleep(1);
+        unsigned long long now = perf_now();
+        if (seconds > 0 && now - start >= seconds * 1000000000ULL)
+            atomic_store(&solver->stop, 1);
+        if (now - last_checkpoint >= SOLVE_CHECKPOINT_SECONDS * 1000000000ULL)
+        {
+            save_solve_checkpoint(solver, checkpoint);
+            last_checkpoint = now;
+            printf("Checkpoint: %llu nodes, %d of 9 openings solved\n",
+                   (unsigned long long)atomic_load(&solver->nodes), settled);
+            fflush(stdout);
+        }
+    }
+    for (int t = 0; t < threads; t++)
+        pthread_join(workers[t], NULL);
+    free(workers);
+    signal(SIGINT, SIG_DFL);
+
+    int stopped = atomic_load(&solver->stop);
+    printf("%s after %.1f s, about %llu nodes\n", stopped ? "Stopped" : "Done", (perf_now() - start) / 1e9,
+           (unsigned long long)atomic_load(&solver->nodes));
+    atomic_store(&solver->stop, 0);
+    int ok = save_solve_checkpoint(solver, checkpoint);
+    if (!ok)
+        printf("Could not write the checkpoint %s\n", checkpoint);
+    if (!stopped)
+        ok &= write_book(solver, book_path);
+    return ok;
+}
+
+// Display CPU register state
+void display_registers()
+{
+    printf("CPU State:\n");
+    printf("regA: %d\n", cpu.regA);
+    printf("regB: %d\n", cpu.regB);
+    printf("acc: %d\n", cpu.acc);
+}
+
+// Directory holding the save slots and their index, created on first use
+const char *save_dir()
+{
+    static char dir[512];
+    if (dir[0])
+        return dir;
+
+#ifdef _WIN32
+    const char *base = getenv("LOCALAPPDATA"); // same place as GLib's user data dir
+    snprintf(dir, sizeof(dir), "%s\\multiplication-game", base ? base : ".");
+    mkdir(dir);
+    strncat(dir, "\\saves", sizeof(dir) - strlen(dir) - 1);
+    mkdir(dir);
+#else
+    const char *data_home = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    if (data_home && data_home[0])
+        snprintf(dir, sizeof(dir), "%s/multiplication-game/saves", data_home);
+    else
+        snprintf(dir, sizeof(dir), "%s/.local/share/multiplication-game/saves", home ? home : ".");
+
+    // mkdir -p
+    for (char *p = dir + 1; *p; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            mkdir(dir, 0755);
+            *p = '/';
+        }
+    }
+    mkdir(dir, 0755);
+#endif
+    return dir;
+}
+
+// Slot names become file names, so only letters, digits, '-' and '_' are allowed
+int valid_slot_name(const char *slot)
+{
+    size_t length = strlen(slot);
+    if (length == 0 || length >= SLOT_NAME_MAX)
+        return 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = slot[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+            return 0;
+    }
+    return 1;
+}
+
+void slot_path(char *path, size_t size, const char *slot)
+{
+    snprintf(path, size, "%s/%s%s", save_dir(), slot, SLOT_SUFFIX);
+}
+
+void index_path(char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s", save_dir(), INDEX_FILE);
+}
+
+// Fill an index record from a game state
+void slot_info_fill(SlotInfo *info, const char *slot, const int *moves, int p_score, int c_score,
+                    int choice, int over, int64_t saved_at)
+{
+    memset(info, 0, sizeof(*info));
+    strncpy(info->name, slot, SLOT_NAME_MAX - 1);
+    info->saved_at = saved_at;
+    info->player_score = p_score;
+    info->computer_score = c_score;
+    info->com_choice = choice;
+    info->game_over = (uint8_t)over;
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (moves[i] != 0)
+            info->move_count++;
+        info->thumbnail[i / 4] |= (uint8_t)((moves[i] & 3) << ((i % 4) * 2));
+    }
+}
+
+// Owner of a cell in an index record's thumbnail (0=none, 1=player, 2=computer)
+int slot_thumbnail_cell(const SlotInfo *info, int idx)
+{
+    return (info->thumbnail[idx / 4] >> ((idx % 4) * 2)) & 3;
+}
+
+// Read the index record of a slot directly from its save file
+int slot_info_from_file(SlotInfo *info, const char *slot)
+{
+    char path[600];
+    slot_path(path, sizeof(path), slot);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    int moves[SIZE];
+    int header[4];
+    int ok = fread(moves, sizeof(int), SIZE, fp) == SIZE && fread(header, sizeof(int), 4, fp) == 4;
+    fclose(fp);
+    if (!ok)
+        return 0;
+
+    struct stat st;
+    int64_t saved_at = stat(path, &st) == 0 ? (int64_t)st.st_mtime : 0;
+    slot_info_fill(info, slot, moves, header[0], header[1], header[2], header[3], saved_at);
+    return 1;
+}
+
+// Rewrite the index from the slot files on disk (used when it is missing or corrupt)
+int rebuild_index()
+{
+    DIR *dir = opendir(save_dir());
+    if (!dir)
+        return 0;
+
+    int count = 0, capacity = 64;
+    SlotInfo *slots = malloc(capacity * sizeof(SlotInfo));
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char slot[SLOT_NAME_MAX + sizeof(SLOT_SUFFIX)];
+        size_t length = strlen(entry->d_name);
+        size_t suffix = strlen(SLOT_SUFFIX);
+        if (length <= suffix || length - suffix >= SLOT_NAME_MAX ||
+                strcmp(entry->d_name + length - suffix, SLOT_SUFFIX) != 0)
+            continue;
+        memcpy(slot, entry->d_name, length - suffix);
+        slot[length - suffix] = '\0';
+        if (!valid_slot_name(slot))
+            continue;
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            slots = realloc(slots, capacity * sizeof(SlotInfo));
+        }
+        if (slot_info_from_file(&slots[count], slot))
+            count++;
+    }
+    closedir(dir);
+
+    char path[600], temp[610];
+    index_path(path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    FILE *fp = fopen(temp, "wb");
+    if (!fp)
+    {
+        free(slots);
+        return 0;
+    }
+    SlotIndexHeader header = { INDEX_MAGIC, INDEX_VERSION, (uint32_t)count, sizeof(SlotInfo) };
+    int written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                  fwrite(slots, sizeof(SlotInfo), count, fp) == (size_t)count;
+    free(slots);
+    return replace_file(fp, temp, path, written);
+}
+
+// Open the index, checking its header; returns NULL if it is missing or corrupt
+FILE *open_index(const char *mode, SlotIndexHeader *header)
+{
+    char path[600];
+    index_path(path, sizeof(path));
+
+    FILE *fp = fopen(path, mode);
+    if (!fp)
+        return NULL;
+
+    long expected;
+    if (fread(header, sizeof(*header), 1, fp) != 1 ||
+            memcmp(header->magic, INDEX_MAGIC, 4) != 0 ||
+            header->version != INDEX_VERSION ||
+            header->record_size != sizeof(SlotInfo) ||
+            fseek(fp, 0, SEEK_END) != 0 ||
+            (expected = (long)(sizeof(*header) + (long)header->count * sizeof(SlotInfo))) != ftell(fp))
+    {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// Update one slot's index record in place, or append it
+int update_index(const SlotInfo *info)
+{
+    SlotIndexHeader header;
+    FILE *fp = open_index("r+b", &header);
+    if (!fp)
+        return rebuild_index();
+
+    uint32_t position = header.count;
+    SlotInfo record;
+    fseek(fp, sizeof(header), SEEK_SET);
+    for (uint32_t i = 0; i < header.count && fread(&record, sizeof(record), 1, fp) == 1; i++)
+    {
+        if (strncmp(record.name, info->name, SLOT_NAME_MAX) == 0)
+        {
+            position = i;
+            break;
+        }
+    }
+
+    fseek(fp, (long)(sizeof(header) + position * sizeof(SlotInfo)), SEEK_SET);
+    int ok = fwrite(info, sizeof(*info), 1, fp) == 1;
+    if (ok && position == header.count)
+    {
+        header.count++;
+        fseek(fp, 0, SEEK_SET);
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    }
+    fclose(fp);
+    return ok;
+}
+
+// Read every index record, rebuilding the index first if it is unusable
+SlotInfo *read_index(int *count)
+{
+    SlotIndexHeader header;
+    FILE *fp = open_index("rb", &header);
+    if (!fp)
+    {
+        rebuild_index();
+        fp = open_index("rb", &header);
+        if (!fp)
+        {
+            *count = 0;
+            return NULL;
+        }
+    }
+
+    SlotInfo *slots = malloc((header.count ? header.count : 1) * sizeof(SlotInfo));
+    if (!slots)
+    {
+        fclose(fp);
+        *count = 0;
+        return NULL;
+    }
+    fseek(fp, sizeof(header), SEEK_SET);
+    int read = (int)fread(slots, sizeof(SlotInfo), header.count, fp);
+    fclose(fp);
+
+    // Names become file paths; drop records whose name is unterminated or invalid
+    *count = 0;
+    for (int i = 0; i < read; i++)
+    {
+        if (memchr(slots[i].name, '\0', SLOT_NAME_MAX) != NULL && valid_slot_name(slots[i].name))
+            slots[(*count)++] = slots[i];
+    }
+    return slots;
+}
+
+// Print the saved slots from the index
+void list_saves()
+{
+    int count;
+    SlotInfo *slots = read_index(&count);
+
+    printf("Saves in %s:\n", save_dir());
+    if (count == 0)
+        printf("  (none)\n");
+    for (int i = 0; i < count; i++)
+    {
+        char when[32];
+        time_t saved_at = (time_t)slots[i].saved_at;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&saved_at));
+
+        char board_text[SIZE + 1];
+        for (int c = 0; c < SIZE; c++)
+            board_text[c] = ".PC?"[slot_thumbnail_cell(&slots[i], c)];
+        board_text[SIZE] = '\0';
+
+        printf("  %-20s %s  Player %d - Computer %d  %2d moves%s  %s\n", slots[i].name, when,
+               slots[i].player_score, slots[i].computer_score, slots[i].move_count,
+               slots[i].game_over ? " (over)" : "", board_text);
+    }
+    free(slots);
+}
+
+// Match history (matches.log in the save directory): every game finished in
+// play is appended as a fixed-size, checksummed record and never rewritten.
+// matches.idx indexes a prefix of the log: per-player totals sorted by name,
+// the players in leaderboard order, and each player's record numbers grouped
+// together, so a leaderboard or a player's history reads a few hundred bytes
+// whatever the size of the log. Records past the indexed prefix (the tail)
+// are scanned on open and merged in; once the tail reaches MATCH_COMPACT_TAIL
+// records it is compacted into a new index, written next to the old one and
+// renamed over it. A torn record at the end of the log is overwritten by the
+// next append and records failing their checksum are left out of the index.
+// The console and the GUI share these files, so appends and compactions hold
+// an advisory lock on matches.lock.
+#define MATCH_LOG_FILE "matches.log"
+#define MATCH_INDEX_FILE "matches.idx"
+#define MATCH_LOCK_FILE "matches.lock"
+#define MATCH_LOG_MAGIC "MGML"
+#define MATCH_INDEX_MAGIC "MGMX"
+#define MATCH_VERSION 1
+#define MATCH_NAME_MAX 32
+#define MATCH_COMPACT_TAIL 1024
+#define MATCH_SCAN_TAIL 65536 // tail held while indexing a long unindexed log
+#define MATCH_FULL_MOVES 1 // factors holds every move of the game
+#define MATCH_OWNERS 2     // owners says who made each move
+#define LEADERBOARD_SIZE 10
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+} MatchLogHeader;
+
+typedef struct
+{
+    char player[MATCH_NAME_MAX];
+    int64_t finished_at;  // seconds since the epoch
+    uint64_t seed;        // the session's game seed
+    uint32_t duration_ms;
+    int8_t result;        // 1 the player won, 0 draw, -1 the computer won
+    uint8_t move_count;   // stones on the final board
+    uint8_t level;
+    uint8_t flags;        // MATCH_FULL_MOVES, MATCH_OWNERS
+    uint8_t opening;      // the computer's first multiplier
+    uint8_t factors[18];  // factor of each move, two per byte, low nibble first
+    uint8_t owners[5];    // bit i set if move i was the computer's
+    uint8_t reserved[4];
+    uint32_t checksum;    // FNV-1a of the bytes above
+} MatchRecord;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t log_records;  // records of the log covered by the index
+    uint32_t player_count;
+    uint32_t reserved;
+} MatchIndexHeader;
+
+typedef struct
+{
+    char name[MATCH_NAME_MAX];
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+    uint32_t first;        // position of the player's first record number
+    uint32_t match_count;  // record numbers belonging to the player
+    uint32_t reserved;
+    int64_t last_played;
+} MatchPlayer;
+
+_Static_assert(sizeof(MatchRecord) == 88, "MatchRecord is part of the log format");
+_Static_assert(sizeof(MatchPlayer) == 64, "MatchPlayer is part of the index format");
+
+// The index in memory plus the log's unindexed tail
+typedef struct
+{
+    MatchIndexHeader header;
+    MatchPlayer *players;   // sorted by name
+    uint32_t *ranking;      // players in leaderboard order
+    MatchRecord *tail;
+    uint32_t *tail_numbers; // log record number of each tail record
+    size_t tail_count;
+    size_t tail_capacity;
+    uint64_t scanned;       // log records read so far, indexed or in the tail
+    uint64_t index_records; // log_records of the index file as read, to notice another compaction
+} MatchStore;
+
+char player_name[MATCH_NAME_MAX] = "player"; // --name
+int match_live = 0;                   // the game in play is recorded when it ends
+unsigned long long match_started = 0; // perf_now() when it started
+
+void match_path(char *path, size_t size, const char *file)
+{
+    snprintf(path, size, "%s/%s", save_dir(), file);
+}
+
+// Take the lock serializing writers of the log and index across processes.
+// Returns a descriptor for match_unlock, or -1 if the lock file cannot be
+// opened, in which case the caller goes ahead unlocked.
+int match_lock()
+{
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOCK_FILE);
+#ifdef _WIN32
+    int fd = _open(path, _O_RDWR | _O_CREAT, _S_IREAD | _S_IWRITE);
+    if (fd == -1)
+        return -1;
+    while (_locking(fd, _LK_LOCK, 1) != 0)
+        ;
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd == -1)
+        return -1;
+    while (flock(fd, LOCK_EX) != 0 && errno == EINTR)
+        ;
+#endif
+    return fd;
+}
+
+void match_unlock(int fd)
+{
+    if (fd == -1)
+        return;
+#ifdef _WIN32
+    _lseek(fd, 0, SEEK_SET);
+    _locking(fd, _LK_UNLCK, 1);
+    _close(fd);
+#else
+    close(fd); // releases the flock
+#endif
+}
+
+// log_records of the index file on disk, 0 if it is missing or unusable
+uint64_t match_index_records()
+{
+    char path[600];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    FILE *fp = fopen(path, "rb");
+    MatchIndexHeader header;
+    int ok = fp && fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, MATCH_INDEX_MAGIC, 4) == 0 && header.version == MATCH_VERSION;
+    if (fp)
+        fclose(fp);
+    return ok ? header.log_records : 0;
+}
+
+uint32_t match_checksum(const MatchRecord *record)
+{
+    return (uint32_t)content_hash((const unsigned char *)record, offsetof(MatchRecord, checksum));
+}
+
+// Leaderboard order: most wins, then fewest losses, then name
+int compare_standing(const MatchPlayer *a, const MatchPlayer *b)
+{
+    if (a->wins != b->wins)
+        return a->wins > b->wins ? -1 : 1;
+    if (a->losses != b->losses)
+        return a->losses < b->losses ? -1 : 1;
+    return strncmp(a->name, b->name, MATCH_NAME_MAX);
+}
+
+// Players of the store being ranked, for the qsort comparator below
+static const MatchPlayer *ranking_players;
+
+int compare_ranking(const void *a, const void *b)
+{
+    return compare_standing(&ranking_players[*(const uint32_t *)a], &ranking_players[*(const uint32_t *)b]);
+}
+
+int compare_players(const void *a, const void *b)
+{
+    return compare_standing((const MatchPlayer *)a, (const MatchPlayer *)b);
+}
+
+// Index of name among the sorted players, or -1
+int find_match_player(const MatchPlayer *players, uint32_t count, const char *name)
+{
+    uint32_t lo = 0, hi = count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = strncmp(players[mid].name, name, MATCH_NAME_MAX);
+        if (c == 0)
+            return (int)mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+// Add a record's result to a player's totals
+void match_count_result(MatchPlayer *player, const MatchRecord *record)
+{
+    if (record->result > 0)
+        player->wins++;
+    else if (record->result < 0)
+        player->losses++;
+    else
+        player->draws++;
+    player->match_count++;
+    if (record->finished_at > player->last_played)
+        player->last_played = record->finished_at;
+}
+
+// Read the index; a missing or unusable one leaves the store empty
+void load_match_index(MatchStore *store)
+{
+    char path[600];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    memset(&store->header, 0, sizeof(store->header));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return;
+    MatchIndexHeader header;
+    uint32_t count = 0;
+    if (fread(&header, sizeof(header), 1, fp) == 1 &&
+            memcmp(header.magic, MATCH_INDEX_MAGIC, 4) == 0 && header.version == MATCH_VERSION)
+    {
+        store->index_records = header.log_records;
+        count = header.player_count;
+        store->players = malloc((count ? count : 1) * sizeof(MatchPlayer));
+        store->ranking = malloc((count ? count : 1) * sizeof(uint32_t));
+        if (fread(store->players, sizeof(MatchPlayer), count, fp) == count &&
+                fread(store->ranking, sizeof(uint32_t), count, fp) == count)
+            store->header = header;
+        else
+            store->header.player_count = 0;
+    }
+    fclose(fp);
+}
+
+int match_compact(MatchStore *store);
+
+// Append a record to the tail. A log far ahead of its index (a lost index, or
+// records written by an older version) is indexed in MATCH_SCAN_TAIL chunks.
+void match_add_tail(MatchStore *store, const MatchRecord *record, uint32_t number)
+{
+    // If another process got there first the tail just keeps growing
+    if (store->tail_count == MATCH_SCAN_TAIL)
+        match_compact(store);
+    if (store->tail_count == store->tail_capacity)
+    {
+        store->tail_capacity = store->tail_capacity ? store->tail_capacity * 2 : MATCH_COMPACT_TAIL;
+        store->tail = realloc(store->tail, store->tail_capacity * sizeof(MatchRecord));
+        store->tail_numbers = realloc(store->tail_numbers, store->tail_capacity * sizeof(uint32_t));
+    }
+    store->tail[store->tail_count] = *record;
+    store->tail_numbers[store->tail_count++] = number;
+}
+
+// Open the store: the index, then every log record past it
+MatchStore *match_store_open()
+{
+    MatchStore *store = calloc(1, sizeof(MatchStore));
+    load_match_index(store);
+
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    FILE *fp = fopen(path, "rb");
+    MatchLogHeader header;
+    if (!fp || fread(&header, sizeof(header), 1, fp) != 1 ||
+            memcmp(header.magic, MATCH_LOG_MAGIC, 4) != 0 || header.version != MATCH_VERSION ||
+            header.record_size != sizeof(MatchRecord))
+    {
+        // No usable log: nothing the index says can be trusted either
+        if (fp)
+            fclose(fp);
+        free(store->players);
+        free(store->ranking);
+        store->players = NULL;
+        store->ranking = NULL;
+        memset(&store->header, 0, sizeof(store->header));
+        return store;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    uint64_t log_records = (uint64_t)(ftell(fp) - (long)sizeof(header)) / sizeof(MatchRecord);
+    if (store->header.log_records > log_records)
+    {
+        // The log was replaced behind the index's back; index it again
+        free(store->players);
+        free(store->ranking);
+        store->players = NULL;
+        store->ranking = NULL;
+        memset(&store->header, 0, sizeof(store->header));
+    }
+
+    store->scanned = store->header.log_records;
+    fseek(fp, (long)(sizeof(header) + store->scanned * sizeof(MatchRecord)), SEEK_SET);
+    MatchRecord record;
+    while (store->scanned < log_records && fread(&record, sizeof(record), 1, fp) == 1)
+    {
+        if (record.checksum == match_checksum(&record))
+            match_add_tail(store, &record, (uint32_t)store->scanned);
+        store->scanned++;
+    }
+    fclose(fp);
+    return store;
+}
+
+void match_store_close(MatchStore *store)
+{
+    if (!store)
+        return;
+    free(store->players);
+    free(store->ranking);
+    free(store->tail);
+    free(store->tail_numbers);
+    free(store);
+}
+
+// Tail records in player order, then log order
+static const MatchRecord *sorting_tail;
+
+int compare_tail(const void *a, const void *b)
+{
+    uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+    int c = strncmp(sorting_tail[i].player, sorting_tail[j].player, MATCH_NAME_MAX);
+    return c != 0 ? c : (i > j) - (i < j);
+}
+
+// Merge the tail into a new index and replace the old one with it. The old
+// index's record numbers are streamed across player by player with the new
+// ones added after them, so the cost is one pass over the index. Fails,
+// leaving the store as it was, if another process compacted since the store
+// was opened.
+int match_compact(MatchStore *store)
+{
+    char path[600], temp[610];
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    int lock = match_lock();
+    if (match_index_records() != store->index_records)
+    {
+        match_unlock(lock);
+        return 0;
+    }
+
+    uint32_t *order = malloc((store->tail_count ? store->tail_count : 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < store->tail_count; i++)
+        order[i] = (uint32_t)i;
+    sorting_tail = store->tail;
+    qsort(order, store->tail_count, sizeof(uint32_t), compare_tail);
+
+    // Merge the sorted player lists
+    uint32_t old_count = store->header.player_count;
+    uint32_t capacity = old_count + (uint32_t)store->tail_count;
+    MatchPlayer *players = calloc(capacity ? capacity : 1, sizeof(MatchPlayer));
+    uint32_t *old_of = malloc((capacity ? capacity : 1) * sizeof(uint32_t));   // old player or UINT32_MAX
+    uint32_t *tail_of = malloc((capacity ? capacity : 1) * sizeof(uint32_t));  // first position in order
+    uint32_t count = 0, p = 0;
+    size_t t = 0;
+    while (p < old_count || t < store->tail_count)
+    {
+        const char *tail_name = t < store->tail_count ? store->tail[order[t]].player : NULL;
+        int c = p == old_count ? 1 : !tail_name ? -1 :
+                strncmp(store->players[p].name, tail_name, MATCH_NAME_MAX);
+        MatchPlayer *player = &players[count];
+        old_of[count] = UINT32_MAX;
+        tail_of[count] = UINT32_MAX;
+        if (c <= 0)
+        {
+            *player = store->players[p];
+            old_of[count] = p++;
+        }
+        else
+            memcpy(player->name, tail_name, MATCH_NAME_MAX);
+        if (c >= 0)
+        {
+            tail_of[count] = (uint32_t)t;
+            for (; t < store->tail_count &&
+                   strncmp(store->tail[order[t]].player, player->name, MATCH_NAME_MAX) == 0; t++)
+                match_count_result(player, &store->tail[order[t]]);
+        }
+        count++;
+    }
+
+    MatchIndexHeader header = { MATCH_INDEX_MAGIC, MATCH_VERSION, store->scanned, count, 0 };
+    uint32_t *ranking = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ranking[i] = i;
+        players[i].first = first;
+        first += players[i].match_count;
+    }
+    ranking_players = players;
+    qsort(ranking, count, sizeof(uint32_t), compare_ranking);
+
+    FILE *in = NULL;
+    if (old_count)
+    {
+        in = fopen(path, "rb");
+        if (in)
+            fseek(in, (long)(sizeof(MatchIndexHeader) + old_count * (sizeof(MatchPlayer) + sizeof(uint32_t))), SEEK_SET);
+    }
+    FILE *out = fopen(temp, "wb");
+    int ok = out != NULL && (old_count == 0 || in != NULL);
+    if (ok)
+    {
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+             fwrite(players, sizeof(MatchPlayer), count, out) == count &&
+             fwrite(ranking, sizeof(uint32_t), count, out) == count;
+        uint32_t buffer[1024];
+        for (uint32_t i = 0; ok && i < count; i++)
+        {
+            // The old record numbers are stored in player order, so they are read in sequence
+            if (old_of[i] != UINT32_MAX)
+            {
+                for (uint32_t left = store->players[old_of[i]].match_count; ok && left > 0;)
+                {
+                    uint32_t chunk = left < 1024 ? left : 1024;
+                    ok = fread(buffer, sizeof(uint32_t), chunk, in) == chunk &&
+                         fwrite(buffer, sizeof(uint32_t), chunk, out) == chunk;
+                    left -= chunk;
+                }
+            }
+            if (tail_of[i] != UINT32_MAX)
+            {
+                for (size_t j = tail_of[i]; ok && j < store->tail_count &&
+                     strncmp(store->tail[order[j]].player, players[i].name, MATCH_NAME_MAX) == 0; j++)
+                    ok = fwrite(&store->tail_numbers[order[j]], sizeof(uint32_t), 1, out) == 1;
+            }
+        }
+    }
+    if (in)
+        fclose(in);
+    free(order);
+    free(old_of);
+    free(tail_of);
+
+    if (out)
+        ok = replace_file(out, temp, path, ok);
+    match_unlock(lock);
+    if (!ok)
+    {
+        free(players);
+        free(ranking);
+        return 0;
+    }
+
+    free(store->players);
+    free(store->ranking);
+    store->players = players;
+    store->ranking = ranking;
+    store->header = header;
+    store->index_records = header.log_records;
+    store->tail_count = 0;
+    return 1;
+}
+
+// Append a finished match to the log, compacting the index when the tail is full
+int match_append(MatchRecord *record)
+{
+    record->checksum = match_checksum(record);
+
+    char path[600];
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    int lock = match_lock();
+    FILE *fp = fopen(path, "r+b");
+    MatchLogHeader header = { MATCH_LOG_MAGIC, MATCH_VERSION, sizeof(MatchRecord), 0 }, existing;
+    if (fp && (fread(&existing, sizeof(existing), 1, fp) != 1 || memcmp(&existing, &header, sizeof(header)) != 0))
+    {
+        // Not a log this version can read: keep it aside and start a new one
+        char aside[640];
+        snprintf(aside, sizeof(aside), "%s.%lld.bad", path, (long long)time(NULL));
+        fclose(fp);
+        fp = NULL;
+        if (rename(path, aside) != 0)
+        {
+            fprintf(stderr, "Cannot read or move aside the match history %s\n", path);
+            match_unlock(lock);
+            return 0;
+        }
+        fprintf(stderr, "The match history was unreadable; moved it to %s\n", aside);
+    }
+    if (!fp)
+    {
+        fp = fopen(path, "wb");
+        if (!fp || fwrite(&header, sizeof(header), 1, fp) != 1)
+        {
+            if (fp)
+                fclose(fp);
+            match_unlock(lock);
+            return 0;
+        }
+    }
+
+    // Start at the end of the last whole record, over any torn write
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    uint64_t records = (uint64_t)(size - (long)sizeof(header)) / sizeof(MatchRecord);
+    fseek(fp, (long)(sizeof(header) + records * sizeof(MatchRecord)), SEEK_SET);
+    int ok = fwrite(record, sizeof(*record), 1, fp) == 1;
+    if (fclose(fp) != 0)
+        ok = 0;
+    match_unlock(lock);
+
+    // Compact once the unindexed tail is full (match_compact takes the lock again)
+    if (ok && records + 1 - match_index_records() >= MATCH_COMPACT_TAIL)
+    {
+        MatchStore *store = match_store_open();
+        match_compact(store);
+        match_store_close(store);
+    }
+    return ok;
+}
+
+// Fill a record of the interactive game that just ended
+void match_fill(MatchRecord *record, int result)
+{
+    memset(record, 0, sizeof(*record));
+    snprintf(record->player, MATCH_NAME_MAX, "%s", player_name);
+    record->finished_at = (int64_t)time(NULL);
+    record->seed = game_seed;
+    record->duration_ms = match_started ? (uint32_t)((perf_now() - match_started) / 1000000) : 0;
+    record->result = (int8_t)result;
+    record->level = (uint8_t)difficulty;
+
+    int stones = 0;
+    for (int i = 0; i < SIZE; i++)
+        stones += player_moves[i] != 0;
+    record->move_count = (uint8_t)stones;
+
+    // Loaded games have no history from the start, so only their end is known
+    if (history.count == stones && stones > 0)
+    {
+        record->flags |= MATCH_FULL_MOVES | MATCH_OWNERS;
+        record->opening = history.moves[0].prev_multiplier;
+        for (int i = 0; i < history.count; i++)
+        {
+            record->factors[i / 2] |= (uint8_t)(history.moves[i].factor << (i % 2 * 4));
+            if (history.moves[i].owner == 2)
+                record->owners[i / 8] |= (uint8_t)(1 << (i % 8));
+        }
+    }
+}
+
+// Record the interactive game's result (1 player won, 0 draw, -1 computer won)
+void record_match(int result)
+{
+    if (!match_live)
+        return;
+    match_live = 0;
+    MatchRecord record;
+    match_fill(&record, result);
+    if (!match_append(&record))
+        printf("Error writing the match history!\n");
+}
+
+// Up to n players in leaderboard order, counting the tail; returns how many
+int match_leaderboard(const MatchStore *store, MatchPlayer *out, int n)
+{
+    // Totals of the players with matches in the tail
+    MatchPlayer *changed = calloc(store->tail_count ? store->tail_count : 1, sizeof(MatchPlayer));
+    size_t changed_count = 0;
+    for (size_t i = 0; i < store->tail_count; i++)
+    {
+        const MatchRecord *record = &store->tail[i];
+        size_t j = 0;
+        while (j < changed_count && strncmp(changed[j].name, record->player, MATCH_NAME_MAX) != 0)
+            j++;
+        if (j == changed_count)
+        {
+            int old = find_match_player(store->players, store->header.player_count, record->player);
+            if (old >= 0)
+                changed[j] = store->players[old];
+            else
+                memcpy(changed[j].name, record->player, MATCH_NAME_MAX);
+            changed_count++;
+        }
+        match_count_result(&changed[j], record);
+    }
+
+    // Players untouched by the tail keep their order, so only the first n of
+    // them can still make the board
+    MatchPlayer *candidates = malloc((n + changed_count + 1) * sizeof(MatchPlayer));
+    size_t count = 0;
+    for (uint32_t i = 0; i < store->header.player_count && (int)(count) < n; i++)
+    {
+        const MatchPlayer *player = &store->players[store->ranking[i]];
+        size_t j = 0;
+        while (j < changed_count && strncmp(changed[j].name, player->name, MATCH_NAME_MAX) != 0)
+            j++;
+        if (j == changed_count)
+            candidates[count++] = *player;
+    }
+    memcpy(candidates + count, changed, changed_count * sizeof(MatchPlayer));
+    count += changed_count;
+    qsort(candidates, count, sizeof(MatchPlayer), compare_players);
+
+    if ((int)count > n)
+        count = (size_t)n;
+    memcpy(out, candidates, count * sizeof(MatchPlayer));
+    free(candidates);
+    free(changed);
+    return (int)count;
+}
+
+// Up to n of name's matches, newest first; totals, if given, gets the
+// player's standing. Returns how many were found.
+int match_history(const MatchStore *store, const char *name, MatchRecord *out, int n, MatchPlayer *totals)
+{
+    int count = 0;
+    if (totals)
+    {
+        memset(totals, 0, sizeof(*totals));
+        strncpy(totals->name, name, MATCH_NAME_MAX - 1);
+    }
+    int p = find_match_player(store->players, store->header.player_count, name);
+    if (p >= 0 && totals)
+        *totals = store->players[p];
+
+    for (size_t i = store->tail_count; i-- > 0;)
+    {
+        if (strncmp(store->tail[i].player, name, MATCH_NAME_MAX) != 0)
+            continue;
+        if (totals)
+            match_count_result(totals, &store->tail[i]);
+        if (count < n)
+            out[count++] = store->tail[i];
+    }
+    if (p < 0 || count >= n)
+        return count;
+
+    // The newest indexed matches are the last of the player's record numbers
+    char path[600];
+    const MatchPlayer *player = &store->players[p];
+    uint32_t wanted = (uint32_t)(n - count) < player->match_count ? (uint32_t)(n - count) : player->match_count;
+    uint32_t *numbers = malloc((wanted ? wanted : 1) * sizeof(uint32_t));
+    match_path(path, sizeof(path), MATCH_INDEX_FILE);
+    FILE *fp = fopen(path, "rb");
+    long offset = (long)(sizeof(MatchIndexHeader) + store->header.player_count * (sizeof(MatchPlayer) + sizeof(uint32_t)) +
+                         (player->first + player->match_count - wanted) * sizeof(uint32_t));
+    if (!fp || fseek(fp, offset, SEEK_SET) != 0 || fread(numbers, sizeof(uint32_t), wanted, fp) != wanted)
+        wanted = 0;
+    if (fp)
+        fclose(fp);
+
+    match_path(path, sizeof(path), MATCH_LOG_FILE);
+    fp = wanted ? fopen(path, "rb") : NULL;
+    for (uint32_t i = wanted; fp && i-- > 0;)
+    {
+        MatchRecord *record = &out[count];
+        if (fseek(fp, (long)(sizeof(MatchLogHeader) + numbers[i] * sizeof(MatchRecord)), SEEK_SET) == 0 &&
+                fread(record, sizeof(*record), 1, fp) == 1 && record->checksum == match_checksum(record))
+            count++;
+    }
+    if (fp)
+        fclose(fp);
+    free(numbers);
+    return count;
+}
+
+// Print the top n players
+void show_leaderboard(int n)
+{
+    MatchStore *store = match_store_open();
+    MatchPlayer *top = malloc((n > 0 ? n : 1) * sizeof(MatchPlayer));
+    int count = match_leaderboard(store, top, n);
+
+    printf("Leaderboard:\n");
+    if (count == 0)
+        printf("  (no matches yet)\n");
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t played = top[i].wins + top[i].draws + top[i].losses;
+        printf("  %2d. %-20s %5u won %5u drawn %5u lost  %3.0f%%\n", i + 1, top[i].name,
+               top[i].wins, top[i].draws, top[i].losses, played ? 100.0 * top[i].wins / played : 0.0);
+    }
+    free(top);
+    match_store_close(store);
+}
+
+// Print a player's totals and latest n matches
+void show_match_history(const char *name, int n)
+{
+    MatchStore *store = match_store_open();
+    MatchRecord *records = malloc((n > 0 ? n : 1) * sizeof(MatchRecord));
+    MatchPlayer totals;
+    int count = match_history(store, name, records, n, &totals);
+
+    printf("Matches of %s: %u won, %u drawn, %u lost\n", totals.name, totals.wins, totals.draws, totals.losses);
+    for (int i = 0; i < count; i++)
+    {
+        char when[32];
+        time_t finished_at = (time_t)records[i].finished_at;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&finished_at));
+        printf("  %s  %-4s %2u moves %6.1fs  level %u  seed %llu\n", when,
+               records[i].result > 0 ? "won" : records[i].result < 0 ? "lost" : "draw",
+               records[i].move_count, records[i].duration_ms / 1000.0, records[i].level,
+               (unsigned long long)records[i].seed);
+    }
+    free(records);
+    match_store_close(store);
+}
+
+// --compact-matches: merge the whole tail into the index now
+int compact_matches()
+{
+    MatchStore *store = match_store_open();
+    int ok = match_compact(store);
+    if (ok)
+        printf("Indexed %llu matches of %u players\n", (unsigned long long)store->header.log_records,
+               store->header.player_count);
+    else
+        printf("Error writing the match index!\n");
+    match_store_close(store);
+    return ok;
+}
+
+// Moves of a match record: cells, owners and factors of up to SIZE moves.
+// Each side multiplies by the other side's last factor (the player starts
+// from the opening); records without owners alternate from the player.
+// Returns the number of moves, 0 if the record holds only the result. The
+// GUI decodes records with the same function.
+int match_decode(const MatchRecord *record, uint8_t *cells, uint8_t *owners, uint8_t *factors)
+{
+    if (!(record->flags & MATCH_FULL_MOVES))
+        return 0;
+
+    int taken[SIZE] = {0};
+    int last_factor[3] = { 0, 0, record->opening };
+    int length = 0;
+    for (int i = 0; i < record->move_count && i < SIZE; i++)
+    {
+        int owner = record->flags & MATCH_OWNERS ? 1 + (record->owners[i / 8] >> (i % 8) & 1) : 1 + i % 2;
+        int factor = record->factors[i / 2] >> (i % 2 * 4) & 0xF;
+        int multiplier = last_factor[3 - owner];
+        int cell = factor >= 1 && factor <= 9 && multiplier >= 1 && multiplier <= 9 ? getIndex(product(factor, multiplier)) : -1;
+        if (cell < 0 || taken[cell])
+            break;
+        taken[cell] = 1;
+        cells[i] = (uint8_t)cell;
+        owners[i] = (uint8_t)owner;
+        factors[i] = (uint8_t)factor;
+        last_factor[owner] = factor;
+        length = i + 1;
+    }
+    return length;
+}
+
+// Aggregate statistics (--aggregate): which products get claimed, when and
+// by whom, and how the opening multiplier affects the result, over match
+// logs or self-play games. Every thread streams its share of the games into
+// its own GameStats and the blocks are summed at the end, so memory does not
+// grow with the number of games. Side 1 is the player.
+#define AGGREGATE_FILE "aggregate.csv"
+#define AGGREGATE_CHUNK 1024 // log records read at once
+
+// Every field is a counter, so blocks are merged by adding them as uint64_t arrays
+typedef struct
+{
+    uint64_t games;              // games with their moves
+    uint64_t moves;
+    uint64_t decided;            // games with a winner
+    uint64_t skipped;            // log records without their moves, or damaged
+    uint64_t claims[2][SIZE];    // times each cell was claimed by the player / the computer
+    uint64_t ply_sum[SIZE];      // sum of the move numbers (from 1) of those claims
+    uint64_t winner_cells[SIZE]; // times the cell was the winner's when the game ended
+    uint64_t openings[10][3];    // results by opening multiplier: player won, draw, computer won
+    uint64_t opening_moves[10];  // moves of the games of each opening
+} GameStats;
+
+// Count one game; result is 1 if the player won, 0 for a draw, -1 if the computer won
+void stats_add_game(GameStats *stats, int opening, const uint8_t *cells, const uint8_t *owners, int length, int result)
+{
+    int final[SIZE] = {0};
+    stats->games++;
+    stats->moves += length;
+    for (int i = 0; i < length; i++)
+    {
+        stats->claims[owners[i] - 1][cells[i]]++;
+        stats->ply_sum[cells[i]] += i + 1;
+        final[cells[i]] = owners[i];
+    }
+    if (result != 0)
+    {
+        int winner = result > 0 ? 1 : 2;
+        stats->decided++;
+        for (int i = 0; i < SIZE; i++)
+            stats->winner_cells[i] += final[i] == winner;
+    }
+    if (opening >= 1 && opening <= 9)
+    {
+        stats->openings[opening][1 - result]++;
+        stats->opening_moves[opening] += length;
+    }
+}
+
+void stats_merge(GameStats *into, const GameStats *from)
+{
+    uint64_t *a = (uint64_t *)into;
+    const uint64_t *b = (const uint64_t *)from;
+    for (size_t i = 0; i < sizeof(GameStats) / sizeof(uint64_t); i++)
+        a[i] += b[i];
+}
+
+// One thread's share: a range of a log's records, or of self-play games
+typedef struct
+{
+    const char *path;    // match log, or NULL for self-play
+    uint64_t first;
+    uint64_t last;
+    GameStats stats;
+} AggregateJob;
+
+// Play one self-play game with the rule-based player on both sides from a
+// random opening, counting it into stats
+void aggregate_self_play(GameStats *stats, uint64_t game)
+{
+    Rng rng;
+    rng_seed(&rng, mix_seed(game_seed, game));
+    int moves[SIZE] = {0};
+    uint8_t cells[SIZE], owners[SIZE];
+    int opening = rng_range(&rng, 9) + 1;
+    int multiplier = opening;
+    int side = 1, length = 0, result = 0;
+
+    for (;;)
+    {
+        int factor = chooseFactor(moves, multiplier, side, eval_weights, &rng);
+        if (factor == -1)
+            break;
+        int cell = getIndex(product(factor, multiplier));
+        moves[cell] = side;
+        cells[length] = (uint8_t)cell;
+        owners[length++] = (uint8_t)side;
+        if (boardWin(moves, side))
+        {
+            result = side == 1 ? 1 : -1;
+            break;
+        }
+        if (boardFull(moves))
+            break;
+        multiplier = factor;
+        side = 3 - side;
+    }
+    stats_add_game(stats, opening, cells, owners, length, result);
+}
+
+void *aggregate_worker(void *arg)
+{
+    AggregateJob *job = arg;
+    if (!job->path)
+    {
+        for (uint64_t game = job->first; game < job->last; game++)
+            aggregate_self_play(&job->stats, game);
+        return NULL;
+    }
+
+    FILE *fp = fopen(job->path, "rb");
+    if (!fp || fseek(fp, (long)(sizeof(MatchLogHeader) + job->first * sizeof(MatchRecord)), SEEK_SET) != 0)
+    {
+        if (fp)
+            fclose(fp);
+        return NULL;
+    }
+    MatchRecord *chunk = malloc(AGGREGATE_CHUNK * sizeof(MatchRecord));
+    uint8_t cells[SIZE], owners[SIZE], factors[SIZE];
+    for (uint64_t number = job->first; number < job->last;)
+    {
+        size_t wanted = job->last - number < AGGREGATE_CHUNK ? (size_t)(job->last - number) : AGGREGATE_CHUNK;
+        size_t got = fread(chunk, sizeof(MatchRecord), wanted, fp);
+        for (size_t i = 0; i < got; i++)
+        {
+            int length = chunk[i].checksum == match_checksum(&chunk[i]) ?
+                         match_decode(&chunk[i], cells, owners, factors) : 0;
+            if (length > 0)
+                stats_add_game(&job->stats, chunk[i].opening, cells, owners, length, chunk[i].result);
+            else
+                job->stats.skipped++;
+        }
+        if (got < wanted)
+            break;
+        number += got;
+    }
+    free(chunk);
+    fclose(fp);
+    return NULL;
+}
+
+// Count count items of one source (a log, or self-play when path is NULL) on
+// all threads into stats
+void aggregate_source(GameStats *stats, const char *path, uint64_t count, int threads)
+{
+    AggregateJob *jobs = calloc(threads, sizeof(AggregateJob));
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    for (int t = 0; t < threads; t++)
+    {
+        jobs[t].path = path;
+        jobs[t].first = count * t / threads;
+        jobs[t].last = count * (t + 1) / threads;
+        pthread_create(&workers[t], NULL, aggregate_worker, &jobs[t]);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+        stats_merge(stats, &jobs[t].stats);
+    }
+    free(jobs);
+    free(workers);
+}
+
+// Records in a match log, or -1 if it is not one
+long long match_log_records(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    MatchLogHeader header;
+    long long records = -1;
+    if (fp && fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.magic, MATCH_LOG_MAGIC, 4) == 0 &&
+            header.version == MATCH_VERSION && header.record_size == sizeof(MatchRecord) &&
+            fseek(fp, 0, SEEK_END) == 0)
+        records = (ftell(fp) - (long)sizeof(header)) / (long)sizeof(MatchRecord);
+    if (fp)
+        fclose(fp);
+    return records;
+}
+
+// One row per cell, then one per opening multiplier:
+//   kind,key,product,games,player,computer,draws,mean_ply,winner_share
+// A cell row counts claims by each side, the mean move number of a claim and
+// the share of decided games the winner ended up owning the cell in; an
+// opening row counts the results and the mean game length.
+void write_stats_csv(FILE *fp, const GameStats *stats)
+{
+    fprintf(fp, "kind,key,product,games,player,computer,draws,mean_ply,winner_share\n");
+    for (int i = 0; i < SIZE; i++)
+    {
+        uint64_t claims = stats->claims[0][i] + stats->claims[1][i];
+        fprintf(fp, "cell,%d,%d,%llu,%llu,%llu,,%.3f,%.4f\n", i, board[i], (unsigned long long)stats->games,
+                (unsigned long long)stats->claims[0][i], (unsigned long long)stats->claims[1][i],
+                claims ? (double)stats->ply_sum[i] / claims : 0.0,
+                stats->decided ? (double)stats->winner_cells[i] / stats->decided : 0.0);
+    }
+    for (int m = 1; m <= 9; m++)
+    {
+        const uint64_t *r = stats->openings[m];
+        uint64_t games = r[0] + r[1] + r[2];
+        fprintf(fp, "opening,%d,,%llu,%llu,%llu,%llu,%.3f,\n", m, (unsigned long long)games,
+                (unsigned long long)r[0], (unsigned long long)r[2], (unsigned long long)r[1],
+                games ? (double)stats->opening_moves[m] / games : 0.0);
+    }
+}
+
+// Print the claim heatmap (share of games each cell was claimed in, and by
+// whom) and the results by opening
+void print_stats(const GameStats *stats)
+{
+    printf("%llu games, %.1f moves on average", (unsigned long long)stats->games,
+           stats->games ? (double)stats->moves / stats->games : 0.0);
+    if (stats->skipped)
+        printf(" (%llu records without moves skipped)", (unsigned long long)stats->skipped);
+    printf("\n\nClaimed in %% of games (P = mostly the player, C = mostly the computer):\n");
+    for (int row = 0; row < HEIGHT; row++)
+    {
+        for (int col = 0; col < WIDTH; col++)
+        {
+            int i = row * WIDTH + col;
+            uint64_t claims = stats->claims[0][i] + stats->claims[1][i];
+            printf("  %2d:%3.0f%c", board[i], stats->games ? 100.0 * claims / stats->games : 0.0,
+                   claims == 0 ? ' ' : stats->claims[0][i] >= stats->claims[1][i] ? 'P' : 'C');
+        }
+        printf("\n");
+    }
+    printf("\nOpening  Games   Player  Draw  Computer  Moves\n");
+    for (int m = 1; m <= 9; m++)
+    {
+        const uint64_t *r = stats->openings[m];
+        uint64_t games = r[0] + r[1] + r[2];
+        if (games == 0)
+            continue;
+        printf("%7d %6llu %7.1f%% %4.1f%% %8.1f%% %6.1f\n", m, (unsigned long long)games,
+               100.0 * r[0] / games, 100.0 * r[1] / games, 100.0 * r[2] / games,
+               (double)stats->opening_moves[m] / games);
+    }
+}
+
+// Aggregate the given match logs, or the given number of self-play games if
+// there are none, then print the summary and write the CSV to output
+int aggregate(char **paths, int path_count, int games, int threads, const char *output)
+{
+    GameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    unsigned long long start = perf_now();
+
+    if (path_count == 0)
+        aggregate_source(&stats, NULL, (uint64_t)games, threads);
+    for (int i = 0; i < path_count; i++)
+    {
+        long long records = match_log_records(paths[i]);
+        if (records < 0)
+        {
+            printf("%s is not a match log\n", paths[i]);
+            return 0;
+        }
+        aggregate_source(&stats, paths[i], (uint64_t)records, threads);
+    }
+    double seconds = (perf_now() - start) / 1e9;
+
+    print_stats(&stats);
+    FILE *fp = fopen(output, "w");
+    if (!fp)
+    {
+        printf("Could not write %s\n", output);
+        return 0;
+    }
+    write_stats_csv(fp, &stats);
+    int ok = fclose(fp) == 0;
+    printf("\nAggregated in %.2f s on %d threads; table written to %s\n", seconds, threads, output);
+    return ok;
+}
+
+// Spectator hub (--hub). One thread polls every connection. Each event from
+// the publisher is applied to the hub's copy of the position and encoded
+// once into a reference-counted SharedEvent; every spectator's queue holds a
+// pointer to it, and the queued events go out in one gathered write, so the
+// fan-out makes no per-spectator copies. A spectator whose queue is full
+// (it reads slower than the game moves) loses the queue and is sent a
+// snapshot of the current position instead, shared by every spectator
+// resynced before the next event; the deltas continue from there.
+#define HUB_QUEUE 64          // events queued per spectator before it is resynced
+#define HUB_SNDBUF 4096       // kernel send buffer per connection, so the backlog stays bounded there too
+#define HUB_REPORT_SECONDS 5
+
+#ifndef _WIN32
+typedef struct
+{
+    int refs;
+    uint32_t length;
+    SpectateSnapshot bytes; // an event, or a snapshot event and its position
+} SharedEvent;
+
+typedef struct
+{
+    int fd;
+    char role;               // SPECTATE_PUBLISHER or SPECTATE_SPECTATOR, 0 until it says
+    int blocked;             // the socket buffer is full; wait for it to drain
+    SharedEvent *queue[HUB_QUEUE];
+    int head, count;
+    uint32_t sent;           // bytes of queue[head] already written
+    uint8_t input[sizeof(SpectateSnapshot)]; // publisher: a partly received event
+    uint32_t input_length;
+} HubClient;
+
+typedef struct
+{
+    HubClient *clients;
+    int count, capacity;
+    int spectators;
+    int publisher;            // a publisher is connected; a second one is turned away
+    PackedGame game;          // the position after the last event
+    int has_game;
+    uint32_t seq;             // the last event applied
+    SharedEvent *snapshot;    // the position as a snapshot event, built on the first resync after an event
+    unsigned long long events, resyncs, rejected, bytes;
+} Hub;
+
+volatile sig_atomic_t hub_stop = 0;
+
+void hub_interrupt(int signal_number)
+{
+    (void)signal_number;
+    hub_stop = 1;
+}
+
+// Returns NULL, and stops the hub, when memory runs out
+SharedEvent *shared_event_new(const void *data, size_t length)
+{
+    SharedEvent *event = malloc(sizeof(SharedEvent));
+    if (event == NULL)
+    {
+        fprintf(stderr, "Out of memory for spectator events; stopping the hub\n");
+        hub_stop = 1;
+        return NULL;
+    }
+    event->refs = 1;
+    event->length = (uint32_t)length;
+    memcpy(&event->bytes, data, length);
+    return event;
+}
+
+void shared_event_unref(SharedEvent *event)
+{
+    if (--event->refs == 0)
+        free(event);
+}
+
+// Let a process hold thousands of sockets
+void raise_fd_limit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+void set_nonblocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+SharedEvent *hub_snapshot(Hub *hub)
+{
+    if (hub->snapshot == NULL)
+    {
+        SpectateSnapshot snapshot = { { SPECTATE_SNAPSHOT, 0, 0, 0, hub->seq }, hub->game };
+        hub->snapshot = shared_event_new(&snapshot, sizeof(snapshot));
+    }
+    return hub->snapshot;
+}
+
+void hub_enqueue(HubClient *client, SharedEvent *event)
+{
+    event->refs++;
+    client->queue[(client->head + client->count) % HUB_QUEUE] = event;
+    client->count++;
+}
+
+// Replace a spectator's backlog with a snapshot; an event already partly
+// written is finished first so the stream stays framed
+void hub_resync(Hub *hub, HubClient *client)
+{
+    int keep = client->sent > 0;
+    for (int i = keep; i < client->count; i++)
+        shared_event_unref(client->queue[(client->head + i) % HUB_QUEUE]);
+    client->count = keep;
+    SharedEvent *snapshot = hub_snapshot(hub);
+    if (snapshot)
+        hub_enqueue(client, snapshot);
+    hub->resyncs++;
+}
+
+// Write as much of a spectator's queue as its socket takes, in one call;
+// returns 0 if the connection failed
+int hub_flush(Hub *hub, HubClient *client)
+{
+    while (client->count > 0 && !client->blocked)
+    {
+        struct iovec iov[HUB_QUEUE];
+        for (int i = 0; i < client->count; i++)
+        {
+            SharedEvent *event = client->queue[(client->head + i) % HUB_QUEUE];
+            iov[i].iov_base = (uint8_t *)&event->bytes;
+            iov[i].iov_len = event->length;
+        }
+        iov[0].iov_base = (uint8_t *)iov[0].iov_base + client->sent;
+        iov[0].iov_len -= client->sent;
+
+        struct msghdr message = { .msg_iov = iov, .msg_iovlen = (size_t)client->count };
+        ssize_t written = sendmsg(client->fd, &message, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                client->blocked = 1;
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        hub->bytes += (unsigned long long)written;
+
+        size_t left = (size_t)written + client->sent;
+        while (client->count > 0)
+        {
+            SharedEvent *event = client->queue[client->head];
+            if (left < event->length)
+                break;
+            left -= event->length;
+            shared_event_unref(event);
+            client->head = (client->head + 1) % HUB_QUEUE;
+            client->count--;
+        }
+        client->sent = (uint32_t)left;
+    }
+    return 1;
+}
+
+// An event from the publisher: apply it and queue it for every spectator
+void hub_publish(Hub *hub, const uint8_t *data, size_t length)
+{
+    SpectateSnapshot event;
+    memcpy(&event, data, length);
+
+    if (hub->snapshot)
+    {
+        shared_event_unref(hub->snapshot);
+        hub->snapshot = NULL;
+    }
+    hub->seq = event.event.seq;
+    if (!spectate_apply(&hub->game, &event))
+    {
+        // Out of step with the publisher: what spectators have is unknowable, so resync them all
+        hub->rejected++;
+        for (int i = 0; i < hub->count; i++)
+            if (hub->clients[i].role == SPECTATE_SPECTATOR)
+                hub_resync(hub, &hub->clients[i]);
+        return;
+    }
+    hub->has_game = 1;
+    hub->events++;
+
+    SharedEvent *shared = shared_event_new(data, length);
+    if (shared == NULL)
+        return;
+    for (int i = 0; i < hub->count; i++)
+    {
+        HubClient *client = &hub->clients[i];
+        if (client->role != SPECTATE_SPECTATOR)
+            continue;
+        // A burst from the publisher can fill a queue the socket would still
+        // take; only a spectator that cannot keep up is resynced. A failed
+        // connection shows up again, and is closed, in the main loop's flush.
+        if (client->count == HUB_QUEUE)
+            hub_flush(hub, client);
+        if (client->count == HUB_QUEUE)
+            hub_resync(hub, client);
+        else
+            hub_enqueue(client, shared);
+    }
+    shared_event_unref(shared);
+}
+
+// Read from a connection; returns 0 once it is closed
+int hub_read(Hub *hub, HubClient *client)
+{
+    uint8_t buffer[4096];
+    ssize_t length = recv(client->fd, buffer, sizeof(buffer), 0);
+    if (length <= 0)
+        return length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+
+    size_t pos = 0;
+    if (client->role == 0)
+    {
+        client->role = (char)buffer[pos++];
+        if (client->role == SPECTATE_SPECTATOR)
+        {
+            hub->spectators++;
+            SharedEvent *snapshot = hub->has_game ? hub_snapshot(hub) : NULL;
+            if (snapshot)
+                hub_enqueue(client, snapshot);
+        }
+        else if (client->role == SPECTATE_PUBLISHER && !hub->publisher)
+        {
+            hub->publisher = 1;
+            printf("Publisher connected\n");
+        }
+        else
+        {
+            // Two publishers would interleave two games into one stream
+            if (client->role == SPECTATE_PUBLISHER)
+                printf("A second publisher was turned away\n");
+            client->role = 0;
+            return 0;
+        }
+    }
+    if (client->role == SPECTATE_SPECTATOR)
+        return 1; // spectators only listen; whatever they send is ignored
+
+    while (pos < (size_t)length)
+    {
+        size_t need = client->input_length > 0 ? spectate_event_size(client->input[0]) : 1;
+        size_t take = need - client->input_length;
+        if (take > (size_t)length - pos)
+            take = (size_t)length - pos;
+        memcpy(client->input + client->input_length, buffer + pos, take);
+        client->input_length += (uint32_t)take;
+        pos += take;
+        if (client->input_length == spectate_event_size(client->input[0]))
+        {
+            hub_publish(hub, client->input, client->input_length);
+            client->input_length = 0;
+        }
+    }
+    return 1;
+}
+
+void hub_close(Hub *hub, int index)
+{
+    HubClient *client = &hub->clients[index];
+    for (int i = 0; i < client->count; i++)
+        shared_event_unref(client->queue[(client->head + i) % HUB_QUEUE]);
+    if (client->role == SPECTATE_SPECTATOR)
+        hub->spectators--;
+    else if (client->role == SPECTATE_PUBLISHER)
+    {
+        hub->publisher = 0;
+        printf("Publisher disconnected\n");
+    }
+    close(client->fd);
+    hub->clients[index] = hub->clients[--hub->count];
+}
+
+// Open a listening socket on this machine's loopback address
+int spectate_listen(int port)
+{
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int one = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+int run_hub(int port)
+{
+    raise_fd_limit();
+    int listener = spectate_listen(port);
+    if (listener < 0)
+    {
+        perror("Could not open the hub port");
+        return 0;
+    }
+
+    Hub hub = { 0 };
+    struct pollfd *fds = NULL;
+    int fd_capacity = 0;
+    unsigned long long report_at = perf_now() + HUB_REPORT_SECONDS * 1000000000ULL;
+    unsigned long long reported_events = 0, reported_bytes = 0;
+
+    signal(SIGINT, hub_interrupt);
+    signal(SIGTERM, hub_interrupt);
+    printf("Spectator hub on 127.0.0.1:%d (Ctrl-C to stop)\n", port);
+    fflush(stdout);
+
+    while (!hub_stop)
+    {
+        int polled = hub.count;
+        if (polled + 1 > fd_capacity)
+        {
+            fd_capacity = (polled + 1) * 2;
+            fds = realloc(fds, fd_capacity * sizeof(struct pollfd));
+        }
+        fds[0] = (struct pollfd){ listener, POLLIN, 0 };
+        for (int i = 0; i < polled; i++)
+        {
+            HubClient *client = &hub.clients[i];
+            fds[i + 1] = (struct pollfd){ client->fd, POLLIN | (client->blocked ? POLLOUT : 0), 0 };
+        }
+
+        if (poll(fds, polled + 1, 1000) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        // Walk down so a closed connection's slot can take the last one
+        for (int i = polled - 1; i >= 0; i--)
+        {
+            short revents = fds[i + 1].revents;
+            HubClient *client = &hub.clients[i];
+            if (revents & POLLOUT)
+                client->blocked = 0;
+            if (((revents & (POLLIN | POLLHUP | POLLERR)) && !hub_read(&hub, client)))
+                hub_close(&hub, i);
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd;
+            while ((fd = accept(listener, NULL, NULL)) >= 0)
+            {
+                int one = 1, size = HUB_SNDBUF;
+                set_nonblocking(fd);
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+                if (hub.count == hub.capacity)
                 {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_moves[idx] = 0;
-                    break;
+                    hub.capacity = hub.capacity ? hub.capacity * 2 : 64;
+                    hub.clients = realloc(hub.clients, hub.capacity * sizeof(HubClient));
                 }
+                memset(&hub.clients[hub.count], 0, sizeof(HubClient));
+                hub.clients[hub.count++].fd = fd;
+            }
+        }
+
+        // Everything queued this round goes out now; blocked sockets wait for POLLOUT
+        for (int i = hub.count - 1; i >= 0; i--)
+        {
+            if (hub.clients[i].count > 0 && !hub_flush(&hub, &hub.clients[i]))
+                hub_close(&hub, i);
+        }
+
+        unsigned long long now = perf_now();
+        if (now >= report_at)
+        {
+            printf("%d spectators, %.0f events/s, %.2f MB/s out, %llu resyncs, %llu rejected\n",
+                   hub.spectators, (hub.events - reported_events) / (double)HUB_REPORT_SECONDS,
+                   (hub.bytes - reported_bytes) / 1e6 / HUB_REPORT_SECONDS, hub.resyncs, hub.rejected);
+            fflush(stdout);
+            reported_events = hub.events;
+            reported_bytes = hub.bytes;
+            report_at = now + HUB_REPORT_SECONDS * 1000000000ULL;
+        }
+    }
+
+    while (hub.count > 0)
+        hub_close(&hub, hub.count - 1);
+    if (hub.snapshot)
+        shared_event_unref(hub.snapshot);
+    free(hub.clients);
+    free(fds);
+    close(listener);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    printf("Hub stopped after %llu events, %llu resyncs\n", hub.events, hub.resyncs);
+    return 1;
+}
+
+// Collect whole events from a stream; calls handle for each and returns the
+// bytes of a trailing partial event left in partial
+void spectate_frames(const uint8_t *data, size_t length, uint8_t *partial, uint32_t *partial_length,
+                     void (*handle)(void *context, const SpectateSnapshot *event), void *context)
+{
+    size_t pos = 0;
+    while (pos < length)
+    {
+        size_t need = *partial_length > 0 ? spectate_event_size(partial[0]) : 1;
+        size_t take = need - *partial_length;
+        if (take > length - pos)
+            take = length - pos;
+        memcpy(partial + *partial_length, data + pos, take);
+        *partial_length += (uint32_t)take;
+        pos += take;
+        if (*partial_length == spectate_event_size(partial[0]))
+        {
+            SpectateSnapshot event;
+            memcpy(&event, partial, *partial_length);
+            handle(context, &event);
+            *partial_length = 0;
+        }
+    }
+}
+
+// --spectate: follow a game on the terminal
+typedef struct
+{
+    PackedGame game;
+    int synced;
+    uint32_t expect;
+    unsigned long resyncs;
+} Spectator;
+
+void spectator_show(void *context, const SpectateSnapshot *event)
+{
+    Spectator *spectator = context;
+    if (event->event.type == SPECTATE_SNAPSHOT)
+    {
+        spectator->resyncs += spectator->synced;
+        spectator->synced = 1;
+    }
+    else if (!spectator->synced)
+        return;
+    spectate_apply(&spectator->game, event);
+    spectator->expect = event->event.seq + 1;
+
+    unpack_game(&spectator->game, player_moves, &player_score, &computer_score, &com_choice, &game_over);
+    clear_screen(0);
+    printf("\nSpectating the Multiplication Game (read-only, Ctrl-C to leave)\n");
+    display();
+    if (event->event.type == SPECTATE_MOVE)
+        printf("\n%s chose %d => %d\n", event->event.owner == 1 ? "Player" : "Computer", event->event.factor,
+               board[event->event.cell]);
+    else if (event->event.type == SPECTATE_END)
+        printf("\n%s\n", event->event.owner == 1 ? "Player wins!" : event->event.owner == 2 ? "Computer wins!" : "Tie.");
+    if (!game_over && com_choice > 0)
+        printf("Multiplier: %d\n", com_choice);
+    if (spectator->resyncs)
+        printf("(resynced %lu times)\n", spectator->resyncs);
+    fflush(stdout);
+}
+
+int spectate(int port)
+{
+    int fd = spectate_connect(port, SPECTATE_SPECTATOR);
+    if (fd < 0)
+    {
+        printf("No spectator hub on port %d (start one with --hub)\n", port);
+        return 0;
+    }
+    Spectator spectator = { 0 };
+    uint8_t buffer[4096], partial[sizeof(SpectateSnapshot)];
+    uint32_t partial_length = 0;
+    ssize_t length;
+    while ((length = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        spectate_frames(buffer, (size_t)length, partial, &partial_length, spectator_show, &spectator);
+    close(fd);
+    printf("\nThe hub closed the connection.\n");
+    return 1;
+}
+
+// Spectator load generator (--spectate-load): publishes a synthetic game at a
+// fixed event rate to a running hub while holding many spectator connections
+// on this machine, some of them deliberately slow readers. Every spectator
+// checks that its stream is consecutive and fits its board; at the end every
+// board must match the published position.
+#define LOAD_TIMES 65536     // send times kept for latency, indexed by seq
+#define LOAD_SLOW_MS 2000    // how long a slow spectator stalls between reads
+#define LOAD_SLOW_RCVBUF 2048
+#define LOAD_DRAIN_SECONDS 5
+
+typedef struct
+{
+    int fd;
+    int slow;
+    int synced;
+    PackedGame game;
+    uint32_t expect;
+    uint8_t partial[sizeof(SpectateSnapshot)];
+    uint32_t partial_length;
+    unsigned long long events, resyncs, errors;
+} LoadSpectator;
+
+typedef struct
+{
+    int moves[SIZE];
+    int multiplier;
+    int side;
+    int over;
+    int winner;              // -1, or the result to announce next
+    Rng rng;
+    PackedGame truth;        // the position every spectator should end with
+    unsigned long long *sent_at;
+    uint32_t *latencies;     // microseconds
+    size_t latency_count, latency_capacity;
+    unsigned long long now;
+} LoadRun;
+
+LoadRun *load_run = NULL;
+
+// The next event of the synthetic game
+void load_next_event(LoadRun *run, SpectateEvent *event)
+{
+    memset(event, 0, sizeof(*event));
+    if (run->winner >= 0)
+    {
+        event->type = SPECTATE_END;
+        event->owner = (uint8_t)run->winner;
+        run->winner = -1;
+        run->over = 1;
+        return;
+    }
+    if (run->over)
+    {
+        memset(run->moves, 0, sizeof(run->moves));
+        run->multiplier = rng_range(&run->rng, 9) + 1;
+        run->side = 1;
+        run->over = 0;
+        event->type = SPECTATE_NEW_GAME;
+        event->factor = (uint8_t)run->multiplier;
+        return;
+    }
+
+    int legal[9], legal_count = 0;
+    for (int factor = 1; factor <= 9; factor++)
+    {
+        int idx = product_cell[factor][run->multiplier];
+        if (idx != -1 && run->moves[idx] == 0)
+            legal[legal_count++] = factor;
+    }
+    if (legal_count == 0)
+    {
+        event->type = SPECTATE_END; // no legal factor: a tie
+        run->over = 1;
+        return;
+    }
+
+    int factor = legal[rng_range(&run->rng, legal_count)];
+    int idx = product_cell[factor][run->multiplier];
+    run->moves[idx] = run->side;
+    event->type = SPECTATE_MOVE;
+    event->cell = (uint8_t)idx;
+    event->owner = (uint8_t)run->side;
+    event->factor = (uint8_t)factor;
+    if (boardWin(run->moves, run->side))
+        run->winner = run->side;
+    else if (boardFull(run->moves))
+        run->winner = 0;
+    run->multiplier = factor;
+    run->side = 3 - run->side;
+}
+
+void load_receive(void *context, const SpectateSnapshot *event)
+{
+    LoadSpectator *spectator = context;
+    uint32_t seq = event->event.seq;
+    if (event->event.type == SPECTATE_SNAPSHOT)
+    {
+        spectator->resyncs += spectator->synced;
+        spectator->synced = 1;
+    }
+    else if (!spectator->synced)
+        return;
+    else
+    {
+        if (seq != spectator->expect)
+            spectator->errors++;
+        // Slow spectators lag by design; latency is that of the ones keeping up
+        if (!spectator->slow && publish_seq - seq <= LOAD_TIMES)
+        {
+            LoadRun *run = load_run;
+            if (run->latency_count == run->latency_capacity)
+            {
+                run->latency_capacity = run->latency_capacity ? run->latency_capacity * 2 : 65536;
+                run->latencies = realloc(run->latencies, run->latency_capacity * sizeof(uint32_t));
+            }
+            run->latencies[run->latency_count++] = (uint32_t)((run->now - run->sent_at[seq % LOAD_TIMES]) / 1000);
+        }
+    }
+    if (!spectate_apply(&spectator->game, event))
+        spectator->errors++;
+    spectator->expect = seq + 1;
+    spectator->events++;
+}
+
+// Read what a spectator's socket holds; returns 0 once it is closed
+int load_read(LoadSpectator *spectator)
+{
+    uint8_t buffer[16384];
+    for (;;)
+    {
+        ssize_t length = recv(spectator->fd, buffer, sizeof(buffer), 0);
+        if (length < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        if (length == 0)
+            return 0;
+        spectate_frames(buffer, (size_t)length, spectator->partial, &spectator->partial_length,
+                        load_receive, spectator);
+    }
+}
+
+int compare_uint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int spectate_load(int port, int count, int slow, int rate, int seconds)
+{
+    raise_fd_limit();
+    LoadRun run = { .winner = -1, .over = 1 };
+    rng_seed(&run.rng, game_seed);
+    run.sent_at = calloc(LOAD_TIMES, sizeof(unsigned long long));
+    packed_set_game_over(&run.truth, 1);
+    load_run = &run;
+
+    publish_fd = spectate_connect(port, SPECTATE_PUBLISHER);
+    if (publish_fd < 0)
+    {
+        printf("No spectator hub on port %d (start one with --hub)\n", port);
+        return 0;
+    }
+    publish_seq = 0;
+    SpectateSnapshot snapshot = { { SPECTATE_SNAPSHOT, 0, 0, 0, 0 }, run.truth };
+    publish_send(&snapshot);
+
+    LoadSpectator *spectators = calloc(count, sizeof(LoadSpectator));
+    struct pollfd *fds = calloc(count, sizeof(struct pollfd));
+    int connected = 0;
+    for (; connected < count; connected++)
+    {
+        LoadSpectator *spectator = &spectators[connected];
+        spectator->slow = connected < slow;
+        spectator->fd = spectate_connect(port, SPECTATE_SPECTATOR);
+        if (spectator->fd < 0)
+        {
+            perror("Could not connect a spectator");
+            break;
+        }
+        if (spectator->slow)
+        {
+            int size = LOAD_SLOW_RCVBUF;
+            setsockopt(spectator->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+        set_nonblocking(spectator->fd);
+    }
+    printf("%d spectators (%d slow) connected; publishing %d events/s for %d s\n",
+           connected, slow < connected ? slow : connected, rate, seconds);
+    fflush(stdout);
+
+    unsigned long long start = perf_now();
+    unsigned long long interval = 1000000000ULL / (rate > 0 ? rate : 1);
+    unsigned long long next_publish = start, next_slow = start;
+    unsigned long long stop_publishing = start + seconds * 1000000000ULL;
+    unsigned long long deadline = stop_publishing + LOAD_DRAIN_SECONDS * 1000000000ULL;
+    int closed = 0;
+
+    for (;;)
+    {
+        run.now = perf_now();
+        while (run.now < stop_publishing && next_publish <= run.now && publish_fd >= 0)
+        {
+            SpectateSnapshot event = { .event = { 0 } };
+            load_next_event(&run, &event.event);
+            run.sent_at[publish_seq % LOAD_TIMES] = run.now;
+            publish_send(&event);
+            spectate_apply(&run.truth, &event);
+            next_publish += interval;
+        }
+        if (publish_fd < 0)
+            break;
+
+        // Draining: done once everyone has the last event
+        int draining = run.now >= stop_publishing;
+        if (draining)
+        {
+            int behind = 0;
+            for (int i = 0; i < connected; i++)
+                behind += spectators[i].fd >= 0 && spectators[i].expect != publish_seq;
+            if (behind == 0 || run.now >= deadline)
+                break;
+        }
+
+        int read_slow = draining || run.now >= next_slow;
+        if (run.now >= next_slow)
+            next_slow = run.now + LOAD_SLOW_MS * 1000000ULL;
+        for (int i = 0; i < connected; i++)
+        {
+            int listen = spectators[i].fd >= 0 && (!spectators[i].slow || read_slow);
+            fds[i] = (struct pollfd){ listen ? spectators[i].fd : -1, POLLIN, 0 };
+        }
+        long long wait_ns = draining ? 10000000LL : (long long)(next_publish - perf_now());
+        if (poll(fds, connected, wait_ns > 0 ? (int)((wait_ns + 999999) / 1000000) : 0) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        run.now = perf_now();
+        for (int i = 0; i < connected; i++)
+        {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !load_read(&spectators[i]))
+            {
+                close(spectators[i].fd);
+                spectators[i].fd = -1;
+                closed++;
+            }
+        }
+    }
+
+    double elapsed = (perf_now() - start) / 1e9;
+    unsigned long long delivered = 0, resyncs = 0, errors = 0, slow_resyncs = 0;
+    int matching = 0, behind = 0;
+    for (int i = 0; i < connected; i++)
+    {
+        LoadSpectator *spectator = &spectators[i];
+        delivered += spectator->events;
+        resyncs += spectator->resyncs;
+        slow_resyncs += spectator->slow ? spectator->resyncs : 0;
+        errors += spectator->errors;
+        matching += spectator->synced && memcmp(&spectator->game, &run.truth, sizeof(PackedGame)) == 0;
+        behind += spectator->fd >= 0 && spectator->expect != publish_seq;
+        if (spectator->fd >= 0)
+            close(spectator->fd);
+    }
+
+    printf("Published %u events in %.1f s; delivered %llu events to %d spectators\n",
+           publish_seq, elapsed, delivered, connected);
+    printf("Resyncs: %llu (%llu on slow spectators); stream errors: %llu; connections lost: %d\n",
+           resyncs, slow_resyncs, errors, closed);
+    if (run.latency_count > 0)
+    {
+        qsort(run.latencies, run.latency_count, sizeof(uint32_t), compare_uint32);
+        size_t last = run.latency_count - 1;
+        printf("Publish-to-spectator latency: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               run.latencies[last / 2] / 1000.0, run.latencies[last * 9 / 10] / 1000.0,
+               run.latencies[last * 99 / 100] / 1000.0, run.latencies[last] / 1000.0);
+    }
+    printf("Final position matches on %d of %d spectators", matching, connected);
+    if (behind > 0)
+        printf(" (%d still behind after %d s of draining)", behind, LOAD_DRAIN_SECONDS);
+    printf("\n");
+
+    if (publish_fd >= 0)
+        close(publish_fd);
+    publish_fd = -1;
+    free(run.latencies);
+    free(run.sent_at);
+    free(spectators);
+    free(fds);
+    load_run = NULL;
+    return connected == count && errors == 0 && matching == connected;
+}
+#else
+int run_hub(int port)
+{
+    (void)port;
+    printf("The spectator hub needs POSIX sockets\n");
+    return 0;
+}
+
+int spectate(int port)
+{
+    (void)port;
+    printf("Spectating needs POSIX sockets\n");
+    return 0;
+}
+
+int spectate_load(int port, int count, int slow, int rate, int seconds)
+{
+    (void)port;
+    (void)count;
+    (void)slow;
+    (void)rate;
+    (void)seconds;
+    printf("The spectator load generator needs POSIX sockets\n");
+    return 0;
+}
+#endif
+
+// Save game state to a slot
+int save_game(const char *slot)
+{
+    PERF_SCOPE(PERF_SAVE_GAME);
+    if (!valid_slot_name(slot))
+    {
+        printf("Invalid slot name. Use letters, digits, '-' and '_'.\n");
+        return 0;
+    }
+
+    char path[600], temp[610];
+    slot_path(path, sizeof(path), slot);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    FILE *fp = fopen(temp, "wb");
+    if (!fp)
+    {
+        printf("Error opening save file!\n");
+        return 0;
+    }
+
+    // Save the board, scores, computer choice and game state
+    PackedGame state;
+    int data[SAVE_STATE_INTS];
+    pack_game(&state, player_moves, player_score, computer_score, com_choice, game_over);
+    unpack_save(&state, data);
+    int written = fwrite(data, sizeof(int), SAVE_STATE_INTS, fp) == SAVE_STATE_INTS;
+
+    // Save random generator so the game replays exactly
+    written = written && fwrite(&game_seed, sizeof(uint64_t), 1, fp) == 1;
+    written = written && fwrite(&game_rng, sizeof(Rng), 1, fp) == 1;
+
+    // Replace the slot only once the new contents are on disk
+    if (!replace_file(fp, temp, path, written))
+    {
+        printf("Error writing save file!\n");
+        return 0;
+    }
+
+    SlotInfo info;
+    slot_info_fill(&info, slot, player_moves, player_score, computer_score, com_choice, game_over,
+                   (int64_t)time(NULL));
+    update_index(&info);
+
+    printf("Game saved to slot '%s'!\n", slot);
+    return 1;
+}
 
+// Load game state from a slot
+int load_game(const char *slot)
+{
+    PERF_SCOPE(PERF_LOAD_GAME);
+    char path[600];
+    if (!valid_slot_name(slot))
+    {
+        printf("Invalid slot name. Use letters, digits, '-' and '_'.\n");
+        return 0;
+    }
+    slot_path(path, sizeof(path), slot);
 
-                int col = idx % WIDTH;
-                count = 0;
-                for (int row = 0; row < HEIGHT; row++)
-                {
-                    if (player_moves[row * WIDTH + col] == 2)
-                        count++;
-                }
-                if (count >= 3)
-                {
-                    comp_num = i;
-                    best_idx = idx;
-                    player_moves[idx] = 0;
-                    break;
-                }
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        printf("No saved game found.\n");
+        return 0;
+    }
+
+    // Load the board, scores, computer choice and game state
+    PackedGame state;
+    int data[SAVE_STATE_INTS];
+    if (fread(data, sizeof(int), SAVE_STATE_INTS, fp) != SAVE_STATE_INTS || !pack_save(&state, data))
+    {
+        printf("Error reading save file!\n");
+        fclose(fp);
+        return 0;
+    }
+    unpack_game(&state, player_moves, &player_score, &computer_score, &com_choice, &game_over);
+
+    // Load random generator (absent in saves from older versions)
+    uint64_t saved_seed;
+    Rng saved_rng;
+    if (fread(&saved_seed, sizeof(uint64_t), 1, fp) == 1 &&
+            fread(&saved_rng, sizeof(Rng), 1, fp) == 1)
+    {
+        game_seed = saved_seed;
+        game_rng = saved_rng;
+    }
+
+    fclose(fp);
+    // The save holds no move history; undo starts over from the loaded position
+    history.count = history.top = 0;
+    think_remaining = think_budget;
+    match_live = 0; // only games played from the start go into the match history
+    printf("Game loaded from slot '%s'!\n", slot);
+    return 1;
+}
+
+// Batch analysis of save files (--analyze). Every file is searched from the
+// player's side with iterative deepening to a fixed depth and/or for a fixed
+// time, on a pool of threads pulling from a shared queue. Results are cached
+// by file content and search settings, so a rerun only searches saves that
+// changed.
+typedef enum
+{
+    ANALYSIS_OK,
+    ANALYSIS_GAME_OVER,
+    ANALYSIS_NO_MOVES,
+    ANALYSIS_UNREADABLE
+} AnalysisStatus;
+
+static const char *analysis_status_names[] = { "ok", "game over", "no moves", "unreadable" };
+
+// Search outcome of one save, as stored in the cache
+typedef struct
+{
+    uint64_t content_hash;
+    uint64_t settings;    // hash of depth, time limit, weights and network
+    int status;
+    int depth;            // deepest completed iteration
+    int best;             // player's best factor, -1 if none
+    int score;            // from the player's side; beyond +-(SEARCH_WIN - SIZE) is a forced result
+    int pv_length;
+    int pv[SIZE];         // factors, alternating player and computer
+    unsigned long long nodes;
+    char *path;           // cache entries: the save it was last seen in, or NULL
+} AnalysisResult;
+
+typedef struct
+{
+    char *path;
+    AnalysisResult result;
+    double millis;
+    int cached;
+} Analysis;
+
+typedef struct
+{
+    Analysis *items;
+    int count;
+    atomic_int next;      // next item to hand out
+    int depth;
+    int movetime;         // milliseconds per file, 0 for none
+    uint64_t settings;
+    const AnalysisResult *cache; // sorted by content hash and settings
+    int cache_count;
+} AnalysisQueue;
+
+int compare_results(const void *a, const void *b)
+{
+    const AnalysisResult *x = a, *y = b;
+    if (x->content_hash != y->content_hash)
+        return x->content_hash < y->content_hash ? -1 : 1;
+    if (x->settings != y->settings)
+        return x->settings < y->settings ? -1 : 1;
+    return 0;
+}
+
+// Read the cache file; entries come back sorted for lookup
+AnalysisResult *load_analysis_cache(const char *path, int *count)
+{
+    *count = 0;
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return NULL;
+
+    int capacity = 256;
+    AnalysisResult *entries = malloc(capacity * sizeof(AnalysisResult));
+    char line[512];
+    while (fgets(line, sizeof(line), fp))
+    {
+        AnalysisResult entry;
+        unsigned long long hash, settings;
+        int used;
+        if (line[0] == '#' ||
+                sscanf(line, "%llx %llx %d %d %d %d %llu %d%n", &hash, &settings, &entry.status,
+                       &entry.depth, &entry.best, &entry.score, &entry.nodes, &entry.pv_length, &used) != 8 ||
+                entry.pv_length < 0 || entry.pv_length > SIZE)
+            continue;
+
+        char *cursor = line + used;
+        for (int i = 0; i < entry.pv_length; i++)
+            entry.pv[i] = (int)strtol(cursor, &cursor, 10);
+        entry.content_hash = hash;
+        entry.settings = settings;
+
+        // The save's path follows a tab (absent in caches from older versions)
+        entry.path = NULL;
+        char *tab = strchr(cursor, '\t');
+        if (tab)
+        {
+            tab[strcspn(tab, "\r\n")] = '\0';
+            entry.path = strdup(tab + 1);
+        }
+
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(AnalysisResult));
+        }
+        entries[(*count)++] = entry;
+    }
+    fclose(fp);
+
+    qsort(entries, *count, sizeof(AnalysisResult), compare_results);
+    return entries;
+}
+
+static void write_analysis_entry(FILE *fp, const AnalysisResult *entry, const char *path)
+{
+    fprintf(fp, "%016llx %016llx %d %d %d %d %llu %d", (unsigned long long)entry->content_hash,
+            (unsigned long long)entry->settings, entry->status, entry->depth, entry->best,
+            entry->score, entry->nodes, entry->pv_length);
+    for (int k = 0; k < entry->pv_length; k++)
+        fprintf(fp, " %d", entry->pv[k]);
+    fprintf(fp, "\t%s\n", path);
+}
+
+int compare_analysis_paths(const void *a, const void *b)
+{
+    const Analysis *const *x = a;
+    const Analysis *const *y = b;
+    return strcmp((*x)->path, (*y)->path);
+}
+
+// Write this run's results plus the old entries still worth keeping, replacing
+// the file atomically. An old entry is dropped when its save no longer exists,
+// or when this run read the same save and either searched it with the same
+// settings or found different contents.
+int save_analysis_cache(const char *path, const AnalysisResult *old, int old_count,
+                        const Analysis *items, int count, uint64_t settings)
+{
+    char temp[600];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *fp = fopen(temp, "w");
+    if (!fp)
+        return 0;
+
+    const Analysis **by_path = malloc((count ? count : 1) * sizeof(Analysis *));
+    if (!by_path)
+    {
+        fclose(fp);
+        remove(temp);
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+        by_path[i] = &items[i];
+    qsort(by_path, count, sizeof(Analysis *), compare_analysis_paths);
+
+    fprintf(fp, "# content_hash settings status depth best score nodes pv_length pv... <tab> file\n");
+    for (int i = 0; i < count; i++)
+    {
+        if (items[i].result.status != ANALYSIS_UNREADABLE)
+            write_analysis_entry(fp, &items[i].result, items[i].path);
+    }
+    for (int i = 0; i < old_count; i++)
+    {
+        struct stat st;
+        if (old[i].path == NULL || stat(old[i].path, &st) != 0)
+            continue;
+
+        Analysis key = { .path = old[i].path };
+        const Analysis *key_ptr = &key;
+        const Analysis **seen = bsearch(&key_ptr, by_path, count, sizeof(Analysis *), compare_analysis_paths);
+        if (seen && (old[i].settings == settings || old[i].content_hash != (*seen)->result.content_hash))
+            continue;
+        write_analysis_entry(fp, &old[i], old[i].path);
+    }
+    free(by_path);
+
+    return replace_file(fp, temp, path, !ferror(fp));
+}
+
+// Search one save to the queue's limits
+void analyze_position(AnalysisResult *result, const int *moves, int multiplier, const AnalysisQueue *queue)
+{
+    SearchResult search;
+    search_position(&search, moves, multiplier, 1, queue->depth, queue->movetime, 0, 0, NULL);
+
+    result->depth = search.depth;
+    result->best = search.best;
+    result->score = search.score;
+    result->pv_length = search.pv_length;
+    memcpy(result->pv, search.pv, sizeof(result->pv));
+    result->nodes = search.nodes;
+    result->status = search.best == -1 ? ANALYSIS_NO_MOVES : ANALYSIS_OK;
+}
+
+// Read, hash and (unless cached) search one save file
+void analyze_item(Analysis *item, const AnalysisQueue *queue)
+{
+    unsigned long long start = perf_now();
+    AnalysisResult *result = &item->result;
+    memset(result, 0, sizeof(*result));
+    result->settings = queue->settings;
+    result->best = -1;
+    result->status = ANALYSIS_UNREADABLE;
+
+    unsigned char data[1024];
+    size_t length = 0;
+    FILE *fp = fopen(item->path, "rb");
+    if (fp)
+    {
+        length = fread(data, 1, sizeof(data), fp);
+        fclose(fp);
+    }
+    if (length < SAVE_STATE_INTS * sizeof(int))
+        return;
+    result->content_hash = content_hash(data, length);
+
+    const AnalysisResult *hit = queue->cache_count ?
+        bsearch(result, queue->cache, queue->cache_count, sizeof(AnalysisResult), compare_results) : NULL;
+    if (hit)
+    {
+        *result = *hit;
+        result->path = NULL;
+        item->cached = 1;
+        item->millis = (perf_now() - start) / 1e6;
+        return;
+    }
+
+    // Same layout as save_game: the board, both scores, the multiplier, game over
+    int fields[SAVE_STATE_INTS], moves[SIZE];
+    PackedGame state;
+    memcpy(fields, data, sizeof(fields));
+    if (!pack_save(&state, fields) || packed_multiplier(&state) == 0)
+        return;
+    for (int i = 0; i < SIZE; i++)
+        moves[i] = packed_owner(&state, i);
+
+    if (packed_game_over(&state) || boardWin(moves, 1) || boardWin(moves, 2) || boardFull(moves))
+        result->status = ANALYSIS_GAME_OVER;
+    else
+        analyze_position(result, moves, packed_multiplier(&state), queue);
+    item->millis = (perf_now() - start) / 1e6;
+}
+
+void *analysis_worker(void *arg)
+{
+    AnalysisQueue *queue = arg;
+    int i;
+    while ((i = atomic_fetch_add(&queue->next, 1)) < queue->count)
+        analyze_item(&queue->items[i], queue);
+    return NULL;
+}
+
+int compare_paths(const void *a, const void *b)
+{
+    return strcmp(((const Analysis *)a)->path, ((const Analysis *)b)->path);
+}
+
+// Add a file, or every save file in a directory (sorted by name), to the work list
+void add_analysis_path(Analysis **items, int *count, int *capacity, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        DIR *dir = opendir(path);
+        if (!dir)
+            return;
+        int first = *count;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            size_t length = strlen(entry->d_name);
+            size_t suffix = strlen(SLOT_SUFFIX);
+            if (length <= suffix || strcmp(entry->d_name + length - suffix, SLOT_SUFFIX) != 0 ||
+                    strcmp(entry->d_name, INDEX_FILE) == 0)
+                continue;
+
+            char child[1024];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            add_analysis_path(items, count, capacity, child);
+        }
+        closedir(dir);
+        qsort(*items + first, *count - first, sizeof(Analysis), compare_paths);
+        return;
+    }
+
+    if (*count == *capacity)
+    {
+        *capacity *= 2;
+        *items = realloc(*items, *capacity * sizeof(Analysis));
+    }
+    memset(&(*items)[*count], 0, sizeof(Analysis));
+    (*items)[(*count)++].path = strdup(path);
+}
+
+// Write text as a quoted CSV field or JSON string
+void write_quoted(FILE *fp, const char *text, int json)
+{
+    fputc('"', fp);
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '"')
+            fputs(json ? "\\\"" : "\"\"", fp);
+        else if (json && *c == '\\')
+            fputs("\\\\", fp);
+        else if (json && (unsigned char)*c < 0x20)
+            fprintf(fp, "\\u%04x", *c);
+        else
+            fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+void write_analysis(FILE *fp, const Analysis *items, int count, int json)
+{
+    if (json)
+        fprintf(fp, "[\n");
+    else
+        fprintf(fp, "file,status,depth,best,score,pv,nodes,ms,cached\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        const Analysis *item = &items[i];
+        const AnalysisResult *result = &item->result;
+        int searched = result->status == ANALYSIS_OK;
 
-                player_moves[idx] = 0;
+        if (json)
+        {
+            fprintf(fp, "  {\"file\": ");
+            write_quoted(fp, item->path, 1);
+            fprintf(fp, ", \"status\": \"%s\"", analysis_status_names[result->status]);
+            if (searched)
+            {
+                fprintf(fp, ", \"depth\": %d, \"best\": %d, \"score\": %d, \"pv\": [",
+                        result->depth, result->best, result->score);
+                for (int k = 0; k < result->pv_length; k++)
+                    fprintf(fp, "%s%d", k ? ", " : "", result->pv[k]);
+                fprintf(fp, "], \"nodes\": %llu", result->nodes);
+            }
+            fprintf(fp, ", \"ms\": %.3f, \"cached\": %s}%s\n", item->millis,
+                    item->cached ? "true" : "false", i + 1 < count ? "," : "");
+        }
+        else
+        {
+            write_quoted(fp, item->path, 0);
+            fprintf(fp, ",%s,", analysis_status_names[result->status]);
+            if (searched)
+            {
+                fprintf(fp, "%d,%d,%d,", result->depth, result->best, result->score);
+                for (int k = 0; k < result->pv_length; k++)
+                    fprintf(fp, "%s%d", k ? " " : "", result->pv[k]);
+                fprintf(fp, ",%llu", result->nodes);
             }
+            else
+            {
+                fprintf(fp, ",,,,");
+            }
+            fprintf(fp, ",%.3f,%d\n", item->millis, item->cached);
         }
     }
 
-    //evaluate
-    if (comp_num == -1)
+    if (json)
+        fprintf(fp, "]\n");
+}
+
+// Analyse every save named by paths and write the report to output (NULL for stdout)
+int analyze_saves(char **paths, int path_count, int depth, int movetime, int threads,
+                  int json, const char *output, const char *cache_path)
+{
+    int count = 0, capacity = 64;
+    Analysis *items = malloc(capacity * sizeof(Analysis));
+    for (int i = 0; i < path_count; i++)
+        add_analysis_path(&items, &count, &capacity, paths[i]);
+
+    AnalysisQueue queue = { .items = items, .count = count, .depth = depth, .movetime = movetime };
+    atomic_init(&queue.next, 0);
+    queue.settings = mix_seed(depth, movetime);
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        queue.settings = mix_seed(queue.settings, (uint64_t)eval_weights[i]);
+    if (nnue)
+        queue.settings = mix_seed(queue.settings, nnue->hash);
+    AnalysisResult *cache = load_analysis_cache(cache_path, &queue.cache_count);
+    queue.cache = cache;
+
+    unsigned long long start = perf_now();
+    if (threads > count)
+        threads = count > 0 ? count : 1;
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    for (int t = 0; t < threads; t++)
+        pthread_create(&workers[t], NULL, analysis_worker, &queue);
+    for (int t = 0; t < threads; t++)
+        pthread_join(workers[t], NULL);
+    free(workers);
+
+    int cached = 0;
+    for (int i = 0; i < count; i++)
+        cached += items[i].cached;
+    if (!save_analysis_cache(cache_path, cache, queue.cache_count, items, count, queue.settings))
+        fprintf(stderr, "Could not write analysis cache %s\n", cache_path);
+
+    int ok = 1;
+    FILE *fp = output ? fopen(output, "w") : stdout;
+    if (fp)
     {
-        for (int i = 1; i <= 9; i++)
+        write_analysis(fp, items, count, json);
+        if (output)
+            ok = fclose(fp) == 0;
+    }
+    else
+    {
+        fprintf(stderr, "Error opening %s\n", output);
+        ok = 0;
+    }
+
+    fprintf(stderr, "Analysed %d files (%d from cache) on %d threads in %.2f s\n",
+            count, cached, threads, (perf_now() - start) / 1e9);
+
+    for (int i = 0; i < count; i++)
+        free(items[i].path);
+    free(items);
+    for (int i = 0; i < queue.cache_count; i++)
+        free(cache[i].path);
+    free(cache);
+    return ok;
+}
+
+// Engine mode (--engine): a line protocol on stdin/stdout modelled on UCI, so
+// tournament managers, servers and test harnesses can drive the search in one
+// resident process. Sides are 1 (moves first from the start position) and 2.
+//   mgi                   identify; answered by id lines and mgiok
+//   isready               answered by readyok
+//   newgame               empty board, multiplier 1, side 1 to move
+//   position startpos|cells <36 digits 0-2> [side S] [multiplier M] [moves F...]
+//   multiplier M          set the multiplier of the side to move
+//   go [depth N] [nodes N] [movetime MS] [time MS] [infinite]
+//                         search; time is the side's remaining game time and
+//                         is split by the think-time manager. With --book, a
+//                         book position is answered from the book at once.
+//   stop                  end the search at once; bestmove follows
+//   d                     print the position
+//   quit
+// A search streams "info depth D score cp S|win N|loss N nodes N nps N time MS
+// pv F..." after each completed depth and ends with "bestmove F" (or "none").
+#define ENGINE_LINE_MAX 1024
+
+typedef struct
+{
+    int moves[SIZE];
+    int multiplier;
+    int side;                 // side to move
+    int finished;             // a line is complete or the board is full
+    pthread_t thread;
+    int searching;            // a search thread is running or not yet joined
+    atomic_int stop;
+    Search search;
+    int max_depth;
+    unsigned long long start; // perf_now() when the search began
+} Engine;
+
+Engine engine;
+pthread_mutex_t engine_output = PTHREAD_MUTEX_INITIALIZER;
+
+// Write one protocol line; the search thread and the reader both print
+void engine_print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&engine_output);
+    vprintf(format, args);
+    putchar('\n');
+    fflush(stdout);
+    pthread_mutex_unlock(&engine_output);
+    va_end(args);
+}
+
+void engine_report(const SearchResult *result, void *data)
+{
+    (void)data;
+    unsigned long long elapsed = perf_now() - engine.start;
+    char line[ENGINE_LINE_MAX], score[32];
+    int length;
+
+    if (result->score >= SEARCH_WIN - SIZE)
+        snprintf(score, sizeof(score), "win %d", SEARCH_WIN - result->score);
+    else if (result->score <= -(SEARCH_WIN - SIZE))
+        snprintf(score, sizeof(score), "loss %d", SEARCH_WIN + result->score);
+    else
+        snprintf(score, sizeof(score), "cp %d", result->score);
+    length = snprintf(line, sizeof(line), "info depth %d score %s nodes %llu nps %llu time %llu pv",
+                      result->depth, score, result->nodes,
+                      elapsed > 0 ? result->nodes * 1000000000ULL / elapsed : 0,
+                      elapsed / 1000000);
+    for (int i = 0; i < result->pv_length && length < (int)sizeof(line) - 4; i++)
+        length += snprintf(line + length, sizeof(line) - length, " %d", result->pv[i]);
+    engine_print("%s", line);
+}
+
+void *engine_search(void *arg)
+{
+    (void)arg;
+    SearchResult result;
+    search_deepen(&engine.search, &result, engine.side, engine.max_depth, engine_report, NULL);
+
+    // Stopped before depth 1 finished: any legal factor beats none
+    for (int factor = 1; factor <= 9 && result.best == -1; factor++)
+    {
+        int idx = product_cell[factor][engine.multiplier];
+        if (idx != -1 && engine.moves[idx] == 0)
+            result.best = factor;
+    }
+    if (result.best == -1 || engine.finished)
+        engine_print("bestmove none");
+    else
+        engine_print("bestmove %d", result.best);
+    return NULL;
+}
+
+// Stop the running search, if any, and wait for its bestmove
+void engine_stop()
+{
+    if (!engine.searching)
+        return;
+    atomic_store(&engine.stop, 1);
+    pthread_join(engine.thread, NULL);
+    engine.searching = 0;
+}
+
+void engine_new_game()
+{
+    memset(engine.moves, 0, sizeof(engine.moves));
+    engine.multiplier = 1;
+    engine.side = 1;
+    engine.finished = 0;
+}
+
+// Play factor for the side to move; returns 0 if it is not legal
+int engine_play(int factor)
+{
+    if (engine.finished || factor < 1 || factor > 9)
+        return 0;
+    int idx = product_cell[factor][engine.multiplier];
+    if (idx == -1 || engine.moves[idx] != 0)
+        return 0;
+
+    engine.moves[idx] = engine.side;
+    engine.finished = search_wins_at(engine.moves, idx) || boardFull(engine.moves);
+    engine.multiplier = factor;
+    engine.side = 3 - engine.side;
+    return 1;
+}
+
+// position startpos|cells <36 digits> [side S] [multiplier M] [moves F...]
+void engine_position(char **save)
+{
+    char *token = strtok_r(NULL, " \t", save);
+    engine_new_game();
+    if (token && strcmp(token, "cells") == 0)
+    {
+        token = strtok_r(NULL, " \t", save);
+        if (!token || strlen(token) != SIZE || strspn(token, "012") != SIZE)
         {
-            int result = multiplication(&i, &player_num);
-            int idx = getIndex(result);
-            if (idx != -1 && player_moves[idx] == 0)
+            engine_print("info string cells needs %d digits 0-2", SIZE);
+            return;
+        }
+        for (int i = 0; i < SIZE; i++)
+            engine.moves[i] = token[i] - '0';
+        // A given board may already be decided; go then answers bestmove none
+        engine.finished = boardWin(engine.moves, 1) || boardWin(engine.moves, 2) || boardFull(engine.moves);
+    }
+    else if (!token || strcmp(token, "startpos") != 0)
+    {
+        engine_print("info string position needs startpos or cells");
+        return;
+    }
+
+    while ((token = strtok_r(NULL, " \t", save)) != NULL)
+    {
+        if (strcmp(token, "side") == 0 && (token = strtok_r(NULL, " \t", save)) != NULL)
+            engine.side = atoi(token) == 2 ? 2 : 1;
+        else if (strcmp(token, "multiplier") == 0 && (token = strtok_r(NULL, " \t", save)) != NULL)
+            engine.multiplier = atoi(token) >= 1 && atoi(token) <= 9 ? atoi(token) : 1;
+        else if (strcmp(token, "moves") == 0)
+        {
+            while ((token = strtok_r(NULL, " \t", save)) != NULL)
             {
-                int value = positionEvaluate(idx);
-                if (value > best_value)
+                if (!engine_play(atoi(token)))
                 {
-                    best_value = value;
-                    comp_num = i;
-                    best_idx = idx;
+                    engine_print("info string illegal move %s", token);
+                    return;
                 }
             }
         }
     }
+}
 
-    // Apply move
-    if (comp_num != -1)
+// go [depth N] [nodes N] [movetime MS] [time MS] [infinite]
+void engine_go(char **save)
+{
+    int depth = SIZE, movetime = 0, remaining = -1;
+    unsigned long long nodes = 0;
+    char *token;
+
+    while ((token = strtok_r(NULL, " \t", save)) != NULL)
     {
-        player_moves[best_idx] = 2;
-        int result = multiplication(&comp_num, &player_num);
-        printf("\nComputer chooses: %d => multiplication result: %d x %d = %d\n",
-               comp_num, comp_num, player_num, result);
-        com_choice = comp_num;
+        char *value = strcmp(token, "infinite") == 0 ? NULL : strtok_r(NULL, " \t", save);
+        if (!value)
+            continue;
+        if (strcmp(token, "depth") == 0)
+            depth = atoi(value) > 0 ? atoi(value) : 1;
+        else if (strcmp(token, "nodes") == 0)
+            nodes = strtoull(value, NULL, 10);
+        else if (strcmp(token, "movetime") == 0)
+            movetime = atoi(value) > 0 ? atoi(value) : 1;
+        else if (strcmp(token, "time") == 0)
+            remaining = atoi(value) > 0 ? atoi(value) : 0;
+    }
 
-        if (checkWin(2))
-        {
-            clear_screen(2);
-            display();
-            updateScore(2);
-            printf("\nComputer Wins by 4 in a line!\n");
-            game_over = 1;
-        }
+    // A book move needs no search
+    int value;
+    int factor = book && !engine.finished ? book_move(book, engine.moves, engine.multiplier, engine.side, &value) : -1;
+    if (factor != -1)
+    {
+        engine_print("info string book %s", value == VALUE_WIN ? "win" : value == VALUE_DRAW ? "draw" : "loss");
+        engine_print("bestmove %d", factor);
+        return;
     }
+
+    // A game clock is shared out by the think-time manager; forced moves get
+    // one ply, enough to see an immediate win
+    if (remaining >= 0 && movetime == 0)
+    {
+        movetime = think_time(engine.moves, engine.multiplier, engine.side, remaining);
+        if (movetime == 0)
+            depth = 1;
+    }
+
+    search_setup(&engine.search, engine.moves, engine.multiplier, movetime, nodes, 0, NULL);
+    atomic_store(&engine.stop, 0);
+    engine.search.stop = &engine.stop;
+    engine.max_depth = engine.finished ? 0 : depth;
+    engine.start = perf_now();
+    engine.searching = 1;
+    pthread_create(&engine.thread, NULL, engine_search, NULL);
 }
 
-// Display CPU register state
-void display_registers()
+// Print the position in the form the position command takes
+void engine_display()
 {
-    printf("CPU State:\n");
-    printf("regA: %d\n", cpu.regA);
-    printf("regB: %d\n", cpu.regB);
-    printf("acc: %d\n", cpu.acc);
+    char cells[SIZE + 1];
+    for (int i = 0; i < SIZE; i++)
+        cells[i] = (char)('0' + engine.moves[i]);
+    cells[SIZE] = '\0';
+    engine_print("info string cells %s side %d multiplier %d%s", cells, engine.side, engine.multiplier,
+                 engine.finished ? " finished" : "");
 }
 
-// Save game state to file
-int save_game()
+// Read commands until quit or end of input
+int engine_loop()
 {
-    FILE *fp = fopen(SAVE_FILE, "wb");
-    if (!fp)
+    char line[ENGINE_LINE_MAX];
+    engine_new_game();
+
+    while (fgets(line, sizeof(line), stdin))
     {
-        printf("Error opening save file!\n");
-        return 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *save;
+        char *command = strtok_r(line, " \t", &save);
+        if (!command)
+            continue;
+
+        if (strcmp(command, "mgi") == 0)
+        {
+            engine_print("id name Multiplication Game");
+            engine_print("id evaluation %s", nnue ? "network" : "weights");
+            engine_print("mgiok");
+        }
+        else if (strcmp(command, "isready") == 0)
+            engine_print("readyok");
+        else if (strcmp(command, "newgame") == 0)
+        {
+            engine_stop();
+            engine_new_game();
+        }
+        else if (strcmp(command, "position") == 0)
+        {
+            engine_stop();
+            engine_position(&save);
+        }
+        else if (strcmp(command, "multiplier") == 0)
+        {
+            char *value = strtok_r(NULL, " \t", &save);
+            engine_stop();
+            if (value && atoi(value) >= 1 && atoi(value) <= 9)
+                engine.multiplier = atoi(value);
+            else
+                engine_print("info string multiplier needs 1-9");
+        }
+        else if (strcmp(command, "go") == 0)
+        {
+            engine_stop();
+            engine_go(&save);
+        }
+        else if (strcmp(command, "stop") == 0)
+            engine_stop();
+        else if (strcmp(command, "d") == 0)
+            engine_display();
+        else if (strcmp(command, "quit") == 0)
+            break;
+        else
+            engine_print("info string unknown command %s", command);
     }
 
-    // Save player move matrix
-    fwrite(player_moves, sizeof(int), SIZE, fp);
+    engine_stop();
+    return 0;
+}
+
+// Prompt for a save slot name on its own line; an empty answer picks the default slot
+void prompt_slot(const char *verb, char *slot)
+{
+    char line[128];
+    printf("%s slot name [%s]: ", verb, DEFAULT_SLOT);
+    fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin))
+        line[0] = '\0';
+    line[strcspn(line, "\r\n")] = '\0';
+    snprintf(slot, SLOT_NAME_MAX, "%s", line[0] ? line : DEFAULT_SLOT);
+}
+
+// Discard the rest of the current input line
+void skip_line()
+{
+    int ch;
+    while ((ch = getchar()) != '\n' && ch != EOF);
+}
+
+// Match mode: games are played back to back by a loop (playMatch), each from
+// a fresh board, keeping only running totals, so a session can go on for days
+// in constant memory. With --autoplay the engine plays the player's side too
+// and nothing waits for input.
+#define GAME_QUIT 2           // playGame result when input ends or the match is stopped
+#define AUTOPLAY_DELAY_MS 800 // pause between autoplay moves so spectators can follow
 
-    // Save scores
-    fwrite(&player_score, sizeof(int), 1, fp);
-    fwrite(&computer_score, sizeof(int), 1, fp);
+int match_target = -1;                     // --match: best-of games, 0 unlimited, -1 ask after each game
+int autoplay = 0;                          // --autoplay: the engine plays the player's side
+int move_delay = AUTOPLAY_DELAY_MS;        // --move-delay; 0 also leaves out the board display
+volatile sig_atomic_t match_stop = 0;      // set by Ctrl-C during autoplay
 
-    // Save computer choice
-    fwrite(&com_choice, sizeof(int), 1, fp);
+typedef struct
+{
+    unsigned long games;
+    unsigned long wins, losses, draws;
+    unsigned long long moves;  // plies over all games
+    unsigned long long millis; // playing time over all games
+    long streak;               // current run: wins if positive, losses if negative
+    long best_streak, worst_streak;
+} MatchStats;
 
-    // Save game state
-    fwrite(&game_over, sizeof(int), 1, fp);
+void match_interrupt(int signal_number)
+{
+    (void)signal_number;
+    match_stop = 1;
+}
 
-    fclose(fp);
-    printf("Game saved successfully!\n");
-    return 1;
+// Is the board shown while the engine plays both sides?
+int autoplay_visible()
+{
+    return !autoplay || move_delay > 0;
 }
 
-// Load game state from file
-int load_game()
+// Pause between autoplay moves, then clear the screen for the next one
+void autoplay_pause()
 {
-    FILE *fp = fopen(SAVE_FILE, "rb");
-    if (!fp)
+    if (move_delay > 0)
     {
-        printf("No saved game found.\n");
-        return 0;
+        fflush(stdout);
+        usleep((useconds_t)move_delay * 1000);
+        clear_screen(0);
     }
+}
 
-    // Load player move matrix
-    if (fread(player_moves, sizeof(int), SIZE, fp) != SIZE)
+// Can factor be played against multiplier on this board?
+int has_legal_factor(const int *moves, int multiplier)
+{
+    for (int factor = 1; factor <= 9; factor++)
     {
-        printf("Error reading save file!\n");
-        fclose(fp);
-        return 0;
+        int idx = product_cell[factor][multiplier];
+        if (idx != -1 && moves[idx] == 0)
+            return 1;
     }
+    return 0;
+}
 
-    // Load scores
-    if (fread(&player_score, sizeof(int), 1, fp) != 1 ||
-            fread(&computer_score, sizeof(int), 1, fp) != 1)
+// Clear the board for the next game; the scores carry over
+void reset_game()
+{
+    memset(player_moves, 0, sizeof(player_moves));
+    history.count = history.top = 0;
+    game_over = 0;
+    com_choice = -1;
+    think_remaining = think_budget;
+    move_note[0] = '\0';
+}
+
+void match_stats_add(MatchStats *stats, int result, int moves, unsigned long long millis)
+{
+    stats->games++;
+    stats->moves += moves;
+    stats->millis += millis;
+    if (result == 1)
     {
-        printf("Error reading save file!\n");
-        fclose(fp);
-        return 0;
+        stats->wins++;
+        stats->streak = stats->streak > 0 ? stats->streak + 1 : 1;
     }
-
-    // Load computer choice
-    if (fread(&com_choice, sizeof(int), 1, fp) != 1)
+    else if (result == -1)
     {
-        printf("Error reading save file!\n");
-        fclose(fp);
-        return 0;
+        stats->losses++;
+        stats->streak = stats->streak < 0 ? stats->streak - 1 : -1;
     }
-
-    // Load game state
-    if (fread(&game_over, sizeof(int), 1, fp) != 1)
+    else
     {
-        printf("Error reading save file!\n");
-        fclose(fp);
-        return 0;
+        stats->draws++;
+        stats->streak = 0;
     }
+    if (stats->streak > stats->best_streak)
+        stats->best_streak = stats->streak;
+    if (stats->streak < stats->worst_streak)
+        stats->worst_streak = stats->streak;
+}
 
-    fclose(fp);
-    printf("Game loaded successfully!\n");
-    return 1;
+// Has one side won a best-of match, or have all its games been played?
+int match_decided(const MatchStats *stats, int target)
+{
+    if (target <= 0)
+        return 0;
+    return stats->games >= (unsigned long)target || stats->wins * 2 > (unsigned long)target ||
+           stats->losses * 2 > (unsigned long)target;
 }
 
-// Play the game
-void playGame()
+void print_match_stats(const MatchStats *stats, int target)
+{
+    if (target > 0)
+        printf("Best of %d, game %lu", target, stats->games);
+    else
+        printf("Game %lu", stats->games);
+    printf(" | You %lu  Computer %lu  Draws %lu", stats->wins, stats->losses, stats->draws);
+    if (stats->games > 0)
+        printf(" | %.1f moves, %.1f s per game", (double)stats->moves / stats->games,
+               stats->millis / 1000.0 / stats->games);
+    if (stats->streak > 1)
+        printf(" | you have won %ld in a row", stats->streak);
+    else if (stats->streak < -1)
+        printf(" | the computer has won %ld in a row", -stats->streak);
+    printf("\n");
+}
+
+// Play one game; returns 1 if the player won, -1 if the computer did, 0 for a
+// tie, or GAME_QUIT if input ran out or the match was stopped
+int playGame()
 {
     int choice;
-    srand(time(NULL));
 
     // Select initial computer choice if not loaded from save
     if (com_choice == -1)
     {
-        com_choice = (rand() % 9) + 1;
+        com_choice = book ? book_opening(book, &game_rng) : -1;
+        if (com_choice == -1)
+            com_choice = rng_range(&game_rng, 9) + 1;
+        match_live = !autoplay; // engine-only games stay out of the match history
+        match_started = perf_now();
+        publish_event(SPECTATE_NEW_GAME, 0, 0, com_choice);
     }
+    else
+        publish_snapshot(); // a loaded game
+    int loaded_over = game_over;
 
     while (!isBoardFull() && !game_over)
     {
-        // Reset terminal color at start of each loop
-        printf("\033[0m");
-
-        printf("\nWelcome to the Multiplication Game!\n");
-        display();
+        if (match_stop)
+            return GAME_QUIT;
+        // A side with no legal factor cannot move, which ends the game in a tie
+        if (!has_legal_factor(player_moves, com_choice))
+            break;
 
-        printf("\nComputer has chosen: %d\n\nPress 0 to see current CPU State\n", com_choice);
-        printf("Press -1 to save game\nPress -2 to load game\n");
-        printf("Enter a number (1-9): ");
+        // Reset terminal color at start of each loop
+        if (autoplay_visible())
+            printf("\033[0m");
 
-        if (scanf("%d", &choice) != 1)
+        if (autoplay)
         {
-            // Clear input buffer if invalid input
-            while (getchar() != '\n');
-            printf("Invalid input. Please enter a number.\n");
-            clear_screen(2);
-            continue;
+            if (autoplay_visible())
+            {
+                printf("\nWelcome to the Multiplication Game!\n");
+                display();
+                show_move_note();
+                printf("\nComputer has chosen: %d\n", com_choice);
+            }
+            move_note[0] = '\0';
+            choice = chooseFactor(player_moves, com_choice, 1, eval_weights, &game_rng);
+            autoplay_pause();
         }
-
-        if (choice == 0)
+        else
         {
-            display_registers();
-            printf("\nPress Enter to continue...");
-            getchar(); // Consume newline
-            getchar(); // Wait for Enter
-            clear_screen(1);
-            continue;
-        }
+            printf("\nWelcome to the Multiplication Game!\n");
+            display();
+            show_move_note();
 
-        if (choice == -1)
-        {
-            save_game();
-            printf("\nPress Enter to continue...");
-            getchar(); // Consume newline
-            getchar(); // Wait for Enter
-            clear_screen(1);
-            continue;
-        }
+            printf("\nComputer has chosen: %d\n\nPress 0 to see current CPU State\n", com_choice);
+            printf("Press -1 to save game\nPress -2 to load game\n");
+            printf("Press -3 to see performance stats\nPress -4 to export them as JSON\n");
+            printf("Press -5 to undo your last move\nPress -6 to redo it\n");
+            printf("Enter a number (1-9): ");
 
-        if (choice == -2)
-        {
-            load_game();
-            printf("\nPress Enter to continue...");
-            getchar(); // Consume newline
-            getchar(); // Wait for Enter
-            clear_screen(1);
-            continue;
-        }
+            int read = scanf("%d", &choice);
+            if (read == EOF)
+                return GAME_QUIT;
+            if (read != 1)
+            {
+                // Clear input buffer if invalid input
+                skip_line();
+                printf("Invalid input. Please enter a number.\n");
+                clear_screen(2);
+                continue;
+            }
 
-        if (choice < 1 || choice > 9)
-        {
-            printf("Invalid input. Please enter a number between 1 and 9.\n");
-            clear_screen(2);
-            continue;
+            if (choice == 0)
+            {
+                display_registers();
+                printf("\nPress Enter to continue...");
+                getchar(); // Consume newline
+                getchar(); // Wait for Enter
+                clear_screen(1);
+                continue;
+            }
+
+            if (choice == -1 || choice == -2)
+            {
+                char slot[SLOT_NAME_MAX];
+                skip_line();
+                if (choice == -1)
+                {
+                    prompt_slot("Save to", slot);
+                    save_game(slot);
+                }
+                else
+                {
+                    list_saves();
+                    prompt_slot("Load from", slot);
+                    if (load_game(slot))
+                    {
+                        publish_snapshot();
+                        loaded_over = game_over;
+                    }
+                }
+                printf("\nPress Enter to continue...");
+                getchar(); // Wait for Enter
+                clear_screen(1);
+                continue;
+            }
+
+            if (choice == -3 || choice == -4)
+            {
+                if (choice == -3)
+                    display_stats();
+                else
+                    export_stats(STATS_FILE);
+                printf("\nPress Enter to continue...");
+                getchar(); // Consume newline
+                getchar(); // Wait for Enter
+                clear_screen(1);
+                continue;
+            }
+
+            if (choice == -5 || choice == -6)
+            {
+                int done = choice == -5 ? undo_turn() : redo_turn();
+                if (!done)
+                    printf("Nothing to %s.\n", choice == -5 ? "undo" : "redo");
+                else
+                    publish_snapshot();
+                clear_screen(done ? 1 : 2);
+                continue;
+            }
+
+            if (choice < 1 || choice > 9)
+            {
+                printf("Invalid input. Please enter a number between 1 and 9.\n");
+                clear_screen(2);
+                continue;
+            }
         }
 
-        int idx = moveCheck(1, choice, com_choice);
+        int multiplier = com_choice;
+        int idx = moveCheck(1, choice, multiplier);
         if (idx != -1)
         {
-            int result = multiplication(&choice, &com_choice);
-            printf("You chose: %d => multiplication result: %d x %d = %d\n",
-                   choice, choice, com_choice, result);
+            publish_event(SPECTATE_MOVE, idx, 1, choice);
+            int result = multiplication(&choice, &multiplier);
+            snprintf(move_note, sizeof(move_note), "You chose: %d => multiplication result: %d x %d = %d\n",
+                     choice, choice, multiplier, result);
 
             if (checkWin(1))
             {
-                clear_screen(1);
-                display();
+                if (autoplay_visible())
+                {
+                    clear_screen(0);
+                    display();
+                    show_move_note();
+                    printf("\nYou Win by 4 in a line!\n");
+                }
                 updateScore(1);
-                printf("\nYou Win by 4 in a line!\n");
                 game_over = 1;
                 break;
             }
@@ -581,40 +6893,462 @@ void playGame()
             continue;
         }
 
-        clear_screen(1);
+        if (!autoplay)
+            clear_screen(0);
 
-        // Computer's turn
-        printf("\nWelcome to the Multiplication Game!\n");
-        display();
-        animate_thinking();
+        // Computer's turn; it takes only the time the think-time manager gives it
+        if (autoplay_visible())
+        {
+            printf("\nWelcome to the Multiplication Game!\n");
+            display();
+            show_move_note();
+        }
+        unsigned long long turn_start = trace_path ? perf_now() : 0;
         compMove(choice);
-        clear_screen(2);
+        trace_complete("computer turn", turn_start);
+        if (!game_over)
+        {
+            if (autoplay)
+                autoplay_pause();
+            else
+                clear_screen(0);
+        }
     }
 
-    if (!game_over)
+    if (!game_over && autoplay_visible())
     {
         display();
         printf("\n====== GAME OVER ======\nIt's a tie. No 4 in a row or column achieved.\n");
     }
 
-    printf("\nFinal Score - Player: %d  Computer: %d\n", player_score, computer_score);
-    printf("\nWould you like to play again? (1=Yes, 0=No): ");
-    int play_again;
-    scanf("%d", &play_again);
+    int result = checkWin(1) ? 1 : checkWin(2) ? -1 : 0;
+    if (!loaded_over)
+        publish_event(SPECTATE_END, 0, result == 1 ? 1 : result == -1 ? 2 : 0, 0);
+    if (autoplay_visible())
+        printf("\nFinal Score - Player: %d  Computer: %d\n", player_score, computer_score);
+    if (match_live)
+    {
+        record_match(result);
+        printf("\n");
+        show_leaderboard(LEADERBOARD_SIZE);
+    }
+    return result;
+}
+
+// Play games until the match is decided, the player stops or input ends. The
+// first game may be a loaded one; every later game starts from a fresh board.
+void playMatch(int target)
+{
+    MatchStats stats = { 0 };
+
+    if (autoplay)
+        signal(SIGINT, match_interrupt);
+
+    for (;;)
+    {
+        unsigned long long start = perf_now();
+        int result = playGame();
+        if (result == GAME_QUIT)
+            break;
+
+        // Count plies from the board: a resumed save has no undo history for its earlier moves
+        PackedGame final;
+        pack_game(&final, player_moves, player_score, computer_score, com_choice, game_over);
+        match_stats_add(&stats, result, packed_move_count(&final), (perf_now() - start) / 1000000ULL);
+        printf("\n");
+        print_match_stats(&stats, target);
+        fflush(stdout);
+        if (match_decided(&stats, target) || match_stop)
+            break;
+
+        if (target < 0)
+        {
+            printf("\nWould you like to play again? (1=Yes, 0=No): ");
+            int play_again = 0;
+            if (scanf("%d", &play_again) != 1 || play_again != 1)
+                break;
+            skip_line();
+        }
+
+        reset_game();
+        if (autoplay)
+            autoplay_pause();
+        else
+            clear_screen(1);
+    }
 
-    if (play_again == 1)
+    if (target > 0 && match_decided(&stats, target))
     {
-        // Reset game state
-        memset(player_moves, 0, sizeof(player_moves));
-        game_over = 0;
-        com_choice = -1;
-        clear_screen(1);
-        playGame();
+        printf("\n====== MATCH OVER ======\n");
+        if (stats.wins != stats.losses)
+            printf("%s the best of %d, %lu to %lu\n", stats.wins > stats.losses ? "You win" : "The computer wins",
+                   target, stats.wins > stats.losses ? stats.wins : stats.losses,
+                   stats.wins > stats.losses ? stats.losses : stats.wins);
+        else
+            printf("The best of %d is drawn, %lu to %lu\n", target, stats.wins, stats.losses);
     }
+    if (stats.games > 1)
+        printf("\nSession: %lu games, longest run of wins %ld, of losses %ld\n", stats.games,
+               stats.best_streak, -stats.worst_streak);
+    if (autoplay)
+        signal(SIGINT, SIG_DFL);
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    int seeded = 0;
+    int tune_iterations = 0;
+    int tune_pairs = 1000;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *weights_path = WEIGHTS_FILE;
+    int analyze = 0;
+    int depth = 0;
+    int movetime = 0;
+    int json = 0;
+    const char *output = NULL;
+    const char *cache_path = ANALYSIS_CACHE_FILE;
+    const char *nnue_path = NULL;
+    const char *positions_path = NULL;
+    const char *train_path = NULL;
+    int epochs = 10;
+    int engine_mode = 0;
+    int solve_mode = 0;
+    int solve_seconds = 0;
+    int hash_mb = SOLVE_HASH_MB;
+    const char *checkpoint = SOLVE_CHECKPOINT_FILE;
+    const char *book_path = NULL;
+    int leaderboard = 0;
+    const char *history_name = NULL;
+    int compact = 0;
+    int aggregate_mode = 0;
+    int hub_mode = 0;
+    int spectate_mode = 0;
+    int publish = 0;
+    int port = SPECTATE_PORT;
+    int load_spectators = 0;
+    int slow_spectators = 0;
+    int event_rate = 1000;
+    int load_seconds = 10;
+    const char *player_specs[TOURNAMENT_MAX_PLAYERS];
+    int player_count = 0;
+    double elo0 = 0, elo1 = 0;
+    char **paths = calloc(argc, sizeof(char *));
+    int path_count = 0;
+
+    // Matches are recorded under the login name unless --name says otherwise
+#ifdef _WIN32
+    const char *user = getenv("USERNAME");
+#else
+    const char *user = getenv("USER");
+#endif
+    if (user && user[0])
+        snprintf(player_name, sizeof(player_name), "%s", user);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--trace") == 0)
+        {
+            trace_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "trace.json";
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            game_seed = strtoull(argv[++i], NULL, 10);
+            seeded = 1;
+        }
+        else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc)
+        {
+            weights_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tune") == 0 && i + 1 < argc)
+        {
+            tune_iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+        {
+            tune_pairs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--list-saves") == 0)
+        {
+            list_saves();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+        {
+            snprintf(player_name, sizeof(player_name), "%s", argv[++i]);
+        }
+        else if (strcmp(argv[i], "--leaderboard") == 0)
+        {
+            leaderboard = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i]) : LEADERBOARD_SIZE;
+        }
+        else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            history_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compact-matches") == 0)
+        {
+            compact = 1;
+        }
+        else if (strcmp(argv[i], "--match") == 0 && i + 1 < argc)
+        {
+            match_target = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--autoplay") == 0)
+        {
+            autoplay = 1;
+        }
+        else if (strcmp(argv[i], "--move-delay") == 0 && i + 1 < argc)
+        {
+            move_delay = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hub") == 0)
+        {
+            hub_mode = 1;
+        }
+        else if (strcmp(argv[i], "--publish") == 0)
+        {
+            publish = 1;
+        }
+        else if (strcmp(argv[i], "--spectate") == 0)
+        {
+            spectate_mode = 1;
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--spectate-load") == 0 && i + 1 < argc)
+        {
+            load_spectators = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--slow") == 0 && i + 1 < argc)
+        {
+            slow_spectators = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+        {
+            event_rate = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            load_seconds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--think-budget") == 0 && i + 1 < argc)
+        {
+            think_budget = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc && parse_level(argv[i + 1]) != -1)
+        {
+            difficulty = parse_level(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--analyze") == 0)
+        {
+            analyze = 1;
+        }
+        else if (strcmp(argv[i], "--aggregate") == 0)
+        {
+            aggregate_mode = 1;
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc)
+        {
+            movetime = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "csv") == 0 || strcmp(argv[i + 1], "json") == 0))
+        {
+            json = strcmp(argv[++i], "json") == 0;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cache_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--player") == 0 && i + 1 < argc && player_count < TOURNAMENT_MAX_PLAYERS)
+        {
+            player_specs[player_count++] = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sprt") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%lf,%lf", &elo0, &elo1) == 2)
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--solve") == 0)
+        {
+            solve_mode = 1;
+        }
+        else if (strcmp(argv[i], "--solve-time") == 0 && i + 1 < argc)
+        {
+            solve_seconds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+        {
+            hash_mb = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            checkpoint = argv[++i];
+        }
+        else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+        {
+            book_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--engine") == 0)
+        {
+            engine_mode = 1;
+        }
+        else if (strcmp(argv[i], "--nnue") == 0 && i + 1 < argc)
+        {
+            nnue_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gen-positions") == 0 && i + 1 < argc)
+        {
+            positions_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--train-nnue") == 0 && i + 1 < argc)
+        {
+            train_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--epochs") == 0 && i + 1 < argc)
+        {
+            epochs = atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-')
+        {
+            paths[path_count++] = argv[i];
+        }
+        else
+        {
+            printf("Usage: %s [--trace [FILE]] [--seed N] [--weights FILE] [--think-budget MS]\n"
+                   "          [--level 0-5|NAME] [--nnue FILE] [--book FILE] [--name NAME] [--list-saves]\n"
+                   "          [--match GAMES] [--autoplay [--move-delay MS]] [--publish [--port N]]\n"
+                   "       %s --hub [--port N] | --spectate [--port N]\n"
+                   "       %s --spectate-load SPECTATORS [--slow N] [--rate EVENTS] [--seconds S] [--port N]\n"
+                   "       %s --leaderboard [N] | --history NAME | --compact-matches\n"
+                   "       %s --tune ITERATIONS [--games PAIRS] [--threads N] [--weights FILE]\n"
+                   "       %s --analyze [--depth N] [--movetime MS] [--format csv|json] [--output FILE]\n"
+                   "          [--cache FILE] [--threads N] [--weights FILE] [--nnue FILE] FILE|DIR...\n"
+                   "       %s --engine [--weights FILE] [--nnue FILE]\n"
+                   "       %s --solve [--threads N] [--hash MB] [--solve-time S] [--checkpoint FILE] [--book FILE]\n"
+                   "       %s --player SPEC --player SPEC... [--games PAIRS] [--sprt ELO0,ELO1] [--threads N]\n"
+                   "       %s --aggregate [--games N] [--output FILE] [--threads N] [--seed N] [MATCHLOG...]\n"
+                   "       %s --gen-positions FILE [--games N] [--threads N] [--seed N]\n"
+                   "       %s --train-nnue POSITIONS [--epochs N] [--nnue FILE] [--seed N]\n",
+                   argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (path_count > 0 && !analyze && !aggregate_mode)
+    {
+        printf("Unexpected argument %s (save files are analysed with --analyze, match logs with --aggregate)\n", paths[0]);
+        return 1;
+    }
+    if (compact)
+        return compact_matches() ? 0 : 1;
+    if (leaderboard > 0 || history_name)
+    {
+        if (leaderboard > 0)
+            show_leaderboard(leaderboard);
+        if (history_name)
+            show_match_history(history_name, LEADERBOARD_SIZE);
+        return 0;
+    }
+    if (threads < 1)
+        threads = 1;
+    if (think_budget < 0)
+        think_budget = 0;
+    think_remaining = think_budget;
+    if (move_delay < 0)
+        move_delay = 0;
+    // Nobody is there to answer "play again?" under autoplay
+    if (autoplay && match_target < 0)
+        match_target = 0;
+    if (tune_pairs < 1)
+        tune_pairs = 1;
+
+    // Seed random number generator
+    if (!seeded)
+        game_seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    rng_seed(&game_rng, game_seed);
+
+    load_weights(weights_path, eval_weights);
+    search_init();
+    if (hub_mode)
+        return run_hub(port) ? 0 : 1;
+    if (spectate_mode)
+        return spectate(port) ? 0 : 1;
+    if (load_spectators > 0)
+        return spectate_load(port, load_spectators, slow_spectators, event_rate, load_seconds > 0 ? load_seconds : 1)
+               ? 0 : 1;
+    if (aggregate_mode)
+        return aggregate(paths, path_count, tune_pairs, threads, output ? output : AGGREGATE_FILE) ? 0 : 1;
+    if (positions_path)
+        return generate_positions(positions_path, tune_pairs, threads) ? 0 : 1;
+    if (train_path)
+        return train_nnue(train_path, epochs > 0 ? epochs : 1, nnue_path ? nnue_path : NNUE_FILE) ? 0 : 1;
+    if (nnue_path && !(nnue = load_nnue(nnue_path)))
+    {
+        printf("Could not load the network %s\n", nnue_path);
+        return 1;
+    }
+    if (solve_mode)
+        return solve(threads, hash_mb > 0 ? hash_mb : SOLVE_HASH_MB, solve_seconds, checkpoint,
+                     book_path ? book_path : BOOK_FILE) ? 0 : 1;
+    if (book_path && !(book = load_book(book_path)))
+    {
+        printf("Could not load the book %s\n", book_path);
+        return 1;
+    }
+    if (engine_mode)
+        return engine_loop();
+    if (player_count > 0)
+    {
+        Player players[TOURNAMENT_MAX_PLAYERS];
+        for (int i = 0; i < player_count; i++)
+        {
+            if (!parse_player(player_specs[i], &players[i]))
+            {
+                printf("Bad player %s (rules|search[,name=N][,weights=FILE][,nnue=FILE][,level=L]"
+                       "[,depth=N][,nodes=N][,movetime=MS][,noise=N])\n", player_specs[i]);
+                for (int k = 0; k <= i; k++)
+                    free_player(&players[k]);
+                return 1;
+            }
+        }
+        if (player_count < 2)
+        {
+            printf("A tournament needs at least two --player options\n");
+            free_player(&players[0]);
+            return 1;
+        }
+        int ok = tournament(players, player_count, tune_pairs, threads, elo0, elo1);
+        for (int i = 0; i < player_count; i++)
+            free_player(&players[i]);
+        return ok ? 0 : 1;
+    }
+    if (tune_iterations > 0)
+        return tune(tune_iterations, tune_pairs, threads, weights_path) ? 0 : 1;
+    if (analyze)
+    {
+        // A time limit alone searches as deep as the time allows
+        if (depth <= 0)
+            depth = movetime > 0 ? SIZE : ANALYSIS_DEPTH;
+        return analyze_saves(paths, path_count, depth, movetime > 0 ? movetime : 0, threads,
+                             json, output, cache_path) ? 0 : 1;
+    }
+    trace_epoch = perf_now();
+    atexit(trace_flush);
+
     // Initialize terminal for color support
 #ifdef _WIN32
     // For Windows
@@ -628,6 +7362,28 @@ int main()
     printf("\n===================================\n");
     printf("  MULTIPLICATION STRATEGY GAME");
     printf("\n===================================\n");
+    printf("Seed: %llu\n", (unsigned long long)game_seed);
+    printf("Level: %s\n", difficulty_levels[difficulty].name);
+    printf("Player: %s\n", autoplay ? "autoplay" : player_name);
+    if (match_target > 0)
+        printf("Match: best of %d\n", match_target);
+    else if (match_target == 0)
+        printf("Match: until stopped\n");
+    if (nnue)
+        printf("Evaluation: network %s\n", nnue_path);
+    if (book)
+        printf("Perfect play: %s (%u positions)\n", book_path, book->header.count);
+    if (publish)
+    {
+        publish_fd = spectate_connect(port, SPECTATE_PUBLISHER);
+        if (publish_fd >= 0)
+        {
+            printf("Publishing moves to the spectator hub on port %d\n", port);
+            publish_snapshot();
+        }
+        else
+            printf("No spectator hub on port %d; playing without spectators\n", port);
+    }
     printf("\nRules:\n");
     printf("# The computer will choose a number (1-9)\n");
     printf("# You choose a number (1-9)\n");
@@ -636,25 +7392,34 @@ int main()
     printf("# Press 0 to view the CPU simulation state\n");
     printf("# Press -1 to save your game\n");
     printf("# Press -2 to load a saved game\n");
-    printf("\nDo you want to load a saved game? (1=Yes, 0=No): ");
-
-    int load_choice;
-    scanf("%d", &load_choice);
+    printf("# Press -3 to view performance stats, -4 to export them\n");
+    printf("# Press -5 to undo your last move, -6 to redo it\n");
 
-    if (load_choice == 1)
+    if (!autoplay)
     {
-        if (!load_game())
+        printf("\nDo you want to load a saved game? (1=Yes, 0=No): ");
+
+        int load_choice = 0;
+        scanf("%d", &load_choice);
+        skip_line();
+
+        if (load_choice == 1)
         {
-            printf("Starting new game instead.\n");
-            sleep(2);
+            char slot[SLOT_NAME_MAX];
+            list_saves();
+            prompt_slot("Load from", slot);
+            if (!load_game(slot))
+            {
+                printf("Starting new game instead.\n");
+                sleep(2);
+            }
         }
-    }
 
-    printf("\nPress Enter to start...");
-    getchar(); // Consume newline
-    getchar(); // Wait for Enter
+        printf("\nPress Enter to start...");
+        getchar(); // Wait for Enter
+    }
 
-    playGame();
+    playMatch(match_target);
 
     return 0;
 }